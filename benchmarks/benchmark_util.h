@@ -0,0 +1,61 @@
+#pragma once
+#ifndef _SIMPLIDFS_BENCHMARK_UTIL_H
+#define _SIMPLIDFS_BENCHMARK_UTIL_H
+
+#include <chrono>
+#include <cstdio>
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Minimal timing helpers shared by the SimpliDFS micro-benchmarks.
+ * The benchmarks are plain executables so that they build without extra dependencies.
+ */
+namespace Benchmark {
+
+/** @brief Keeps the compiler from discarding a computed value. */
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * @brief Runs body repeatedly for at least minSeconds and returns the average cost of one call.
+ * @param body Callable executed once per iteration.
+ * @param minSeconds Minimum wall time spent measuring.
+ * @return Average nanoseconds per call.
+ */
+template <typename Body>
+double MeasureNanosPerOp(Body&& body, double minSeconds = 0.2) {
+    using Clock = std::chrono::steady_clock;
+    size_t iterations = 0;
+    size_t batch = 1;
+    Clock::time_point start = Clock::now();
+    double elapsed = 0;
+    do {
+        for (size_t i = 0; i < batch; ++i) {
+            body();
+        }
+        iterations += batch;
+        batch *= 2;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (elapsed < minSeconds);
+    return elapsed * 1e9 / iterations;
+}
+
+/** @brief Prints one result row: name, parameter, nanoseconds per op and throughput. */
+inline void Report(const std::string& name, const std::string& parameter, double nanosPerOp, size_t bytesPerOp) {
+    double megabytesPerSecond = bytesPerOp > 0 ? (bytesPerOp / (nanosPerOp / 1e9)) / (1024.0 * 1024.0) : 0;
+    std::printf("%-40s %-12s %14.1f ns/op %12.1f MiB/s\n", name.c_str(), parameter.c_str(), nanosPerOp, megabytesPerSecond);
+}
+
+/** @brief Formats a byte count as "16B", "4KiB" or "1MiB". */
+inline std::string FormatSize(size_t bytes) {
+    if (bytes >= 1024 * 1024 && bytes % (1024 * 1024) == 0) return std::to_string(bytes / (1024 * 1024)) + "MiB";
+    if (bytes >= 1024 && bytes % 1024 == 0) return std::to_string(bytes / 1024) + "KiB";
+    return std::to_string(bytes) + "B";
+}
+
+}
+
+#endif
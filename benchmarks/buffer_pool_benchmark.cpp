@@ -0,0 +1,32 @@
+// Compares allocating a fresh receive buffer per message with taking one from Networking::BufferPool.
+#include "benchmark_util.h"
+#include "bufferpool.h"
+#include <cstdio>
+#include <vector>
+
+int main() {
+    const std::vector<size_t> messageSizes = {512, 16 * 1024, 256 * 1024, 4 * 1024 * 1024};
+    Networking::BufferPool pool;
+
+    for (size_t messageSize : messageSizes) {
+        std::string parameter = Benchmark::FormatSize(messageSize);
+
+        // Touch one byte per page so the cost of faulting in fresh memory is counted
+        Benchmark::Report("vector/allocate", parameter,
+            Benchmark::MeasureNanosPerOp([&]() {
+                std::vector<char> buffer(messageSize);
+                for (size_t i = 0; i < buffer.size(); i += 4096) buffer[i] = 1;
+                Benchmark::DoNotOptimize(buffer.data());
+            }), messageSize);
+        Benchmark::Report("pool/acquire", parameter,
+            Benchmark::MeasureNanosPerOp([&]() {
+                Networking::SharedBuffer buffer = pool.Acquire(messageSize);
+                for (size_t i = 0; i < buffer->size(); i += 4096) (*buffer)[i] = 1;
+                Benchmark::DoNotOptimize(buffer->data());
+            }), messageSize);
+    }
+
+    Networking::BufferPool::Stats stats = pool.GetStats();
+    std::printf("pool hit rate %.4f, %zu bytes pooled\n", stats.HitRate(), stats.pooledBytes);
+    return 0;
+}
@@ -0,0 +1,78 @@
+// Measures the frame compression stage on text logs, the workload it is meant
+// for, and on random bytes, which it should give up on quickly.
+#include "benchmark_util.h"
+#include "compression.h"
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<char> MakeLogText(size_t size) {
+    static const char* const levels[] = {"INFO", "WARN", "DEBUG", "ERROR"};
+    static const char* const events[] = {"heartbeat received from node", "replicating chunk to node",
+                                         "write committed for file", "client connection closed for file"};
+    std::mt19937 random(42);
+    std::string text;
+    while (text.size() < size) {
+        char line[160];
+        std::snprintf(line, sizeof(line), "2026-10-16T12:%02u:%02u.%03uZ [%s] %s node-%u /data/file_%05u.log\n",
+                      (unsigned)(random() % 60), (unsigned)(random() % 60), (unsigned)(random() % 1000),
+                      levels[random() % 4], events[random() % 4], (unsigned)(random() % 16), (unsigned)(random() % 50000));
+        text += line;
+    }
+    return std::vector<char>(text.begin(), text.begin() + size);
+}
+
+std::vector<char> MakeRandomBytes(size_t size) {
+    std::mt19937 random(7);
+    std::vector<char> bytes(size);
+    for (char& byte : bytes) byte = (char)random();
+    return bytes;
+}
+
+}
+
+int main() {
+    const std::vector<size_t> payloadSizes = {4 * 1024, 64 * 1024, 1024 * 1024};
+
+    for (size_t payloadSize : payloadSizes) {
+        std::string parameter = Benchmark::FormatSize(payloadSize);
+        const std::pair<const char*, std::vector<char> > inputs[] = {
+            {"logs", MakeLogText(payloadSize)},
+            {"random", MakeRandomBytes(payloadSize)},
+        };
+
+        for (const auto& input : inputs) {
+            const std::vector<char>& payload = input.second;
+            std::vector<char> compressed(Networking::CompressedPayloadBound(payload.size()));
+            size_t compressedSize = Networking::CompressFramePayload(Networking::CompressionCodec::Lz,
+                                                                     payload.data(), payload.size(), compressed.data());
+
+            Benchmark::Report(std::string("lz/compress/") + input.first, parameter,
+                Benchmark::MeasureNanosPerOp([&]() {
+                    Benchmark::DoNotOptimize(Networking::CompressFramePayload(Networking::CompressionCodec::Lz,
+                        payload.data(), payload.size(), compressed.data()));
+                }), payload.size());
+
+            if (compressedSize == 0) {
+                std::printf("%s/%s: incompressible, sent as is\n", input.first, parameter.c_str());
+                continue;
+            }
+            std::vector<char> restored(payload.size());
+            Benchmark::Report(std::string("lz/decompress/") + input.first, parameter,
+                Benchmark::MeasureNanosPerOp([&]() {
+                    Benchmark::DoNotOptimize(Networking::DecompressFramePayload(Networking::CompressionCodec::Lz,
+                        compressed.data(), compressedSize, restored.data(), restored.size()));
+                }), payload.size());
+            std::printf("%s/%s: ratio %.2f\n", input.first, parameter.c_str(), (double)payload.size() / compressedSize);
+        }
+    }
+
+    Networking::CompressionStats stats = Networking::GetCompressionStats();
+    std::printf("compressed %llu frames at ratio %.2f, %.1f ms compressing, %.1f ms decompressing\n",
+                (unsigned long long)stats.framesCompressed, stats.Ratio(),
+                stats.compressNanoseconds / 1e6, stats.decompressNanoseconds / 1e6);
+    return 0;
+}
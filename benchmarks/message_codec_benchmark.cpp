@@ -0,0 +1,38 @@
+// Compares the legacy pipe-delimited text codec with the binary codec in message.h, decoding
+// into owning Messages and into MessageViews.
+#include "benchmark_util.h"
+#include "message.h"
+#include <vector>
+
+int main() {
+    const std::vector<size_t> contentSizes = {16, 1024, 64 * 1024, 1024 * 1024};
+
+    for (size_t contentSize : contentSizes) {
+        Message msg;
+        msg._Type = MessageType::WriteFile;
+        msg._Filename = "logs/2024/08/04/node-17.log";
+        // The text format cannot carry '|', so the payload avoids it for a fair comparison
+        msg._Content.assign(contentSize, 'x');
+        msg._NodeAddress = "10.0.12.34";
+        msg._NodePort = 50505;
+
+        std::string text = Message::Serialize(msg);
+        std::string binary = Message::SerializeBinary(msg);
+        std::string parameter = Benchmark::FormatSize(contentSize);
+
+        Benchmark::Report("text/serialize", parameter,
+            Benchmark::MeasureNanosPerOp([&]() { Benchmark::DoNotOptimize(Message::Serialize(msg)); }), text.size());
+        Benchmark::Report("binary/serialize", parameter,
+            Benchmark::MeasureNanosPerOp([&]() { Benchmark::DoNotOptimize(Message::SerializeBinary(msg)); }), binary.size());
+        Benchmark::Report("text/deserialize", parameter,
+            Benchmark::MeasureNanosPerOp([&]() { Benchmark::DoNotOptimize(Message::Deserialize(text)); }), text.size());
+        Benchmark::Report("binary/deserialize", parameter,
+            Benchmark::MeasureNanosPerOp([&]() { Benchmark::DoNotOptimize(Message::DeserializeBinary(binary)); }), binary.size());
+        // MessageView leaves the fields in the encoded buffer instead of copying them
+        Benchmark::Report("text/view", parameter,
+            Benchmark::MeasureNanosPerOp([&]() { Benchmark::DoNotOptimize(MessageView::Deserialize(text.data(), text.size())); }), text.size());
+        Benchmark::Report("binary/view", parameter,
+            Benchmark::MeasureNanosPerOp([&]() { Benchmark::DoNotOptimize(MessageView::DeserializeBinary(binary.data(), binary.size())); }), binary.size());
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+// Compares the request throughput of Server::Run in blocking (thread per
+// connection), epoll and io_uring mode over TCP loopback.
+#include "benchmark_util.h"
+#include "client.h"
+#include "server.h"
+#include "uringloop.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const int BENCHMARK_PORT = 12498;
+
+// Each client sends requestsPerClient echo requests of messageSize bytes, one
+// at a time on its own keep-alive connection. Returns the average wall time
+// per request across all clients.
+double MeasureServer(Networking::ServerMode mode, int clientCount, int requestsPerClient, size_t messageSize) {
+    Networking::Server server(BENCHMARK_PORT);
+    server.SetKeepAlive(true);
+    std::thread runThread([&]() {
+        server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+            server.SendFrame(message.data(), message.size(), c);
+        }, mode);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::string payload(messageSize, 'x');
+    std::atomic<int> ready{0};
+    std::atomic<bool> start{false};
+    std::vector<std::thread> clients;
+    for (int i = 0; i < clientCount; ++i) {
+        clients.emplace_back([&]() {
+            Networking::Client client("127.0.0.1", BENCHMARK_PORT);
+            ready++;
+            while (!start) std::this_thread::yield();
+            for (int r = 0; r < requestsPerClient; ++r) {
+                client.SendFrame(payload);
+                std::vector<char> reply = client.ReceiveFrame();
+                Benchmark::DoNotOptimize(reply.data());
+            }
+            client.Disconnect();
+        });
+    }
+    while (ready < clientCount) std::this_thread::yield();
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    start = true;
+    for (auto& client : clients) client.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    server.Stop();
+    runThread.join();
+    return elapsed * 1e9 / (double(clientCount) * requestsPerClient);
+}
+
+}
+
+int main() {
+    struct Mode {
+        const char* name;
+        Networking::ServerMode mode;
+    };
+    std::vector<Mode> modes = {
+        {"blocking", Networking::ServerMode::Blocking},
+        {"epoll", Networking::ServerMode::Epoll},
+    };
+    if (Networking::UringLoop::IsSupported())
+        modes.push_back({"uring", Networking::ServerMode::Uring});
+    else
+        std::printf("io_uring is not available; skipping uring mode\n");
+
+    const int totalRequests = 20000;
+    for (size_t messageSize : {size_t(64), size_t(16 * 1024)}) {
+        for (int clientCount : {1, 16, 64}) {
+            for (const Mode& mode : modes) {
+                double nanosPerOp = MeasureServer(mode.mode, clientCount, totalRequests / clientCount, messageSize);
+                Benchmark::Report(std::string("server-") + mode.name + "/" + std::to_string(clientCount) + "-clients",
+                    Benchmark::FormatSize(messageSize), nanosPerOp, 2 * messageSize);
+            }
+        }
+    }
+    return 0;
+}
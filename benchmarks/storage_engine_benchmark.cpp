@@ -0,0 +1,85 @@
+// Compares the in-memory storage engine with the log-structured disk engine behind
+// FileSystem: overwrites, whole-file, shared and ranged reads, and what recovering a log on startup costs.
+#include "benchmark_util.h"
+#include "filesystem.h"
+#include "logstorageengine.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace {
+
+const char* const DATA_DIRECTORY = "storage_engine_benchmark_data";
+const size_t FILE_COUNT = 64;
+
+std::string FileName(size_t index) {
+    return "dir/file-" + std::to_string(index);
+}
+
+// Writes and then reads FILE_COUNT files of the given size, round-robin
+void Run(const std::string& engineName, StorageEngine* engine, size_t fileSize) {
+    FileSystem fs{std::unique_ptr<StorageEngine>(engine)};
+    std::string content(fileSize, 'c');
+    for (size_t i = 0; i < FILE_COUNT; ++i) {
+        fs.createFile(FileName(i));
+    }
+    std::string parameter = Benchmark::FormatSize(fileSize);
+
+    size_t next = 0;
+    Benchmark::Report(engineName + "/write", parameter,
+        Benchmark::MeasureNanosPerOp([&]() {
+            Benchmark::DoNotOptimize(fs.writeFile(FileName(next++ % FILE_COUNT), content));
+        }, 0.1), fileSize);
+    Benchmark::Report(engineName + "/read", parameter,
+        Benchmark::MeasureNanosPerOp([&]() {
+            Benchmark::DoNotOptimize(fs.readFile(FileName(next++ % FILE_COUNT)));
+        }), fileSize);
+    Benchmark::Report(engineName + "/read-shared", parameter,
+        Benchmark::MeasureNanosPerOp([&]() {
+            Benchmark::DoNotOptimize(fs.readFileShared(FileName(next++ % FILE_COUNT)));
+        }), fileSize);
+    // A 4KiB slice from the middle of the file, the way clients tail and page through large files
+    const size_t rangeLength = std::min<size_t>(4096, fileSize);
+    Benchmark::Report(engineName + "/read-range-4KiB", parameter,
+        Benchmark::MeasureNanosPerOp([&]() {
+            Benchmark::DoNotOptimize(fs.readRange(FileName(next++ % FILE_COUNT), fileSize / 2, rangeLength));
+        }), rangeLength);
+}
+
+}
+
+int main() {
+    const std::vector<size_t> fileSizes = {4 * 1024, 64 * 1024, 1024 * 1024};
+
+    for (size_t fileSize : fileSizes) {
+        Run("memory", new MemoryStorageEngine(), fileSize);
+
+        std::filesystem::remove_all(DATA_DIRECTORY);
+        LogStorageEngine* log = new LogStorageEngine(DATA_DIRECTORY);
+        Run("log", log, fileSize);
+
+        // Reopening replays and checksums every segment written above
+        using Clock = std::chrono::steady_clock;
+        Clock::time_point start = Clock::now();
+        LogStorageEngine reopened(DATA_DIRECTORY);
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        LogStorageStats stats = reopened.getStats();
+        std::printf("log/recover %-12s %llu records, %.1f MiB in %.1f ms\n", Benchmark::FormatSize(fileSize).c_str(),
+                    (unsigned long long)stats.recoveredRecords, stats.totalBytes / (1024.0 * 1024.0), seconds * 1e3);
+        start = Clock::now();
+        size_t removed = reopened.compact();
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        std::printf("log/compact %-12s %zu segments removed, %.1f MiB left in %.1f ms\n", Benchmark::FormatSize(fileSize).c_str(),
+                    removed, reopened.getStats().totalBytes / (1024.0 * 1024.0), seconds * 1e3);
+
+        // Durable writes wait for the disk on every record
+        std::filesystem::remove_all(DATA_DIRECTORY);
+        LogStorageOptions durable;
+        durable.syncWrites = true;
+        Run("log-sync", new LogStorageEngine(DATA_DIRECTORY, durable), fileSize);
+        std::filesystem::remove_all(DATA_DIRECTORY);
+    }
+    return 0;
+}
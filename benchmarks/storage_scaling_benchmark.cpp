@@ -0,0 +1,98 @@
+// Measures how FileSystem throughput scales with the number of threads sharing it, for the
+// in-memory engine with a single lock (one shard) and with the default lock striping, and
+// for the log engine. Each thread runs a mix of reads and overwrites on random files.
+#include "benchmark_util.h"
+#include "filesystem.h"
+#include "logstorageengine.h"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const char* const DATA_DIRECTORY = "storage_scaling_benchmark_data";
+const size_t FILE_COUNT = 4096;
+const size_t FILE_SIZE = 256;
+const double SECONDS_PER_RUN = 0.3;
+
+std::string FileName(size_t index) {
+    return "dir/file-" + std::to_string(index);
+}
+
+// Runs threadCount threads for SECONDS_PER_RUN; writePercent of the operations are overwrites
+double MeasureOpsPerSecond(FileSystem& fs, size_t threadCount, unsigned writePercent) {
+    std::atomic<bool> start{false};
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> totalOps{0};
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t]() {
+            std::mt19937_64 random(t + 1);
+            std::string content(FILE_SIZE, static_cast<char>('a' + t % 26));
+            uint64_t ops = 0;
+            while (!start) {
+                std::this_thread::yield();
+            }
+            while (!stop) {
+                uint64_t value = random();
+                std::string name = FileName(value % FILE_COUNT);
+                if ((value >> 32) % 100 < writePercent) {
+                    Benchmark::DoNotOptimize(fs.writeFile(name, content));
+                } else {
+                    Benchmark::DoNotOptimize(fs.readFile(name));
+                }
+                ++ops;
+            }
+            totalOps += ops;
+        });
+    }
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point begin = Clock::now();
+    start = true;
+    std::this_thread::sleep_for(std::chrono::duration<double>(SECONDS_PER_RUN));
+    stop = true;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    return totalOps / seconds;
+}
+
+void Run(const std::string& engineName, const std::function<StorageEngine*()>& makeEngine, unsigned writePercent) {
+    FileSystem fs{std::unique_ptr<StorageEngine>(makeEngine())};
+    std::string content(FILE_SIZE, 'c');
+    for (size_t i = 0; i < FILE_COUNT; ++i) {
+        fs.createFile(FileName(i));
+        fs.writeFile(FileName(i), content);
+    }
+
+    std::string name = engineName + "/" + std::to_string(writePercent) + "%-writes";
+    double singleThread = 0;
+    for (size_t threads = 1; threads <= 64; threads *= 2) {
+        double opsPerSecond = MeasureOpsPerSecond(fs, threads, writePercent);
+        if (threads == 1) {
+            singleThread = opsPerSecond;
+        }
+        std::printf("%-40s %3zu threads %14.0f ops/s %8.2fx\n", name.c_str(), threads, opsPerSecond, opsPerSecond / singleThread);
+    }
+}
+
+}
+
+int main() {
+    std::printf("%zu hardware threads, %zu files of %s\n", static_cast<size_t>(std::thread::hardware_concurrency()),
+                FILE_COUNT, Benchmark::FormatSize(FILE_SIZE).c_str());
+    for (unsigned writePercent : {0u, 10u, 50u}) {
+        Run("memory-1-shard", []() { return new MemoryStorageEngine(1); }, writePercent);
+        Run("memory-" + std::to_string(DEFAULT_STORAGE_SHARD_COUNT) + "-shards", []() { return new MemoryStorageEngine(); }, writePercent);
+        std::filesystem::remove_all(DATA_DIRECTORY);
+        Run("log", []() { return new LogStorageEngine(DATA_DIRECTORY); }, writePercent);
+        std::filesystem::remove_all(DATA_DIRECTORY);
+    }
+    return 0;
+}
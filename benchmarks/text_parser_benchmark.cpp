@@ -0,0 +1,50 @@
+// Compares the one-pass text parser in Message::Deserialize with the istringstream parser
+// it replaced, and the delimiter scan kernels underneath it, across payload sizes.
+#include "benchmark_util.h"
+#include "delimiterscan.h"
+#include "message.h"
+#include <vector>
+
+int main() {
+    const std::vector<size_t> contentSizes = {16, 256, 4 * 1024, 64 * 1024, 1024 * 1024};
+    const std::pair<const char*, DelimiterScan::Kernel> kernels[] = {
+        {"scan/scalar", DelimiterScan::Kernel::Scalar},
+        {"scan/sse2", DelimiterScan::Kernel::Sse2},
+        {"scan/avx2", DelimiterScan::Kernel::Avx2},
+    };
+
+    for (size_t contentSize : contentSizes) {
+        Message msg;
+        msg._Type = MessageType::WriteFile;
+        msg._Filename = "logs/2024/08/04/node-17.log";
+        // Newlines and spaces, like log content, but no '|', which the format cannot carry
+        msg._Content.reserve(contentSize);
+        while (msg._Content.size() < contentSize) {
+            msg._Content += "INFO chunk replicated to node-3\n";
+        }
+        msg._Content.resize(contentSize);
+        msg._NodeAddress = "10.0.12.34";
+        msg._NodePort = 50505;
+
+        std::string text = Message::Serialize(msg);
+        std::string parameter = Benchmark::FormatSize(contentSize);
+
+        Benchmark::Report("text/deserialize-streams", parameter,
+            Benchmark::MeasureNanosPerOp([&]() { Benchmark::DoNotOptimize(Message::DeserializeWithStreams(text)); }), text.size());
+        Benchmark::Report("text/deserialize", parameter,
+            Benchmark::MeasureNanosPerOp([&]() { Benchmark::DoNotOptimize(Message::Deserialize(text)); }), text.size());
+
+        for (const auto& kernel : kernels) {
+            if (!DelimiterScan::IsSupported(kernel.second)) {
+                std::printf("%s: not supported on this CPU\n", kernel.first);
+                continue;
+            }
+            size_t positions[4];
+            Benchmark::Report(kernel.first, parameter,
+                Benchmark::MeasureNanosPerOp([&]() {
+                    Benchmark::DoNotOptimize(DelimiterScan::Find(text.data(), text.size(), '|', positions, 4, kernel.second));
+                }), text.size());
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+// Compares request/reply round trips over TCP loopback, a Unix domain socket and Networking::ShmChannel.
+#include "benchmark_util.h"
+#include "client.h"
+#include "server.h"
+#include "shmchannel.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+// Measures echoing payloads of each size through a server running in epoll mode
+void BenchmarkServer(const std::string& name, Networking::Server& server, Networking::Client& client,
+    const std::vector<size_t>& messageSizes) {
+    for (size_t messageSize : messageSizes) {
+        std::string payload(messageSize, 'x');
+        Benchmark::Report(name, Benchmark::FormatSize(messageSize),
+            Benchmark::MeasureNanosPerOp([&]() {
+                client.SendFrame(payload);
+                std::vector<char> reply = client.ReceiveFrame();
+                Benchmark::DoNotOptimize(reply.data());
+            }), 2 * messageSize);
+    }
+    client.Disconnect();
+    server.Stop();
+}
+
+}
+
+int main() {
+    const std::vector<size_t> messageSizes = {64, 4 * 1024, 64 * 1024, 1024 * 1024};
+    auto echo = [](Networking::Server& server) {
+        return [&server](Networking::ClientConnection c, const std::vector<char>& message) {
+            server.SendFrame(message.data(), message.size(), c);
+        };
+    };
+
+    {
+        const int port = 12499;
+        Networking::Server server(port);
+        server.SetKeepAlive(true);
+        std::thread runThread([&]() { server.Run(echo(server), Networking::ServerMode::Epoll); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        Networking::Client client("127.0.0.1", port);
+        BenchmarkServer("tcp-loopback/roundtrip", server, client, messageSizes);
+        runThread.join();
+    }
+
+    {
+        const std::string socketPath = "/tmp/simplidfs-transport-benchmark-" + std::to_string(getpid()) + ".sock";
+        Networking::Server server(socketPath);
+        server.SetKeepAlive(true);
+        std::thread runThread([&]() { server.Run(echo(server), Networking::ServerMode::Epoll); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        Networking::Client client;
+        client.ConnectUnixSocket(socketPath);
+        BenchmarkServer("unix-socket/roundtrip", server, client, messageSizes);
+        runThread.join();
+    }
+
+    {
+        int sockets[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+            std::perror("socketpair");
+            return 1;
+        }
+        Networking::ShmChannel channel = Networking::ShmChannel::Create();
+        channel.ShareOver(sockets[0]);
+        Networking::ShmChannel peer = Networking::ShmChannel::AttachFrom(sockets[1]);
+        std::thread echoThread([&]() {
+            while (true) {
+                uint32_t requestId;
+                std::vector<char> frame = peer.ReceiveFrame(requestId);
+                if (frame.empty())
+                    break;
+                peer.SendFrame(frame.data(), frame.size(), requestId);
+            }
+        });
+
+        for (size_t messageSize : messageSizes) {
+            std::string payload(messageSize, 'x');
+            Benchmark::Report("shm-channel/roundtrip", Benchmark::FormatSize(messageSize),
+                Benchmark::MeasureNanosPerOp([&]() {
+                    channel.SendFrame(payload);
+                    std::vector<char> reply = channel.ReceiveFrame();
+                    Benchmark::DoNotOptimize(reply.data());
+                }), 2 * messageSize);
+        }
+        channel.Close();
+        echoThread.join();
+        close(sockets[0]);
+        close(sockets[1]);
+    }
+    return 0;
+}
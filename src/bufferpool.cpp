@@ -0,0 +1,151 @@
+#include "bufferpool.h"
+
+namespace {
+
+// Index of the smallest class of at least _pSize bytes
+size_t CeilClass(size_t _pSize)
+{
+	size_t index = 0;
+	size_t classSize = Networking::BufferPool::MIN_CLASS_SIZE;
+	while(classSize < _pSize && index < 63)
+	{
+		classSize <<= 1;
+		index++;
+	}
+	return index;
+}
+
+// Index of the largest class of at most _pCapacity bytes; only called with
+// capacities of at least MIN_CLASS_SIZE
+size_t FloorClass(size_t _pCapacity)
+{
+	size_t index = 0;
+	size_t classSize = Networking::BufferPool::MIN_CLASS_SIZE;
+	while((classSize << 1) <= _pCapacity)
+	{
+		classSize <<= 1;
+		index++;
+	}
+	return index;
+}
+
+}
+
+const size_t Networking::BufferPool::MIN_CLASS_SIZE;
+
+Networking::BufferPool::BufferPool(size_t _pMaxClassSize, size_t _pMaxFreePerClass)
+	: core(std::make_shared<Core>())
+{
+	core->maxFreePerClass = _pMaxFreePerClass;
+	size_t classCount = CeilClass(_pMaxClassSize) + 1;
+	for(size_t i = 0; i < classCount; i++)
+		core->classes.emplace_back(new SizeClass());
+}
+
+Networking::BufferPool::~BufferPool()
+{
+	core->open = false;
+	core->Trim();
+}
+
+Networking::SharedBuffer Networking::BufferPool::Acquire(size_t _pSize)
+{
+	core->acquisitions++;
+	size_t index = CeilClass(_pSize);
+	std::unique_ptr<std::vector<char> > buffer;
+	if(index < core->classes.size())
+	{
+		SizeClass& sizeClass = *core->classes[index];
+		std::lock_guard<std::mutex> lock(sizeClass.mutex);
+		if(!sizeClass.free.empty())
+		{
+			buffer = std::move(sizeClass.free.back());
+			sizeClass.free.pop_back();
+		}
+	}
+
+	if(buffer)
+	{
+		core->hits++;
+		core->pooledBytes -= buffer->capacity();
+	}
+	else
+	{
+		core->misses++;
+		buffer.reset(new std::vector<char>());
+		// Pooled buffers get the full class capacity so they fit any later request of that class
+		buffer->reserve(index < core->classes.size() ? MIN_CLASS_SIZE << index : _pSize);
+	}
+	// Growing within the capacity does not allocate
+	buffer->resize(_pSize);
+	core->outstandingBuffers++;
+	core->outstandingBytes += buffer->capacity();
+
+	std::shared_ptr<Core> owner = core;
+	return SharedBuffer(buffer.release(), [owner](std::vector<char>* _pBuffer) {
+		owner->Release(_pBuffer);
+	});
+}
+
+void Networking::BufferPool::Trim()
+{
+	core->Trim();
+}
+
+Networking::BufferPool::Stats Networking::BufferPool::GetStats() const
+{
+	Stats snapshot;
+	snapshot.acquisitions = core->acquisitions;
+	snapshot.hits = core->hits;
+	snapshot.misses = core->misses;
+	snapshot.discarded = core->discarded;
+	snapshot.outstandingBuffers = core->outstandingBuffers;
+	snapshot.outstandingBytes = core->outstandingBytes;
+	snapshot.pooledBytes = core->pooledBytes;
+	return snapshot;
+}
+
+Networking::BufferPool& Networking::BufferPool::Default()
+{
+	static BufferPool pool;
+	return pool;
+}
+
+void Networking::BufferPool::Core::Release(std::vector<char>* _pBuffer)
+{
+	std::unique_ptr<std::vector<char> > buffer(_pBuffer);
+	size_t capacity = buffer->capacity();
+	outstandingBuffers--;
+	outstandingBytes -= capacity;
+
+	if(open && capacity >= MIN_CLASS_SIZE)
+	{
+		size_t index = FloorClass(capacity);
+		if(index < classes.size())
+		{
+			SizeClass& sizeClass = *classes[index];
+			std::lock_guard<std::mutex> lock(sizeClass.mutex);
+			if(sizeClass.free.size() < maxFreePerClass)
+			{
+				pooledBytes += capacity;
+				sizeClass.free.push_back(std::move(buffer));
+				return;
+			}
+		}
+	}
+	discarded++;
+}
+
+void Networking::BufferPool::Core::Trim()
+{
+	for(auto& sizeClass : classes)
+	{
+		std::vector<std::unique_ptr<std::vector<char> > > released;
+		{
+			std::lock_guard<std::mutex> lock(sizeClass->mutex);
+			released.swap(sizeClass->free);
+		}
+		for(auto& buffer : released)
+			pooledBytes -= buffer->capacity();
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+#ifndef _NET_BUFFER_POOL_
+#define _NET_BUFFER_POOL_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Networking {
+
+// Size of the scratch buffer the unframed Receive and ReceiveFrom calls read through
+const size_t RECEIVE_CHUNK_SIZE = 64 * 1024;
+
+// A receive buffer shared by everything that reads it. When the last reference
+// is dropped the storage goes back to the pool it came from instead of being freed.
+typedef std::shared_ptr<std::vector<char> > SharedBuffer;
+
+// Recycles receive buffers so that reading a message does not allocate. Buffers
+// are grouped into power-of-two size classes by capacity; Acquire takes a free
+// buffer of the smallest class that fits and only allocates when that class is
+// empty. Requests larger than the biggest class are allocated exactly and freed
+// on release. Safe to use from any thread; buffers may be released on a
+// different thread from the one that acquired them, and may outlive the pool.
+class BufferPool {
+public:
+
+// Counters describing how well buffers are being reused
+struct Stats {
+	uint64_t acquisitions = 0;     // Calls to Acquire
+	uint64_t hits = 0;             // Acquisitions served from a free buffer
+	uint64_t misses = 0;           // Acquisitions that had to allocate
+	uint64_t discarded = 0;        // Released buffers freed because their class was full or they were oversized
+	size_t outstandingBuffers = 0; // Buffers currently handed out
+	size_t outstandingBytes = 0;   // Capacity of the buffers currently handed out
+	size_t pooledBytes = 0;        // Capacity of the free buffers held by the pool
+
+	// Fraction of acquisitions served without allocating
+	double HitRate() const { return acquisitions == 0 ? 0.0 : (double)hits / acquisitions; }
+};
+
+// Smallest size class; smaller requests are rounded up to it
+static const size_t MIN_CLASS_SIZE = 4 * 1024;
+
+// Creates a pool with size classes from MIN_CLASS_SIZE up to _pMaxClassSize,
+// keeping at most _pMaxFreePerClass free buffers in each
+BufferPool(size_t _pMaxClassSize = 16 * 1024 * 1024, size_t _pMaxFreePerClass = 32);
+
+// Frees the pooled buffers; buffers still handed out are freed when released
+~BufferPool();
+
+BufferPool(const BufferPool&) = delete;
+BufferPool& operator=(const BufferPool&) = delete;
+
+// Returns a buffer holding _pSize bytes. Its contents are unspecified: it is
+// meant to be filled from a socket, not read before it is written.
+SharedBuffer Acquire(size_t _pSize);
+
+// Frees every buffer waiting in the pool
+void Trim();
+
+Stats GetStats() const;
+
+// Pool shared by the receive paths of Client, Server and EventLoop
+static BufferPool& Default();
+
+private:
+
+struct SizeClass {
+	std::mutex mutex;
+	std::vector<std::unique_ptr<std::vector<char> > > free;
+};
+
+// State the buffers point back to, so a buffer released after the pool is
+// destroyed is simply freed
+struct Core {
+	size_t maxFreePerClass;
+	std::vector<std::unique_ptr<SizeClass> > classes;
+	std::atomic<bool> open{true};
+	std::atomic<uint64_t> acquisitions{0};
+	std::atomic<uint64_t> hits{0};
+	std::atomic<uint64_t> misses{0};
+	std::atomic<uint64_t> discarded{0};
+	std::atomic<size_t> outstandingBuffers{0};
+	std::atomic<size_t> outstandingBytes{0};
+	std::atomic<size_t> pooledBytes{0};
+
+	void Release(std::vector<char>* _pBuffer);
+	void Trim();
+};
+
+std::shared_ptr<Core> core;
+};
+
+}
+
+#endif
@@ -0,0 +1,68 @@
+#pragma once
+#ifndef _SIMPLIDFS_CHUNK_H
+#define _SIMPLIDFS_CHUNK_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * @file chunk.h
+ * @brief Fixed-size chunks, the unit in which file content is placed and replicated.
+ *
+ * The MetadataManager splits every file into chunks of its chunk size and keeps, per file,
+ * the ordered list of chunk IDs with the nodes that hold each one. Nodes know nothing about
+ * files: they store each chunk in their FileSystem under GetChunkStorageName.
+ */
+
+/** @brief Identifies a chunk across the cluster. Assigned by the MetadataManager and never reused. */
+typedef uint64_t ChunkId;
+
+/**
+ * @brief Chunk ID of files recorded before chunking. Their content is a single chunk
+ *        that nodes keep under the file's own name.
+ */
+const ChunkId WHOLE_FILE_CHUNK_ID = 0;
+
+/** @brief Chunk size of a MetadataManager unless it is given another one. */
+const uint64_t DEFAULT_CHUNK_SIZE = 64ull * 1024 * 1024;
+
+/** @brief Most chunks a file may span, which with the default chunk size allows 4 TiB files. */
+const uint64_t MAX_CHUNKS_PER_FILE = 65536;
+
+/**
+ * @brief One chunk of a file and the nodes holding a replica of it.
+ */
+struct ChunkInfo {
+    ChunkId id = WHOLE_FILE_CHUNK_ID;   ///< Cluster-wide chunk ID.
+    std::vector<std::string> replicas;  ///< Identifiers of the nodes storing this chunk.
+
+    bool operator==(const ChunkInfo& other) const { return id == other.id && replicas == other.replicas; }
+};
+
+/**
+ * @brief Name under which nodes store a chunk in their FileSystem.
+ * @param filename The file the chunk belongs to; only used for WHOLE_FILE_CHUNK_ID.
+ * @param id The chunk.
+ * @return "chunk-" followed by the ID as 16 hex digits, or the filename for whole-file chunks.
+ */
+inline std::string GetChunkStorageName(const std::string& filename, ChunkId id) {
+    if (id == WHOLE_FILE_CHUNK_ID) {
+        return filename;
+    }
+    char name[32];
+    std::snprintf(name, sizeof(name), "chunk-%016llx", static_cast<unsigned long long>(id));
+    return name;
+}
+
+/**
+ * @brief Number of chunks a file of the given size occupies. Every file has at least one
+ *        chunk, so that an empty file still has a place to be written to.
+ */
+inline uint64_t GetChunkCount(uint64_t fileSize, uint64_t chunkSize) {
+    // Rounded up without adding to fileSize, which could wrap for sizes near the limit
+    return fileSize == 0 ? 1 : fileSize / chunkSize + (fileSize % chunkSize != 0);
+}
+
+#endif
@@ -1,4 +1,29 @@
 #include "client.h" // include the header file for the client class
+#include <fcntl.h>
+#include <poll.h>
+
+namespace {
+
+// Failures worth another attempt: the host may be restarting or the network briefly unavailable
+bool IsTransientConnectError(int _pErrorCode)
+{
+	switch(_pErrorCode)
+	{
+	case ECONNREFUSED:
+	case ECONNRESET:
+	case ETIMEDOUT:
+	case EHOSTUNREACH:
+	case ENETUNREACH:
+	case EADDRNOTAVAIL:
+	case EAGAIN:
+	case EINTR:
+		return true;
+	default:
+		return false;
+	}
+}
+
+}
 
 // Constructor that initializes the client socket
 Networking::Client::Client()
@@ -9,9 +34,9 @@ Networking::Client::Client()
 	}
 
 	// Catch any exceptions that are thrown
-	catch(int errorCode) {
+	catch(NetworkException& exception) {
 		// Print the error code
-		std::cout<<"Exception thrown. Error Code"<<errorCode;
+		std::cout<<"Exception thrown. Error Code"<<exception.GetErrorCode();
 	}
 }
 
@@ -27,9 +52,9 @@ Networking::Client::Client(PCSTR _pHost, int _pPortNumber)
 		Networking::Client::ConnectClientSocket();
 	}
 	// Catch any exceptions that are thrown
-	catch(int errorCode) {
+	catch(NetworkException& exception) {
 		// Print the error code
-		std::cout<<"Exception thrown. Error Code "<<errorCode;
+		std::cout<<"Exception thrown. Error Code "<<exception.GetErrorCode();
 	}
 }
 
@@ -46,7 +71,7 @@ bool Networking::Client::InitClientSocket()
 	int errorCode = WSAStartup(VERSIONREQUESTED, &this->wsaData);
 	// If there was an error, throw an exception
 	if(errorCode)
-		throw errorCode;
+		ThrowSocketException(connectionSocket, errorCode);
     #endif
 	// If there was an error, throw an exception
 	return true;
@@ -76,7 +101,7 @@ bool Networking::Client::CreateClientTCPSocket(PCSTR _pHost, int _pPort)
     #ifdef _WIN32
         WSACleanup();
     #endif
-        throw errorCode;
+        ThrowSocketException(connectionSocket, errorCode);
     }
 
     connectionSocket = socket(hostAddressInfo->ai_family, hostAddressInfo->ai_socktype,  hostAddressInfo->ai_protocol);
@@ -87,7 +112,7 @@ bool Networking::Client::CreateClientTCPSocket(PCSTR _pHost, int _pPort)
     #ifdef _WIN32
         WSACleanup();
     #endif
-        throw errorCode;
+        ThrowSocketException(connectionSocket, errorCode);
     }
     return true;
 }
@@ -113,7 +138,7 @@ bool Networking::Client::CreateClientUDPSocket(PCSTR _pHost, int _pPort)
 		WSACleanup();
     #endif
 		// Throw the error code
-		throw errorCode;
+		ThrowSocketException(connectionSocket, errorCode);
 	}
 
 	// Create the UDP socket
@@ -130,7 +155,7 @@ bool Networking::Client::CreateClientUDPSocket(PCSTR _pHost, int _pPort)
 		WSACleanup();
 	#endif
 		// Throw the error code
-		throw errorCode;
+		ThrowSocketException(connectionSocket, errorCode);
 	}
 	// Return true if the UDP socket was created successfully
 	return true;
@@ -146,7 +171,7 @@ bool Networking::Client::CreateClientSocket(PCSTR _pHost, int _pPort)
     #ifdef _WIN32
 		WSACleanup();
     #endif
-		throw errorCode;
+		ThrowSocketException(connectionSocket, errorCode);
 	}
 
 	connectionSocket = socket(hostAddressInfo->ai_family, hostAddressInfo->ai_socktype,  hostAddressInfo->ai_protocol);
@@ -157,7 +182,7 @@ bool Networking::Client::CreateClientSocket(PCSTR _pHost, int _pPort)
 	#ifdef _WIN32
 		WSACleanup();
 	#endif
-		throw errorCode;
+		ThrowSocketException(connectionSocket, errorCode);
 	}
 	return true;
 }
@@ -175,12 +200,107 @@ bool Networking::Client::ConnectClientSocket()
     #ifdef _WIN32
         WSACleanup();
     #endif
-        throw errorCode;
+        ThrowSocketException(connectionSocket, errorCode);
     }
     clientIsConnected = true;
     return true;
 }
 
+// Connect to the server without blocking past the deadline
+bool Networking::Client::ConnectClientSocket(const Deadline& _pDeadline)
+{
+	// Connecting nonblocking lets the wait be bounded by poll instead of the kernel's SYN retries
+	int flags = fcntl(connectionSocket, F_GETFL, 0);
+	fcntl(connectionSocket, F_SETFL, flags | O_NONBLOCK);
+
+	int errorCode = 0;
+	if(connect(connectionSocket, hostAddressInfo->ai_addr, hostAddressInfo->ai_addrlen))
+	{
+		errorCode = GETERROR();
+		if(errorCode == EINPROGRESS)
+		{
+			errorCode = 0;
+			if(WaitForSocket(connectionSocket, POLLOUT, _pDeadline) == SOCKET_ERROR)
+				errorCode = GETERROR();
+			else
+			{
+				// The outcome of the handshake is reported through SO_ERROR
+				socklen_t length = sizeof(errorCode);
+				getsockopt(connectionSocket, SOL_SOCKET, SO_ERROR, &errorCode, &length);
+			}
+		}
+	}
+	if(errorCode)
+	{
+		CLOSESOCKET(connectionSocket);
+		ThrowSocketException(connectionSocket, errorCode);
+	}
+
+	// The rest of the client expects a blocking socket
+	fcntl(connectionSocket, F_SETFL, flags);
+	clientIsConnected = true;
+	return true;
+}
+
+// Resolve and connect with retries, backoff and the circuit breaker
+bool Networking::Client::Connect(PCSTR _pHost, int _pPort, const Deadline& _pDeadline, const RetryPolicy& _pPolicy)
+{
+	std::string peer = std::string(_pHost) + ":" + std::to_string(_pPort);
+	for(int retry = 0; ; retry++)
+	{
+		// A host known to be down fails fast instead of costing every caller a timeout
+		if(circuitBreaker != nullptr && !circuitBreaker->Allow(peer))
+			ThrowSocketException(connectionSocket, EHOSTDOWN);
+
+		int errorCode;
+		try
+		{
+			if(hostAddressInfo != nullptr)
+			{
+				freeaddrinfo(hostAddressInfo);
+				hostAddressInfo = nullptr;
+			}
+			CreateClientTCPSocket(_pHost, _pPort);
+			ConnectClientSocket(_pDeadline);
+			if(circuitBreaker != nullptr)
+				circuitBreaker->RecordSuccess(peer);
+			return true;
+		}
+		catch(NetworkException& _pError)
+		{
+			errorCode = _pError.GetErrorCode();
+		}
+
+		if(circuitBreaker != nullptr)
+			circuitBreaker->RecordFailure(peer);
+		if(!IsTransientConnectError(errorCode) || !_pPolicy.WaitBeforeRetry(retry, _pDeadline))
+			ThrowSocketException(connectionSocket, errorCode);
+	}
+}
+
+// Connect to a server on the same host through a Unix domain socket
+bool Networking::Client::ConnectUnixSocket(const std::string& _pSocketPath)
+{
+	sockaddr_un address;
+	ZeroMemory(&address, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if(_pSocketPath.size() >= sizeof(address.sun_path))
+		ThrowSocketException(connectionSocket, ENAMETOOLONG);
+	memcpy(address.sun_path, _pSocketPath.c_str(), _pSocketPath.size() + 1);
+
+	connectionSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(INVALIDSOCKET(connectionSocket))
+		ThrowSocketException(connectionSocket, GETERROR());
+	if(connect(connectionSocket, (sockaddr*)&address, sizeof(address)))
+	{
+		int errorCode = GETERROR();
+		CLOSESOCKET(connectionSocket);
+		ThrowSocketException(connectionSocket, errorCode);
+	}
+	clientIsConnected = true;
+	return true;
+}
+
 void Networking::Client::SetSocketType(int _pSocketType)
 {
 	addressInfo.ai_socktype = _pSocketType;
@@ -200,29 +320,68 @@ void Networking::Client::SetProtocol(int _pProtocol)
 // Send data to the server
 int Networking::Client::Send(PCSTR _pSendBuffer)
 {
-	// Send the data to the server
-	int bytesSent = send(connectionSocket,_pSendBuffer, strlen(_pSendBuffer),0 );
+	return Send(_pSendBuffer, strlen(_pSendBuffer));
+}
 
-	// If there was an error, throw an exception
-	if(bytesSent ==SOCKET_ERROR)
-	{
-		// Get the error code
-		int errorCode = GETERROR();
+// Send a buffer of known length to the server
+int Networking::Client::Send(const char* _pData, size_t _pLength)
+{
+	iovec vector;
+	vector.iov_base = (void*)_pData;
+	vector.iov_len = _pLength;
+	return (int)Send(&vector, 1);
+}
 
-		// Close the socket
-		CLOSESOCKET(connectionSocket);
-	#ifdef _WIN32
-		// Clean up the Windows Sockets DLL
-		WSACleanup();
-	#endif
-		// Throw the error code
-		throw errorCode;
-	}
+// Send several buffers to the server as one stream
+long Networking::Client::Send(const iovec* _pVectors, size_t _pCount)
+{
+	Result<long> bytesSent = TrySend(_pVectors, _pCount);
+	if(!bytesSent)
+		ThrowSendException(connectionSocket, bytesSent.GetError().code);
 
 	// Return  the number of bytes sent if the data was sent successfully
+	return bytesSent.Value();
+}
+
+Networking::Result<long> Networking::Client::TrySend(const iovec* _pVectors, size_t _pCount)
+{
+	long bytesSent = WriteVectors(_pVectors, _pCount);
+	if(bytesSent == SOCKET_ERROR)
+		return FailConnection(GETERROR());
 	return bytesSent;
 }
 
+Networking::IoError Networking::Client::FailConnection(int _pErrorCode)
+{
+	// Close the socket
+	CLOSESOCKET(connectionSocket);
+	clientIsConnected = false;
+#ifdef _WIN32
+	// Clean up the Windows Sockets DLL
+	WSACleanup();
+#endif
+	return IoError::FromCode(_pErrorCode);
+}
+
+long Networking::Client::WriteVectors(const iovec* _pVectors, size_t _pCount)
+{
+	size_t totalLength = 0;
+	for(size_t i = 0; i < _pCount; i++)
+		totalLength += _pVectors[i].iov_len;
+
+	if(zeroCopyThreshold > 0 && totalLength >= zeroCopyThreshold)
+	{
+		// SO_ZEROCOPY is only set once a write is large enough to use it
+		if(!zeroCopyEnabled)
+		{
+			zeroCopy.Enable(connectionSocket);
+			zeroCopyEnabled = true;
+		}
+		return zeroCopy.Write(connectionSocket, _pVectors, _pCount, ioDeadline);
+	}
+	return WriteVectorFully(connectionSocket, _pVectors, _pCount, ioDeadline);
+}
+
 // Send data to a specified address and port
 int Networking::Client::SendTo(PCSTR _pBuffer, PCSTR _pAddress, int _pPort)
 {
@@ -253,7 +412,7 @@ int Networking::Client::SendTo(PCSTR _pBuffer, PCSTR _pAddress, int _pPort)
 		WSACleanup();
 	#endif
 		// Throw the error code
-		throw errorCode;
+		ThrowSendException(connectionSocket, errorCode);
 	}
 
 	// Return  the number of bytes sent if the data was sent successfully
@@ -262,28 +421,44 @@ int Networking::Client::SendTo(PCSTR _pBuffer, PCSTR _pAddress, int _pPort)
 
 
 // Send a file to the server
-void Networking::Client::SendFile(const std::string& _pFilePath)
+long long Networking::Client::SendFile(const std::string& _pFilePath, uint64_t _pOffset, uint64_t _pLength)
 {
-	// Open the file for reading
-	std::ifstream file(_pFilePath, std::ios::in | std::ios::binary);
+	// Send the file data to the server
+	long long bytesSent = SendFileRange(connectionSocket, _pFilePath, _pOffset, _pLength);
 
-	// Check if the file was opened successfully
-	if(!file)
+	// If there was an error, throw an exception
+	if(bytesSent == SOCKET_ERROR)
 	{
-		// Throw an exception if the file could not be opened
-		throw std::runtime_error("Error: Unable to open file '" + _pFilePath + "'");
-	}
-
-	// Read the file data into a buffer
-	std::vector<char> fileData((std::istreambuf_iterator<char>(file)), (std::istreambuf_iterator<char>()));
+		// Get the error code
+		int errorCode = GETERROR();
 
-	// Send the file data to the server
-	Send(&fileData[0]);
+		// Close the socket, since the receiver cannot tell where the stream ended
+		CLOSESOCKET(connectionSocket);
+		clientIsConnected = false;
+	#ifdef _WIN32
+		// Clean up the Windows Sockets DLL
+		WSACleanup();
+	#endif
+		// Throw the error code
+		ThrowSendException(connectionSocket, errorCode);
+	}
+	return bytesSent;
 }
 
 
 // Receive data from the server
 std::vector <char> Networking::Client::Receive()
+{
+	Result<std::vector<char>> received = TryReceive();
+	if(received)
+		return std::move(received.Value());
+	// An orderly close is reported as no data, as a zero-length read always has been
+	if(received.GetError().code == 0)
+		return std::vector<char>();
+	ThrowReceiveException(connectionSocket, received.GetError().code);
+}
+
+Networking::Result<std::vector<char>> Networking::Client::TryReceive()
 {
 	// Initialize the number of bytes received to 0
 	int bytesReceived =0;
@@ -291,33 +466,20 @@ std::vector <char> Networking::Client::Receive()
 	// Create a vector to store the received data
 	std::vector<char> receiveBuffer;
 
-	// Receive data from the server in a loop
+	// Read through a pooled scratch buffer and append each chunk once, instead
+	// of growing the result 512 bytes at a time
+	SharedBuffer chunk = BufferPool::Default().Acquire(RECEIVE_CHUNK_SIZE);
 	do{
-		// Get the current size of the receive buffer
-		int bufferStart = receiveBuffer.size();
-		// Resize the buffer to make room for more data
-		receiveBuffer.resize(bufferStart+512);
 		// Receive data from the server
-		bytesReceived = recv(connectionSocket, &receiveBuffer[bufferStart],512,0);
-		// Resize the buffer to the actual size of the received data
-		receiveBuffer.resize(bufferStart + bytesReceived);
-	} while (bytesReceived == 512);
+		bytesReceived = recv(connectionSocket, chunk->data(), chunk->size(), 0);
+		if(bytesReceived > 0)
+			receiveBuffer.insert(receiveBuffer.end(), chunk->data(), chunk->data() + bytesReceived);
+	} while (bytesReceived == (int)chunk->size());
 
-// If there was an error, throw an exception
 	if (bytesReceived == SOCKET_ERROR)
-	{
-		// Get the error code
-		int errorCode = GETERROR();
-
-		// Close the socket
-		CLOSESOCKET(connectionSocket);
-    #ifdef _WIN32
-		// Clean up the Windows Sockets DLL
-		WSACleanup();
-    #endif
-		// Throw the error code
-		throw errorCode;
-	}
+		return FailConnection(GETERROR());
+	if(receiveBuffer.empty())
+		return Result<std::vector<char>>::Failure(0);
 	// Return the vector containing the received data
 	return receiveBuffer;
 }
@@ -344,17 +506,15 @@ std::vector<char> Networking::Client::ReceiveFrom(PCSTR _pAddress, int _pPort)
 	std::vector<char> receiveBuffer;
 
 
-	// Receive data from the server in a loop
+	// Read through a pooled scratch buffer and append each chunk once, instead
+	// of growing the result 512 bytes at a time
+	SharedBuffer chunk = BufferPool::Default().Acquire(RECEIVE_CHUNK_SIZE);
 	do{
-		// Get the current size of the receive buffer
-		int bufferStart = receiveBuffer.size();
-		// Resize the buffer to make room for more data
-		receiveBuffer.resize(bufferStart+512);
 		// Receive data from the server
-		bytesReceived = recvfrom(connectionSocket, &receiveBuffer[bufferStart], 512, 0, (sockaddr*)&sender, (socklen_t*)sizeof(sender));
-		// Resize the buffer to the actual size of the received data
-		receiveBuffer.resize(bufferStart + bytesReceived);
-	} while (bytesReceived == 512);
+		bytesReceived = recvfrom(connectionSocket, chunk->data(), chunk->size(), 0, (sockaddr*)&sender, (socklen_t*)sizeof(sender));
+		if(bytesReceived > 0)
+			receiveBuffer.insert(receiveBuffer.end(), chunk->data(), chunk->data() + bytesReceived);
+	} while (bytesReceived == (int)chunk->size());
 
 
 	// If there was an error, throw an exception
@@ -370,7 +530,7 @@ std::vector<char> Networking::Client::ReceiveFrom(PCSTR _pAddress, int _pPort)
 		WSACleanup();
 	#endif
 		// Throw the error code
-		throw errorCode;
+		ThrowReceiveException(connectionSocket, errorCode);
 	}
 
 	// Return the received data
@@ -378,25 +538,166 @@ std::vector<char> Networking::Client::ReceiveFrom(PCSTR _pAddress, int _pPort)
 }
 
 // Receive a file from the server
-void Networking::Client::ReceiveFile(const std::string& _pFilePath)
+long long Networking::Client::ReceiveFile(const std::string& _pFilePath, uint64_t _pMaxLength)
+{
+	// Write the file data to the file as it arrives
+	long long bytesReceived = ReceiveFileToPath(connectionSocket, _pFilePath, _pMaxLength);
+
+	// If there was an error, throw an exception
+	if(bytesReceived == SOCKET_ERROR)
+	{
+		// Get the error code
+		int errorCode = GETERROR();
+
+		// Close the socket, since the rest of the stream cannot be skipped reliably
+		CLOSESOCKET(connectionSocket);
+		clientIsConnected = false;
+	#ifdef _WIN32
+		// Clean up the Windows Sockets DLL
+		WSACleanup();
+	#endif
+		// Throw the error code
+		ThrowReceiveException(connectionSocket, errorCode);
+	}
+	return bytesReceived;
+}
+
+
+// Send a length-prefixed frame to the server
+int Networking::Client::SendFrame(const char* _pData, size_t _pLength, uint32_t _pRequestId)
+{
+	Result<long> bytesSent = TrySendFrame(_pData, _pLength, _pRequestId);
+	if(!bytesSent)
+		ThrowSendException(connectionSocket, bytesSent.GetError().code);
+	return (int)bytesSent.Value();
+}
+
+Networking::Result<long> Networking::Client::TrySendFrame(const char* _pData, size_t _pLength, uint32_t _pRequestId)
+{
+	// An oversized payload is refused before anything is written, so the connection stays usable
+	if(_pLength > maxMessageSize)
+		return Result<long>::Failure(EMSGSIZE);
+
+	// Header and payload go out in one sendmsg, so small frames are not split
+	// across segments and the payload is never copied into a joined buffer
+	FrameHeader header;
+	header.payloadLength = _pLength;
+	header.requestId = _pRequestId;
+	if(compressionCodec != CompressionCodec::None)
+	{
+		header.flags |= FRAME_FLAG_ACCEPTS_COMPRESSED;
+		header.codec = (uint8_t)compressionCodec;
+		if(_pLength >= compressionThreshold)
+		{
+			if(compressionBuffer.size() < CompressedPayloadBound(_pLength))
+				compressionBuffer.resize(CompressedPayloadBound(_pLength));
+			size_t compressed = CompressFramePayload(compressionCodec, _pData, _pLength, compressionBuffer.data());
+			if(compressed > 0)
+			{
+				header.flags |= FRAME_FLAG_COMPRESSED;
+				header.payloadLength = compressed;
+				_pData = compressionBuffer.data();
+			}
+		}
+	}
+	char headerBuffer[FRAME_HEADER_SIZE];
+	EncodeFrameHeader(header, headerBuffer);
+	iovec vectors[2];
+	vectors[0].iov_base = headerBuffer;
+	vectors[0].iov_len = FRAME_HEADER_SIZE;
+	vectors[1].iov_base = (void*)_pData;
+	vectors[1].iov_len = header.payloadLength;
+
+	if(WriteVectors(vectors, 2) == SOCKET_ERROR)
+		return FailConnection(GETERROR());
+	return (long)_pLength;
+}
+
+int Networking::Client::SendFrame(const std::string& _pData, uint32_t _pRequestId)
+{
+	return SendFrame(_pData.data(), _pData.size(), _pRequestId);
+}
+
+// Receive a length-prefixed frame from the server
+std::vector<char> Networking::Client::ReceiveFrame()
+{
+	uint32_t requestId;
+	return ReceiveFrame(requestId);
+}
+
+std::vector<char> Networking::Client::ReceiveFrame(uint32_t& _pRequestId)
 {
-	// Open the file for writing
-	std::ofstream file(_pFilePath, std::ios::out | std::ios::binary);
+	Result<std::vector<char>> payload = TryReceiveFrame(_pRequestId);
+	if(payload)
+		return std::move(payload.Value());
+	// The host closing the connection between frames is reported as an empty payload
+	if(payload.GetError().code == 0)
+		return std::vector<char>();
+	ThrowReceiveException(connectionSocket, payload.GetError().code);
+}
 
-	// Check if the file was opened successfully
-	if(!file)
+Networking::Result<std::vector<char>> Networking::Client::TryReceiveFrame(uint32_t& _pRequestId)
+{
+	_pRequestId = 0;
+	char headerBuffer[FRAME_HEADER_SIZE];
+	long bytesReceived = ReadFully(connectionSocket, headerBuffer, FRAME_HEADER_SIZE, ioDeadline);
+	if(bytesReceived == SOCKET_ERROR)
+		return FailConnection(GETERROR());
+	if(bytesReceived != (long)FRAME_HEADER_SIZE)
+		return Result<std::vector<char>>::Failure(0);
+
+	// A malformed or oversized frame is reported without closing the connection
+	FrameHeader header;
+	if(!DecodeFrameHeader(headerBuffer, header))
+		return Result<std::vector<char>>::Failure(EPROTO);
+	if(header.payloadLength > maxMessageSize)
+		return Result<std::vector<char>>::Failure(EMSGSIZE);
+
+	// The header tells us the full size, so the payload is read into one buffer
+	std::vector<char> payload(header.payloadLength);
+	if(header.payloadLength > 0)
 	{
-		// Throw an exception if the file could not be opened
-		throw std::runtime_error("Error: Unable to open file '" + _pFilePath + "'");
+		bytesReceived = ReadFully(connectionSocket, &payload[0], payload.size(), ioDeadline);
+		if(bytesReceived == SOCKET_ERROR)
+			return FailConnection(GETERROR());
+		if(bytesReceived != (long)payload.size())
+			return Result<std::vector<char>>::Failure(0);
 	}
+	_pRequestId = header.requestId;
+	if(!(header.flags & FRAME_FLAG_COMPRESSED))
+		return payload;
+
+	// The whole frame has been read, so a bad payload leaves the connection usable
+	CompressionCodec codec = (CompressionCodec)header.codec;
+	Result<size_t> length = GetDecompressedLength(codec, payload.data(), payload.size(), maxMessageSize);
+	if(!length)
+		return length.GetError();
+	std::vector<char> original(length.Value());
+	if(!DecompressFramePayload(codec, payload.data(), payload.size(), original.data(), original.size()))
+		return Result<std::vector<char>>::Failure(EPROTO);
+	return original;
+}
 
-	// Receive the file data from the server
-	std::vector<char> fileData = Receive();
+void Networking::Client::SetMaxMessageSize(size_t _pMaxMessageSize)
+{
+	maxMessageSize = _pMaxMessageSize;
+}
 
-	// Write the file data to the file
-	file.write(&fileData[0], fileData.size());
+void Networking::Client::SetCompression(CompressionCodec _pCodec, size_t _pThreshold)
+{
+	compressionCodec = _pCodec;
+	compressionThreshold = _pThreshold;
 }
 
+Networking::CompressionCodec Networking::Client::GetCompression() const
+{
+	return compressionCodec;
+}
+
+size_t Networking::Client::GetMaxMessageSize() const
+{
+	return maxMessageSize;
+}
 
 // Disconnect from the server and close the client socket
 bool Networking::Client::Disconnect()
@@ -417,7 +718,7 @@ bool Networking::Client::Disconnect()
 		WSACleanup();
 	#endif
 		// Throw the error code
-		throw errorCode;
+		ThrowShutdownException(connectionSocket, errorCode);
 	}
 
 	// Close the client socket
@@ -436,19 +737,67 @@ bool Networking::Client::Disconnect()
 		WSACleanup();
 	#endif
 		// Throw the error code
-		throw errorCode;
+		ThrowShutdownException(connectionSocket, errorCode);
 	}
 	clientIsConnected = false;
 	// Return true if the client was disconnected and the socket was closed successfully
 	return true;
 }
 
+void Networking::Client::SetDeadline(const Deadline& _pDeadline)
+{
+	ioDeadline = _pDeadline;
+}
+
+void Networking::Client::SetZeroCopyThreshold(size_t _pThreshold)
+{
+	zeroCopyThreshold = _pThreshold;
+}
+
+Networking::ZeroCopySender::Stats Networking::Client::GetZeroCopyStats() const
+{
+	return zeroCopy.GetStats();
+}
+
+void Networking::Client::SetCircuitBreaker(CircuitBreaker* _pCircuitBreaker)
+{
+	circuitBreaker = _pCircuitBreaker;
+}
+
 //Returns whether the client is currently connected to a host.
 bool Networking::Client::IsConnected()
 {
 	return clientIsConnected;
 }
 
+void Networking::Client::Shutdown()
+{
+	if(clientIsConnected)
+		shutdown(connectionSocket, SHUT_RDWR);
+}
+
+SOCKET Networking::Client::GetSocket() const
+{
+	return connectionSocket;
+}
+
+bool Networking::Client::IsHealthy()
+{
+	if(!clientIsConnected)
+		return false;
+
+	// Peek without blocking: nothing to read is the only healthy answer for an idle
+	// connection. Zero means the host closed it; data means a stray reply is pending.
+	char byte;
+	ssize_t result = recv(connectionSocket, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+	if(result < 0)
+	{
+		int errorCode = GETERROR();
+		return errorCode == EAGAIN || errorCode == EWOULDBLOCK;
+	}
+	return false;
+}
+
 // Get the hostname of the client
 std::string Networking::Client::GetHostName()
 {
@@ -466,7 +815,7 @@ std::string Networking::Client::GetHostName()
 		WSACleanup();
 	#endif
 		// Throw the error code
-		throw errorCode;
+		ThrowSocketException(connectionSocket, errorCode);
 	}
 
 	// Return the hostname of the client
@@ -494,7 +843,7 @@ std::string Networking::Client::GetServerHostName()
 		WSACleanup();
 	#endif
 		// Throw the error code
-		throw errorCode;
+		ThrowSocketException(connectionSocket, errorCode);
 	}
 
 	// Return the hostname of the server
@@ -518,7 +867,7 @@ std::string Networking::Client::GetLocalIPAddress()
 		WSACleanup();
 	#endif
 		// Throw the error code
-		throw errorCode;
+		ThrowSocketException(connectionSocket, errorCode);
 	}
 
 	// Convert the local IP address to a string
@@ -535,7 +884,7 @@ std::string Networking::Client::GetLocalIPAddress()
 		WSACleanup();
 	#endif
 		// Throw the error code
-		throw errorCode;
+		ThrowSocketException(connectionSocket, errorCode);
 	}
 
 	// Return the local IP address of the client
@@ -562,7 +911,7 @@ std::string Networking::Client::GetRemoteIPAddress()
 		WSACleanup();
 	#endif
 		// Throw the error code
-		throw errorCode;
+		ThrowSocketException(connectionSocket, errorCode);
 	}
 
 	// Return the remote IP address of the server
@@ -19,6 +19,7 @@
 #else
 #include  <sys/socket.h>
 #include <netinet/in.h>
+#include <sys/un.h>
 #include  <errno.h>
 #include <arpa/inet.h>
 #include <unistd.h>
@@ -40,6 +41,13 @@ typedef const char* PCSTR;
 #include <iostream>
 #include <string>
 #include <vector>
+#include "bufferpool.h"
+#include "compression.h"
+#include "filetransfer.h"
+#include "frame.h"
+#include "result.h"
+#include "zerocopy.h"
+#include "errorcodes.h"
 
 namespace Networking {
 
@@ -71,6 +79,22 @@ bool CreateClientSocket(PCSTR _pHost, int _pPort);
 // Connects the client socket to the specified host on the specified port.
 bool ConnectClientSocket();
 
+// Connects the client socket without blocking past _pDeadline. Throws a
+// NetworkException carrying ETIMEDOUT if the handshake has not completed by
+// then, or the error code.
+bool ConnectClientSocket(const Deadline& _pDeadline);
+
+// Resolves _pHost and connects to it on _pPort, retrying refused, reset and
+// timed-out attempts with backoff per _pPolicy for as long as _pDeadline
+// allows. Throws a NetworkException carrying EHOSTDOWN without trying if the
+// circuit breaker has the host marked as down, and carrying the last error
+// code if every attempt fails.
+bool Connect(PCSTR _pHost, int _pPort, const Deadline& _pDeadline, const RetryPolicy& _pPolicy = RetryPolicy());
+
+// Creates a Unix domain socket and connects it to the server listening on
+// _pSocketPath. Throws a NetworkException on failure.
+bool ConnectUnixSocket(const std::string& _pSocketPath);
+
 // Sets the socket type for the client socket.
 void SetSocketType(int _pSocktype);
 
@@ -83,11 +107,22 @@ void SetFamily(int _pFamily);
 // Sends the specified data buffer to the connected host.
 int Send(PCSTR _pSendBuffer);
 
+// Sends _pLength bytes, which may include NUL bytes, to the connected host.
+int Send(const char* _pData, size_t _pLength);
+
+// Sends the _pCount buffers described by _pVectors as one stream, gathered by
+// the kernel in as few system calls as possible. Returns the total number of
+// bytes sent; throws a NetworkException on failure.
+long Send(const iovec* _pVectors, size_t _pCount);
+
 // Send data to a specified address and port
 int SendTo(PCSTR pBuffer, PCSTR pAddress, int pPort);
 
-// Send a file to the server
-void SendFile(const std::string& _pFilePath);
+// Streams a file, or the byte range [_pOffset, _pOffset + _pLength) of it, to the
+// server as a file stream (see filetransfer.h) without copying it through user
+// space. Returns the number of file bytes sent; throws a NetworkException on
+// socket errors and std::runtime_error if the file cannot be opened.
+long long SendFile(const std::string& _pFilePath, uint64_t _pOffset = 0, uint64_t _pLength = FILE_TO_END);
 
 // Receives data from the connected host and stores it in a vector.
 std::vector<char> Receive();
@@ -95,15 +130,80 @@ std::vector<char> Receive();
 // Receive data from a specified address and port
 std::vector<char> ReceiveFrom(PCSTR _pAddress, int _pPort);
 
-// Receive a file from the server
-void   ReceiveFile(const std::string& _pFilePath);
+// Receives a file stream from the server and writes it to _pFilePath as it
+// arrives, using a bounded amount of memory whatever the file size. Returns the
+// number of bytes written. Throws a NetworkException on socket errors (EPROTO if the
+// data is not a file stream, EFBIG if it announces more than _pMaxLength bytes),
+// leaving no partial file behind, and std::runtime_error if the file cannot be created.
+long long ReceiveFile(const std::string& _pFilePath, uint64_t _pMaxLength = FILE_TO_END);
+
+// Sends _pLength bytes to the connected host as a single length-prefixed frame.
+// A nonzero _pRequestId marks the request as correlated: the server may answer
+// it out of order, with a reply frame carrying the same ID.
+int SendFrame(const char* _pData, size_t _pLength, uint32_t _pRequestId = 0);
+int SendFrame(const std::string& _pData, uint32_t _pRequestId = 0);
+
+// Receives one length-prefixed frame and returns its payload. Returns an empty
+// vector if the host closed the connection; throws a NetworkException on socket
+// errors, or carrying EPROTO/EMSGSIZE for malformed or oversized frames.
+std::vector<char> ReceiveFrame();
+// As above, also storing the frame's request ID in _pRequestId. The ID is
+// left at zero when no complete frame was received.
+std::vector<char> ReceiveFrame(uint32_t& _pRequestId);
+
+// Non-throwing forms of Send, Receive, SendFrame and ReceiveFrame, which are
+// thin wrappers that throw a NetworkException. A socket error closes the
+// connection just the same, but comes back as a classified error; a host that
+// hung up is ErrorKind::PeerClosed, with code zero for an orderly close.
+Result<long> TrySend(const iovec* _pVectors, size_t _pCount);
+Result<std::vector<char>> TryReceive();
+Result<long> TrySendFrame(const char* _pData, size_t _pLength, uint32_t _pRequestId = 0);
+Result<std::vector<char>> TryReceiveFrame(uint32_t& _pRequestId);
+
+// Sets the largest frame payload this client will accept
+void SetMaxMessageSize(size_t _pMaxMessageSize);
+size_t GetMaxMessageSize() const;
+
+// Compresses the frames this client sends with _pCodec once their payload is
+// at least _pThreshold bytes, and asks the host to compress its replies the
+// same way. Only use a codec the host advertised in its Hello reply (see
+// NegotiateCodec); None, the default, turns compression off. Compressed
+// frames are always accepted.
+void SetCompression(CompressionCodec _pCodec, size_t _pThreshold = DEFAULT_COMPRESSION_THRESHOLD);
+CompressionCodec GetCompression() const;
 
 // Disconnects the client socket from the host.
 bool Disconnect();
 
+// Shuts the connection down in both directions without closing the socket, so
+// that a thread blocked in ReceiveFrame returns. Disconnect must still be called.
+void Shutdown();
+
+// Sets the deadline for the SendFrame and ReceiveFrame calls that follow.
+// A frame not transferred by then fails with ETIMEDOUT and closes the
+// connection, since the stream is left mid-frame. The default never expires.
+void SetDeadline(const Deadline& _pDeadline);
+
+// Sends writes of at least _pThreshold bytes (frame header included) with
+// MSG_ZEROCOPY, see zerocopy.h. Zero, the default, disables zero-copy sends.
+void SetZeroCopyThreshold(size_t _pThreshold);
+ZeroCopySender::Stats GetZeroCopyStats() const;
+
+// Sets the breaker consulted and updated by Connect; nullptr disables it.
+// Defaults to CircuitBreaker::Default().
+void SetCircuitBreaker(CircuitBreaker* _pCircuitBreaker);
+
 // Returns whether the client is currently connected to a host.
 bool IsConnected();
 
+// Returns the connected socket, e.g. to pass descriptors over a Unix domain connection
+SOCKET GetSocket() const;
+
+// Returns whether an idle connection can still carry a request: it must be
+// connected, the host must not have closed it and no unread data may be waiting.
+// Does not block.
+bool IsHealthy();
+
 // Get the hostname of the client
 std::string GetHostName();
 
@@ -123,6 +223,33 @@ bool clientIsConnected = false;
 // The client socket.
 SOCKET connectionSocket;
 
+// Largest frame payload accepted by ReceiveFrame.
+size_t maxMessageSize = DEFAULT_MAX_MESSAGE_SIZE;
+
+// Deadline for frame I/O, see SetDeadline.
+Deadline ioDeadline;
+
+// Health of the hosts this client connects to.
+CircuitBreaker* circuitBreaker = &CircuitBreaker::Default();
+
+// Codec for outgoing frames and the smallest payload compressed, see SetCompression.
+CompressionCodec compressionCodec = CompressionCodec::None;
+size_t compressionThreshold = DEFAULT_COMPRESSION_THRESHOLD;
+// Reused for compressed payloads, so sending one does not allocate.
+std::vector<char> compressionBuffer;
+
+// Smallest write sent with MSG_ZEROCOPY, or zero if disabled.
+size_t zeroCopyThreshold = 0;
+ZeroCopySender zeroCopy;
+bool zeroCopyEnabled = false;
+
+// Writes the buffers with or without zero-copy, per the threshold.
+long WriteVectors(const iovec* _pVectors, size_t _pCount);
+
+// Closes the connection after a socket error, since the stream is left in an
+// unknown state, and returns the classified error.
+IoError FailConnection(int _pErrorCode);
+
 // Windows-specific data for socket initialization.
     #ifdef _WIN32
 WSADATA wsaData;
@@ -130,7 +257,7 @@ WSADATA wsaData;
 
 // Address information for the client socket.
 addrinfo addressInfo;
-addrinfo* hostAddressInfo;
+addrinfo* hostAddressInfo = nullptr;
 
 };
 
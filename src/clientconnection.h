@@ -0,0 +1,45 @@
+#pragma once
+#ifndef _NET_CLIENT_CONNECTION_
+#define _NET_CLIENT_CONNECTION_
+#ifndef _WIN32
+#include <netinet/in.h>
+#ifndef SOCKET
+#define SOCKET int
+#endif
+#else
+#include <WinSock2.h>
+#include <ws2ipdef.h>
+#endif
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace Networking {
+
+// Struct to hold information about a connected client
+struct ClientConnection {
+	SOCKET clientSocket = -1;
+	sockaddr_in clientInfo;
+	sockaddr_in6 clientInfo6;
+	// Request ID of the frame being handled; Server::SendFrame copies it into the reply
+	uint32_t requestId = 0;
+	// Codec the request said the peer accepts (see compression.h), or zero;
+	// Server::SendFrame compresses large replies with it
+	uint8_t replyCodec = 0;
+	// Listener, and so event loop, that accepted the connection when the server has several
+	size_t listenerIndex = 0;
+	bool operator==(const ClientConnection& other) const
+	{
+		// Compare the clientSocket member variables of the two objects
+		return clientSocket == other.clientSocket;
+	}
+};
+
+// Callback invoked by Server::Run with each complete message read from a client.
+// Replies are sent with Server::Send using the same ClientConnection.
+typedef std::function<void(Networking::ClientConnection, const std::vector<char>&)> MessageHandler;
+
+}
+
+#endif
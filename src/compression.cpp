@@ -0,0 +1,365 @@
+#include "compression.h"
+#include <arpa/inet.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+
+namespace {
+
+// The Lz block format is a series of sequences, each a token byte, literals
+// and a match:
+//   token        high nibble: literal count, low nibble: match length - 4
+//   [length]     when a nibble is 15, further bytes are added to it until one is below 255
+//   literals     copied to the output as they are
+//   offset       2 bytes, little endian: how far back the match starts
+//   [length]     extension of the match length, as above
+// The last sequence stops after its literals.
+const size_t MIN_MATCH = 4;
+const size_t MAX_OFFSET = 65535;
+const int HASH_BITS = 14;
+
+std::atomic<uint64_t> framesCompressed{0};
+std::atomic<uint64_t> framesIncompressible{0};
+std::atomic<uint64_t> bytesBeforeCompression{0};
+std::atomic<uint64_t> bytesAfterCompression{0};
+std::atomic<uint64_t> compressNanoseconds{0};
+std::atomic<uint64_t> framesDecompressed{0};
+std::atomic<uint64_t> decompressNanoseconds{0};
+
+uint64_t ThreadCpuNanoseconds()
+{
+	timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+uint32_t Read32(const uint8_t* _pData)
+{
+	uint32_t value;
+	memcpy(&value, _pData, sizeof(value));
+	return value;
+}
+
+uint32_t Hash(uint32_t _pValue)
+{
+	return (_pValue * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Number of bytes at _pMatch equal to those at _pCurrent, compared a word at a
+// time; _pMatch is behind _pCurrent, so only _pCurrent needs to stop at _pEnd
+size_t MatchLength(const uint8_t* _pMatch, const uint8_t* _pCurrent, const uint8_t* _pEnd)
+{
+	const uint8_t* start = _pCurrent;
+	while(_pEnd - _pCurrent >= 8)
+	{
+		uint64_t match;
+		uint64_t current;
+		memcpy(&match, _pMatch, sizeof(match));
+		memcpy(&current, _pCurrent, sizeof(current));
+		uint64_t difference = match ^ current;
+		if(difference != 0)
+		{
+			// The first differing byte is the lowest one in memory order
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+			return (_pCurrent - start) + (__builtin_ctzll(difference) >> 3);
+#else
+			return (_pCurrent - start) + (__builtin_clzll(difference) >> 3);
+#endif
+		}
+		_pMatch += 8;
+		_pCurrent += 8;
+	}
+	while(_pCurrent < _pEnd && *_pMatch == *_pCurrent)
+	{
+		_pMatch++;
+		_pCurrent++;
+	}
+	return _pCurrent - start;
+}
+
+// Appends the extension bytes of a length whose nibble was 15
+bool WriteLength(size_t _pLength, uint8_t*& _pOut, const uint8_t* _pEnd)
+{
+	for(;;)
+	{
+		if(_pOut == _pEnd)
+			return false;
+		if(_pLength < 255)
+		{
+			*_pOut++ = (uint8_t)_pLength;
+			return true;
+		}
+		*_pOut++ = 255;
+		_pLength -= 255;
+	}
+}
+
+bool ReadLength(size_t& _pLength, const uint8_t*& _pIn, const uint8_t* _pEnd, size_t _pLimit)
+{
+	for(;;)
+	{
+		if(_pIn == _pEnd)
+			return false;
+		uint8_t byte = *_pIn++;
+		_pLength += byte;
+		// Anything longer than the output cannot be valid, which also stops overflow
+		if(_pLength > _pLimit)
+			return false;
+		if(byte < 255)
+			return true;
+	}
+}
+
+// Writes one sequence; a match length of zero ends the block
+bool WriteSequence(const uint8_t* _pLiterals, size_t _pLiteralCount, size_t _pOffset, size_t _pMatchLength, uint8_t*& _pOut, const uint8_t* _pEnd)
+{
+	if(_pOut == _pEnd)
+		return false;
+	uint8_t* token = _pOut++;
+	size_t matchCode = _pMatchLength == 0 ? 0 : _pMatchLength - MIN_MATCH;
+	*token = (uint8_t)((std::min<size_t>(_pLiteralCount, 15) << 4) | std::min<size_t>(matchCode, 15));
+	if(_pLiteralCount >= 15 && !WriteLength(_pLiteralCount - 15, _pOut, _pEnd))
+		return false;
+	if((size_t)(_pEnd - _pOut) < _pLiteralCount)
+		return false;
+	memcpy(_pOut, _pLiterals, _pLiteralCount);
+	_pOut += _pLiteralCount;
+	if(_pMatchLength == 0)
+		return true;
+
+	if(_pEnd - _pOut < 2)
+		return false;
+	*_pOut++ = (uint8_t)(_pOffset & 0xFF);
+	*_pOut++ = (uint8_t)(_pOffset >> 8);
+	if(matchCode >= 15 && !WriteLength(matchCode - 15, _pOut, _pEnd))
+		return false;
+	return true;
+}
+
+}
+
+const char* Networking::GetCodecName(CompressionCodec _pCodec)
+{
+	switch(_pCodec)
+	{
+	case CompressionCodec::Lz:
+		return "lz";
+	default:
+		return "none";
+	}
+}
+
+Networking::CompressionCodec Networking::ParseCodecName(const std::string& _pName)
+{
+	if(_pName == "lz")
+		return CompressionCodec::Lz;
+	return CompressionCodec::None;
+}
+
+std::string Networking::GetSupportedCodecs()
+{
+	return GetCodecName(CompressionCodec::Lz);
+}
+
+Networking::CompressionCodec Networking::NegotiateCodec(const std::string& _pPeerCodecs)
+{
+	// The peer lists its codecs best first, and its preference wins
+	std::istringstream names(_pPeerCodecs);
+	std::string name;
+	while(std::getline(names, name, ','))
+	{
+		CompressionCodec codec = ParseCodecName(name);
+		if(codec != CompressionCodec::None)
+			return codec;
+	}
+	return CompressionCodec::None;
+}
+
+size_t Networking::LzCompressBound(size_t _pLength)
+{
+	// Incompressible input becomes a single run of literals
+	return _pLength + _pLength / 255 + 16;
+}
+
+size_t Networking::LzCompress(const char* _pInput, size_t _pLength, char* _pOutput, size_t _pCapacity)
+{
+	const uint8_t* input = (const uint8_t*)_pInput;
+	uint8_t* out = (uint8_t*)_pOutput;
+	const uint8_t* outEnd = out + _pCapacity;
+
+	// Most recent position of each hashed 4-byte sequence. Stale or colliding
+	// entries are harmless, since every candidate is compared before use.
+	uint32_t table[1 << HASH_BITS];
+	memset(table, 0, sizeof(table));
+
+	size_t anchor = 0;
+	size_t position = 0;
+	while(position + MIN_MATCH <= _pLength)
+	{
+		uint32_t sequence = Read32(input + position);
+		uint32_t hash = Hash(sequence);
+		size_t candidate = table[hash];
+		table[hash] = (uint32_t)position;
+		if(candidate >= position || position - candidate > MAX_OFFSET || Read32(input + candidate) != sequence)
+		{
+			// Step further the longer nothing has matched, so incompressible data is skipped quickly
+			position += 1 + ((position - anchor) >> 6);
+			continue;
+		}
+
+		size_t matchLength = MatchLength(input + candidate + MIN_MATCH, input + position + MIN_MATCH, input + _pLength) + MIN_MATCH;
+		// The match may also reach back into the literals before it
+		while(position > anchor && candidate > 0 && input[position - 1] == input[candidate - 1])
+		{
+			position--;
+			candidate--;
+			matchLength++;
+		}
+
+		if(!WriteSequence(input + anchor, position - anchor, position - candidate, matchLength, out, outEnd))
+			return 0;
+		position += matchLength;
+		anchor = position;
+		if(position >= 2 && position + 2 <= _pLength)
+			table[Hash(Read32(input + position - 2))] = (uint32_t)(position - 2);
+	}
+
+	if(!WriteSequence(input + anchor, _pLength - anchor, 0, 0, out, outEnd))
+		return 0;
+	return out - (uint8_t*)_pOutput;
+}
+
+bool Networking::LzDecompress(const char* _pInput, size_t _pLength, char* _pOutput, size_t _pOutputLength)
+{
+	const uint8_t* in = (const uint8_t*)_pInput;
+	const uint8_t* inEnd = in + _pLength;
+	uint8_t* out = (uint8_t*)_pOutput;
+	uint8_t* outStart = out;
+	uint8_t* outEnd = out + _pOutputLength;
+
+	for(;;)
+	{
+		if(in == inEnd)
+			return false;
+		uint8_t token = *in++;
+
+		size_t literalCount = token >> 4;
+		if(literalCount == 15 && !ReadLength(literalCount, in, inEnd, _pOutputLength))
+			return false;
+		if((size_t)(inEnd - in) < literalCount || (size_t)(outEnd - out) < literalCount)
+			return false;
+		memcpy(out, in, literalCount);
+		in += literalCount;
+		out += literalCount;
+		if(in == inEnd)
+			return out == outEnd;
+
+		if(inEnd - in < 2)
+			return false;
+		size_t offset = in[0] | ((size_t)in[1] << 8);
+		in += 2;
+		if(offset == 0 || offset > (size_t)(out - outStart))
+			return false;
+		size_t matchLength = token & 0x0F;
+		if(matchLength == 15 && !ReadLength(matchLength, in, inEnd, _pOutputLength))
+			return false;
+		matchLength += MIN_MATCH;
+		if((size_t)(outEnd - out) < matchLength)
+			return false;
+
+		const uint8_t* match = out - offset;
+		if(offset >= matchLength)
+		{
+			memcpy(out, match, matchLength);
+			out += matchLength;
+		}
+		else
+		{
+			// An overlapping match repeats the last offset bytes
+			for(size_t i = 0; i < matchLength; i++)
+				*out++ = match[i];
+		}
+	}
+}
+
+size_t Networking::CompressedPayloadBound(size_t _pLength)
+{
+	return COMPRESSED_PAYLOAD_PREFIX_SIZE + LzCompressBound(_pLength);
+}
+
+size_t Networking::CompressFramePayload(CompressionCodec _pCodec, const char* _pPayload, size_t _pLength, char* _pOutput)
+{
+	if(_pCodec != CompressionCodec::Lz || _pLength > UINT32_MAX)
+		return 0;
+
+	uint64_t started = ThreadCpuNanoseconds();
+	uint32_t originalLength = htonl((uint32_t)_pLength);
+	memcpy(_pOutput, &originalLength, sizeof(originalLength));
+	// Output that would not be smaller than the payload is abandoned as soon as it gets there
+	size_t compressed = 0;
+	if(_pLength > COMPRESSED_PAYLOAD_PREFIX_SIZE)
+		compressed = LzCompress(_pPayload, _pLength, _pOutput + COMPRESSED_PAYLOAD_PREFIX_SIZE, _pLength - COMPRESSED_PAYLOAD_PREFIX_SIZE - 1);
+	compressNanoseconds += ThreadCpuNanoseconds() - started;
+
+	if(compressed == 0)
+	{
+		framesIncompressible++;
+		return 0;
+	}
+	compressed += COMPRESSED_PAYLOAD_PREFIX_SIZE;
+	framesCompressed++;
+	bytesBeforeCompression += _pLength;
+	bytesAfterCompression += compressed;
+	return compressed;
+}
+
+Networking::Result<size_t> Networking::GetDecompressedLength(CompressionCodec _pCodec, const char* _pPayload, size_t _pLength, size_t _pMaxSize)
+{
+	if(_pCodec != CompressionCodec::Lz || _pLength < COMPRESSED_PAYLOAD_PREFIX_SIZE)
+		return Result<size_t>::Failure(EPROTO);
+	uint32_t originalLength;
+	memcpy(&originalLength, _pPayload, sizeof(originalLength));
+	originalLength = ntohl(originalLength);
+	if(originalLength > _pMaxSize)
+		return Result<size_t>::Failure(EMSGSIZE);
+	return (size_t)originalLength;
+}
+
+bool Networking::DecompressFramePayload(CompressionCodec _pCodec, const char* _pPayload, size_t _pLength, char* _pOutput, size_t _pOutputLength)
+{
+	if(_pCodec != CompressionCodec::Lz || _pLength < COMPRESSED_PAYLOAD_PREFIX_SIZE)
+		return false;
+	uint64_t started = ThreadCpuNanoseconds();
+	bool valid = LzDecompress(_pPayload + COMPRESSED_PAYLOAD_PREFIX_SIZE, _pLength - COMPRESSED_PAYLOAD_PREFIX_SIZE, _pOutput, _pOutputLength);
+	decompressNanoseconds += ThreadCpuNanoseconds() - started;
+	if(valid)
+		framesDecompressed++;
+	return valid;
+}
+
+Networking::Result<Networking::SharedBuffer> Networking::DecompressFramePayload(CompressionCodec _pCodec, const char* _pPayload, size_t _pLength, size_t _pMaxSize)
+{
+	Result<size_t> length = GetDecompressedLength(_pCodec, _pPayload, _pLength, _pMaxSize);
+	if(!length)
+		return length.GetError();
+	SharedBuffer payload = BufferPool::Default().Acquire(length.Value());
+	if(!DecompressFramePayload(_pCodec, _pPayload, _pLength, payload->data(), payload->size()))
+		return Result<SharedBuffer>::Failure(EPROTO);
+	return payload;
+}
+
+Networking::CompressionStats Networking::GetCompressionStats()
+{
+	CompressionStats stats;
+	stats.framesCompressed = framesCompressed;
+	stats.framesIncompressible = framesIncompressible;
+	stats.bytesBeforeCompression = bytesBeforeCompression;
+	stats.bytesAfterCompression = bytesAfterCompression;
+	stats.compressNanoseconds = compressNanoseconds;
+	stats.framesDecompressed = framesDecompressed;
+	stats.decompressNanoseconds = decompressNanoseconds;
+	return stats;
+}
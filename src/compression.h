@@ -0,0 +1,93 @@
+#pragma once
+#ifndef _NET_COMPRESSION_
+#define _NET_COMPRESSION_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "bufferpool.h"
+#include "result.h"
+
+namespace Networking {
+
+// Codecs a frame payload may be compressed with. The value travels in the
+// codec byte of the frame header (see frame.h), so it must never be reused.
+enum class CompressionCodec : uint8_t {
+	None = 0,
+	Lz = 1 // Byte-oriented LZ77 in the style of LZ4: fast, modest ratios, no dependencies
+};
+
+// Payloads shorter than this are sent as they are unless SetCompression says otherwise
+const size_t DEFAULT_COMPRESSION_THRESHOLD = 1024;
+
+// Name of a codec as advertised in the Hello handshake ("lz"); "none" for None
+const char* GetCodecName(CompressionCodec _pCodec);
+
+// Codec with the given name, or None if this build does not know it
+CompressionCodec ParseCodecName(const std::string& _pName);
+
+// Comma-separated names of the codecs this build can decode, best first
+std::string GetSupportedCodecs();
+
+// Best codec in a peer's comma-separated list that this build supports, or
+// None if there is none (or the peer predates compression and sent nothing)
+CompressionCodec NegotiateCodec(const std::string& _pPeerCodecs);
+
+// Largest output LzCompress can produce for _pLength bytes
+size_t LzCompressBound(size_t _pLength);
+
+// Compresses _pLength bytes into _pOutput, which holds _pCapacity bytes.
+// Returns the compressed size, or 0 if it would not fit.
+size_t LzCompress(const char* _pInput, size_t _pLength, char* _pOutput, size_t _pCapacity);
+
+// Decompresses _pLength bytes produced by LzCompress into exactly
+// _pOutputLength bytes. Returns false if the input is corrupt or does not
+// expand to that length; never reads or writes out of bounds.
+bool LzDecompress(const char* _pInput, size_t _pLength, char* _pOutput, size_t _pOutputLength);
+
+// A compressed frame payload is the original length (4 bytes, network byte
+// order) followed by the codec's output
+const size_t COMPRESSED_PAYLOAD_PREFIX_SIZE = 4;
+
+// Room CompressFramePayload may need for _pLength bytes
+size_t CompressedPayloadBound(size_t _pLength);
+
+// Compresses a frame payload into _pOutput, which must hold
+// CompressedPayloadBound(_pLength) bytes. Returns the size of the compressed
+// payload, or 0 if compressing does not make it smaller, in which case the
+// frame should go out uncompressed.
+size_t CompressFramePayload(CompressionCodec _pCodec, const char* _pPayload, size_t _pLength, char* _pOutput);
+
+// Original length of a compressed payload. Fails with EPROTO if the codec is
+// unknown or the prefix is missing, and EMSGSIZE if it exceeds _pMaxSize.
+Result<size_t> GetDecompressedLength(CompressionCodec _pCodec, const char* _pPayload, size_t _pLength, size_t _pMaxSize);
+
+// Restores a compressed payload into _pOutput, which must hold the
+// GetDecompressedLength bytes passed as _pOutputLength. Returns false if the
+// data is corrupt.
+bool DecompressFramePayload(CompressionCodec _pCodec, const char* _pPayload, size_t _pLength, char* _pOutput, size_t _pOutputLength);
+
+// As above, into a buffer from BufferPool::Default(); fails as
+// GetDecompressedLength does, or with EPROTO for corrupt data
+Result<SharedBuffer> DecompressFramePayload(CompressionCodec _pCodec, const char* _pPayload, size_t _pLength, size_t _pMaxSize);
+
+// Process-wide counters for the frame compression stage. Times are the CPU
+// time of the calling threads.
+struct CompressionStats {
+	uint64_t framesCompressed = 0;       // Payloads sent compressed
+	uint64_t framesIncompressible = 0;   // Payloads that did not shrink and went out as they were
+	uint64_t bytesBeforeCompression = 0; // Original size of the compressed payloads
+	uint64_t bytesAfterCompression = 0;  // Their size on the wire, prefix included
+	uint64_t compressNanoseconds = 0;    // Spent compressing, incompressible attempts included
+	uint64_t framesDecompressed = 0;     // Compressed payloads received intact
+	uint64_t decompressNanoseconds = 0;  // Spent decompressing
+
+	// Original bytes per byte sent for the payloads that were compressed
+	double Ratio() const { return bytesAfterCompression == 0 ? 0.0 : (double)bytesBeforeCompression / bytesAfterCompression; }
+};
+
+CompressionStats GetCompressionStats();
+
+}
+
+#endif
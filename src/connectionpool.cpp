@@ -0,0 +1,246 @@
+#include "connectionpool.h"
+
+Networking::ConnectionPool::Lease::Lease()
+{
+}
+
+Networking::ConnectionPool::Lease::Lease(ConnectionPool* _pPool, const std::string& _pKey, std::unique_ptr<Client> _pClient, bool _pReused)
+	: pool(_pPool), key(_pKey), client(std::move(_pClient)), reused(_pReused)
+{
+}
+
+Networking::ConnectionPool::Lease::Lease(Lease&& _pOther)
+	: pool(_pOther.pool), key(std::move(_pOther.key)), client(std::move(_pOther.client)), reused(_pOther.reused), reusable(_pOther.reusable)
+{
+	_pOther.pool = nullptr;
+}
+
+Networking::ConnectionPool::Lease& Networking::ConnectionPool::Lease::operator=(Lease&& _pOther)
+{
+	if(this != &_pOther)
+	{
+		Release();
+		pool = _pOther.pool;
+		key = std::move(_pOther.key);
+		client = std::move(_pOther.client);
+		reused = _pOther.reused;
+		reusable = _pOther.reusable;
+		_pOther.pool = nullptr;
+	}
+	return *this;
+}
+
+Networking::ConnectionPool::Lease::~Lease()
+{
+	Release();
+}
+
+Networking::Client* Networking::ConnectionPool::Lease::operator->()
+{
+	return client.get();
+}
+
+Networking::Client& Networking::ConnectionPool::Lease::operator*()
+{
+	return *client;
+}
+
+Networking::ConnectionPool::Lease::operator bool() const
+{
+	return client != nullptr;
+}
+
+bool Networking::ConnectionPool::Lease::IsReused() const
+{
+	return reused;
+}
+
+void Networking::ConnectionPool::Lease::Invalidate()
+{
+	reusable = false;
+}
+
+void Networking::ConnectionPool::Lease::Release()
+{
+	if(!client)
+		return;
+	// A client whose send or receive failed has already closed its socket
+	if(pool != nullptr && reusable && client->IsConnected())
+		pool->Return(key, std::move(client));
+	else
+		ConnectionPool::Close(client);
+	client.reset();
+	pool = nullptr;
+}
+
+Networking::ConnectionPool::ConnectionPool(size_t _pMaxIdlePerKey, std::chrono::milliseconds _pIdleTimeout)
+	: maxIdlePerKey(_pMaxIdlePerKey), idleTimeout(_pIdleTimeout)
+{
+}
+
+Networking::ConnectionPool::~ConnectionPool()
+{
+	Clear();
+}
+
+Networking::ConnectionPool::Lease Networking::ConnectionPool::Acquire(const std::string& _pHost, int _pPort)
+{
+	std::string key = _pHost + ":" + std::to_string(_pPort);
+	std::vector<std::unique_ptr<Client> > discarded;
+	std::unique_ptr<Client> client;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		EvictIdleLocked(std::chrono::steady_clock::now(), discarded);
+
+		auto it = idleConnections.find(key);
+		// The most recently returned connection is the least likely to have been closed by the server
+		while(it != idleConnections.end() && !it->second.empty())
+		{
+			std::unique_ptr<Client> candidate = std::move(it->second.back().client);
+			it->second.pop_back();
+			if(candidate->IsHealthy())
+			{
+				client = std::move(candidate);
+				break;
+			}
+			stats.failedHealthChecks++;
+			discarded.push_back(std::move(candidate));
+		}
+		if(client)
+			stats.hits++;
+		else
+			stats.misses++;
+	}
+
+	// Sockets are closed outside the lock
+	for(auto& stale : discarded)
+		Close(stale);
+
+	if(client)
+	{
+		client->SetDeadline(Deadline::After(ioTimeout));
+		return Lease(this, key, std::move(client), true);
+	}
+
+	// New connections are bounded by the connect timeout and skip hosts the circuit breaker has marked down
+	std::unique_ptr<Client> fresh(new Client());
+	try
+	{
+		fresh->Connect(_pHost.c_str(), _pPort, Deadline::After(connectTimeout), retryPolicy);
+	}
+	catch(NetworkException&)
+	{
+		return Lease();
+	}
+	fresh->SetDeadline(Deadline::After(ioTimeout));
+	return Lease(this, key, std::move(fresh), false);
+}
+
+void Networking::ConnectionPool::SetConnectTimeout(std::chrono::milliseconds _pConnectTimeout)
+{
+	connectTimeout = _pConnectTimeout;
+}
+
+void Networking::ConnectionPool::SetIoTimeout(std::chrono::milliseconds _pIoTimeout)
+{
+	ioTimeout = _pIoTimeout;
+}
+
+void Networking::ConnectionPool::SetRetryPolicy(const RetryPolicy& _pRetryPolicy)
+{
+	retryPolicy = _pRetryPolicy;
+}
+
+void Networking::ConnectionPool::EvictIdle()
+{
+	std::vector<std::unique_ptr<Client> > expired;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		EvictIdleLocked(std::chrono::steady_clock::now(), expired);
+	}
+	for(auto& client : expired)
+		Close(client);
+}
+
+void Networking::ConnectionPool::Clear()
+{
+	std::unordered_map<std::string, std::vector<IdleConnection> > idle;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		idle.swap(idleConnections);
+	}
+	for(auto& entry : idle)
+		for(auto& connection : entry.second)
+			Close(connection.client);
+}
+
+Networking::ConnectionPool::Stats Networking::ConnectionPool::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Stats snapshot = stats;
+	snapshot.idle = 0;
+	for(const auto& entry : idleConnections)
+		snapshot.idle += entry.second.size();
+	return snapshot;
+}
+
+void Networking::ConnectionPool::Return(const std::string& _pKey, std::unique_ptr<Client> _pClient)
+{
+	std::unique_ptr<Client> overflow;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::vector<IdleConnection>& idle = idleConnections[_pKey];
+		if(maxIdlePerKey == 0)
+		{
+			overflow = std::move(_pClient);
+		}
+		else
+		{
+			if(idle.size() >= maxIdlePerKey)
+			{
+				overflow = std::move(idle.front().client);
+				idle.erase(idle.begin());
+			}
+			idle.push_back(IdleConnection{std::move(_pClient), std::chrono::steady_clock::now()});
+		}
+		if(overflow)
+			stats.evictions++;
+	}
+	Close(overflow);
+}
+
+void Networking::ConnectionPool::EvictIdleLocked(std::chrono::steady_clock::time_point _pNow, std::vector<std::unique_ptr<Client> >& _pExpired)
+{
+	for(auto it = idleConnections.begin(); it != idleConnections.end();)
+	{
+		// Connections are appended as they are returned, so the oldest are at the front
+		std::vector<IdleConnection>& idle = it->second;
+		size_t expired = 0;
+		while(expired < idle.size() && _pNow - idle[expired].idleSince >= idleTimeout)
+		{
+			_pExpired.push_back(std::move(idle[expired].client));
+			expired++;
+		}
+		idle.erase(idle.begin(), idle.begin() + expired);
+		stats.evictions += expired;
+
+		if(idle.empty())
+			it = idleConnections.erase(it);
+		else
+			++it;
+	}
+}
+
+void Networking::ConnectionPool::Close(std::unique_ptr<Client>& _pClient)
+{
+	if(!_pClient || !_pClient->IsConnected())
+		return;
+	try
+	{
+		_pClient->Disconnect();
+	}
+	catch(NetworkException&)
+	{
+		// Disconnect has already closed the socket; the peer was gone
+	}
+}
@@ -0,0 +1,128 @@
+#pragma once
+#ifndef _NET_CONNECTION_POOL_
+#define _NET_CONNECTION_POOL_
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "client.h"
+
+namespace Networking {
+
+// Keeps connected Clients open between requests, keyed by host and port, so
+// that repeated requests to the same server skip name resolution and the TCP
+// handshake. The server must have keep-alive enabled for a connection to
+// carry more than one request. Idle connections are checked with
+// Client::IsHealthy before reuse and closed once they exceed the idle timeout.
+class ConnectionPool {
+public:
+
+// Exclusive use of one pooled connection. Returns the connection to the pool
+// when destroyed, unless it was invalidated or its socket failed.
+class Lease {
+public:
+Lease();
+Lease(Lease&& _pOther);
+Lease& operator=(Lease&& _pOther);
+Lease(const Lease&) = delete;
+Lease& operator=(const Lease&) = delete;
+~Lease();
+
+Client* operator->();
+Client& operator*();
+
+// Returns true if the lease holds a connected client
+explicit operator bool() const;
+
+// Returns true if the connection was taken from the pool rather than opened for this lease.
+// A request that fails on a reused connection may be retried on a fresh one.
+bool IsReused() const;
+
+// Closes the connection when the lease ends instead of returning it, e.g. after a
+// protocol error left unread data on the socket
+void Invalidate();
+
+private:
+friend class ConnectionPool;
+Lease(ConnectionPool* _pPool, const std::string& _pKey, std::unique_ptr<Client> _pClient, bool _pReused);
+void Release();
+
+ConnectionPool* pool = nullptr;
+std::string key;
+std::unique_ptr<Client> client;
+bool reused = false;
+bool reusable = true;
+};
+
+// Counters describing how well the pool is being reused
+struct Stats {
+	uint64_t hits = 0;               // Leases served from an idle connection
+	uint64_t misses = 0;             // Leases that had to open a new connection
+	uint64_t failedHealthChecks = 0; // Idle connections found closed or dirty on reuse
+	uint64_t evictions = 0;          // Idle connections closed for age or over the per-key limit
+	size_t idle = 0;                 // Connections currently waiting in the pool
+};
+
+// Creates a pool keeping at most _pMaxIdlePerKey idle connections per host and
+// port, each for at most _pIdleTimeout
+ConnectionPool(size_t _pMaxIdlePerKey = 4, std::chrono::milliseconds _pIdleTimeout = std::chrono::seconds(60));
+
+// Closes all idle connections. Outstanding leases must end before the pool is destroyed.
+~ConnectionPool();
+
+ConnectionPool(const ConnectionPool&) = delete;
+ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+// Returns a healthy idle connection to _pHost:_pPort, or opens a new one.
+// The returned lease is empty if the connection could not be established
+// within the connect timeout or the host's circuit breaker is open.
+Lease Acquire(const std::string& _pHost, int _pPort);
+
+// Sets how long Acquire may spend opening a new connection, retries included
+void SetConnectTimeout(std::chrono::milliseconds _pConnectTimeout);
+
+// Sets how long each lease may spend sending and receiving frames. Leased
+// clients get a deadline this far ahead, so a peer that never replies makes
+// SendFrame or ReceiveFrame fail with ETIMEDOUT instead of blocking forever.
+void SetIoTimeout(std::chrono::milliseconds _pIoTimeout);
+
+// Sets how failed connection attempts are retried within the connect timeout
+void SetRetryPolicy(const RetryPolicy& _pRetryPolicy);
+
+// Closes idle connections that have exceeded the idle timeout
+void EvictIdle();
+
+// Closes all idle connections
+void Clear();
+
+Stats GetStats() const;
+
+private:
+
+struct IdleConnection {
+	std::unique_ptr<Client> client;
+	std::chrono::steady_clock::time_point idleSince;
+};
+
+void Return(const std::string& _pKey, std::unique_ptr<Client> _pClient);
+void EvictIdleLocked(std::chrono::steady_clock::time_point _pNow, std::vector<std::unique_ptr<Client> >& _pExpired);
+static void Close(std::unique_ptr<Client>& _pClient);
+
+size_t maxIdlePerKey;
+std::chrono::milliseconds idleTimeout;
+std::chrono::milliseconds connectTimeout = std::chrono::seconds(2);
+std::chrono::milliseconds ioTimeout = std::chrono::seconds(10);
+RetryPolicy retryPolicy;
+mutable std::mutex mutex;
+// Idle connections per "host:port", most recently returned last
+std::unordered_map<std::string, std::vector<IdleConnection> > idleConnections;
+Stats stats;
+};
+
+}
+
+#endif
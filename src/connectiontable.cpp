@@ -0,0 +1,229 @@
+#include "connectiontable.h"
+#include <algorithm>
+
+Networking::ConnectionTable::ConnectionTable(size_t _pMaxConnections, std::chrono::milliseconds _pIdleTimeout)
+	: maxConnections(_pMaxConnections), idleTimeoutMs(0), tickMs(1)
+{
+	SetIdleTimeout(_pIdleTimeout);
+}
+
+void Networking::ConnectionTable::SetMaxConnections(size_t _pMaxConnections)
+{
+	maxConnections = _pMaxConnections;
+}
+
+size_t Networking::ConnectionTable::GetMaxConnections() const
+{
+	return maxConnections;
+}
+
+void Networking::ConnectionTable::SetIdleTimeout(std::chrono::milliseconds _pIdleTimeout)
+{
+	idleTimeoutMs = std::max<int64_t>(_pIdleTimeout.count(), 0);
+	// The wheel spans one idle timeout, so a deadline never laps it
+	tickMs = std::max<int64_t>((idleTimeoutMs + WHEEL_SLOTS - 2) / (WHEEL_SLOTS - 1), 1);
+
+	// Ticks are counted in the new length from here on, so every connection
+	// is rescheduled; this also picks up ones added while expiry was off
+	int64_t now = TickOf(std::chrono::steady_clock::now());
+	for(Shard& shard : shards)
+	{
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		for(std::vector<WheelEntry>& bucket : shard.wheel)
+			bucket.clear();
+		shard.currentTick = now;
+		if(idleTimeoutMs == 0)
+			continue;
+		for(size_t i = 0; i < shard.slots.size(); i++)
+		{
+			const Slot& slot = shard.slots[i];
+			if(slot.used && !slot.expired)
+				Schedule(shard, slot.client.clientSocket, slot.generation, slot.lastActivity + _pIdleTimeout);
+		}
+	}
+}
+
+std::chrono::milliseconds Networking::ConnectionTable::GetIdleTimeout() const
+{
+	return std::chrono::milliseconds(idleTimeoutMs.load());
+}
+
+std::chrono::milliseconds Networking::ConnectionTable::GetTickLength() const
+{
+	return std::chrono::milliseconds(tickMs.load());
+}
+
+bool Networking::ConnectionTable::Insert(const ClientConnection& _pClient)
+{
+	if(_pClient.clientSocket < 0)
+		return false;
+	// The slot is reserved before taking the lock, so the limit holds however many threads insert
+	size_t limit = maxConnections;
+	if(count.fetch_add(1) >= limit && limit > 0)
+	{
+		count--;
+		return false;
+	}
+
+	Shard& shard = ShardFor(_pClient.clientSocket);
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	{
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		size_t index = _pClient.clientSocket / SHARD_COUNT;
+		if(index >= shard.slots.size())
+			shard.slots.resize(std::max(index + 1, shard.slots.size() * 2));
+		Slot& slot = shard.slots[index];
+		if(slot.used)
+		{
+			count--;
+			return false;
+		}
+		slot.client = _pClient;
+		slot.lastActivity = now;
+		slot.generation++;
+		slot.used = true;
+		slot.expired = false;
+		if(idleTimeoutMs > 0)
+			Schedule(shard, _pClient.clientSocket, slot.generation, now + GetIdleTimeout());
+	}
+	version++;
+	return true;
+}
+
+bool Networking::ConnectionTable::Remove(SOCKET _pSocket)
+{
+	Shard& shard = ShardFor(_pSocket);
+	{
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		Slot* slot = FindSlot(shard, _pSocket);
+		if(slot == nullptr)
+			return false;
+		// The wheel entry is left behind and dropped once its generation is seen to be stale
+		slot->used = false;
+		slot->client = ClientConnection();
+	}
+	count--;
+	version++;
+	return true;
+}
+
+bool Networking::ConnectionTable::Contains(SOCKET _pSocket) const
+{
+	Shard& shard = ShardFor(_pSocket);
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	return FindSlot(shard, _pSocket) != nullptr;
+}
+
+void Networking::ConnectionTable::Touch(SOCKET _pSocket)
+{
+	Shard& shard = ShardFor(_pSocket);
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	if(Slot* slot = FindSlot(shard, _pSocket))
+		slot->lastActivity = now;
+}
+
+size_t Networking::ConnectionTable::Size() const
+{
+	return count;
+}
+
+Networking::ConnectionTable::Snapshot Networking::ConnectionTable::GetSnapshot() const
+{
+	uint64_t current = version;
+	std::lock_guard<std::mutex> lock(snapshotMutex);
+	if(snapshot && snapshotVersion == current)
+		return snapshot;
+
+	std::shared_ptr<std::vector<ClientConnection> > clients = std::make_shared<std::vector<ClientConnection> >();
+	clients->reserve(count);
+	for(Shard& shard : shards)
+	{
+		std::lock_guard<std::mutex> shardLock(shard.mutex);
+		for(const Slot& slot : shard.slots)
+		{
+			if(slot.used)
+				clients->push_back(slot.client);
+		}
+	}
+	// A change made while the shards were walked bumps the version again, so
+	// the next call rebuilds rather than keeping a list that may miss it
+	snapshot = clients;
+	snapshotVersion = current;
+	return snapshot;
+}
+
+size_t Networking::ConnectionTable::ExpireIdle(std::chrono::steady_clock::time_point _pNow, const std::function<void(const ClientConnection&)>& _pExpire)
+{
+	std::chrono::milliseconds idleTimeout = GetIdleTimeout();
+	if(idleTimeout.count() == 0)
+		return 0;
+
+	size_t expired = 0;
+	int64_t nowTick = TickOf(_pNow);
+	for(Shard& shard : shards)
+	{
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		if(nowTick <= shard.currentTick)
+			continue;
+
+		// Buckets up to now are emptied first, so entries rescheduled below
+		// cannot land in a bucket that is still to be visited in this pass
+		std::vector<WheelEntry> due;
+		int64_t buckets = std::min<int64_t>(nowTick - shard.currentTick, WHEEL_SLOTS);
+		for(int64_t i = 1; i <= buckets; i++)
+		{
+			std::vector<WheelEntry>& bucket = shard.wheel[(shard.currentTick + i) % WHEEL_SLOTS];
+			due.insert(due.end(), bucket.begin(), bucket.end());
+			bucket.clear();
+		}
+		shard.currentTick = nowTick;
+
+		for(const WheelEntry& entry : due)
+		{
+			Slot* slot = FindSlot(shard, entry.socket);
+			if(slot == nullptr || slot->generation != entry.generation || slot->expired)
+				continue;
+			std::chrono::steady_clock::time_point deadline = slot->lastActivity + idleTimeout;
+			if(deadline > _pNow)
+			{
+				Schedule(shard, entry.socket, entry.generation, deadline);
+				continue;
+			}
+			slot->expired = true;
+			expired++;
+			_pExpire(slot->client);
+		}
+	}
+	return expired;
+}
+
+Networking::ConnectionTable::Shard& Networking::ConnectionTable::ShardFor(SOCKET _pSocket) const
+{
+	return shards[(size_t)_pSocket % SHARD_COUNT];
+}
+
+Networking::ConnectionTable::Slot* Networking::ConnectionTable::FindSlot(Shard& _pShard, SOCKET _pSocket) const
+{
+	if(_pSocket < 0)
+		return nullptr;
+	size_t index = _pSocket / SHARD_COUNT;
+	if(index >= _pShard.slots.size() || !_pShard.slots[index].used)
+		return nullptr;
+	return &_pShard.slots[index];
+}
+
+int64_t Networking::ConnectionTable::TickOf(std::chrono::steady_clock::time_point _pTime) const
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(_pTime.time_since_epoch()).count() / tickMs;
+}
+
+void Networking::ConnectionTable::Schedule(Shard& _pShard, SOCKET _pSocket, uint64_t _pGeneration, std::chrono::steady_clock::time_point _pDeadline)
+{
+	// A deadline is due once its tick has fully passed; one further out than
+	// the wheel reaches is parked in the last bucket and re-checked from there
+	int64_t tick = TickOf(_pDeadline) + 1;
+	tick = std::max(tick, _pShard.currentTick + 1);
+	tick = std::min<int64_t>(tick, _pShard.currentTick + WHEEL_SLOTS - 1);
+	_pShard.wheel[tick % WHEEL_SLOTS].push_back(WheelEntry{_pSocket, _pGeneration});
+}
@@ -0,0 +1,124 @@
+#pragma once
+#ifndef _NET_CONNECTION_TABLE_
+#define _NET_CONNECTION_TABLE_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "clientconnection.h"
+
+namespace Networking {
+
+// Most connections a server holds at once unless SetMaxConnections says otherwise
+const size_t DEFAULT_MAX_CONNECTIONS = 10000;
+
+// Connections closed for inactivity unless SetIdleTimeout says otherwise
+const std::chrono::milliseconds DEFAULT_IDLE_TIMEOUT{60000};
+
+// The connections a server holds, indexed by descriptor so that adding,
+// removing and touching one is O(1). Descriptors are spread over shards with a
+// lock each, so the accepting thread, event loops and serving threads rarely
+// contend. Each shard keeps a timing wheel of idle deadlines: Touch only
+// records the time, and ExpireIdle re-checks an entry when its bucket comes
+// round, so activity costs no reordering. Safe to use from any thread.
+//
+// An owner must Remove a descriptor before closing it. ExpireIdle reports a
+// connection with its shard locked, so the descriptor cannot be closed and
+// reused while the callback acts on it.
+class ConnectionTable {
+public:
+// Immutable list of the connections at some moment, shared between readers
+typedef std::shared_ptr<const std::vector<ClientConnection> > Snapshot;
+
+explicit ConnectionTable(size_t _pMaxConnections = DEFAULT_MAX_CONNECTIONS, std::chrono::milliseconds _pIdleTimeout = DEFAULT_IDLE_TIMEOUT);
+
+// Zero removes the limit
+void SetMaxConnections(size_t _pMaxConnections);
+size_t GetMaxConnections() const;
+
+// Connections without activity for this long are reported by ExpireIdle.
+// Zero disables expiry.
+void SetIdleTimeout(std::chrono::milliseconds _pIdleTimeout);
+std::chrono::milliseconds GetIdleTimeout() const;
+
+// Granularity of the timing wheel; ExpireIdle need not run more often
+std::chrono::milliseconds GetTickLength() const;
+
+// Adds a connection as active now. Returns false if the table is full or the
+// descriptor is already present.
+bool Insert(const ClientConnection& _pClient);
+
+// Removes a connection; returns false if it was not present
+bool Remove(SOCKET _pSocket);
+
+bool Contains(SOCKET _pSocket) const;
+
+// Records activity on a connection
+void Touch(SOCKET _pSocket);
+
+size_t Size() const;
+
+// Returns the current connections. Repeated calls share one list until the
+// table changes.
+Snapshot GetSnapshot() const;
+
+// Calls _pExpire for each connection idle for at least the idle timeout as of
+// _pNow and not reported before. The connection stays in the table until its
+// owner removes it. _pExpire must not call back into the table.
+size_t ExpireIdle(std::chrono::steady_clock::time_point _pNow, const std::function<void(const ClientConnection&)>& _pExpire);
+
+private:
+
+static const size_t SHARD_COUNT = 16;
+static const size_t WHEEL_SLOTS = 64;
+
+struct Slot {
+	ClientConnection client;
+	std::chrono::steady_clock::time_point lastActivity;
+	// Counts insertions, so a wheel entry left by an earlier connection on the
+	// same descriptor is recognised as stale
+	uint64_t generation = 0;
+	bool used = false;
+	bool expired = false;
+};
+
+struct WheelEntry {
+	SOCKET socket;
+	uint64_t generation;
+};
+
+struct Shard {
+	mutable std::mutex mutex;
+	// Indexed by descriptor / SHARD_COUNT
+	std::vector<Slot> slots;
+	std::vector<WheelEntry> wheel[WHEEL_SLOTS];
+	// Last tick whose bucket has been processed
+	int64_t currentTick = 0;
+};
+
+Shard& ShardFor(SOCKET _pSocket) const;
+Slot* FindSlot(Shard& _pShard, SOCKET _pSocket) const;
+int64_t TickOf(std::chrono::steady_clock::time_point _pTime) const;
+void Schedule(Shard& _pShard, SOCKET _pSocket, uint64_t _pGeneration, std::chrono::steady_clock::time_point _pDeadline);
+
+mutable Shard shards[SHARD_COUNT];
+std::atomic<size_t> count{0};
+std::atomic<size_t> maxConnections;
+std::atomic<int64_t> idleTimeoutMs;
+std::atomic<int64_t> tickMs;
+
+// Bumped on every insert and remove; the cached snapshot is rebuilt when it moves
+std::atomic<uint64_t> version{0};
+mutable std::mutex snapshotMutex;
+mutable Snapshot snapshot;
+mutable uint64_t snapshotVersion = 0;
+};
+
+}
+
+#endif
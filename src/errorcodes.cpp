@@ -1,45 +1,54 @@
 #include "errorcodes.h"
+#include <cstring>
 #include <iostream>
 
+std::string Networking::ErrorMessage(const Error::ErrorMap& _pMap, int errorCode)
+{
+	auto it = _pMap.find(errorCode);
+	if(it != _pMap.end())
+		return it->second;
+	return strerror(errorCode);
+}
+
 void Networking::ThrowSocketException(int socket, int errorCode)
 {
 	std::cerr<<"Sockket Error"<< errorCode<< std::endl;
-	throw Networking::NetworkException(socket, errorCode, Networking::Error::socketMap.at(errorCode));
+	throw Networking::NetworkException(socket, errorCode, ErrorMessage(Networking::Error::socketMap, errorCode));
 }
 
 void Networking::ThrowBindException(int socket, int errorCode)
 {
 	std::cerr<<"Bind Error"<< errorCode<< std::endl;
-	throw Networking::NetworkException(socket, errorCode, Networking::Error::bindMap.at(errorCode));
+	throw Networking::NetworkException(socket, errorCode, ErrorMessage(Networking::Error::bindMap, errorCode));
 }
 
 void Networking::ThrowListenException(int socket, int errorCode)
 {
 	std::cerr<<"Listen Error"<< errorCode<< std::endl;
-	throw Networking::NetworkException(socket, errorCode, Networking::Error::listenMap.at(errorCode));
+	throw Networking::NetworkException(socket, errorCode, ErrorMessage(Networking::Error::listenMap, errorCode));
 }
 
 void Networking::ThrowAcceptException(int socket, int errorCode)
 {
 	std::cerr<<"Accept Error"<< errorCode<< std::endl;
-	throw Networking::NetworkException(socket, errorCode, Networking::Error::acceptMap.at(errorCode));
+	throw Networking::NetworkException(socket, errorCode, ErrorMessage(Networking::Error::acceptMap, errorCode));
 }
 
 void Networking::ThrowSendException(int socket, int errorCode)
 {
 	std::cerr<<"Send Error"<< errorCode<< std::endl;
-	throw Networking::NetworkException(socket, errorCode, Networking::Error::sendMap.at(errorCode));
+	throw Networking::NetworkException(socket, errorCode, ErrorMessage(Networking::Error::sendMap, errorCode));
 }
 
 void Networking::ThrowReceiveException(int socket, int errorCode)
 {
 	std::cerr<<"Recieve Error"<< errorCode<< std::endl;
-	throw Networking::NetworkException(socket, errorCode, Networking::Error::receiveMap.at(errorCode));
+	throw Networking::NetworkException(socket, errorCode, ErrorMessage(Networking::Error::receiveMap, errorCode));
 }
 
 
 void Networking::ThrowShutdownException(int socket, int errorCode)
 {
 	std::cerr<<"Shutdown Error"<< errorCode<< std::endl;
-	throw Networking::NetworkException(socket, errorCode, Networking::Error::shutdownMap.at(errorCode));
+	throw Networking::NetworkException(socket, errorCode, ErrorMessage(Networking::Error::shutdownMap, errorCode));
 }
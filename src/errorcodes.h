@@ -140,12 +140,17 @@ const ErrorMap shutdownMap ={
 };
 
 }
-void ThrowSocketException(int socket, int errorCode);
-void ThrowBindException(int socket, int errorCode);
-void ThrowListenException(int socket, int errorCode);
-void ThrowAcceptException(int socket, int errorCode);
-void ThrowSendException(int socket, int errorCode);
-void ThrowReceiveException(int socket, int errorCode);
-void ThrowShutdownException(int socket, int errorCode);
+
+// Looks up the message for errorCode in _pMap, falling back to strerror for
+// codes the map does not list instead of throwing std::out_of_range
+std::string ErrorMessage(const Error::ErrorMap& _pMap, int errorCode);
+
+[[noreturn]] void ThrowSocketException(int socket, int errorCode);
+[[noreturn]] void ThrowBindException(int socket, int errorCode);
+[[noreturn]] void ThrowListenException(int socket, int errorCode);
+[[noreturn]] void ThrowAcceptException(int socket, int errorCode);
+[[noreturn]] void ThrowSendException(int socket, int errorCode);
+[[noreturn]] void ThrowReceiveException(int socket, int errorCode);
+[[noreturn]] void ThrowShutdownException(int socket, int errorCode);
 }
 #endif
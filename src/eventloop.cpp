@@ -0,0 +1,677 @@
+#include "eventloop.h"
+#include "compression.h"
+#include "server.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace {
+
+// Number of events fetched per epoll_wait call
+const int MAX_EVENTS = 256;
+
+// Amount of data read from a socket per recv call
+const size_t READ_CHUNK_SIZE = 64 * 1024;
+
+// Queued writes gathered into one sendmsg call
+const size_t MAX_WRITE_VECTORS = 64;
+
+bool SetNonBlocking(int _pFd, bool _pNonBlocking)
+{
+	int flags = fcntl(_pFd, F_GETFL, 0);
+	if(flags < 0)
+		return false;
+	flags = _pNonBlocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+	return fcntl(_pFd, F_SETFL, flags) == 0;
+}
+
+}
+
+Networking::EventLoop::EventLoop(SOCKET _pListenSocket, MessageHandler _pHandler, Logger& _pLogger, size_t _pMaxMessageSize, ThreadPool* _pExecutor)
+	: listenSocket(_pListenSocket), handler(std::move(_pHandler)), logger(_pLogger), maxMessageSize(_pMaxMessageSize), executor(_pExecutor)
+{
+	epollFd = epoll_create1(EPOLL_CLOEXEC);
+	wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(epollFd < 0 || wakeFd < 0)
+		throw std::runtime_error("Error: Unable to create event loop: " + std::string(strerror(errno)));
+
+	epoll_event event;
+	ZeroMemory(&event, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = wakeFd;
+	epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+}
+
+Networking::EventLoop::~EventLoop()
+{
+	for(auto& entry : connections)
+	{
+		if(connectionTable != nullptr)
+			connectionTable->Remove(entry.first);
+		CLOSESOCKET(entry.first);
+	}
+	connections.clear();
+	if(wakeFd >= 0)
+		close(wakeFd);
+	if(epollFd >= 0)
+		close(epollFd);
+}
+
+void Networking::EventLoop::SetKeepAlive(bool _pKeepAlive)
+{
+	keepAlive = _pKeepAlive;
+}
+
+void Networking::EventLoop::SetListenerIndex(size_t _pListenerIndex)
+{
+	listenerIndex = _pListenerIndex;
+}
+
+void Networking::EventLoop::SetConnectionTable(ConnectionTable* _pTable)
+{
+	connectionTable = _pTable;
+}
+
+void Networking::EventLoop::Run()
+{
+	loopThreadId = std::this_thread::get_id();
+	SetNonBlocking(listenSocket, true);
+
+	epoll_event listenEvent;
+	ZeroMemory(&listenEvent, sizeof(listenEvent));
+	listenEvent.events = EPOLLIN | EPOLLET;
+	listenEvent.data.fd = listenSocket;
+	if(epoll_ctl(epollFd, EPOLL_CTL_ADD, listenSocket, &listenEvent) < 0)
+	{
+		logger.log("Unable to watch listening socket: " + std::string(strerror(errno)));
+		return;
+	}
+
+	running = true;
+	std::vector<epoll_event> events(MAX_EVENTS);
+	while(!stopRequested)
+	{
+		int ready = epoll_wait(epollFd, events.data(), MAX_EVENTS, -1);
+		if(ready < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			logger.log("epoll_wait failed: " + std::string(strerror(errno)));
+			break;
+		}
+
+		for(int i = 0; i < ready; i++)
+		{
+			int fd = events[i].data.fd;
+			uint32_t flags = events[i].events;
+
+			if(fd == listenSocket)
+			{
+				AcceptConnections();
+				continue;
+			}
+
+			if(fd == wakeFd)
+			{
+				uint64_t counter;
+				while(read(wakeFd, &counter, sizeof(counter)) > 0) {}
+				ProcessPendingOperations();
+				continue;
+			}
+
+			auto it = connections.find(fd);
+			if(it == connections.end())
+				continue;
+			Connection& connection = *it->second;
+
+			if(flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+				HandleReadable(connection);
+			if((flags & EPOLLOUT) && connection.state != ConnectionState::Broken)
+				FlushWrites(connection);
+			CloseIfDone(fd);
+		}
+	}
+
+	running = false;
+	epoll_ctl(epollFd, EPOLL_CTL_DEL, listenSocket, NULL);
+	SetNonBlocking(listenSocket, false);
+	// Workers still hold a pointer to this loop until their handlers return
+	WaitForHandlers();
+	ProcessPendingOperations();
+}
+
+void Networking::EventLoop::Stop()
+{
+	stopRequested = true;
+	Wake();
+}
+
+bool Networking::EventLoop::QueueSend(SOCKET _pSocket, const char* _pData, size_t _pLength)
+{
+	return QueueSend(_pSocket, std::vector<char>(_pData, _pData + _pLength));
+}
+
+bool Networking::EventLoop::QueueSend(SOCKET _pSocket, std::vector<char>&& _pData)
+{
+	if(!running)
+		return false;
+
+	if(OnLoopThread())
+	{
+		ApplySend(_pSocket, std::move(_pData));
+		return true;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		pendingOperations.push_back(PendingOperation{_pSocket, false, 0, std::move(_pData)});
+	}
+	Wake();
+	return true;
+}
+
+bool Networking::EventLoop::QueueShared(SOCKET _pSocket, const SharedBuffer& _pData, size_t _pHighWaterMark, SlowReceiverPolicy _pPolicy, std::unique_ptr<WriteCompletion> _pCompletion)
+{
+	if(!running)
+		return false;
+
+	PendingOperation operation{_pSocket, false, 0, QueuedWrite(_pData, std::move(_pCompletion))};
+	operation.highWaterMark = _pHighWaterMark;
+	operation.policy = _pPolicy;
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		pendingOperations.push_back(std::move(operation));
+	}
+	Wake();
+	return true;
+}
+
+void Networking::EventLoop::FinishRequest(SOCKET _pSocket, uint32_t _pRequestId)
+{
+	if(OnLoopThread())
+	{
+		ApplyFinishRequest(_pSocket, _pRequestId);
+		ResumeReading(_pSocket);
+		CloseIfDone(_pSocket);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		pendingOperations.push_back(PendingOperation{_pSocket, true, _pRequestId, std::vector<char>()});
+	}
+	Wake();
+}
+
+bool Networking::EventLoop::IsRunning() const
+{
+	return running;
+}
+
+size_t Networking::EventLoop::GetConnectionCount() const
+{
+	return connectionCount;
+}
+
+void Networking::EventLoop::AcceptConnections()
+{
+	// Edge triggered: keep accepting until the backlog is empty
+	while(true)
+	{
+		ClientConnection client;
+		client.listenerIndex = listenerIndex;
+		socklen_t clientAddrSize = sizeof(client.clientInfo);
+		client.clientSocket = accept4(listenSocket, (sockaddr*)&client.clientInfo, &clientAddrSize, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if(INVALIDSOCKET(client.clientSocket))
+		{
+			int errorCode = GETERROR();
+			if(errorCode == EINTR || errorCode == ECONNABORTED)
+				continue;
+			if(errorCode != EAGAIN && errorCode != EWOULDBLOCK)
+				logger.log("Accept failed: " + std::string(strerror(errorCode)));
+			return;
+		}
+		if(connectionTable != nullptr && !connectionTable->Insert(client))
+		{
+			logger.log("Refusing connection: " + std::to_string(connectionTable->Size()) + " connections are open");
+			CLOSESOCKET(client.clientSocket);
+			continue;
+		}
+
+		epoll_event event;
+		ZeroMemory(&event, sizeof(event));
+		event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+		event.data.fd = client.clientSocket;
+		if(epoll_ctl(epollFd, EPOLL_CTL_ADD, client.clientSocket, &event) < 0)
+		{
+			logger.log("Unable to watch client socket: " + std::string(strerror(errno)));
+			if(connectionTable != nullptr)
+				connectionTable->Remove(client.clientSocket);
+			CLOSESOCKET(client.clientSocket);
+			continue;
+		}
+
+		std::unique_ptr<Connection> connection(new Connection());
+		connection->client = client;
+		connections[client.clientSocket] = std::move(connection);
+		connectionCount++;
+	}
+}
+
+void Networking::EventLoop::HandleReadable(Connection& _pConnection)
+{
+	bool peerClosed = false;
+	bool touched = false;
+
+	// Edge triggered: drain the socket until it would block. Reading pauses while
+	// an uncorrelated request is with a worker, or too many correlated ones are,
+	// and resumes in ResumeReading once they return.
+	while(CanRead(_pConnection))
+	{
+		char* destination;
+		size_t capacity;
+		bool direct = _pConnection.readState == ReadState::ReadingPayload
+			&& _pConnection.inputStart == _pConnection.inputEnd
+			&& _pConnection.payload->size() - _pConnection.payloadFilled >= READ_CHUNK_SIZE;
+		if(direct)
+		{
+			// Large payloads are read straight into their pre-sized buffer
+			destination = _pConnection.payload->data() + _pConnection.payloadFilled;
+			capacity = _pConnection.payload->size() - _pConnection.payloadFilled;
+		}
+		else
+		{
+			if(!_pConnection.input)
+				_pConnection.input = BufferPool::Default().Acquire(READ_CHUNK_SIZE);
+			destination = _pConnection.input->data() + _pConnection.inputEnd;
+			capacity = _pConnection.input->size() - _pConnection.inputEnd;
+		}
+
+		ssize_t bytesReceived = recv(_pConnection.client.clientSocket, destination, capacity, 0);
+		if(bytesReceived == 0)
+		{
+			peerClosed = true;
+			break;
+		}
+		if(bytesReceived < 0)
+		{
+			int errorCode = GETERROR();
+			if(errorCode == EINTR)
+				continue;
+			if(errorCode != EAGAIN && errorCode != EWOULDBLOCK)
+				_pConnection.state = ConnectionState::Broken;
+			break;
+		}
+
+		if(!touched && connectionTable != nullptr)
+		{
+			// Once per wakeup is enough to keep the connection off the idle list
+			connectionTable->Touch(_pConnection.client.clientSocket);
+			touched = true;
+		}
+		if(direct)
+		{
+			_pConnection.payloadFilled += bytesReceived;
+			if(_pConnection.payloadFilled == _pConnection.payload->size())
+				DispatchMessage(_pConnection);
+		}
+		else
+		{
+			_pConnection.inputEnd += bytesReceived;
+			ParseInput(_pConnection);
+		}
+	}
+
+	if(peerClosed && _pConnection.state == ConnectionState::Open)
+		_pConnection.state = ConnectionState::Closing;
+	if(_pConnection.state != ConnectionState::Open)
+	{
+		_pConnection.input.reset();
+		_pConnection.payload.reset();
+	}
+}
+
+void Networking::EventLoop::ParseInput(Connection& _pConnection)
+{
+	while(CanRead(_pConnection))
+	{
+		size_t available = _pConnection.inputEnd - _pConnection.inputStart;
+		const char* data = _pConnection.input->data() + _pConnection.inputStart;
+
+		if(_pConnection.readState == ReadState::ReadingHeader)
+		{
+			if(available < FRAME_HEADER_SIZE)
+				break;
+
+			FrameHeader header;
+			if(!DecodeFrameHeader(data, header) || header.payloadLength > maxMessageSize)
+			{
+				logger.log("Dropping connection after invalid or oversized frame header");
+				_pConnection.state = ConnectionState::Broken;
+				return;
+			}
+			_pConnection.inputStart += FRAME_HEADER_SIZE;
+			_pConnection.requestId = header.requestId;
+			_pConnection.compressed = (header.flags & FRAME_FLAG_COMPRESSED) != 0;
+			_pConnection.replyCodec = GetReplyCodec(header);
+			_pConnection.payload = BufferPool::Default().Acquire(header.payloadLength);
+			_pConnection.payloadFilled = 0;
+			_pConnection.readState = ReadState::ReadingPayload;
+			continue;
+		}
+
+		size_t needed = _pConnection.payload->size() - _pConnection.payloadFilled;
+		size_t take = std::min(needed, available);
+		if(take > 0)
+			memcpy(_pConnection.payload->data() + _pConnection.payloadFilled, data, take);
+		_pConnection.payloadFilled += take;
+		_pConnection.inputStart += take;
+		if(_pConnection.payloadFilled < _pConnection.payload->size())
+			break;
+		DispatchMessage(_pConnection);
+	}
+
+	// Move any partial header to the front so the next recv has room behind it
+	if(_pConnection.inputStart == _pConnection.inputEnd)
+	{
+		_pConnection.inputStart = 0;
+		_pConnection.inputEnd = 0;
+	}
+	else if(_pConnection.inputEnd == _pConnection.input->size())
+	{
+		size_t remaining = _pConnection.inputEnd - _pConnection.inputStart;
+		memmove(_pConnection.input->data(), _pConnection.input->data() + _pConnection.inputStart, remaining);
+		_pConnection.inputStart = 0;
+		_pConnection.inputEnd = remaining;
+	}
+}
+
+bool Networking::EventLoop::CanRead(const Connection& _pConnection) const
+{
+	return _pConnection.state == ConnectionState::Open
+		&& _pConnection.orderedRequests == 0
+		&& _pConnection.pendingRequests < MAX_REQUESTS_IN_FLIGHT;
+}
+
+void Networking::EventLoop::DispatchMessage(Connection& _pConnection)
+{
+	// The handler gets the pooled buffer the payload was read into; it goes back
+	// to the pool once the last reference to it is dropped
+	SharedBuffer message = std::move(_pConnection.payload);
+	_pConnection.payloadFilled = 0;
+	_pConnection.readState = ReadState::ReadingHeader;
+	SOCKET socket = _pConnection.client.clientSocket;
+	uint32_t requestId = _pConnection.requestId;
+
+	// The handler only ever sees the original payload
+	if(_pConnection.compressed)
+	{
+		Result<SharedBuffer> restored = DecompressFramePayload((CompressionCodec)_pConnection.replyCodec, message->data(), message->size(), maxMessageSize);
+		if(!restored)
+		{
+			logger.log("Dropping connection after invalid compressed frame");
+			_pConnection.state = ConnectionState::Broken;
+			return;
+		}
+		message = std::move(restored.Value());
+	}
+
+	_pConnection.pendingRequests++;
+	if(requestId == 0)
+		_pConnection.orderedRequests++;
+	// Without keep-alive each connection carries one request: stop reading once it has arrived
+	if(!keepAlive && _pConnection.state == ConnectionState::Open)
+		_pConnection.state = ConnectionState::Closing;
+
+	// Replies carry the ID of the request they answer
+	ClientConnection client = _pConnection.client;
+	client.requestId = requestId;
+	client.replyCodec = _pConnection.replyCodec;
+
+	if(executor != nullptr)
+	{
+		{
+			std::lock_guard<std::mutex> lock(handlersMutex);
+			handlersInFlight++;
+		}
+		bool queued = executor->TrySubmit([this, client, message]() mutable {
+			RunHandler(client, *message);
+			// Back to the pool now rather than whenever the worker drops the task
+			message.reset();
+			FinishRequest(client.clientSocket, client.requestId);
+			std::lock_guard<std::mutex> lock(handlersMutex);
+			if(--handlersInFlight == 0)
+				handlersDone.notify_all();
+		});
+		if(queued)
+			return;
+
+		// The pool is saturated, so the loop takes the request itself
+		std::lock_guard<std::mutex> lock(handlersMutex);
+		handlersInFlight--;
+	}
+
+	RunHandler(client, *message);
+	// The caller still holds _pConnection, so closing is left to the main loop
+	ApplyFinishRequest(socket, requestId);
+}
+
+void Networking::EventLoop::RunHandler(const ClientConnection& _pClient, const std::vector<char>& _pMessage)
+{
+	try
+	{
+		handler(_pClient, _pMessage);
+	}
+	catch(const std::exception& ex)
+	{
+		logger.log("Unhandled exception in message handler: " + std::string(ex.what()));
+	}
+}
+
+void Networking::EventLoop::WaitForHandlers()
+{
+	std::unique_lock<std::mutex> lock(handlersMutex);
+	handlersDone.wait(lock, [this]() { return handlersInFlight == 0; });
+}
+
+void Networking::EventLoop::FlushWrites(Connection& _pConnection)
+{
+	while(!_pConnection.writeQueue.empty())
+	{
+		// Replies queued behind each other leave in one sendmsg instead of one send each
+		iovec vectors[MAX_WRITE_VECTORS];
+		size_t count = 0;
+		for(auto it = _pConnection.writeQueue.begin(); it != _pConnection.writeQueue.end() && count < MAX_WRITE_VECTORS; ++it)
+		{
+			size_t offset = count == 0 ? _pConnection.writeOffset : 0;
+			vectors[count].iov_base = it->Data() + offset;
+			vectors[count].iov_len = it->Size() - offset;
+			count++;
+		}
+		msghdr message;
+		memset(&message, 0, sizeof(message));
+		message.msg_iov = vectors;
+		message.msg_iovlen = count;
+		ssize_t bytesSent = sendmsg(_pConnection.client.clientSocket, &message, MSG_NOSIGNAL);
+		if(bytesSent < 0)
+		{
+			int errorCode = GETERROR();
+			if(errorCode == EINTR)
+				continue;
+			if(errorCode != EAGAIN && errorCode != EWOULDBLOCK)
+			{
+				_pConnection.state = ConnectionState::Broken;
+				_pConnection.writeQueue.clear();
+				_pConnection.queuedBytes = 0;
+				_pConnection.writeOffset = 0;
+			}
+			// Wait for EPOLLOUT before writing again
+			return;
+		}
+
+		// Drop every buffer that was written completely and remember how far into the next one we got
+		size_t remaining = bytesSent;
+		while(remaining > 0)
+		{
+			QueuedWrite& front = _pConnection.writeQueue.front();
+			size_t left = front.Size() - _pConnection.writeOffset;
+			if(remaining < left)
+			{
+				_pConnection.writeOffset += remaining;
+				break;
+			}
+			remaining -= left;
+			PopWrite(_pConnection);
+		}
+		// Empty buffers are never sent, so they are dropped here
+		while(!_pConnection.writeQueue.empty() && _pConnection.writeQueue.front().Size() == _pConnection.writeOffset)
+			PopWrite(_pConnection);
+	}
+}
+
+void Networking::EventLoop::PopWrite(Connection& _pConnection)
+{
+	QueuedWrite& front = _pConnection.writeQueue.front();
+	if(front.completion)
+		front.completion->Report(DeliveryStatus::Sent);
+	_pConnection.queuedBytes -= front.Size();
+	_pConnection.writeQueue.pop_front();
+	_pConnection.writeOffset = 0;
+}
+
+void Networking::EventLoop::ApplySend(SOCKET _pSocket, QueuedWrite&& _pData)
+{
+	// A write that is not queued reports Failed as it goes out of scope
+	auto it = connections.find(_pSocket);
+	if(it == connections.end() || it->second->state == ConnectionState::Broken)
+		return;
+
+	Connection& connection = *it->second;
+	bool wasIdle = connection.writeQueue.empty();
+	connection.queuedBytes += _pData.Size();
+	connection.writeQueue.push_back(std::move(_pData));
+	// A nonempty queue is already waiting for EPOLLOUT
+	if(wasIdle)
+		FlushWrites(connection);
+}
+
+void Networking::EventLoop::ApplyShared(SOCKET _pSocket, QueuedWrite&& _pData, size_t _pHighWaterMark, SlowReceiverPolicy _pPolicy)
+{
+	// Broadcasts go only to connections still taking requests
+	auto it = connections.find(_pSocket);
+	if(it == connections.end() || it->second->state != ConnectionState::Open)
+		return;
+
+	Connection& connection = *it->second;
+	if(connection.queuedBytes <= _pHighWaterMark)
+	{
+		ApplySend(_pSocket, std::move(_pData));
+		return;
+	}
+	if(_pPolicy == SlowReceiverPolicy::Drop)
+	{
+		_pData.completion->Report(DeliveryStatus::Dropped);
+		return;
+	}
+	// Closed by CloseIfDone once no handler can still reply on it
+	_pData.completion->Report(DeliveryStatus::Disconnected);
+	connection.state = ConnectionState::Broken;
+	connection.writeQueue.clear();
+	connection.queuedBytes = 0;
+	connection.writeOffset = 0;
+}
+
+void Networking::EventLoop::ApplyFinishRequest(SOCKET _pSocket, uint32_t _pRequestId)
+{
+	auto it = connections.find(_pSocket);
+	if(it == connections.end())
+		return;
+
+	it->second->pendingRequests--;
+	if(_pRequestId == 0)
+		it->second->orderedRequests--;
+}
+
+void Networking::EventLoop::ResumeReading(SOCKET _pSocket)
+{
+	auto it = connections.find(_pSocket);
+	if(it == connections.end())
+		return;
+
+	Connection& connection = *it->second;
+	if(!CanRead(connection))
+		return;
+	// Frames that arrived while reading was paused are already buffered,
+	// and the socket was not drained, so no further edge will be reported for it
+	if(connection.inputStart != connection.inputEnd)
+		ParseInput(connection);
+	HandleReadable(connection);
+}
+
+void Networking::EventLoop::ProcessPendingOperations()
+{
+	std::vector<PendingOperation> operations;
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		operations.swap(pendingOperations);
+	}
+
+	for(auto& operation : operations)
+	{
+		if(operation.finishRequest)
+		{
+			ApplyFinishRequest(operation.socket, operation.requestId);
+			ResumeReading(operation.socket);
+		}
+		else if(operation.data.shared)
+			ApplyShared(operation.socket, std::move(operation.data), operation.highWaterMark, operation.policy);
+		else
+			ApplySend(operation.socket, std::move(operation.data));
+		CloseIfDone(operation.socket);
+	}
+}
+
+void Networking::EventLoop::CloseIfDone(SOCKET _pSocket)
+{
+	auto it = connections.find(_pSocket);
+	if(it == connections.end())
+		return;
+
+	Connection& connection = *it->second;
+	// A descriptor is never closed while a handler may still reply on it,
+	// otherwise the number could be reused by a new connection
+	if(connection.pendingRequests > 0 || connection.state == ConnectionState::Open)
+		return;
+	if(connection.state == ConnectionState::Closing && !connection.writeQueue.empty())
+		return;
+	CloseConnection(_pSocket);
+}
+
+void Networking::EventLoop::CloseConnection(SOCKET _pSocket)
+{
+	epoll_ctl(epollFd, EPOLL_CTL_DEL, _pSocket, NULL);
+	// The descriptor leaves the table before it can be reused
+	if(connectionTable != nullptr)
+		connectionTable->Remove(_pSocket);
+	CLOSESOCKET(_pSocket);
+	connections.erase(_pSocket);
+	connectionCount--;
+}
+
+bool Networking::EventLoop::OnLoopThread() const
+{
+	return running && std::this_thread::get_id() == loopThreadId;
+}
+
+void Networking::EventLoop::Wake()
+{
+	uint64_t one = 1;
+	ssize_t written = write(wakeFd, &one, sizeof(one));
+	(void)written;
+}
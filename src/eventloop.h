@@ -0,0 +1,184 @@
+#pragma once
+#ifndef _NET_EVENT_LOOP_
+#define _NET_EVENT_LOOP_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "bufferpool.h"
+#include "clientconnection.h"
+#include "frame.h"
+#include "logger.h"
+#include "serverloop.h"
+#include "threadpool.h"
+
+namespace Networking {
+
+// Largest number of correlated requests a connection may have with handlers at
+// once; reading from it pauses at this limit
+const int MAX_REQUESTS_IN_FLIGHT = 64;
+
+// Edge-triggered epoll reactor used by Server::Run in ServerMode::Epoll.
+// A single thread accepts connections on a nonblocking listening socket,
+// reads framed requests and flushes queued replies. Every connection keeps
+// its own read and write state so that no thread ever blocks on a slow peer.
+// Handlers run on an optional ThreadPool, or on the loop thread without one.
+// Receive buffers come from BufferPool::Default().
+class EventLoop : public ServerLoop {
+public:
+
+// Progress of the frame currently being read from a connection
+enum ReadState
+{
+	ReadingHeader,
+	ReadingPayload
+};
+
+// Lifecycle of a connection owned by the loop
+enum ConnectionState
+{
+	Open,    // Reading requests and writing replies
+	Closing, // No more requests; close once replies are flushed
+	Broken   // I/O failed; close once in-flight requests finish
+};
+
+// Creates a loop that serves connections accepted on _pListenSocket.
+// The socket must already be bound and listening. Frames announcing a payload
+// larger than _pMaxMessageSize cause the connection to be dropped. When
+// _pExecutor is set, requests are handed to it; if its queue is full the
+// handler runs on the loop thread, which stops reading until it catches up.
+EventLoop(SOCKET _pListenSocket, MessageHandler _pHandler, Logger& _pLogger, size_t _pMaxMessageSize = DEFAULT_MAX_MESSAGE_SIZE, ThreadPool* _pExecutor = nullptr);
+
+// Closes the epoll and wakeup descriptors and any remaining connections
+~EventLoop() override;
+
+// Keeps connections open after a request so that one socket can carry many.
+// Uncorrelated requests (request ID 0) on a connection are handled one at a
+// time, so replies stay in order. Requests carrying an ID are handed to the
+// executor as they arrive, up to MAX_REQUESTS_IN_FLIGHT per connection, and
+// their replies go out as the handlers finish. Must be called before Run().
+void SetKeepAlive(bool _pKeepAlive) override;
+
+// Records which of the server's listeners this loop serves, in the
+// listenerIndex of every connection it accepts. Must be called before Run().
+void SetListenerIndex(size_t _pListenerIndex) override;
+
+// Registers accepted connections in _pTable; see ServerLoop. Must be called before Run().
+void SetConnectionTable(ConnectionTable* _pTable) override;
+
+// Runs the loop on the calling thread until Stop() is called.
+// Returns once every handler submitted to the executor has finished.
+void Run() override;
+
+// Asks the loop to exit; safe to call from any thread
+void Stop() override;
+
+// Queues data to be written to a connection; safe to call from any thread.
+// Returns false if the loop is not running.
+bool QueueSend(SOCKET _pSocket, const char* _pData, size_t _pLength) override;
+bool QueueSend(SOCKET _pSocket, std::vector<char>&& _pData) override;
+
+// Queues a buffer shared with other connections; see ServerLoop::QueueShared.
+// Always posted, so a broadcast from a handler on the loop thread is applied
+// once the handler has returned.
+bool QueueShared(SOCKET _pSocket, const SharedBuffer& _pData, size_t _pHighWaterMark, SlowReceiverPolicy _pPolicy, std::unique_ptr<WriteCompletion> _pCompletion) override;
+
+// Signals that the handler for the request _pRequestId on the connection has returned
+void FinishRequest(SOCKET _pSocket, uint32_t _pRequestId = 0);
+
+// Returns true while Run() is executing
+bool IsRunning() const override;
+
+// Returns the number of connections currently owned by the loop
+size_t GetConnectionCount() const override;
+
+private:
+
+struct Connection {
+	ClientConnection client;
+	ConnectionState state = ConnectionState::Open;
+	ReadState readState = ReadState::ReadingHeader;
+	// Bytes read from the socket but not yet parsed live in [inputStart, inputEnd).
+	// Taken from the buffer pool on the first read and returned when the connection closes.
+	SharedBuffer input;
+	size_t inputStart = 0;
+	size_t inputEnd = 0;
+	// Payload of the current frame, taken from the buffer pool at the size given
+	// by its header and handed to the handler without copying
+	SharedBuffer payload;
+	size_t payloadFilled = 0;
+	std::deque<QueuedWrite> writeQueue;
+	// Bytes in writeQueue, counted from the start of its front entry
+	size_t queuedBytes = 0;
+	size_t writeOffset = 0;
+	// Request ID of the frame being read
+	uint32_t requestId = 0;
+	// Whether its payload is compressed, and the codec its sender takes replies in
+	bool compressed = false;
+	uint8_t replyCodec = 0;
+	// Requests with a handler that has not returned, and how many of them are uncorrelated
+	int pendingRequests = 0;
+	int orderedRequests = 0;
+};
+
+// A send or request completion posted from a thread other than the loop
+struct PendingOperation {
+	SOCKET socket;
+	bool finishRequest;
+	uint32_t requestId;
+	QueuedWrite data;
+	// Set for a shared write, which is skipped above this many queued bytes
+	size_t highWaterMark = 0;
+	SlowReceiverPolicy policy = SlowReceiverPolicy::Drop;
+};
+
+void AcceptConnections();
+void HandleReadable(Connection& _pConnection);
+void ParseInput(Connection& _pConnection);
+bool CanRead(const Connection& _pConnection) const;
+void FlushWrites(Connection& _pConnection);
+void DispatchMessage(Connection& _pConnection);
+void RunHandler(const ClientConnection& _pClient, const std::vector<char>& _pMessage);
+void WaitForHandlers();
+void ApplyFinishRequest(SOCKET _pSocket, uint32_t _pRequestId);
+void ResumeReading(SOCKET _pSocket);
+void ApplySend(SOCKET _pSocket, QueuedWrite&& _pData);
+void PopWrite(Connection& _pConnection);
+void ApplyShared(SOCKET _pSocket, QueuedWrite&& _pData, size_t _pHighWaterMark, SlowReceiverPolicy _pPolicy);
+void ProcessPendingOperations();
+void CloseIfDone(SOCKET _pSocket);
+void CloseConnection(SOCKET _pSocket);
+bool OnLoopThread() const;
+void Wake();
+
+SOCKET listenSocket;
+int epollFd = -1;
+int wakeFd = -1;
+MessageHandler handler;
+Logger& logger;
+size_t maxMessageSize;
+ThreadPool* executor;
+bool keepAlive = false;
+size_t listenerIndex = 0;
+ConnectionTable* connectionTable = nullptr;
+std::atomic<bool> running{false};
+std::atomic<bool> stopRequested{false};
+std::atomic<size_t> connectionCount{0};
+std::thread::id loopThreadId;
+std::unordered_map<SOCKET, std::unique_ptr<Connection> > connections;
+std::mutex pendingMutex;
+std::vector<PendingOperation> pendingOperations;
+// Handlers submitted to the executor that have not returned yet
+std::mutex handlersMutex;
+std::condition_variable handlersDone;
+size_t handlersInFlight = 0;
+};
+
+}
+
+#endif
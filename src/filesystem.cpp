@@ -1,40 +1,100 @@
 #include "filesystem.h"
 
+FileSystem::FileSystem()
+	: _Engine(new MemoryStorageEngine())
+{
+}
+
+
+FileSystem::FileSystem(std::unique_ptr<StorageEngine> _pEngine)
+	: _Engine(std::move(_pEngine))
+{
+}
+
+
+void FileSystem::setMaxFileSize(uint64_t _pMaxFileSize)
+{
+	_MaxFileSize = _pMaxFileSize;
+}
+
+
+uint64_t FileSystem::getMaxFileSize() const
+{
+	return _MaxFileSize;
+}
+
+
 bool FileSystem::createFile(const std::string& _pFilename)
 {
-	std::unique_lock<std::mutex> lock(_Mutex);
-	if(_Files.count(_pFilename))
-		return false;
-	_Files[_pFilename] = "";
-	return true;
-		
+	return _Engine->create(_pFilename);
 }
 
 
 bool FileSystem::writeFile(const std::string& _pFilename, const std::string& _pContent)
 {
-	std::unique_lock<std::mutex> lock(_Mutex);
-	if(!_Files.count(_pFilename))
-		return false;
-	_Files[_pFilename] = _pContent;
-	return true;
+	return _Engine->write(_pFilename, _pContent);
+}
+
 
+bool FileSystem::writeFile(const std::string& _pFilename, std::string&& _pContent)
+{
+	return _Engine->write(_pFilename, std::move(_pContent));
 }
 
 
 std::string FileSystem::readFile(const std::string& _pFilename)
 {
-	std::unique_lock<std::mutex> lock(_Mutex);
-	if(!_Files.count(_pFilename))
+	std::string content;
+	if(!_Engine->read(_pFilename, content))
+		return "";
+	return content;
+}
+
+FileContent FileSystem::readFileShared(const std::string& _pFilename)
+{
+	return _Engine->readShared(_pFilename);
+}
+
+
+std::string FileSystem::readRange(const std::string& _pFilename, uint64_t _pOffset, uint64_t _pLength)
+{
+	std::string content;
+	if(!_Engine->readRange(_pFilename, _pOffset, _pLength, content))
 		return "";
-	return _Files[_pFilename];
+	return content;
+}
+
+
+bool FileSystem::readRange(const std::string& _pFilename, uint64_t _pOffset, uint64_t _pLength, std::string& _pContent)
+{
+	return _Engine->readRange(_pFilename, _pOffset, _pLength, _pContent);
+}
+
+
+bool FileSystem::writeAt(const std::string& _pFilename, uint64_t _pOffset, const std::string& _pData)
+{
+	// Checked before the engine resizes anything, so a bogus offset fails instead of allocating
+	if(_pOffset > _MaxFileSize || _pData.size() > _MaxFileSize - _pOffset)
+		return false;
+	return _Engine->writeAt(_pFilename, _pOffset, _pData);
+}
+
+
+bool FileSystem::append(const std::string& _pFilename, const std::string& _pData)
+{
+	// The engine checks the bound, since only it knows the size the file has when the data lands
+	return _Engine->append(_pFilename, _pData, _MaxFileSize);
 }
 
+
+bool FileSystem::truncate(const std::string& _pFilename, uint64_t _pSize)
+{
+	if(_pSize > _MaxFileSize)
+		return false;
+	return _Engine->truncate(_pFilename, _pSize);
+}
+
+
 bool FileSystem::deleteFile(const std::string& _pFilename) {
-    std::unique_lock<std::mutex> lock(_Mutex);
-    if (_Files.count(_pFilename)) {
-        _Files.erase(_pFilename);
-        return true; // Successfully deleted
-    }
-    return false; // File did not exist
+    return _Engine->remove(_pFilename);
 }
@@ -2,19 +2,51 @@
 #ifndef _SIMPLIDFS_FILESYSTEM_H
 #define _SIMPLIDFS_FILESYSTEM_H
 
+#include <cstdint>
 #include <string>
-#include <unordered_map>
-#include <mutex> // Required for std::mutex and std::unique_lock
+#include <memory>
+#include "storageengine.h"
 
 /**
- * @brief Manages an in-memory file system for storing file content.
+ * @brief Largest file a FileSystem lets a partial write or truncate produce unless told otherwise.
+ * Nodes store chunks, which are far smaller; the bound keeps a request's offset or size from
+ * making the node allocate whatever it names.
+ */
+const uint64_t DEFAULT_MAX_FILE_SIZE = 1ull << 30;
+
+/**
+ * @brief Manages the file system a node stores file content in.
  * 
  * This class provides basic file operations such as creating, writing, reading,
- * and deleting files. All operations are thread-safe through the use of a mutex.
- * File content is stored as strings in an unordered map.
+ * and deleting files. All operations are thread-safe. Content is kept by a
+ * StorageEngine: in memory by default, or on disk with a LogStorageEngine.
  */
 class FileSystem {
 public:
+    /**
+     * @brief Creates a file system that keeps its files in memory (MemoryStorageEngine).
+     */
+    FileSystem();
+
+    /**
+     * @brief Creates a file system on top of the given storage engine.
+     * @param _pEngine The engine that stores the files, e.g. a LogStorageEngine for
+     *                 content that survives a restart.
+     */
+    explicit FileSystem(std::unique_ptr<StorageEngine> _pEngine);
+
+    /**
+     * @brief Sets the largest size writeAt, append and truncate may give a file. Not synchronized:
+     *        set it before the file system is shared between threads.
+     * @param _pMaxFileSize The bound in bytes; DEFAULT_MAX_FILE_SIZE unless set.
+     */
+    void setMaxFileSize(uint64_t _pMaxFileSize);
+
+    /**
+     * @brief The largest size writeAt, append and truncate may give a file.
+     */
+    uint64_t getMaxFileSize() const;
+
     /**
      * @brief Creates a new, empty file in the file system.
      * If the file already exists, the operation fails.
@@ -32,6 +64,15 @@ public:
      */
     bool writeFile(const std::string& _pFilename, const std::string& _pContent);
 
+    /**
+     * @brief Writes content to an existing file, taking ownership of the content buffer.
+     * Lets a request handler store the content it decoded without copying it again.
+     * @param _pFilename The name of the file to write to.
+     * @param _pContent The content to move into the file.
+     * @return True if the content was successfully written, false otherwise (e.g., if the file does not exist).
+     */
+    bool writeFile(const std::string& _pFilename, std::string&& _pContent);
+
     /**
      * @brief Reads the content of an existing file.
      * If the file does not exist, an empty string is returned.
@@ -40,6 +81,64 @@ public:
      */
     std::string readFile(const std::string& _pFilename);
 
+    /**
+     * @brief Returns the current content of a file as a shared, immutable buffer.
+     * Nothing is copied when the content is kept in memory, and the buffer stays valid and
+     * unchanged while it is held, even if the file is written or deleted meanwhile.
+     * @param _pFilename The name of the file to read from.
+     * @return The content, or nullptr if the file does not exist.
+     */
+    FileContent readFileShared(const std::string& _pFilename);
+
+    /**
+     * @brief Reads part of an existing file.
+     * Only the requested bytes are copied, or read from disk with a LogStorageEngine.
+     * @param _pFilename The name of the file to read from.
+     * @param _pOffset First byte to read.
+     * @param _pLength Number of bytes to read; fewer are returned where the file ends first.
+     * @return The bytes read, or an empty string if the file does not exist or the offset is at or past its end.
+     */
+    std::string readRange(const std::string& _pFilename, uint64_t _pOffset, uint64_t _pLength);
+
+    /**
+     * @brief Reads part of an existing file, telling a missing file apart from an empty range.
+     * @param _pFilename The name of the file to read from.
+     * @param _pOffset First byte to read.
+     * @param _pLength Number of bytes to read; fewer are returned where the file ends first.
+     * @param _pContent Receives the bytes read; empty if the offset is at or past the end of the file.
+     * @return True if the file exists and could be read, false otherwise.
+     */
+    bool readRange(const std::string& _pFilename, uint64_t _pOffset, uint64_t _pLength, std::string& _pContent);
+
+    /**
+     * @brief Overwrites part of an existing file, leaving the rest of its content as it is.
+     * Writing past the end extends the file; a gap before the written bytes is filled with zero bytes.
+     * @param _pFilename The name of the file to write to.
+     * @param _pOffset Where the data goes.
+     * @param _pData The bytes to write.
+     * @return True if the data was written, false otherwise (e.g., if the file does not exist or
+     *         the write would end past the maximum file size).
+     */
+    bool writeAt(const std::string& _pFilename, uint64_t _pOffset, const std::string& _pData);
+
+    /**
+     * @brief Adds data at the end of an existing file.
+     * @param _pFilename The name of the file to append to.
+     * @param _pData The bytes to append.
+     * @return True if the data was appended, false otherwise (e.g., if the file does not exist or
+     *         would grow past the maximum file size).
+     */
+    bool append(const std::string& _pFilename, const std::string& _pData);
+
+    /**
+     * @brief Sets the size of an existing file, cutting off its end or extending it with zero bytes.
+     * @param _pFilename The name of the file to resize.
+     * @param _pSize The new size in bytes.
+     * @return True if the file was resized, false otherwise (e.g., if the file does not exist or
+     *         _pSize is past the maximum file size).
+     */
+    bool truncate(const std::string& _pFilename, uint64_t _pSize);
+
     /**
      * @brief Deletes a file from the file system.
      * If the file exists, it is removed.
@@ -50,15 +149,14 @@ public:
 
 private:
     /**
-     * @brief In-memory storage for files, mapping filename to its content.
+     * @brief Where the files are kept. The engine does its own locking.
      */
-    std::unordered_map<std::string, std::string> _Files;
+    std::unique_ptr<StorageEngine> _Engine;
 
     /**
-     * @brief Mutex to protect the _Files map, ensuring thread-safe access to file data.
-     * All public methods acquire this mutex before accessing _Files.
+     * @brief Bound on the size writeAt, append and truncate may give a file.
      */
-    std::mutex _Mutex; 
+    uint64_t _MaxFileSize = DEFAULT_MAX_FILE_SIZE;
 };
 
 
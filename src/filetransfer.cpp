@@ -0,0 +1,409 @@
+#include "filetransfer.h"
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Largest count the kernel transfers in one sendfile call
+const size_t MAX_SENDFILE_CHUNK = 0x7ffff000;
+
+// Pipe capacity requested for splicing; the kernel default is 64 KiB
+const int SPLICE_PIPE_SIZE = 1024 * 1024;
+
+// Outcome of receiving a body with splice
+enum SpliceResult
+{
+	SpliceDone,        // The whole body is in the file
+	SpliceUnsupported, // The socket or file cannot splice; copy the rest
+	SpliceFailed       // An I/O error occurred; errno is set
+};
+
+// Waits until a nonblocking socket can take more data
+bool WaitWritable(SOCKET _pSocket)
+{
+	pollfd descriptor;
+	descriptor.fd = _pSocket;
+	descriptor.events = POLLOUT;
+	descriptor.revents = 0;
+	while(poll(&descriptor, 1, -1) < 0)
+	{
+		if(errno != EINTR)
+			return false;
+	}
+	return true;
+}
+
+// Waits until a nonblocking socket has data to read
+bool WaitReadable(SOCKET _pSocket)
+{
+	pollfd descriptor;
+	descriptor.fd = _pSocket;
+	descriptor.events = POLLIN;
+	descriptor.revents = 0;
+	while(poll(&descriptor, 1, -1) < 0)
+	{
+		if(errno != EINTR)
+			return false;
+	}
+	return true;
+}
+
+// Buffer reused by every copying receive on the calling thread
+std::vector<char>& TransferBuffer()
+{
+	thread_local std::vector<char> buffer(Networking::FILE_TRANSFER_CHUNK_SIZE);
+	return buffer;
+}
+
+// Reads up to _pLength bytes, waiting out EAGAIN on nonblocking sockets.
+// Returns the count read, zero if the peer closed the connection, or -1.
+ssize_t ReceiveSome(SOCKET _pSocket, char* _pBuffer, size_t _pLength)
+{
+	while(true)
+	{
+		ssize_t result = recv(_pSocket, _pBuffer, _pLength, 0);
+		if(result >= 0)
+			return result;
+		if(errno == EINTR)
+			continue;
+		if((errno == EAGAIN || errno == EWOULDBLOCK) && WaitReadable(_pSocket))
+			continue;
+		return -1;
+	}
+}
+
+// Writes all of _pBuffer to a file descriptor
+bool WriteAll(int _pFd, const char* _pBuffer, size_t _pLength)
+{
+	size_t bytesWritten = 0;
+	while(bytesWritten < _pLength)
+	{
+		ssize_t result = write(_pFd, _pBuffer + bytesWritten, _pLength - bytesWritten);
+		if(result < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return false;
+		}
+		bytesWritten += result;
+	}
+	return true;
+}
+
+// Moves _pLength bytes already in a pipe to the file by reading and writing them
+bool CopyFromPipe(int _pPipeFd, int _pFileFd, size_t _pLength)
+{
+	std::vector<char>& buffer = TransferBuffer();
+	while(_pLength > 0)
+	{
+		ssize_t bytesRead = read(_pPipeFd, buffer.data(), std::min(buffer.size(), _pLength));
+		if(bytesRead < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return false;
+		}
+		if(!WriteAll(_pFileFd, buffer.data(), bytesRead))
+			return false;
+		_pLength -= bytesRead;
+	}
+	return true;
+}
+
+// Splices the body from the socket into the file through a pipe, so that it
+// never enters user space. _pReceived counts the bytes already in the file.
+SpliceResult SpliceBody(SOCKET _pSocket, int _pFileFd, uint64_t _pLength, uint64_t& _pReceived)
+{
+	int pipeFds[2];
+	if(pipe2(pipeFds, O_CLOEXEC) < 0)
+		return SpliceUnsupported;
+	int pipeSize = fcntl(pipeFds[1], F_SETPIPE_SZ, SPLICE_PIPE_SIZE);
+	if(pipeSize <= 0)
+		pipeSize = fcntl(pipeFds[1], F_GETPIPE_SZ);
+	if(pipeSize <= 0)
+		pipeSize = 64 * 1024;
+
+	SpliceResult result = SpliceDone;
+	while(_pReceived < _pLength && result == SpliceDone)
+	{
+		size_t wanted = std::min<uint64_t>(pipeSize, _pLength - _pReceived);
+		ssize_t bytesIn = splice(_pSocket, NULL, pipeFds[1], NULL, wanted, SPLICE_F_MOVE | SPLICE_F_MORE);
+		if(bytesIn < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			if((errno == EAGAIN || errno == EWOULDBLOCK) && WaitReadable(_pSocket))
+				continue;
+			// The pipe is empty here, so the copy path can take over cleanly
+			result = errno == EINVAL ? SpliceUnsupported : SpliceFailed;
+			break;
+		}
+		if(bytesIn == 0)
+		{
+			errno = EIO;
+			result = SpliceFailed;
+			break;
+		}
+
+		size_t pending = bytesIn;
+		while(pending > 0)
+		{
+			ssize_t bytesOut = splice(pipeFds[0], NULL, _pFileFd, NULL, pending, SPLICE_F_MOVE | SPLICE_F_MORE);
+			if(bytesOut < 0)
+			{
+				if(errno == EINTR)
+					continue;
+				// Files opened with O_APPEND, for example, cannot be spliced into:
+				// empty the pipe by copying and let the copy path do the rest
+				if(errno == EINVAL && CopyFromPipe(pipeFds[0], _pFileFd, pending))
+				{
+					result = SpliceUnsupported;
+					pending = 0;
+					break;
+				}
+				result = SpliceFailed;
+				break;
+			}
+			pending -= bytesOut;
+		}
+		if(result != SpliceFailed)
+			_pReceived += bytesIn;
+	}
+
+	int errorCode = errno;
+	close(pipeFds[0]);
+	close(pipeFds[1]);
+	errno = errorCode;
+	return result;
+}
+
+// Writes all of _pBuffer, waiting out EAGAIN on nonblocking sockets
+bool SendAll(SOCKET _pSocket, const char* _pBuffer, size_t _pLength, int _pFlags)
+{
+	size_t bytesWritten = 0;
+	while(bytesWritten < _pLength)
+	{
+		ssize_t result = send(_pSocket, _pBuffer + bytesWritten, _pLength - bytesWritten, _pFlags | MSG_NOSIGNAL);
+		if(result < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			if((errno == EAGAIN || errno == EWOULDBLOCK) && WaitWritable(_pSocket))
+				continue;
+			return false;
+		}
+		bytesWritten += result;
+	}
+	return true;
+}
+
+// Copies the body through a user-space buffer when sendfile cannot be used.
+// Descriptors that cannot seek are read from their current position.
+long long SendWithPread(SOCKET _pSocket, int _pFileFd, uint64_t _pOffset, uint64_t _pLength)
+{
+	std::vector<char> buffer(std::min<uint64_t>(Networking::FILE_TRANSFER_CHUNK_SIZE, _pLength));
+	uint64_t bytesSent = 0;
+	bool seekable = true;
+	while(bytesSent < _pLength)
+	{
+		size_t wanted = std::min<uint64_t>(buffer.size(), _pLength - bytesSent);
+		ssize_t bytesRead = seekable
+			? pread(_pFileFd, buffer.data(), wanted, _pOffset + bytesSent)
+			: read(_pFileFd, buffer.data(), wanted);
+		if(bytesRead < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			if(errno == ESPIPE && seekable)
+			{
+				seekable = false;
+				continue;
+			}
+			return -1;
+		}
+		if(bytesRead == 0)
+		{
+			errno = EIO;
+			return -1;
+		}
+		if(!SendAll(_pSocket, buffer.data(), bytesRead, 0))
+			return -1;
+		bytesSent += bytesRead;
+	}
+	return bytesSent;
+}
+
+}
+
+void Networking::EncodeFileStreamHeader(uint64_t _pLength, char* _pBuffer)
+{
+	FrameHeader header;
+	header.flags = FRAME_FLAG_FILE;
+	header.payloadLength = sizeof(uint64_t);
+	EncodeFrameHeader(header, _pBuffer);
+
+	uint32_t high = htonl((uint32_t)(_pLength >> 32));
+	uint32_t low = htonl((uint32_t)_pLength);
+	memcpy(_pBuffer + FRAME_HEADER_SIZE, &high, sizeof(high));
+	memcpy(_pBuffer + FRAME_HEADER_SIZE + sizeof(high), &low, sizeof(low));
+}
+
+bool Networking::DecodeFileStreamHeader(const char* _pBuffer, uint64_t& _pLength)
+{
+	FrameHeader header;
+	if(!DecodeFrameHeader(_pBuffer, header))
+		return false;
+	if(!(header.flags & FRAME_FLAG_FILE) || header.payloadLength != sizeof(uint64_t))
+		return false;
+
+	uint32_t high;
+	uint32_t low;
+	memcpy(&high, _pBuffer + FRAME_HEADER_SIZE, sizeof(high));
+	memcpy(&low, _pBuffer + FRAME_HEADER_SIZE + sizeof(high), sizeof(low));
+	_pLength = ((uint64_t)ntohl(high) << 32) | ntohl(low);
+	return true;
+}
+
+long long Networking::SendFileStream(SOCKET _pSocket, int _pFileFd, uint64_t _pOffset, uint64_t _pLength)
+{
+	char header[FILE_STREAM_HEADER_SIZE];
+	EncodeFileStreamHeader(_pLength, header);
+	// MSG_MORE lets the kernel put the header in the same segment as the start of the body
+	if(!SendAll(_pSocket, header, sizeof(header), _pLength > 0 ? MSG_MORE : 0))
+		return -1;
+
+	off_t offset = _pOffset;
+	uint64_t bytesSent = 0;
+	while(bytesSent < _pLength)
+	{
+		size_t count = std::min<uint64_t>(MAX_SENDFILE_CHUNK, _pLength - bytesSent);
+		ssize_t result = sendfile(_pSocket, _pFileFd, &offset, count);
+		if(result < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			if((errno == EAGAIN || errno == EWOULDBLOCK) && WaitWritable(_pSocket))
+				continue;
+			// Descriptors that cannot be mapped, such as pipes, are copied instead
+			if(errno == EINVAL || errno == ENOSYS)
+			{
+				long long copied = SendWithPread(_pSocket, _pFileFd, _pOffset + bytesSent, _pLength - bytesSent);
+				return copied == -1 ? -1 : (long long)(bytesSent + copied);
+			}
+			return -1;
+		}
+		if(result == 0)
+		{
+			// The file is shorter than the length already announced
+			errno = EIO;
+			return -1;
+		}
+		bytesSent += result;
+	}
+	return bytesSent;
+}
+
+long long Networking::SendFileRange(SOCKET _pSocket, const std::string& _pFilePath, uint64_t _pOffset, uint64_t _pLength)
+{
+	int fileFd = open(_pFilePath.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fileFd < 0)
+		throw std::runtime_error("Error: Unable to open file '" + _pFilePath + "'");
+
+	struct stat fileInfo;
+	if(fstat(fileFd, &fileInfo) < 0 || (uint64_t)fileInfo.st_size < _pOffset)
+	{
+		close(fileFd);
+		throw std::runtime_error("Error: Offset " + std::to_string(_pOffset) + " is past the end of '" + _pFilePath + "'");
+	}
+
+	uint64_t available = fileInfo.st_size - _pOffset;
+	long long result = SendFileStream(_pSocket, fileFd, _pOffset, std::min(_pLength, available));
+	int errorCode = errno;
+	close(fileFd);
+	errno = errorCode;
+	return result;
+}
+
+long long Networking::ReceiveFileStream(SOCKET _pSocket, int _pFileFd, uint64_t _pMaxLength)
+{
+	char header[FILE_STREAM_HEADER_SIZE];
+	size_t headerBytes = 0;
+	while(headerBytes < sizeof(header))
+	{
+		ssize_t result = ReceiveSome(_pSocket, header + headerBytes, sizeof(header) - headerBytes);
+		if(result < 0)
+			return -1;
+		if(result == 0)
+		{
+			errno = EIO;
+			return -1;
+		}
+		headerBytes += result;
+	}
+
+	uint64_t length;
+	if(!DecodeFileStreamHeader(header, length))
+	{
+		errno = EPROTO;
+		return -1;
+	}
+	if(length > _pMaxLength)
+	{
+		errno = EFBIG;
+		return -1;
+	}
+
+	// Reserving the space up front keeps large files contiguous; not every file system supports it
+	off_t start = lseek(_pFileFd, 0, SEEK_CUR);
+	if(length > 0 && start >= 0)
+		fallocate(_pFileFd, FALLOC_FL_KEEP_SIZE, start, length);
+
+	uint64_t received = 0;
+	SpliceResult spliced = SpliceBody(_pSocket, _pFileFd, length, received);
+	if(spliced == SpliceFailed)
+		return -1;
+
+	std::vector<char>& buffer = TransferBuffer();
+	while(received < length)
+	{
+		size_t wanted = std::min<uint64_t>(buffer.size(), length - received);
+		ssize_t bytesReceived = ReceiveSome(_pSocket, buffer.data(), wanted);
+		if(bytesReceived < 0)
+			return -1;
+		if(bytesReceived == 0)
+		{
+			errno = EIO;
+			return -1;
+		}
+		if(!WriteAll(_pFileFd, buffer.data(), bytesReceived))
+			return -1;
+		received += bytesReceived;
+	}
+	return received;
+}
+
+long long Networking::ReceiveFileToPath(SOCKET _pSocket, const std::string& _pFilePath, uint64_t _pMaxLength)
+{
+	int fileFd = open(_pFilePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if(fileFd < 0)
+		throw std::runtime_error("Error: Unable to open file '" + _pFilePath + "'");
+
+	long long result = ReceiveFileStream(_pSocket, fileFd, _pMaxLength);
+	int errorCode = errno;
+	close(fileFd);
+	// A truncated file would look like a complete one to later readers
+	if(result == -1)
+		unlink(_pFilePath.c_str());
+	errno = errorCode;
+	return result;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#ifndef _NET_FILE_TRANSFER_
+#define _NET_FILE_TRANSFER_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "frame.h"
+
+namespace Networking {
+
+// A file is sent as a file stream: a frame with FRAME_FLAG_FILE set whose
+// 8-byte payload holds the body length in network byte order, followed by
+// exactly that many raw bytes. Unlike a frame payload, the body length is
+// 64 bits, so a stream can carry files larger than 4 GiB.
+const size_t FILE_STREAM_HEADER_SIZE = FRAME_HEADER_SIZE + sizeof(uint64_t);
+
+// Size of the buffer used when data has to be copied through user space
+const size_t FILE_TRANSFER_CHUNK_SIZE = 256 * 1024;
+
+// Passed as a length to send everything from the offset to the end of the file
+const uint64_t FILE_TO_END = UINT64_MAX;
+
+// Writes the header announcing a body of _pLength bytes into _pBuffer, which
+// must hold FILE_STREAM_HEADER_SIZE bytes
+void EncodeFileStreamHeader(uint64_t _pLength, char* _pBuffer);
+
+// Parses FILE_STREAM_HEADER_SIZE bytes from _pBuffer. Returns false if they are
+// not a file stream header.
+bool DecodeFileStreamHeader(const char* _pBuffer, uint64_t& _pLength);
+
+// Sends _pLength bytes of the open file _pFileFd, starting at _pOffset, as a
+// file stream. The body goes from the page cache to the socket with sendfile(2);
+// if the descriptor does not support that it is copied with pread and send.
+// Nonblocking sockets are waited on with poll. Returns the number of body bytes
+// sent, or SOCKET_ERROR with errno set (EIO if the file ended early, in which
+// case the stream is incomplete and the connection must be closed).
+long long SendFileStream(SOCKET _pSocket, int _pFileFd, uint64_t _pOffset, uint64_t _pLength);
+
+// Opens _pFilePath and sends the range [_pOffset, _pOffset + _pLength) as a
+// file stream; the range is clipped to the end of the file. Throws
+// std::runtime_error if the file cannot be opened or _pOffset is past its end.
+// Returns as SendFileStream.
+long long SendFileRange(SOCKET _pSocket, const std::string& _pFilePath, uint64_t _pOffset = 0, uint64_t _pLength = FILE_TO_END);
+
+// Receives a file stream and writes its body to the open file _pFileFd as it
+// arrives. The body is spliced from the socket through a pipe into the file when
+// both support it, and otherwise copied through a fixed-size buffer reused by
+// the calling thread, so memory use does not depend on the file size. Exactly
+// the announced number of bytes is consumed from the socket. Streams announcing
+// more than _pMaxLength bytes are refused before anything is written. Returns
+// the number of body bytes written, or SOCKET_ERROR with errno set (EPROTO if the
+// data is not a file stream, EFBIG if it is too large, EIO if the peer closed
+// the connection before the end of the body).
+long long ReceiveFileStream(SOCKET _pSocket, int _pFileFd, uint64_t _pMaxLength = FILE_TO_END);
+
+// Creates _pFilePath and receives a file stream into it. A partially written
+// file is removed if the transfer fails. Throws std::runtime_error if the file
+// cannot be created. Returns as ReceiveFileStream.
+long long ReceiveFileToPath(SOCKET _pSocket, const std::string& _pFilePath, uint64_t _pMaxLength = FILE_TO_END);
+
+}
+
+#endif
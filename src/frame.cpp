@@ -0,0 +1,196 @@
+#include "frame.h"
+#include <sys/socket.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <limits.h>
+#include <algorithm>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+
+void Networking::EncodeFrameHeader(const FrameHeader& _pHeader, char* _pBuffer)
+{
+	uint16_t magic = htons(FRAME_MAGIC);
+	uint32_t payloadLength = htonl(_pHeader.payloadLength);
+	uint32_t requestId = htonl(_pHeader.requestId);
+	memcpy(_pBuffer, &magic, sizeof(magic));
+	_pBuffer[2] = (char)_pHeader.flags;
+	_pBuffer[3] = (char)_pHeader.codec;
+	memcpy(_pBuffer + 4, &payloadLength, sizeof(payloadLength));
+	memcpy(_pBuffer + 8, &requestId, sizeof(requestId));
+}
+
+bool Networking::DecodeFrameHeader(const char* _pBuffer, FrameHeader& _pHeader)
+{
+	uint16_t magic;
+	uint32_t payloadLength;
+	uint32_t requestId;
+	memcpy(&magic, _pBuffer, sizeof(magic));
+	memcpy(&payloadLength, _pBuffer + 4, sizeof(payloadLength));
+	memcpy(&requestId, _pBuffer + 8, sizeof(requestId));
+	if(ntohs(magic) != FRAME_MAGIC)
+		return false;
+	_pHeader.flags = (uint8_t)_pBuffer[2];
+	_pHeader.codec = (uint8_t)_pBuffer[3];
+	_pHeader.payloadLength = ntohl(payloadLength);
+	_pHeader.requestId = ntohl(requestId);
+	return true;
+}
+
+long Networking::ReadFully(SOCKET _pSocket, char* _pBuffer, size_t _pLength)
+{
+	size_t bytesRead = 0;
+	while(bytesRead < _pLength)
+	{
+		ssize_t result = recv(_pSocket, _pBuffer + bytesRead, _pLength - bytesRead, 0);
+		if(result == 0)
+			break;
+		if(result < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return -1;
+		}
+		bytesRead += result;
+	}
+	return bytesRead;
+}
+
+long Networking::WriteFully(SOCKET _pSocket, const char* _pBuffer, size_t _pLength)
+{
+	size_t bytesWritten = 0;
+	while(bytesWritten < _pLength)
+	{
+		ssize_t result = send(_pSocket, _pBuffer + bytesWritten, _pLength - bytesWritten, MSG_NOSIGNAL);
+		if(result < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return -1;
+		}
+		bytesWritten += result;
+	}
+	return bytesWritten;
+}
+
+long Networking::ReadFully(SOCKET _pSocket, char* _pBuffer, size_t _pLength, const Deadline& _pDeadline)
+{
+	if(!_pDeadline.IsSet())
+		return ReadFully(_pSocket, _pBuffer, _pLength);
+
+	size_t bytesRead = 0;
+	while(bytesRead < _pLength)
+	{
+		// Try first and only wait when nothing is buffered, so a ready socket costs no poll
+		ssize_t result = recv(_pSocket, _pBuffer + bytesRead, _pLength - bytesRead, MSG_DONTWAIT);
+		if(result == 0)
+			break;
+		if(result < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			if(errno != EAGAIN && errno != EWOULDBLOCK)
+				return -1;
+			if(WaitForSocket(_pSocket, POLLIN, _pDeadline) < 0)
+				return -1;
+			continue;
+		}
+		bytesRead += result;
+	}
+	return bytesRead;
+}
+
+long Networking::WriteFully(SOCKET _pSocket, const char* _pBuffer, size_t _pLength, const Deadline& _pDeadline)
+{
+	if(!_pDeadline.IsSet())
+		return WriteFully(_pSocket, _pBuffer, _pLength);
+
+	size_t bytesWritten = 0;
+	while(bytesWritten < _pLength)
+	{
+		ssize_t result = send(_pSocket, _pBuffer + bytesWritten, _pLength - bytesWritten, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if(result < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			if(errno != EAGAIN && errno != EWOULDBLOCK)
+				return -1;
+			if(WaitForSocket(_pSocket, POLLOUT, _pDeadline) < 0)
+				return -1;
+			continue;
+		}
+		bytesWritten += result;
+	}
+	return bytesWritten;
+}
+
+long Networking::WriteVectorFully(SOCKET _pSocket, const iovec* _pVectors, size_t _pCount, const Deadline& _pDeadline, int _pFlags)
+{
+	// Work on a copy so partially written buffers can be trimmed in place
+	std::vector<iovec> pending(_pVectors, _pVectors + _pCount);
+	size_t first = 0;
+	long bytesWritten = 0;
+	int flags = MSG_NOSIGNAL | _pFlags;
+	if(_pDeadline.IsSet())
+		flags |= MSG_DONTWAIT;
+
+	while(true)
+	{
+		// Empty buffers would otherwise end a call with nothing left to send
+		while(first < pending.size() && pending[first].iov_len == 0)
+			first++;
+		if(first == pending.size())
+			return bytesWritten;
+
+		msghdr message;
+		memset(&message, 0, sizeof(message));
+		message.msg_iov = &pending[first];
+		message.msg_iovlen = std::min<size_t>(pending.size() - first, IOV_MAX);
+		ssize_t result = sendmsg(_pSocket, &message, flags);
+		if(result < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			if((errno == EAGAIN || errno == EWOULDBLOCK) && _pDeadline.IsSet())
+			{
+				if(WaitForSocket(_pSocket, POLLOUT, _pDeadline) < 0)
+					return -1;
+				continue;
+			}
+			return -1;
+		}
+		bytesWritten += result;
+
+		size_t remaining = result;
+		while(remaining > 0)
+		{
+			size_t consumed = std::min(remaining, pending[first].iov_len);
+			pending[first].iov_base = (char*)pending[first].iov_base + consumed;
+			pending[first].iov_len -= consumed;
+			remaining -= consumed;
+			if(pending[first].iov_len == 0)
+				first++;
+		}
+	}
+}
+
+int Networking::WaitForSocket(SOCKET _pSocket, short _pEvents, const Deadline& _pDeadline)
+{
+	pollfd descriptor;
+	descriptor.fd = _pSocket;
+	descriptor.events = _pEvents;
+	while(true)
+	{
+		descriptor.revents = 0;
+		int ready = poll(&descriptor, 1, _pDeadline.PollTimeout());
+		if(ready > 0)
+			return 0;
+		if(ready == 0)
+		{
+			errno = ETIMEDOUT;
+			return -1;
+		}
+		if(errno != EINTR)
+			return -1;
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+#ifndef _NET_FRAME_
+#define _NET_FRAME_
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/uio.h>
+#include "clientconnection.h"
+#include "retry.h"
+
+namespace Networking {
+
+// Every framed message starts with a fixed-size header:
+//   bytes 0-1   magic ("SD")
+//   byte  2     flags
+//   byte  3     codec (see compression.h), zero unless a compression flag is set
+//   bytes 4-7   payload length
+//   bytes 8-11  request ID
+// Multi-byte fields are in network byte order. A reply carries the request ID
+// of the request it answers, which lets a client keep several requests in
+// flight on one connection. Zero means the request is not correlated and must
+// be answered in order.
+const size_t FRAME_HEADER_SIZE = 12;
+const uint16_t FRAME_MAGIC = 0x5344;
+
+// Largest payload accepted unless SetMaxMessageSize says otherwise
+const size_t DEFAULT_MAX_MESSAGE_SIZE = 64 * 1024 * 1024;
+
+// Frame flags
+const uint8_t FRAME_FLAG_FILE = 0x01; // Payload announces a raw file body that follows the frame (see filetransfer.h)
+const uint8_t FRAME_FLAG_COMPRESSED = 0x02; // Payload is compressed with the header's codec
+const uint8_t FRAME_FLAG_ACCEPTS_COMPRESSED = 0x04; // Sender takes replies compressed with the header's codec
+
+struct FrameHeader {
+	uint8_t flags = 0;
+	uint8_t codec = 0;
+	uint32_t payloadLength = 0;
+	uint32_t requestId = 0;
+};
+
+// Writes the header for a payload into _pBuffer, which must hold FRAME_HEADER_SIZE bytes
+void EncodeFrameHeader(const FrameHeader& _pHeader, char* _pBuffer);
+
+// Parses FRAME_HEADER_SIZE bytes from _pBuffer. Returns false if the magic does not match.
+bool DecodeFrameHeader(const char* _pBuffer, FrameHeader& _pHeader);
+
+// Codec the sender of a frame takes replies in: the one it compressed with or
+// asked for, or zero
+inline uint8_t GetReplyCodec(const FrameHeader& _pHeader)
+{
+	return (_pHeader.flags & (FRAME_FLAG_COMPRESSED | FRAME_FLAG_ACCEPTS_COMPRESSED)) ? _pHeader.codec : 0;
+}
+
+// Reads exactly _pLength bytes from a blocking socket, retrying on short reads and EINTR.
+// Returns the number of bytes read, which is less than _pLength only if the peer closed
+// the connection, or SOCKET_ERROR with errno set.
+long ReadFully(SOCKET _pSocket, char* _pBuffer, size_t _pLength);
+
+// Writes exactly _pLength bytes to a blocking socket, retrying on short writes and EINTR.
+// Returns the number of bytes written or SOCKET_ERROR with errno set.
+long WriteFully(SOCKET _pSocket, const char* _pBuffer, size_t _pLength);
+
+// As above, but give up once _pDeadline expires: SOCKET_ERROR is returned with
+// errno set to ETIMEDOUT. Bytes already transferred are lost to the caller, so
+// the connection should be closed after a timeout.
+long ReadFully(SOCKET _pSocket, char* _pBuffer, size_t _pLength, const Deadline& _pDeadline);
+long WriteFully(SOCKET _pSocket, const char* _pBuffer, size_t _pLength, const Deadline& _pDeadline);
+
+// Writes the buffers described by _pVectors in order, as one contiguous stream,
+// with sendmsg so that e.g. a frame header and its payload leave in a single
+// system call without being copied together first. Short writes resume from
+// the right buffer; up to IOV_MAX buffers go out per call. _pFlags is added
+// to MSG_NOSIGNAL. Returns the number of bytes written or SOCKET_ERROR with
+// errno set (ETIMEDOUT once _pDeadline expires).
+long WriteVectorFully(SOCKET _pSocket, const iovec* _pVectors, size_t _pCount, const Deadline& _pDeadline = Deadline(), int _pFlags = 0);
+
+// Waits until _pSocket is ready for _pEvents (POLLIN/POLLOUT) or _pDeadline
+// expires. Returns 0 when ready, or SOCKET_ERROR with errno set to ETIMEDOUT.
+int WaitForSocket(SOCKET _pSocket, short _pEvents, const Deadline& _pDeadline);
+
+}
+
+#endif
@@ -0,0 +1,636 @@
+#include "logstorageengine.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define SIMPLIDFS_HARDWARE_CRC32C 1
+#endif
+
+namespace {
+
+// Record layout, integers big-endian:
+//   magic(4) crc32c(4) type(1) reserved(3) name length(4) value length(8) name value
+// The checksum covers everything after it, so a torn or damaged record is detected
+// wherever the damage is.
+const uint32_t RECORD_MAGIC = 0x53444653; // "SDFS"
+const size_t RECORD_HEADER_SIZE = 24;
+const size_t RECORD_CHECKSUMMED_HEADER_OFFSET = 8;
+const uint8_t RECORD_PUT = 1;
+const uint8_t RECORD_DELETE = 2;
+const uint32_t MAX_NAME_LENGTH = 64 * 1024;
+const size_t SCAN_BUFFER_SIZE = 1024 * 1024;
+
+uint64_t RecordSize(size_t _pNameLength, uint64_t _pValueLength)
+{
+	return RECORD_HEADER_SIZE + _pNameLength + _pValueLength;
+}
+
+void StoreBigEndian(char* _pOut, uint64_t _pValue, size_t _pBytes)
+{
+	for (size_t i = 0; i < _pBytes; ++i)
+		_pOut[i] = static_cast<char>(_pValue >> (8 * (_pBytes - 1 - i)));
+}
+
+uint64_t LoadBigEndian(const char* _pIn, size_t _pBytes)
+{
+	uint64_t value = 0;
+	for (size_t i = 0; i < _pBytes; ++i)
+		value = (value << 8) | static_cast<unsigned char>(_pIn[i]);
+	return value;
+}
+
+uint32_t ExtendCrc32cSoftware(uint32_t _pCrc, const char* _pData, size_t _pLength)
+{
+	static const std::array<uint32_t, 256> table = [] {
+		std::array<uint32_t, 256> entries;
+		for (uint32_t i = 0; i < 256; ++i) {
+			uint32_t crc = i;
+			for (int bit = 0; bit < 8; ++bit)
+				crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78 : crc >> 1;
+			entries[i] = crc;
+		}
+		return entries;
+	}();
+	for (size_t i = 0; i < _pLength; ++i)
+		_pCrc = table[(_pCrc ^ static_cast<unsigned char>(_pData[i])) & 0xFF] ^ (_pCrc >> 8);
+	return _pCrc;
+}
+
+#ifdef SIMPLIDFS_HARDWARE_CRC32C
+__attribute__((target("sse4.2")))
+uint32_t ExtendCrc32cHardware(uint32_t _pCrc, const char* _pData, size_t _pLength)
+{
+	uint64_t crc = _pCrc;
+	for (; _pLength >= 8; _pData += 8, _pLength -= 8) {
+		uint64_t word;
+		std::memcpy(&word, _pData, sizeof(word));
+		crc = _mm_crc32_u64(crc, word);
+	}
+	uint32_t crc32 = static_cast<uint32_t>(crc);
+	for (; _pLength > 0; ++_pData, --_pLength)
+		crc32 = _mm_crc32_u8(crc32, static_cast<unsigned char>(*_pData));
+	return crc32;
+}
+#endif
+
+// CRC-32C state update; start from 0xFFFFFFFF and invert the result. The SSE4.2
+// instruction computes the same function, so segments move freely between machines.
+uint32_t ExtendCrc32c(uint32_t _pCrc, const char* _pData, size_t _pLength)
+{
+#ifdef SIMPLIDFS_HARDWARE_CRC32C
+	static const bool hardware = __builtin_cpu_supports("sse4.2");
+	if (hardware)
+		return ExtendCrc32cHardware(_pCrc, _pData, _pLength);
+#endif
+	return ExtendCrc32cSoftware(_pCrc, _pData, _pLength);
+}
+
+bool WriteFullyAt(int _pFd, iovec* _pIov, int _pCount, uint64_t _pOffset)
+{
+	while (_pCount > 0) {
+		ssize_t written = pwritev(_pFd, _pIov, _pCount, static_cast<off_t>(_pOffset));
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		_pOffset += static_cast<uint64_t>(written);
+		size_t remaining = static_cast<size_t>(written);
+		while (_pCount > 0 && remaining >= _pIov->iov_len) {
+			remaining -= _pIov->iov_len;
+			++_pIov;
+			--_pCount;
+		}
+		if (_pCount > 0) {
+			_pIov->iov_base = static_cast<char*>(_pIov->iov_base) + remaining;
+			_pIov->iov_len -= remaining;
+		}
+	}
+	return true;
+}
+
+bool ReadFullyAt(int _pFd, char* _pBuffer, size_t _pLength, uint64_t _pOffset)
+{
+	while (_pLength > 0) {
+		ssize_t received = pread(_pFd, _pBuffer, _pLength, static_cast<off_t>(_pOffset));
+		if (received < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		if (received == 0) {
+			errno = EIO; // The segment is shorter than its index says
+			return false;
+		}
+		_pBuffer += received;
+		_pLength -= static_cast<size_t>(received);
+		_pOffset += static_cast<uint64_t>(received);
+	}
+	return true;
+}
+
+// Segment files are named by their ID: 00000001.seg, 00000002.seg, ...
+bool ParseSegmentFileName(const std::string& _pName, uint32_t& _pId)
+{
+	if (_pName.size() != 12 || _pName.compare(8, 4, ".seg") != 0)
+		return false;
+	uint32_t id = 0;
+	for (size_t i = 0; i < 8; ++i) {
+		if (_pName[i] < '0' || _pName[i] > '9')
+			return false;
+		id = id * 10 + static_cast<uint32_t>(_pName[i] - '0');
+	}
+	_pId = id;
+	return id != 0;
+}
+
+}
+
+
+LogStorageEngine::LogStorageEngine(const std::string& _pDirectory, const LogStorageOptions& _pOptions)
+	: _Directory(_pDirectory), _Options(_pOptions), _Index(_pOptions.indexShards)
+{
+	try {
+		recover();
+	} catch (...) {
+		for (auto& entry : _Segments)
+			close(entry.second.fd);
+		throw;
+	}
+}
+
+
+void LogStorageEngine::recover()
+{
+	std::error_code error;
+	std::filesystem::create_directories(_Directory, error);
+	if (error)
+		throw std::runtime_error("Cannot create storage directory '" + _Directory + "': " + error.message());
+
+	std::vector<uint32_t> ids;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(_Directory, error)) {
+		uint32_t id = 0;
+		if (entry.is_regular_file() && ParseSegmentFileName(entry.path().filename().string(), id))
+			ids.push_back(id);
+	}
+	if (error)
+		throw std::runtime_error("Cannot list storage directory '" + _Directory + "': " + error.message());
+	std::sort(ids.begin(), ids.end());
+
+	// Replay the segments oldest first; a later record for a name replaces an earlier one.
+	// Nothing else can see the engine yet, so no locks are taken.
+	for (uint32_t id : ids) {
+		int fd = open(segmentPath(id).c_str(), O_RDWR | O_CLOEXEC);
+		struct stat status;
+		if (fd < 0 || fstat(fd, &status) != 0) {
+			std::string reason = std::strerror(errno);
+			if (fd >= 0)
+				close(fd);
+			throw std::runtime_error("Cannot open segment '" + segmentPath(id) + "': " + reason);
+		}
+		Segment& segment = _Segments[id];
+		segment.fd = fd;
+		segment.size = static_cast<uint64_t>(status.st_size);
+
+		uint64_t validEnd = scanSegment(segment, [&](const Record& record) {
+			++_RecoveredRecords;
+			std::unordered_map<std::string, Location>& entries = _Index.shardFor(record.name).entries;
+			auto it = entries.find(record.name);
+			if (it != entries.end())
+				retire(record.name, it->second);
+			if (record.type == RECORD_PUT) {
+				Location location;
+				location.segment = id;
+				location.offset = record.offset;
+				location.length = record.valueLength;
+				if (it != entries.end())
+					it->second = location;
+				else
+					entries.emplace(record.name, location);
+				segment.liveBytes += record.size;
+			} else if (it != entries.end()) {
+				entries.erase(it);
+			}
+		});
+		if (validEnd < segment.size) {
+			// A crash can leave a partly written record at the end of the log
+			std::cerr << "[STORAGE] Truncating " << segmentPath(id) << " from " << segment.size << " to " << validEnd
+			          << " bytes after an incomplete or corrupt record." << std::endl;
+			if (ftruncate(fd, static_cast<off_t>(validEnd)) != 0)
+				throw std::runtime_error("Cannot truncate segment '" + segmentPath(id) + "': " + std::strerror(errno));
+			_TruncatedBytes += segment.size - validEnd;
+			segment.size = validEnd;
+		}
+	}
+
+	if (_Segments.empty()) {
+		if (!startSegment(1))
+			throw std::runtime_error("Cannot create segment '" + segmentPath(1) + "': " + std::strerror(errno));
+	} else {
+		_ActiveSegment = _Segments.rbegin()->first;
+	}
+}
+
+
+LogStorageEngine::~LogStorageEngine()
+{
+	for (auto& entry : _Segments)
+		close(entry.second.fd);
+}
+
+
+bool LogStorageEngine::create(const std::string& _pName)
+{
+	return put(_pName, nullptr, 0, false);
+}
+
+
+bool LogStorageEngine::write(const std::string& _pName, const std::string& _pContent)
+{
+	return put(_pName, _pContent.data(), _pContent.size(), true);
+}
+
+
+bool LogStorageEngine::write(const std::string& _pName, std::string&& _pContent)
+{
+	// The content is copied to disk either way; there is nothing to gain from owning it
+	return write(_pName, static_cast<const std::string&>(_pContent));
+}
+
+
+bool LogStorageEngine::read(const std::string& _pName, std::string& _pContent)
+{
+	Index::Shard& shard = _Index.shardFor(_pName);
+	std::shared_lock<std::shared_mutex> lock(shard.mutex);
+	auto it = shard.entries.find(_pName);
+	if (it == shard.entries.end())
+		return false;
+	return readValue(it->second, _pName.size(), 0, it->second.length, _pContent);
+}
+
+
+bool LogStorageEngine::readRange(const std::string& _pName, uint64_t _pOffset, uint64_t _pLength, std::string& _pContent)
+{
+	Index::Shard& shard = _Index.shardFor(_pName);
+	std::shared_lock<std::shared_mutex> lock(shard.mutex);
+	auto it = shard.entries.find(_pName);
+	if (it == shard.entries.end())
+		return false;
+	const Location& location = it->second;
+	if (_pOffset >= location.length) {
+		_pContent.clear();
+		return true;
+	}
+	return readValue(location, _pName.size(), _pOffset, std::min(_pLength, location.length - _pOffset), _pContent);
+}
+
+
+bool LogStorageEngine::writeAt(const std::string& _pName, uint64_t _pOffset, const std::string& _pData)
+{
+	if (_pOffset + _pData.size() < _pOffset)
+		return false;
+	return update(_pName, [&](std::string& _pContent) {
+		if (_pContent.size() < _pOffset + _pData.size())
+			_pContent.resize(static_cast<size_t>(_pOffset + _pData.size()));
+		_pContent.replace(static_cast<size_t>(_pOffset), _pData.size(), _pData);
+		return true;
+	});
+}
+
+
+bool LogStorageEngine::append(const std::string& _pName, const std::string& _pData, uint64_t _pMaxSize)
+{
+	return update(_pName, [&](std::string& _pContent) {
+		if (_pContent.size() > _pMaxSize || _pData.size() > _pMaxSize - _pContent.size())
+			return false;
+		_pContent.append(_pData);
+		return true;
+	});
+}
+
+
+bool LogStorageEngine::truncate(const std::string& _pName, uint64_t _pSize)
+{
+	return update(_pName, [&](std::string& _pContent) {
+		_pContent.resize(static_cast<size_t>(_pSize));
+		return true;
+	});
+}
+
+
+bool LogStorageEngine::remove(const std::string& _pName)
+{
+	Index::Shard& shard = _Index.shardFor(_pName);
+	std::unique_lock<std::shared_mutex> lock(shard.mutex);
+	auto it = shard.entries.find(_pName);
+	if (it == shard.entries.end())
+		return false;
+	{
+		std::lock_guard<std::mutex> appendLock(_AppendMutex);
+		Location tombstone;
+		if (!appendRecord(RECORD_DELETE, _pName, nullptr, 0, tombstone))
+			return false;
+		retire(_pName, it->second);
+	}
+	shard.entries.erase(it);
+	return true;
+}
+
+
+size_t LogStorageEngine::compact(double _pMaxLiveFraction)
+{
+	// Moving records rewrites index entries all over, and a removed segment must have no readers
+	std::vector<std::unique_lock<std::shared_mutex>> shardLocks;
+	shardLocks.reserve(_Index.shardCount());
+	for (size_t i = 0; i < _Index.shardCount(); ++i)
+		shardLocks.emplace_back(_Index.shard(i).mutex);
+	std::lock_guard<std::mutex> appendLock(_AppendMutex);
+
+	// Records copied forward land in segments newer than this one, which are left for a later pass
+	const uint32_t firstUncompacted = _ActiveSegment;
+	size_t removed = 0;
+	std::string value;
+
+	for (auto it = _Segments.begin(); it != _Segments.end() && it->first < firstUncompacted; ) {
+		const uint32_t id = it->first;
+		Segment& segment = it->second;
+		if (static_cast<double>(segment.liveBytes) > _pMaxLiveFraction * static_cast<double>(segment.size)) {
+			++it;
+			continue;
+		}
+
+		// A tombstone only matters while an older segment may still hold the content it deleted
+		const bool olderSegmentsExist = it != _Segments.begin();
+		bool copied = true;
+		uint64_t scanned = scanSegment(segment, [&](const Record& record) {
+			if (!copied)
+				return;
+			std::unordered_map<std::string, Location>& entries = _Index.shardFor(record.name).entries;
+			auto entry = entries.find(record.name);
+			if (record.type == RECORD_PUT) {
+				if (entry == entries.end() || entry->second.segment != id || entry->second.offset != record.offset)
+					return; // Overwritten or deleted since
+				Location moved;
+				if (!readValue(entry->second, record.name.size(), 0, entry->second.length, value) ||
+				    !appendRecord(RECORD_PUT, record.name, value.data(), value.size(), moved)) {
+					copied = false;
+					return;
+				}
+				retire(record.name, entry->second);
+				entry->second = moved;
+				_Segments.at(moved.segment).liveBytes += record.size;
+			} else if (olderSegmentsExist && entry == entries.end()) {
+				Location tombstone;
+				copied = appendRecord(RECORD_DELETE, record.name, nullptr, 0, tombstone);
+			}
+		});
+		if (!copied || scanned != segment.size) {
+			// Whatever was copied is a harmless duplicate; keep the segment for another try
+			std::cerr << "[STORAGE] Could not compact " << segmentPath(id) << "." << std::endl;
+			++it;
+			continue;
+		}
+
+		// The copies must be on disk before the only other copy is deleted
+		for (auto newer = _Segments.find(firstUncompacted); newer != _Segments.end(); ++newer)
+			fdatasync(newer->second.fd);
+		close(segment.fd);
+		unlink(segmentPath(id).c_str());
+		{
+			std::unique_lock<std::shared_mutex> segmentsLock(_SegmentsMutex);
+			it = _Segments.erase(it);
+		}
+		++removed;
+	}
+	return removed;
+}
+
+
+LogStorageStats LogStorageEngine::getStats()
+{
+	LogStorageStats stats;
+	for (size_t i = 0; i < _Index.shardCount(); ++i) {
+		std::shared_lock<std::shared_mutex> lock(_Index.shard(i).mutex);
+		stats.files += _Index.shard(i).entries.size();
+	}
+	std::lock_guard<std::mutex> appendLock(_AppendMutex);
+	stats.segments = _Segments.size();
+	for (const auto& entry : _Segments) {
+		stats.totalBytes += entry.second.size;
+		stats.liveBytes += entry.second.liveBytes;
+	}
+	stats.recoveredRecords = _RecoveredRecords;
+	stats.truncatedBytes = _TruncatedBytes;
+	return stats;
+}
+
+
+bool LogStorageEngine::put(const std::string& _pName, const char* _pData, uint64_t _pLength, bool _pMustExist)
+{
+	Index::Shard& shard = _Index.shardFor(_pName);
+	std::unique_lock<std::shared_mutex> lock(shard.mutex);
+	auto it = shard.entries.find(_pName);
+	if (_pMustExist ? it == shard.entries.end() : it != shard.entries.end())
+		return false;
+	return store(shard, it, _pName, _pData, _pLength);
+}
+
+
+bool LogStorageEngine::update(const std::string& _pName, const std::function<bool(std::string&)>& _pChange)
+{
+	// Records hold whole files, so a partial change writes the changed file as a new record
+	Index::Shard& shard = _Index.shardFor(_pName);
+	std::unique_lock<std::shared_mutex> lock(shard.mutex);
+	auto it = shard.entries.find(_pName);
+	if (it == shard.entries.end())
+		return false;
+	std::string content;
+	if (!readValue(it->second, _pName.size(), 0, it->second.length, content))
+		return false;
+	if (!_pChange(content))
+		return false;
+	return store(shard, it, _pName, content.data(), content.size());
+}
+
+
+bool LogStorageEngine::store(Index::Shard& _pShard, IndexEntries::iterator _pEntry, const std::string& _pName, const char* _pData, uint64_t _pLength)
+{
+	Location location;
+	{
+		std::lock_guard<std::mutex> appendLock(_AppendMutex);
+		if (!appendRecord(RECORD_PUT, _pName, _pData, _pLength, location))
+			return false;
+		if (_pEntry != _pShard.entries.end())
+			retire(_pName, _pEntry->second);
+		_Segments.at(location.segment).liveBytes += RecordSize(_pName.size(), _pLength);
+	}
+	if (_pEntry != _pShard.entries.end())
+		_pEntry->second = location;
+	else
+		_pShard.entries.emplace(_pName, location);
+	return true;
+}
+
+
+bool LogStorageEngine::appendRecord(uint8_t _pType, const std::string& _pName, const char* _pData, uint64_t _pLength, Location& _pLocation)
+{
+	if (_pName.size() > MAX_NAME_LENGTH)
+		return false;
+	const uint64_t size = RecordSize(_pName.size(), _pLength);
+	Segment* active = &_Segments.at(_ActiveSegment);  // at(), unlike [], may run alongside readers' lookups
+	if (active->size > 0 && active->size + size > _Options.segmentSize) {
+		if (!startSegment(_ActiveSegment + 1)) {
+			std::cerr << "[STORAGE] Cannot create segment " << segmentPath(_ActiveSegment + 1) << ": " << std::strerror(errno) << std::endl;
+			return false;
+		}
+		active = &_Segments.at(_ActiveSegment);
+	}
+
+	char header[RECORD_HEADER_SIZE] = {};
+	StoreBigEndian(header, RECORD_MAGIC, 4);
+	header[8] = static_cast<char>(_pType);
+	StoreBigEndian(header + 12, _pName.size(), 4);
+	StoreBigEndian(header + 16, _pLength, 8);
+	uint32_t crc = ExtendCrc32c(0xFFFFFFFF, header + RECORD_CHECKSUMMED_HEADER_OFFSET, RECORD_HEADER_SIZE - RECORD_CHECKSUMMED_HEADER_OFFSET);
+	crc = ExtendCrc32c(crc, _pName.data(), _pName.size());
+	crc = ExtendCrc32c(crc, _pData, _pLength);
+	StoreBigEndian(header + 4, ~crc, 4);
+
+	iovec iov[3];
+	iov[0].iov_base = header;
+	iov[0].iov_len = sizeof(header);
+	iov[1].iov_base = const_cast<char*>(_pName.data());
+	iov[1].iov_len = _pName.size();
+	iov[2].iov_base = const_cast<char*>(_pData);
+	iov[2].iov_len = _pLength;
+	if (!WriteFullyAt(active->fd, iov, _pLength > 0 ? 3 : 2, active->size) ||
+	    (_Options.syncWrites && fdatasync(active->fd) != 0)) {
+		std::cerr << "[STORAGE] Append to " << segmentPath(_ActiveSegment) << " failed: " << std::strerror(errno) << std::endl;
+		// Drop the partial record so that the next append does not land behind it
+		if (ftruncate(active->fd, static_cast<off_t>(active->size)) != 0)
+			std::cerr << "[STORAGE] Cannot trim " << segmentPath(_ActiveSegment) << ": " << std::strerror(errno) << std::endl;
+		return false;
+	}
+
+	_pLocation.segment = _ActiveSegment;
+	_pLocation.offset = active->size;
+	_pLocation.length = _pLength;
+	active->size += size;
+	return true;
+}
+
+
+bool LogStorageEngine::startSegment(uint32_t _pId)
+{
+	int fd = open(segmentPath(_pId).c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return false;
+	if (_Options.syncWrites) {
+		// Make the new file's directory entry durable along with the records written to it
+		int directory = open(_Directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (directory >= 0) {
+			fsync(directory);
+			close(directory);
+		}
+	}
+	std::unique_lock<std::shared_mutex> segmentsLock(_SegmentsMutex);
+	Segment& segment = _Segments[_pId];
+	segment.fd = fd;
+	_ActiveSegment = _pId;
+	return true;
+}
+
+
+void LogStorageEngine::retire(const std::string& _pName, const Location& _pLocation)
+{
+	auto segment = _Segments.find(_pLocation.segment);
+	if (segment != _Segments.end())
+		segment->second.liveBytes -= RecordSize(_pName.size(), _pLocation.length);
+}
+
+
+uint64_t LogStorageEngine::scanSegment(const Segment& _pSegment, const std::function<void(const Record&)>& _pVisit)
+{
+	std::vector<char> buffer;
+	Record record;
+	uint64_t offset = 0;
+	while (_pSegment.size - offset >= RECORD_HEADER_SIZE) {
+		char header[RECORD_HEADER_SIZE];
+		if (!ReadFullyAt(_pSegment.fd, header, sizeof(header), offset) || LoadBigEndian(header, 4) != RECORD_MAGIC)
+			break;
+		record.type = static_cast<uint8_t>(header[8]);
+		uint64_t nameLength = LoadBigEndian(header + 12, 4);
+		record.valueLength = LoadBigEndian(header + 16, 8);
+		uint64_t remaining = _pSegment.size - offset - RECORD_HEADER_SIZE;
+		if ((record.type != RECORD_PUT && record.type != RECORD_DELETE) || nameLength > MAX_NAME_LENGTH ||
+		    nameLength > remaining || record.valueLength > remaining - nameLength)
+			break;
+
+		record.name.resize(nameLength);
+		if (!ReadFullyAt(_pSegment.fd, &record.name[0], nameLength, offset + RECORD_HEADER_SIZE))
+			break;
+		uint32_t crc = ExtendCrc32c(0xFFFFFFFF, header + RECORD_CHECKSUMMED_HEADER_OFFSET, RECORD_HEADER_SIZE - RECORD_CHECKSUMMED_HEADER_OFFSET);
+		crc = ExtendCrc32c(crc, record.name.data(), record.name.size());
+		uint64_t valueOffset = offset + RECORD_HEADER_SIZE + nameLength;
+		bool readable = true;
+		for (uint64_t done = 0; done < record.valueLength; ) {
+			size_t chunk = static_cast<size_t>(std::min<uint64_t>(SCAN_BUFFER_SIZE, record.valueLength - done));
+			buffer.resize(chunk);
+			if (!ReadFullyAt(_pSegment.fd, buffer.data(), chunk, valueOffset + done)) {
+				readable = false;
+				break;
+			}
+			crc = ExtendCrc32c(crc, buffer.data(), chunk);
+			done += chunk;
+		}
+		if (!readable || ~crc != static_cast<uint32_t>(LoadBigEndian(header + 4, 4)))
+			break;
+
+		record.offset = offset;
+		record.size = RecordSize(nameLength, record.valueLength);
+		_pVisit(record);
+		offset += record.size;
+	}
+	return offset;
+}
+
+
+bool LogStorageEngine::readValue(const Location& _pLocation, size_t _pNameLength, uint64_t _pOffset, uint64_t _pLength, std::string& _pContent)
+{
+	int fd = -1;
+	{
+		std::shared_lock<std::shared_mutex> segmentsLock(_SegmentsMutex);
+		auto segment = _Segments.find(_pLocation.segment);
+		if (segment != _Segments.end())
+			fd = segment->second.fd;
+	}
+	_pContent.resize(_pLength);
+	if (fd < 0 ||
+	    !ReadFullyAt(fd, &_pContent[0], _pLength, _pLocation.offset + RECORD_HEADER_SIZE + _pNameLength + _pOffset)) {
+		std::cerr << "[STORAGE] Cannot read " << segmentPath(_pLocation.segment) << ": " << std::strerror(errno) << std::endl;
+		_pContent.clear();
+		return false;
+	}
+	return true;
+}
+
+
+std::string LogStorageEngine::segmentPath(uint32_t _pId) const
+{
+	char name[16];
+	std::snprintf(name, sizeof(name), "%08u.seg", _pId);
+	return _Directory + "/" + name;
+}
@@ -0,0 +1,153 @@
+#pragma once
+#ifndef _SIMPLIDFS_LOGSTORAGEENGINE_H
+#define _SIMPLIDFS_LOGSTORAGEENGINE_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include "storageengine.h"
+
+/** @brief Size at which LogStorageEngine starts a new segment file by default. */
+const uint64_t DEFAULT_LOG_SEGMENT_SIZE = 64ull * 1024 * 1024;
+
+/**
+ * @brief Tuning for a LogStorageEngine.
+ */
+struct LogStorageOptions {
+    /** @brief A new segment is started once a record would take the active one past this size. */
+    uint64_t segmentSize = DEFAULT_LOG_SEGMENT_SIZE;
+    /** @brief fdatasync every record before the call returns. Without it a process crash loses
+     *         nothing, but a power failure may lose the most recent writes. */
+    bool syncWrites = false;
+    /** @brief Number of independently locked shards the in-memory index is split into. */
+    size_t indexShards = DEFAULT_STORAGE_SHARD_COUNT;
+};
+
+/**
+ * @brief Space and recovery counters of a LogStorageEngine.
+ */
+struct LogStorageStats {
+    size_t files = 0;               ///< Files currently stored.
+    size_t segments = 0;            ///< Segment files on disk.
+    uint64_t totalBytes = 0;        ///< Size of all segment files.
+    uint64_t liveBytes = 0;         ///< Bytes of the records that hold current content; the rest is garbage until compact().
+    uint64_t recoveredRecords = 0;  ///< Records replayed when the engine was opened.
+    uint64_t truncatedBytes = 0;    ///< Bytes of torn or corrupt records cut off when the engine was opened.
+};
+
+/**
+ * @brief Stores files on disk as records appended to segment files.
+ *
+ * Every create, write and delete appends one checksummed record to the active
+ * segment in the engine's directory (00000001.seg, 00000002.seg, ...); nothing on
+ * disk is modified in place. An in-memory index maps each filename to the segment,
+ * offset and length of its latest content, and reads fetch it with pread. Opening
+ * a directory replays its segments in order to rebuild the index, cutting off a
+ * torn record left at the end of a segment by a crash.
+ *
+ * Overwritten and deleted content stays in its segment until compact() copies the
+ * live records of mostly-garbage segments forward and removes those files.
+ *
+ * The index is lock-striped by filename (ShardedFileMap). Reads hold their shard's lock
+ * shared while they pread, so reads of any files run in parallel; writes hold it
+ * exclusively and serialize only on the append itself. compact() takes every shard.
+ */
+class LogStorageEngine : public StorageEngine {
+public:
+    /**
+     * @brief Opens, or creates, a log in the given directory and recovers its content.
+     * @param _pDirectory Directory holding the segment files. Created if missing.
+     * @param _pOptions Segment size and durability settings.
+     * @throw std::runtime_error if the directory or a segment cannot be opened.
+     */
+    explicit LogStorageEngine(const std::string& _pDirectory, const LogStorageOptions& _pOptions = LogStorageOptions());
+    ~LogStorageEngine() override;
+
+    LogStorageEngine(const LogStorageEngine&) = delete;
+    LogStorageEngine& operator=(const LogStorageEngine&) = delete;
+
+    bool create(const std::string& _pName) override;
+    bool write(const std::string& _pName, const std::string& _pContent) override;
+    bool write(const std::string& _pName, std::string&& _pContent) override;
+    bool read(const std::string& _pName, std::string& _pContent) override;
+    /** @brief Reads only the requested bytes from the file's record. */
+    bool readRange(const std::string& _pName, uint64_t _pOffset, uint64_t _pLength, std::string& _pContent) override;
+    /** @brief Like append and truncate, appends the whole changed file as a new record. */
+    bool writeAt(const std::string& _pName, uint64_t _pOffset, const std::string& _pData) override;
+    bool append(const std::string& _pName, const std::string& _pData, uint64_t _pMaxSize) override;
+    bool truncate(const std::string& _pName, uint64_t _pSize) override;
+    bool remove(const std::string& _pName) override;
+
+    /**
+     * @brief Rewrites sealed segments whose live records fill at most the given fraction of them.
+     * Their live records are appended to the active segment and the old files are deleted.
+     * @param _pMaxLiveFraction Segments with more live data than this are left alone.
+     * @return The number of segment files removed.
+     */
+    size_t compact(double _pMaxLiveFraction = 0.5);
+
+    /** @brief Returns a snapshot of the space and recovery counters. */
+    LogStorageStats getStats();
+
+private:
+    /** @brief Where the latest record of a file starts, and the length of its content. */
+    struct Location {
+        uint32_t segment = 0;
+        uint64_t offset = 0;
+        uint64_t length = 0;
+    };
+
+    /** @brief An open segment file. */
+    struct Segment {
+        int fd = -1;
+        uint64_t size = 0;      ///< Bytes of valid records; appends go here.
+        uint64_t liveBytes = 0; ///< Bytes of the records the index still points at.
+    };
+
+    /** @brief A record found while scanning a segment. */
+    struct Record {
+        uint8_t type = 0;
+        std::string name;
+        uint64_t offset = 0;      ///< Start of the record in its segment.
+        uint64_t valueLength = 0;
+        uint64_t size = 0;        ///< Header, name and value.
+    };
+
+    typedef ShardedFileMap<Location> Index;
+    typedef std::unordered_map<std::string, Location> IndexEntries;
+
+    void recover();
+    bool put(const std::string& _pName, const char* _pData, uint64_t _pLength, bool _pMustExist);
+    bool update(const std::string& _pName, const std::function<bool(std::string&)>& _pChange);
+    bool store(Index::Shard& _pShard, IndexEntries::iterator _pEntry, const std::string& _pName, const char* _pData, uint64_t _pLength);
+    bool appendRecord(uint8_t _pType, const std::string& _pName, const char* _pData, uint64_t _pLength, Location& _pLocation);
+    bool startSegment(uint32_t _pId);
+    void retire(const std::string& _pName, const Location& _pLocation);
+    uint64_t scanSegment(const Segment& _pSegment, const std::function<void(const Record&)>& _pVisit);
+    bool readValue(const Location& _pLocation, size_t _pNameLength, uint64_t _pOffset, uint64_t _pLength, std::string& _pContent);
+    std::string segmentPath(uint32_t _pId) const;
+
+    std::string _Directory;
+    LogStorageOptions _Options;
+    std::map<uint32_t, Segment> _Segments;           ///< Open segments by ID, oldest first.
+    uint32_t _ActiveSegment = 0;                     ///< The newest segment, which receives appends.
+    Index _Index;                                    ///< Latest record of every file, striped by name.
+    uint64_t _RecoveredRecords = 0;
+    uint64_t _TruncatedBytes = 0;
+
+    // Locks are taken in this order: index shard(s), then _AppendMutex, then _SegmentsMutex.
+    // A segment is only removed while every shard is held, so a reader holding its shard
+    // can use the segment its location points at.
+
+    /** @brief Serializes appends and guards the active segment and every segment's size and live bytes. */
+    std::mutex _AppendMutex;
+
+    /** @brief Guards the shape of _Segments: shared to look up a segment's descriptor, exclusive to add or remove one. */
+    std::shared_mutex _SegmentsMutex;
+};
+
+#endif
@@ -5,7 +5,24 @@
 #include <string>
 #include <vector>   // Not strictly needed for these specific implementations, but good for general message handling
 #include <sstream>  // For std::ostringstream, std::istringstream
-#include <stdexcept> // For std::runtime_error, std::invalid_argument, std::out_of_range
+#include <stdexcept> // For std::runtime_error, std::invalid_argument, std::out_of_range, std::length_error
+#include <cstdint>  // For uint8_t, uint32_t
+#include <algorithm> // For std::min
+#include <charconv> // For std::from_chars
+#include <string_view> // For MessageView fields
+#include <cstring>  // For memchr
+#include "delimiterscan.h"
+
+/** @brief Wire version of the legacy pipe-delimited text format produced by Message::Serialize. */
+const uint8_t MESSAGE_PROTOCOL_TEXT = 0;
+/** @brief Wire version of the binary format produced by Message::SerializeBinary. */
+const uint8_t MESSAGE_PROTOCOL_BINARY_V1 = 1;
+/**
+ * @brief Highest wire version this build understands.
+ * Binary versions are kept below '0' so that the first byte of an encoded message
+ * distinguishes them from the text format, whose first byte is a decimal digit.
+ */
+const uint8_t MESSAGE_PROTOCOL_VERSION = MESSAGE_PROTOCOL_BINARY_V1;
 
 /**
  * @brief Defines the types of messages that can be exchanged within the SimpliDFS system.
@@ -27,9 +44,32 @@ enum class MessageType{
 	ReplicateFileCommand,   ///< Command from MetaServer to a source Node to replicate a file to another Node. _Filename (file to replicate), _NodeAddress (target node's address:port), _Content (source node ID for logging/confirmation by target) required.
 	ReceiveFileCommand,     ///< Command from MetaServer to a destination Node to expect a file from another Node. _Filename (file to receive), _NodeAddress (source node's address:port), _Content (target node ID for logging/confirmation by source) required.
     // Client to MetaServer, MetaServer to Node
-	DeleteFile              ///< Request to delete a file. _Filename required.
+	DeleteFile,             ///< Request to delete a file. _Filename required.
+    // Any peer to any peer
+	Hello,                  ///< Protocol version handshake. _Content carries the sender's highest wire version, optionally followed by a space and the comma-separated compression codecs it accepts. Always sent in the text format.
+    // Client to MetaServer, MetaServer to Node. Offsets and sizes are decimal numbers; see ParseMessageNumber.
+    // The MetaServer answers ReadFileRange, WriteFileAt and AppendFile with the chunks involved (see
+    // EncodeChunkRange); to it, _Content of a WriteFileAt or AppendFile carries the number of bytes instead.
+	ReadFileRange,          ///< Request to read part of a file. _Filename, _NodeAddress (offset) and _Content (length) required.
+	WriteFileAt,            ///< Request to overwrite part of a file, extending it if needed. _Filename, _NodeAddress (offset) and _Content (the bytes) required.
+	AppendFile,             ///< Request to add content at the end of a file. _Filename and _Content required.
+	TruncateFile            ///< Request to set the size of a file. _Filename and _Content (the new size) required.
 };
 
+/**
+ * @brief Parses an offset or size carried as a decimal number in a message field.
+ * @param text The field, e.g. the _NodeAddress of a ReadFileRange.
+ * @param value Receives the number.
+ * @return False unless the whole field is a number that fits in 64 bits.
+ */
+inline bool ParseMessageNumber(std::string_view text, uint64_t& value) {
+    const char* end = text.data() + text.size();
+    std::from_chars_result result = std::from_chars(text.data(), end, value);
+    return !text.empty() && result.ec == std::errc() && result.ptr == end;
+}
+
+struct MessageView;
+
 /**
  * @brief Represents a message for communication between components of SimpliDFS.
  * The meaning and usage of _Filename, _Content, _NodeAddress, and _NodePort can vary
@@ -100,6 +140,31 @@ public:
      *       may fail or yield incorrect results. Empty optional fields are handled.
      */
     inline static Message Deserialize(const std::string& data) {
+        return Deserialize(data.data(), data.size());
+    }
+
+    /**
+     * @brief Deserializes the text format straight from a buffer.
+     * Copies the fields of MessageView::Deserialize, which locates the four field delimiters in
+     * a single DelimiterScan pass and reads the numbers with std::from_chars. Results and error messages are the same as those of
+     * DeserializeWithStreams, including its quirks: NodePort runs to the first newline and
+     * may itself contain '|', and a field that would start at the very end of the data
+     * counts as missing.
+     * @param data Pointer to the encoded bytes.
+     * @param size Number of encoded bytes.
+     * @return A Message object.
+     * @throw std::runtime_error as Deserialize(const std::string&).
+     */
+    inline static Message Deserialize(const char* data, size_t size);
+
+    /**
+     * @brief The original istringstream-based parser for the text format.
+     * Kept as the reference Deserialize is tested and benchmarked against; use Deserialize instead.
+     * @param data The string data to deserialize.
+     * @return A Message object.
+     * @throw std::runtime_error as Deserialize.
+     */
+    inline static Message DeserializeWithStreams(const std::string& data) {
         std::istringstream iss(data);
         std::string token;
         Message msg{}; // Value-initialize (NodePort = 0, strings empty)
@@ -160,6 +225,329 @@ public:
         }
         return msg;
     }
+
+    /**
+     * @brief Serializes a Message object into the compact binary wire format.
+     * The format is: Version(1 byte) Type(varint) FilenameLength(varint) Filename
+     * ContentLength(varint) Content NodeAddressLength(varint) NodeAddress NodePort(varint).
+     * Varints are unsigned LEB128. Strings are copied as raw bytes, so any content,
+     * including '|' and NUL characters, round-trips unchanged.
+     * @param msg The Message object to serialize.
+     * @return A string holding the encoded bytes.
+     * @throw std::length_error if a field is 4 GiB or longer, which its length prefix cannot hold.
+     */
+    inline static std::string SerializeBinary(const Message& msg) {
+        std::string out;
+        out.reserve(1 + 4 * 5 + msg._Filename.size() + msg._Content.size() + msg._NodeAddress.size());
+        out.push_back(static_cast<char>(MESSAGE_PROTOCOL_BINARY_V1));
+        AppendVarint(out, static_cast<uint32_t>(msg._Type));
+        AppendField(out, msg._Filename, "Filename");
+        AppendField(out, msg._Content, "Content");
+        AppendField(out, msg._NodeAddress, "NodeAddress");
+        AppendVarint(out, static_cast<uint32_t>(msg._NodePort));
+        return out;
+    }
+
+    /**
+     * @brief Deserializes a message encoded by SerializeBinary.
+     * @param data Pointer to the encoded bytes.
+     * @param size Number of encoded bytes.
+     * @return A Message object.
+     * @throw std::runtime_error if the version byte is unsupported or the data is truncated.
+     */
+    inline static Message DeserializeBinary(const char* data, size_t size);
+
+    inline static Message DeserializeBinary(const std::string& data) {
+        return DeserializeBinary(data.data(), data.size());
+    }
+
+    /**
+     * @brief Encodes a message using the given wire version.
+     * @param msg The Message object to encode.
+     * @param version MESSAGE_PROTOCOL_TEXT for the legacy format, otherwise the binary format.
+     * @return The encoded message.
+     */
+    inline static std::string Encode(const Message& msg, uint8_t version) {
+        if (version == MESSAGE_PROTOCOL_TEXT) {
+            return Serialize(msg);
+        }
+        return SerializeBinary(msg);
+    }
+
+    /**
+     * @brief Decodes a message in either wire format, detected from its first byte.
+     * @param data Pointer to the encoded bytes.
+     * @param size Number of encoded bytes.
+     * @return A Message object.
+     * @throw std::runtime_error if the data cannot be parsed.
+     */
+    inline static Message Decode(const char* data, size_t size);
+
+    inline static Message Decode(const std::string& data) {
+        return Decode(data.data(), data.size());
+    }
+
+    /**
+     * @brief Copies a decoded MessageView into a Message that owns its fields.
+     * @param view The view to copy.
+     * @return A Message object.
+     */
+    inline static Message FromView(const MessageView& view);
+
+    /**
+     * @brief Returns the wire version of an encoded message.
+     * Anything that does not start with a known binary version byte is treated as text.
+     */
+    inline static uint8_t GetWireVersion(const char* data, size_t size) {
+        if (size > 0 && static_cast<uint8_t>(data[0]) == MESSAGE_PROTOCOL_BINARY_V1) {
+            return MESSAGE_PROTOCOL_BINARY_V1;
+        }
+        return MESSAGE_PROTOCOL_TEXT;
+    }
+
+    /**
+     * @brief Builds the Hello message announcing this build's highest wire version.
+     * Hello is always encoded with Serialize so that text-only peers can parse it.
+     * @param codecs Comma-separated frame compression codecs the sender accepts, best first
+     *               (see Networking::GetSupportedCodecs). Omitted when empty; older peers
+     *               read only the version in front of it.
+     */
+    inline static Message CreateHello(const std::string& codecs = std::string()) {
+        Message hello{};
+        hello._Type = MessageType::Hello;
+        hello._Content = std::to_string(MESSAGE_PROTOCOL_VERSION);
+        if (!codecs.empty()) {
+            hello._Content += " " + codecs;
+        }
+        return hello;
+    }
+
+    /**
+     * @brief Returns the compression codecs a peer advertised in its Hello.
+     * @param reply The peer's Hello.
+     * @return The comma-separated codec names, or an empty string if the peer sent none
+     *         or the reply is not a Hello.
+     */
+    inline static std::string GetHelloCodecs(const Message& reply) {
+        if (reply._Type != MessageType::Hello) {
+            return std::string();
+        }
+        size_t separator = reply._Content.find(' ');
+        if (separator == std::string::npos) {
+            return std::string();
+        }
+        return reply._Content.substr(separator + 1);
+    }
+
+    /**
+     * @brief Picks the wire version to use with a peer from its Hello reply.
+     * @param reply The peer's reply to our Hello. Peers that predate the handshake answer
+     *              with something other than a Hello, which selects the text format.
+     * @return The highest version both sides understand.
+     */
+    inline static uint8_t NegotiateVersion(const Message& reply) {
+        if (reply._Type != MessageType::Hello || reply._Content.empty()) {
+            return MESSAGE_PROTOCOL_TEXT;
+        }
+        int peerVersion = 0;
+        try {
+            peerVersion = std::stoi(reply._Content);
+        } catch (const std::exception&) {
+            return MESSAGE_PROTOCOL_TEXT;
+        }
+        if (peerVersion < 0) {
+            return MESSAGE_PROTOCOL_TEXT;
+        }
+        return static_cast<uint8_t>(std::min<int>(peerVersion, MESSAGE_PROTOCOL_VERSION));
+    }
+
+private:
+    inline static void AppendVarint(std::string& out, uint32_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    /** @brief Appends a field's length prefix and bytes, refusing lengths the prefix would cut off. */
+    inline static void AppendField(std::string& out, const std::string& field, const char* name) {
+        if (field.size() > UINT32_MAX) {
+            throw std::length_error(std::string("SerializeBinary error: ") + name + " of " + std::to_string(field.size()) +
+                                    " bytes exceeds the 4 GiB field limit.");
+        }
+        AppendVarint(out, static_cast<uint32_t>(field.size()));
+        out.append(field);
+    }
 };
 
+/**
+ * @brief A decoded message whose string fields point into the buffer it was decoded from.
+ * Decoding into a MessageView copies none of the payload, so a handler can look at a request
+ * and copy only what it keeps, such as content written to storage. The fields have the same
+ * meaning as in Message and are valid only as long as the decoded buffer is.
+ */
+struct MessageView {
+    MessageType _Type{};            ///< The type of the message.
+    std::string_view _Filename;     ///< See Message::_Filename.
+    std::string_view _Content;      ///< See Message::_Content.
+    std::string_view _NodeAddress;  ///< See Message::_NodeAddress.
+    int _NodePort = 0;              ///< See Message::_NodePort.
+
+public:
+    /**
+     * @brief Parses the legacy text format without copying its fields.
+     * Accepts and rejects exactly what Message::Deserialize does.
+     * @param data Pointer to the encoded bytes, which must outlive the view.
+     * @param size Number of encoded bytes.
+     * @return A view into data.
+     * @throw std::runtime_error as Message::Deserialize.
+     */
+    inline static MessageView Deserialize(const char* data, size_t size) {
+        if (size == 0) {
+            throw std::runtime_error("Deserialize error: Message stream empty or type missing. Data: ''");
+        }
+        // Anything past the fourth delimiter belongs to NodePort, so the scan can stop there
+        size_t delimiters[4];
+        size_t found = DelimiterScan::Find(data, size, '|', delimiters, 4);
+        MessageView view;
+
+        // Type
+        view._Type = static_cast<MessageType>(ParseTextInt(data, data + (found > 0 ? delimiters[0] : size),
+                                                           "Invalid message type format", "Message type value out of range"));
+
+        // Filename, Content and NodeAddress each start after a delimiter. Like std::getline, a field
+        // cannot start at the end of the data, so a trailing delimiter does not make it present.
+        static const char* const missingField[] = {
+            "type. Expected Filename", "Filename. Expected Content", "Content. Expected NodeAddress"};
+        std::string_view* const fields[] = {&view._Filename, &view._Content, &view._NodeAddress};
+        for (size_t field = 0; field < 3; ++field) {
+            if (field >= found || delimiters[field] + 1 == size) {
+                throw std::runtime_error(std::string("Deserialize error: Message stream ended prematurely after ") +
+                                         missingField[field] + ". Data: '" + std::string(data, size) + "'");
+            }
+            size_t begin = delimiters[field] + 1;
+            size_t end = field + 1 < found ? delimiters[field + 1] : size;
+            *fields[field] = std::string_view(data + begin, end - begin);
+        }
+
+        // NodePort (last field) is read up to the first newline; absent or empty leaves it at 0
+        if (found == 4 && delimiters[3] + 1 < size) {
+            const char* port = data + delimiters[3] + 1;
+            const char* portEnd = static_cast<const char*>(std::memchr(port, '\n', static_cast<size_t>(data + size - port)));
+            if (portEnd == nullptr) {
+                portEnd = data + size;
+            }
+            if (port != portEnd) {
+                view._NodePort = ParseTextInt(port, portEnd, "Invalid NodePort format", "NodePort value out of range");
+            }
+        }
+        return view;
+    }
+
+    /**
+     * @brief Parses the binary format without copying its fields.
+     * @param data Pointer to the encoded bytes, which must outlive the view.
+     * @param size Number of encoded bytes.
+     * @return A view into data.
+     * @throw std::runtime_error as Message::DeserializeBinary.
+     */
+    inline static MessageView DeserializeBinary(const char* data, size_t size) {
+        const char* end = data + size;
+        if (size == 0 || static_cast<uint8_t>(*data) != MESSAGE_PROTOCOL_BINARY_V1) {
+            throw std::runtime_error("Deserialize error: Unsupported binary message version.");
+        }
+        const char* cursor = data + 1;
+        MessageView view;
+        view._Type = static_cast<MessageType>(ReadVarint(cursor, end));
+        view._Filename = ReadLengthPrefixed(cursor, end);
+        view._Content = ReadLengthPrefixed(cursor, end);
+        view._NodeAddress = ReadLengthPrefixed(cursor, end);
+        view._NodePort = static_cast<int>(ReadVarint(cursor, end));
+        return view;
+    }
+
+    /**
+     * @brief Decodes either wire format, detected from the first byte, without copying its fields.
+     * @param data Pointer to the encoded bytes, which must outlive the view.
+     * @param size Number of encoded bytes.
+     * @return A view into data.
+     * @throw std::runtime_error if the data cannot be parsed.
+     */
+    inline static MessageView Decode(const char* data, size_t size) {
+        if (Message::GetWireVersion(data, size) == MESSAGE_PROTOCOL_TEXT) {
+            return Deserialize(data, size);
+        }
+        return DeserializeBinary(data, size);
+    }
+
+private:
+    /**
+     * @brief Reads a decimal int the way std::stoi does, trailing characters included.
+     * std::from_chars handles the common case; leading whitespace, a '+' sign and every
+     * error go through std::stoi so values and messages match Message::DeserializeWithStreams.
+     */
+    inline static int ParseTextInt(const char* begin, const char* end, const char* invalidMessage, const char* rangeMessage) {
+        int value = 0;
+        if (std::from_chars(begin, end, value).ec == std::errc()) {
+            return value;
+        }
+        std::string token(begin, end);
+        try {
+            return std::stoi(token);
+        } catch (const std::invalid_argument& ia) {
+            throw std::runtime_error(std::string("Deserialize error: ") + invalidMessage + " '" + token + "'. " + std::string(ia.what()));
+        } catch (const std::out_of_range& oor) {
+            throw std::runtime_error(std::string("Deserialize error: ") + rangeMessage + " '" + token + "'. " + std::string(oor.what()));
+        }
+    }
+
+    inline static uint32_t ReadVarint(const char*& cursor, const char* end) {
+        uint32_t value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (cursor == end) {
+                throw std::runtime_error("Deserialize error: Binary message truncated inside a varint.");
+            }
+            uint8_t byte = static_cast<uint8_t>(*cursor++);
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        throw std::runtime_error("Deserialize error: Binary message varint is too long.");
+    }
+
+    inline static std::string_view ReadLengthPrefixed(const char*& cursor, const char* end) {
+        uint32_t length = ReadVarint(cursor, end);
+        if (static_cast<size_t>(end - cursor) < length) {
+            throw std::runtime_error("Deserialize error: Binary message field exceeds message length.");
+        }
+        std::string_view field(cursor, length);
+        cursor += length;
+        return field;
+    }
+};
+
+inline Message Message::FromView(const MessageView& view) {
+    Message msg{};
+    msg._Type = view._Type;
+    msg._Filename.assign(view._Filename.data(), view._Filename.size());
+    msg._Content.assign(view._Content.data(), view._Content.size());
+    msg._NodeAddress.assign(view._NodeAddress.data(), view._NodeAddress.size());
+    msg._NodePort = view._NodePort;
+    return msg;
+}
+
+inline Message Message::Deserialize(const char* data, size_t size) {
+    return FromView(MessageView::Deserialize(data, size));
+}
+
+inline Message Message::DeserializeBinary(const char* data, size_t size) {
+    return FromView(MessageView::DeserializeBinary(data, size));
+}
+
+inline Message Message::Decode(const char* data, size_t size) {
+    return FromView(MessageView::Decode(data, size));
+}
+
 #endif // _SIMPLIDFS_MESSAGE_H
@@ -27,67 +27,132 @@
 Networking::Server server(50505);
 MetadataManager metadataManager;
 
-void HandleClientConnection(Networking::ClientConnection _pClient)
+void HandleClientConnection(Networking::ClientConnection _pClient, const std::vector<char>& received_vector)
 {
     try {
-        std::vector<char> received_vector = server.Receive(_pClient);
         if (received_vector.empty()) {
             // Handle empty receive, maybe client disconnected or sent no data
             std::cerr << "Received empty data from client." << std::endl;
             // Depending on server logic, might want to close connection or return
             return; 
         }
-        std::string received_data_str(received_vector.begin(), received_vector.end());
-        Message request = Message::Deserialize(received_data_str);
+        // Accepts both the legacy text format and the binary format. The fields point into
+        // received_vector; only what the MetadataManager keeps is copied.
+        MessageView request = MessageView::Decode(received_vector.data(), received_vector.size());
+        std::string filename(request._Filename);
         bool shouldSave = false;
         switch (request._Type)
     {
     case MessageType::CreateFile:
     {
         std::vector<std::string> nodes; // preferred nodes could be part of message
-        metadataManager.addFile(request._Filename, nodes);
+        metadataManager.addFile(filename, nodes);
         shouldSave = true;
+        server.SendFrame("Create command processed.", _pClient);
         break;
     }
 
     case MessageType::ReadFile:
+    case MessageType::WriteFile:
     {
-        std::vector<std::string> nodes = metadataManager.getFileNodes(request._Filename);
+        // Tell the client which nodes to send the data request to
+        std::vector<std::string> nodes = metadataManager.getFileNodes(filename);
+        std::string nodeList;
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            nodeList += (i == 0 ? "" : std::string(1, NODE_LIST_SEPARATOR)) + nodes[i];
+        }
+        server.SendFrame(nodeList, _pClient);
         break;
     }
-
-    case MessageType::WriteFile:
+    case MessageType::ReadFileRange:
+    {
+        // Answer the chunks the range lies in, so the client can address each one on its nodes
+        uint64_t offset = 0, length = 0;
+        if (!ParseMessageNumber(request._NodeAddress, offset) || !ParseMessageNumber(request._Content, length)) {
+            server.SendFrame("Error: Invalid range.", _pClient);
+            break;
+        }
+        server.SendFrame(EncodeChunkRange(metadataManager.getChunkRange(filename, offset, length)), _pClient);
+        break;
+    }
+    case MessageType::WriteFileAt:
+    case MessageType::AppendFile:
     {
-        std::vector<std::string> nodes = metadataManager.getFileNodes(request._Filename);
+        // A write past the end grows the file first, so the chunks it needs exist in the reply
+        uint64_t offset = 0, length = 0;
+        bool isAppend = request._Type == MessageType::AppendFile;
+        if ((!isAppend && !ParseMessageNumber(request._NodeAddress, offset)) || !ParseMessageNumber(request._Content, length)) {
+            server.SendFrame("Error: Invalid range.", _pClient);
+            break;
+        }
+        ChunkRange range;
+        bool withinLimit = isAppend ? metadataManager.prepareAppend(filename, length, range)
+                                    : metadataManager.prepareWrite(filename, offset, length, range);
+        if (!withinLimit) {
+            server.SendFrame("Error: Size exceeds maximum file size.", _pClient);
+            break;
+        }
+        server.SendFrame(EncodeChunkRange(range), _pClient);
+        shouldSave = true;
+        break;
+    }
+    case MessageType::TruncateFile:
+    {
+        uint64_t size = 0;
+        if (!ParseMessageNumber(request._Content, size)) {
+            server.SendFrame("Error: Invalid size.", _pClient);
+            break;
+        }
+        if (size > metadataManager.getMaxFileSize()) {
+            server.SendFrame("Error: Size exceeds maximum file size.", _pClient);
+            break;
+        }
+        metadataManager.resizeFile(filename, size); // Allocates or releases chunks
+        server.SendFrame("Truncate command processed.", _pClient);
+        shouldSave = true;
         break;
     }
     case MessageType::RegisterNode:
     {
         // Assuming _Filename carries nodeIdentifier, _NodeAddress carries IP, and _NodePort carries port
-        metadataManager.registerNode(request._Filename, request._NodeAddress, request._NodePort);
+        metadataManager.registerNode(filename, std::string(request._NodeAddress), request._NodePort);
         shouldSave = true;
         // Send a confirmation response back to the node
-        server.Send("Node registered successfully", _pClient); // Actual send call
+        server.SendFrame("Node registered successfully", _pClient); // Actual send call
         std::cout << "Sent registration confirmation to node " << request._Filename << std::endl; // Placeholder
         break;
     }
     case MessageType::Heartbeat:
     {
-        metadataManager.processHeartbeat(request._Filename); // _Filename contains nodeIdentifier
+        metadataManager.processHeartbeat(filename); // _Filename contains nodeIdentifier
         // For heartbeats, saving metadata might be too frequent.
         // Node liveness changes are saved by checkForDeadNodes if it's called and modifies state.
         // shouldSave = false; // Or true if every heartbeat should force a save of NodeInfo
+        // With keep-alive the connection stays open, so the node waits for this reply
+        server.SendFrame("Heartbeat acknowledged.", _pClient);
         break;
     }
     case MessageType::DeleteFile: {
         std::cout << "[METASERVER] Received DeleteFile request for " << request._Filename << std::endl;
-        metadataManager.removeFile(request._Filename); // This will trigger notifications
-        server.Send("Delete command processed.", _pClient);
+        metadataManager.removeFile(filename); // This will trigger notifications
+        server.SendFrame("Delete command processed.", _pClient);
         std::cout << "[METASERVER_STUB] Sent DeleteFile command processed confirmation." << std::endl;
         shouldSave = true; // Ensure metadata is saved
         break;
     }
+    case MessageType::Hello:
+    {
+        // Answer in the text format so that peers of any version can read it
+        server.SendFrame(Message::Serialize(Message::CreateHello(Networking::GetSupportedCodecs())), _pClient);
+        break;
+    }
     // Add cases for other metadata-modifying operations like RemoveFile if they exist
+    default:
+    {
+        // Every request gets a reply, or a keep-alive client would wait for one forever
+        server.SendFrame("Unknown request type.", _pClient);
+        break;
+    }
     }
 
     if (shouldSave) {
@@ -99,36 +164,47 @@ void HandleClientConnection(Networking::ClientConnection _pClient)
         // server.DisconnectClient(_pClient); // Or similar cleanup
     } catch (const std::runtime_error& re) {
         std::cerr << "Runtime error (e.g., deserialization) in HandleClientConnection: " << re.what() << std::endl;
-        server.Send("Error: Malformed message.", _pClient); // Optional: inform client
+        server.SendFrame("Error: Malformed message.", _pClient); // Optional: inform client
+    } catch (const std::exception& e) {
+        std::cerr << "Error handling request in HandleClientConnection: " << e.what() << std::endl;
+        server.SendFrame("Error: Request failed.", _pClient);
     }
 }
 
-int main()
+int main(int argc, char* argv[])
 {
+    // Optional: --mode blocking|epoll|uring selects how client connections are serviced,
+    // --workers N sets the size of the request thread pool and --listeners N
+    // spreads accepting over N SO_REUSEPORT listeners in epoll or uring mode
+    Networking::ServerMode serverMode = Networking::ServerMode::Blocking;
+    size_t workerCount = 0; // One per hardware thread
+    size_t listenerCount = 1;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--mode") {
+            serverMode = Networking::ParseServerMode(argv[++i]);
+        } else if (std::string(argv[i]) == "--workers") {
+            workerCount = std::stoul(argv[++i]);
+        } else if (std::string(argv[i]) == "--listeners") {
+            listenerCount = std::stoul(argv[++i]);
+        }
+    }
+
     // Load metadata at startup
     // Using global constants defined in metaserver.h for paths
     metadataManager.loadMetadata("file_metadata.dat", "node_registry.dat");
 
     if (server.ServerIsRunning())
     {
-
-        FileSystem fileSystem; // Using FileSystem from filesystem.h to manage file operations
-        while (true)
-        {
-            // Accept a client connection
-
-            Networking::ClientConnection client = server.Accept();
-            std::thread clientThread(HandleClientConnection, client);
-            clientThread.detach();
-
-            // Periodically check for dead nodes (simplified for now)
-            // In a production system, this would be handled by a separate timer thread
-            // or integrated into an event loop more cleanly.
-            // metadataManager.checkForDeadNodes(); 
-            // If checkForDeadNodes modifies data and doesn't save itself, save here:
-            // metadataManager.saveMetadata(FILE_METADATA_PATH, NODE_REGISTRY_PATH);
-            // std::this_thread::sleep_for(std::chrono::seconds(NODE_TIMEOUT_SECONDS / 2)); // Example check interval
-        }
+        // Run accepts connections and hands every received message to HandleClientConnection.
+        // Periodically checking for dead nodes (metadataManager.checkForDeadNodes()) would be
+        // handled by a separate timer thread in a production system.
+        // Nodes keep pooled connections open between heartbeats. Idle connections are cheap
+        // for the event loop but would each hold a worker thread in blocking mode.
+        server.SetKeepAlive(serverMode != Networking::ServerMode::Blocking);
+        // Mass node restarts arrive as a burst of connections, which one accepting thread caps
+        server.SetListenerCount(listenerCount);
+        ThreadPool requestPool(workerCount);
+        server.Run(HandleClientConnection, serverMode, &requestPool);
     }
 
     return 0;
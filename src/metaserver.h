@@ -8,6 +8,7 @@
  */
 #include "filesystem.h" // Included for context, though not directly used in this header
 #include "message.h"    // For Message struct and MessageType enum
+#include "chunk.h"      // For ChunkInfo and chunk storage names
 #include <vector>
 #include <string>
 #include <iostream>
@@ -23,6 +24,10 @@
 const char METADATA_SEPARATOR = '|';
 /** @brief Separator character for lists of nodes in metadata persistence files. */
 const char NODE_LIST_SEPARATOR = ',';
+/** @brief Separator character between the chunks of a file in metadata persistence files. */
+const char CHUNK_LIST_SEPARATOR = ';';
+/** @brief Separator character between a chunk's ID and its node list in metadata persistence files. */
+const char CHUNK_ID_SEPARATOR = ':';
 
 /**
  * @brief Holds information about a registered storage node.
@@ -35,6 +40,100 @@ struct NodeInfo {
     // Potentially other info: capacity, load, etc. could be added here.
 };
 
+/**
+ * @brief Metadata of one file: its size and its chunks in file order.
+ * Chunk i holds bytes [i * chunk size, (i + 1) * chunk size) of the file.
+ */
+struct FileMetadata {
+    uint64_t size = 0;              ///< File size in bytes.
+    std::vector<ChunkInfo> chunks;  ///< Never empty; see GetChunkCount.
+};
+
+/**
+ * @brief The chunks holding a byte range of a file, as the metaserver answers ReadFileRange,
+ *        WriteFileAt and AppendFile.
+ * chunks[i] holds the file bytes from (firstChunk + i) * chunkSize on, so file byte b of the
+ * range lies at offset b - (firstChunk + i) * chunkSize of the chunk's GetChunkStorageName.
+ */
+struct ChunkRange {
+    uint64_t offset = 0;            ///< First byte of the range; for an append, where the data goes.
+    uint64_t chunkSize = 0;         ///< Chunk size of the file; 0 for a file recorded before chunking, held whole by its one chunk.
+    uint64_t firstChunk = 0;        ///< Index in the file of chunks[0].
+    std::vector<ChunkInfo> chunks;  ///< The chunks the range touches, in file order; empty for an empty range.
+
+    bool operator==(const ChunkRange& other) const {
+        return offset == other.offset && chunkSize == other.chunkSize && firstChunk == other.firstChunk && chunks == other.chunks;
+    }
+};
+
+/**
+ * @brief Writes chunks as "id:node,node;id:node", the form used in metadata files and replies.
+ */
+inline std::string EncodeChunkList(const std::vector<ChunkInfo>& chunks) {
+    std::string out;
+    for (size_t c = 0; c < chunks.size(); ++c) {
+        out += (c == 0 ? "" : std::string(1, CHUNK_LIST_SEPARATOR)) + std::to_string(chunks[c].id) + CHUNK_ID_SEPARATOR;
+        for (size_t i = 0; i < chunks[c].replicas.size(); ++i) {
+            out += (i == 0 ? "" : std::string(1, NODE_LIST_SEPARATOR)) + chunks[c].replicas[i];
+        }
+    }
+    return out;
+}
+
+/**
+ * @brief Reads a chunk list written by EncodeChunkList.
+ * @throw std::invalid_argument or std::out_of_range if a chunk ID is not a number.
+ */
+inline std::vector<ChunkInfo> DecodeChunkList(const std::string& text) {
+    std::vector<ChunkInfo> chunks;
+    std::stringstream chunks_ss(text);
+    std::string chunkStr;
+    while (std::getline(chunks_ss, chunkStr, CHUNK_LIST_SEPARATOR)) {
+        size_t idEnd = chunkStr.find(CHUNK_ID_SEPARATOR);
+        ChunkInfo chunk;
+        chunk.id = std::stoull(chunkStr.substr(0, idEnd));
+        std::stringstream nodes_ss(idEnd == std::string::npos ? "" : chunkStr.substr(idEnd + 1));
+        std::string node;
+        while (std::getline(nodes_ss, node, NODE_LIST_SEPARATOR)) {
+            chunk.replicas.push_back(node);
+        }
+        chunks.push_back(std::move(chunk));
+    }
+    return chunks;
+}
+
+/**
+ * @brief Writes a ChunkRange as "offset|chunkSize|firstChunk|chunk list".
+ */
+inline std::string EncodeChunkRange(const ChunkRange& range) {
+    return std::to_string(range.offset) + METADATA_SEPARATOR + std::to_string(range.chunkSize) + METADATA_SEPARATOR +
+           std::to_string(range.firstChunk) + METADATA_SEPARATOR + EncodeChunkList(range.chunks);
+}
+
+/**
+ * @brief Reads a reply written by EncodeChunkRange.
+ * @return False if the text is not a chunk range, e.g. an error reply.
+ */
+inline bool DecodeChunkRange(const std::string& text, ChunkRange& range) {
+    std::stringstream ss(text);
+    std::string offsetStr, chunkSizeStr, firstChunkStr, chunksStr;
+    if (!std::getline(ss, offsetStr, METADATA_SEPARATOR) || !std::getline(ss, chunkSizeStr, METADATA_SEPARATOR) ||
+        !std::getline(ss, firstChunkStr, METADATA_SEPARATOR)) {
+        return false;
+    }
+    std::getline(ss, chunksStr);
+    if (!ParseMessageNumber(offsetStr, range.offset) || !ParseMessageNumber(chunkSizeStr, range.chunkSize) ||
+        !ParseMessageNumber(firstChunkStr, range.firstChunk)) {
+        return false;
+    }
+    try {
+        range.chunks = DecodeChunkList(chunksStr);
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
 /** @brief Timeout in seconds. If a node doesn't send a heartbeat within this period, it's marked as not alive. */
 const int NODE_TIMEOUT_SECONDS = 30; 
 
@@ -43,8 +142,10 @@ const int NODE_TIMEOUT_SECONDS = 30;
  * 
  * This class is responsible for:
  * - Tracking registered storage nodes and their liveness via heartbeats.
- * - Managing file metadata, including which nodes store replicas of each file.
- * - Implementing a replication strategy for file creation and handling node failures.
+ * - Managing file metadata: every file is split into fixed-size chunks, each with its own
+ *   ID and replica set, so a large file spreads over many nodes and is re-replicated
+ *   chunk by chunk when one of them fails.
+ * - Implementing a replication strategy for chunk placement and handling node failures.
  * - Persisting its state (file metadata and node registry) to disk and loading it on startup.
  * All public methods are thread-safe.
  */
@@ -53,24 +154,150 @@ private:
     // Mutex to protect all shared metadata (fileMetadata, registeredNodes). Critical for all operations.
     std::mutex metadataMutex; ///< Mutex ensuring thread-safe access to internal data structures.
     
-    /** @brief Maps filenames to a list of node identifiers that store replicas of the file. */
-    std::unordered_map<std::string, std::vector<std::string>> fileMetadata;
+    /** @brief Maps filenames to their size and ordered chunk list. */
+    std::unordered_map<std::string, FileMetadata> fileMetadata;
     
     /** @brief Maps node identifiers to NodeInfo structs containing details about each registered node. */
     std::unordered_map<std::string, NodeInfo> registeredNodes;
     
-    /** @brief Default number of replicas to create for each file. */
+    /** @brief Default number of replicas to create for each chunk. */
     static const int DEFAULT_REPLICATION_FACTOR = 3;
 
+    /** @brief Size of every chunk but the last one of a file. */
+    uint64_t chunkSize;
+
+    /** @brief ID the next allocated chunk receives. */
+    ChunkId nextChunkId = 1;
+
+    /** @brief Whether a file was recorded before chunking: a single WHOLE_FILE_CHUNK_ID chunk of unknown size. */
+    static bool isWholeFile(const FileMetadata& metadata) {
+        return metadata.chunks.size() == 1 && metadata.chunks[0].id == WHOLE_FILE_CHUNK_ID;
+    }
+
+    /** @brief Number of chunk replicas each node holds, which placement keeps balanced. */
+    std::unordered_map<std::string, size_t> countChunksPerNode() const {
+        std::unordered_map<std::string, size_t> load;
+        for (const auto& file : fileMetadata) {
+            for (const ChunkInfo& chunk : file.second.chunks) {
+                for (const std::string& nodeID : chunk.replicas) {
+                    ++load[nodeID];
+                }
+            }
+        }
+        return load;
+    }
+
+    /**
+     * @brief Picks up to `count` live nodes for a chunk, those holding the fewest chunks first.
+     * @param load Chunks per node; updated with the picks.
+     * @param exclude Nodes that must not be picked, e.g. the chunk's current replicas.
+     */
+    std::vector<std::string> pickChunkReplicas(std::unordered_map<std::string, size_t>& load, const std::vector<std::string>& exclude, size_t count) const {
+        std::vector<std::pair<size_t, std::string>> candidates;
+        for (const auto& entry : registeredNodes) {
+            if (entry.second.isAlive && std::find(exclude.begin(), exclude.end(), entry.first) == exclude.end()) {
+                candidates.push_back({load[entry.first], entry.first});
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        std::vector<std::string> picked;
+        for (size_t i = 0; i < candidates.size() && picked.size() < count; ++i) {
+            picked.push_back(candidates[i].second);
+            ++load[candidates[i].second];
+        }
+        return picked;
+    }
+
+    /** @brief Logs (stubbed) the message telling a node to create or delete its replica of a chunk. */
+    void notifyChunkReplica(MessageType type, const std::string& filename, const ChunkInfo& chunk, const std::string& nodeID) const {
+        Message msg;
+        msg._Type = type;
+        msg._Filename = GetChunkStorageName(filename, chunk.id);
+        msg._Content = filename; // The file the chunk belongs to, for the node's logs
+        std::cout << "[METASERVER_STUB] To " << nodeID << ": " << Message::Serialize(msg) << std::endl;
+    }
+
+
+    /** @brief resizeFile on a file already looked up, with metadataMutex held. */
+    void resizeLocked(const std::string& filename, FileMetadata& metadata, uint64_t newSize) {
+        std::vector<ChunkInfo>& chunks = metadata.chunks;
+        // A file recorded before chunking is one chunk of unknown size holding all of its
+        // bytes, so new chunks could not be placed after them without overlapping
+        if (isWholeFile(metadata)) {
+            throw std::runtime_error("File " + filename + " predates chunking and cannot be resized.");
+        }
+        const size_t chunkCount = GetChunkCount(newSize, chunkSize);
+
+        if (chunkCount > chunks.size()) {
+            std::unordered_map<std::string, size_t> load = countChunksPerNode();
+            std::vector<ChunkInfo> added;
+            while (chunks.size() + added.size() < chunkCount) {
+                ChunkInfo chunk;
+                chunk.replicas = pickChunkReplicas(load, {}, DEFAULT_REPLICATION_FACTOR);
+                if (chunk.replicas.empty()) {
+                    throw std::runtime_error("No live nodes available for new chunks of " + filename);
+                }
+                added.push_back(std::move(chunk));
+            }
+            // IDs are only taken once every chunk has found its nodes
+            for (ChunkInfo& chunk : added) {
+                chunk.id = nextChunkId++;
+                for (const std::string& nodeID : chunk.replicas) {
+                    notifyChunkReplica(MessageType::CreateFile, filename, chunk, nodeID);
+                }
+                chunks.push_back(std::move(chunk));
+            }
+        } else {
+            for (size_t i = chunkCount; i < chunks.size(); ++i) {
+                for (const std::string& nodeID : chunks[i].replicas) {
+                    notifyChunkReplica(MessageType::DeleteFile, filename, chunks[i], nodeID);
+                }
+            }
+            chunks.resize(chunkCount);
+        }
+        metadata.size = newSize;
+        std::cout << "File " << filename << " resized to " << newSize << " bytes in " << chunks.size() << " chunks." << std::endl;
+    }
+
+    /** @brief The chunks holding bytes [offset, end) of a file, clipped to its size; with metadataMutex held. */
+    ChunkRange chunkRangeLocked(const FileMetadata& metadata, uint64_t offset, uint64_t end) const {
+        ChunkRange range;
+        range.offset = offset;
+        if (isWholeFile(metadata)) {
+            // Its one chunk holds every byte, wherever the file ends
+            range.chunks = metadata.chunks;
+            return range;
+        }
+        range.chunkSize = chunkSize;
+        range.firstChunk = offset / chunkSize;
+        end = std::min(end, metadata.size);
+        if (offset < end) {
+            uint64_t lastChunk = (end - 1) / chunkSize;
+            range.chunks.assign(metadata.chunks.begin() + range.firstChunk, metadata.chunks.begin() + lastChunk + 1);
+        }
+        return range;
+    }
+
 public:
     /**
      * @brief Constructs a MetadataManager object.
+     * @param chunkSizeBytes Size in which files are split into chunks.
      * @note Metadata loading from persistence files is typically handled separately after construction (e.g., in main).
      */
-    MetadataManager() {
+    explicit MetadataManager(uint64_t chunkSizeBytes = DEFAULT_CHUNK_SIZE) : chunkSize(chunkSizeBytes) {
         // loadMetadata is called from metaserver.cpp after instantiation
     }
 
+    /** @brief Size in which this manager splits files into chunks. */
+    uint64_t getChunkSize() const {
+        return chunkSize;
+    }
+
+    /** @brief Largest size resizeFile accepts: MAX_CHUNKS_PER_FILE chunks. */
+    uint64_t getMaxFileSize() const {
+        return chunkSize > UINT64_MAX / MAX_CHUNKS_PER_FILE ? UINT64_MAX : chunkSize * MAX_CHUNKS_PER_FILE;
+    }
+
     /**
      * @brief Registers a new storage node or updates information for an existing one.
      * Initializes the node's registration time and last heartbeat time. Marks the node as alive.
@@ -109,93 +336,78 @@ public:
     /**
      * @brief Periodically checks all registered nodes for liveness based on heartbeat timestamps.
      * If a node exceeds `NODE_TIMEOUT_SECONDS` without a heartbeat, it's marked as not alive (`isAlive = false`).
-     * If a node is marked as offline, this method triggers the replica redistribution logic for
-     * any files that had replicas on the failed node.
+     * Every chunk that had a replica on the failed node then gets a new replica on the live node
+     * holding the fewest chunks, copied from one of its surviving replicas, so only the chunks
+     * the node held are copied rather than whole files.
+     * @param currentTime The time to check the heartbeats against; now by default.
      * @note This method should be called periodically by the metaserver's main loop or a dedicated timer thread.
      *       It also handles logging for node timeouts and replica redistribution actions.
      *       Actual network communication to instruct nodes for replication is stubbed with log messages.
      */
-    void checkForDeadNodes() {
+    void checkForDeadNodes(time_t currentTime = time(nullptr)) {
         std::lock_guard<std::mutex> lock(metadataMutex);
-        time_t currentTime = time(nullptr);
         for (auto& entry : registeredNodes) {
             if (entry.second.isAlive && (currentTime - entry.second.lastHeartbeat > NODE_TIMEOUT_SECONDS)) {
                 entry.second.isAlive = false;
-                std::string deadNodeID = entry.first;
-                std::cout << "Node " << deadNodeID << " timed out. Marked as offline." << std::endl;
-                
-                std::cout << "Starting replica redistribution for files on " << deadNodeID << std::endl;
-                std::vector<std::pair<std::string, std::string>> tasks;
+                const std::string failedNodeID = entry.first;
+                std::cout << "Node " << failedNodeID << " timed out. Marked as offline." << std::endl;
+                std::cout << "Starting replica redistribution for chunks on " << failedNodeID << std::endl;
 
-                // Collect tasks: Iterate through fileMetadata to find files hosted on the dead node
-                for (const auto& fileEntry : fileMetadata) {
+                std::unordered_map<std::string, size_t> load = countChunksPerNode();
+                for (auto& fileEntry : fileMetadata) {
                     const std::string& filename = fileEntry.first;
-                    const std::vector<std::string>& currentReplicas = fileEntry.second;
-                    if (std::find(currentReplicas.begin(), currentReplicas.end(), deadNodeID) != currentReplicas.end()) {
-                        tasks.push_back({filename, deadNodeID});
-                    }
-                }
-
-                // Process tasks: For each file that needs a new replica
-                for (const auto& task : tasks) {
-                    const std::string& filename = task.first;
-                    const std::string& failedNodeID = task.second; // Renamed for clarity within this loop
-                    std::vector<std::string>& currentReplicas = fileMetadata[filename];
-
-                    std::cout << "File " << filename << " needs new replica due to " << failedNodeID << " failure." << std::endl;
-
-                    std::string newNodeID = "";
-                    // Find a new node for replica
-                    for (const auto& nodeEntry : registeredNodes) {
-                        const std::string& potentialNodeID = nodeEntry.first;
-                        if (nodeEntry.second.isAlive &&
-                            potentialNodeID != failedNodeID &&
-                            std::find(currentReplicas.begin(), currentReplicas.end(), potentialNodeID) == currentReplicas.end()) {
-                            newNodeID = potentialNodeID;
-                            break;
+                    for (size_t index = 0; index < fileEntry.second.chunks.size(); ++index) {
+                        ChunkInfo& chunk = fileEntry.second.chunks[index];
+                        std::vector<std::string>& currentReplicas = chunk.replicas;
+                        if (std::find(currentReplicas.begin(), currentReplicas.end(), failedNodeID) == currentReplicas.end()) {
+                            continue;
                         }
-                    }
-
-                    if (newNodeID.empty()) {
-                        std::cout << "Warning: Could not find a new live node for " << filename << "." << std::endl;
-                        continue; // Skip to next task
-                    }
+                        std::cout << "Chunk " << index << " of file " << filename << " needs new replica due to "
+                                  << failedNodeID << " failure." << std::endl;
 
-                    std::string sourceNodeID = "";
-                    // Find a live source node from the remaining replicas
-                    for (const std::string& replicaNodeID : currentReplicas) {
-                        if (replicaNodeID != failedNodeID && registeredNodes[replicaNodeID].isAlive) {
-                            sourceNodeID = replicaNodeID;
-                            break;
+                        std::vector<std::string> newNodes = pickChunkReplicas(load, currentReplicas, 1);
+                        if (newNodes.empty()) {
+                            std::cout << "Warning: Could not find a new live node for chunk " << index << " of " << filename << "." << std::endl;
+                            continue;
+                        }
+                        const std::string& newNodeID = newNodes.front();
+
+                        std::string sourceNodeID = "";
+                        // Find a live source node from the remaining replicas
+                        for (const std::string& replicaNodeID : currentReplicas) {
+                            if (replicaNodeID != failedNodeID && registeredNodes[replicaNodeID].isAlive) {
+                                sourceNodeID = replicaNodeID;
+                                break;
+                            }
+                        }
+                        if (sourceNodeID.empty()) {
+                            std::cout << "Error: No live source replica found for chunk " << index << " of " << filename << "." << std::endl;
+                            --load[newNodeID];
+                            continue;
                         }
-                    }
 
-                    if (sourceNodeID.empty()) {
-                        std::cout << "Error: No live source replica found for " << filename << "." << std::endl;
-                        continue; // Skip to next task
+                        // Update metadata
+                        currentReplicas.erase(std::remove(currentReplicas.begin(), currentReplicas.end(), failedNodeID), currentReplicas.end());
+                        currentReplicas.push_back(newNodeID);
+                        std::cout << "Replaced " << failedNodeID << " with " << newNodeID << " for chunk " << index
+                                  << " of file " << filename << "." << std::endl;
+
+                        // Log commands (simulating sending messages)
+                        const std::string chunkName = GetChunkStorageName(filename, chunk.id);
+                        Message replicateMsg;
+                        replicateMsg._Type = MessageType::ReplicateFileCommand;
+                        replicateMsg._Filename = chunkName;
+                        replicateMsg._NodeAddress = registeredNodes[newNodeID].nodeAddress; // Target for replica
+                        replicateMsg._Content = sourceNodeID; // Informing who is the source
+                        std::cout << "[METASERVER_STUB] To " << sourceNodeID << " (source): " << Message::Serialize(replicateMsg) << std::endl;
+
+                        Message receiveMsg;
+                        receiveMsg._Type = MessageType::ReceiveFileCommand;
+                        receiveMsg._Filename = chunkName;
+                        receiveMsg._NodeAddress = registeredNodes[sourceNodeID].nodeAddress; // Source of replica
+                        receiveMsg._Content = newNodeID; // Informing who is the target
+                        std::cout << "[METASERVER_STUB] To " << newNodeID << " (target): " << Message::Serialize(receiveMsg) << std::endl;
                     }
-
-                    // Update metadata
-                    currentReplicas.erase(std::remove(currentReplicas.begin(), currentReplicas.end(), failedNodeID), currentReplicas.end());
-                    currentReplicas.push_back(newNodeID);
-                    std::cout << "Replaced " << failedNodeID << " with " << newNodeID << " for file " << filename << "." << std::endl;
-
-                    // Log commands (simulating sending messages)
-                    Message replicateMsg;
-                    replicateMsg._Type = MessageType::ReplicateFileCommand;
-                    replicateMsg._Filename = filename;
-                    replicateMsg._NodeAddress = registeredNodes[newNodeID].nodeAddress; // Target for replica
-                    replicateMsg._Content = sourceNodeID; // Informing who is the source
-                    std::string serRepMsg = Message::Serialize(replicateMsg);
-                    std::cout << "[METASERVER_STUB] To " << sourceNodeID << " (source): " << serRepMsg << std::endl;
-
-                    Message receiveMsg;
-                    receiveMsg._Type = MessageType::ReceiveFileCommand;
-                    receiveMsg._Filename = filename;
-                    receiveMsg._NodeAddress = registeredNodes[sourceNodeID].nodeAddress; // Source of replica
-                    receiveMsg._Content = newNodeID; // Informing who is the target
-                    std::string serRecMsg = Message::Serialize(receiveMsg);
-                    std::cout << "[METASERVER_STUB] To " << newNodeID << " (target): " << serRecMsg << std::endl;
                 }
                 // After processing all redistributions for a dead node.
                 // Call saveMetadata here if defined, path constants should be accessible.
@@ -212,8 +424,9 @@ public:
      * If not enough preferred nodes are available or none are provided, it selects other live nodes
      * to meet the `DEFAULT_REPLICATION_FACTOR`.
      * 
-     * After selecting target nodes, it updates `fileMetadata` and logs (stubbed) messages
-     * to be sent to the target nodes to create the file.
+     * The new file is empty and has a single chunk, placed on the selected nodes; resizeFile
+     * allocates further chunks as it grows. After selecting target nodes, it updates
+     * `fileMetadata` and logs (stubbed) messages to be sent to the target nodes to create the chunk.
      * 
      * @param filename The name of the file to add.
      * @param preferredNodes A list of node identifiers suggested to store this file. Can be empty.
@@ -264,19 +477,24 @@ public:
         }
 
         // Update metadata and send messages if nodes were found
-        fileMetadata[filename] = targetNodes;
+        ChunkInfo chunk;
+        chunk.id = nextChunkId++;
+        chunk.replicas = targetNodes;
+        FileMetadata& metadata = fileMetadata[filename];
+        metadata.size = 0;
+        metadata.chunks.assign(1, chunk);
         std::cout << "File " << filename << " added with chunks on nodes: ";
         for (const auto &node : targetNodes) {
             std::cout << node << " ";
         }
         std::cout << std::endl;
 
-        // Sending message to nodes about new file
+        // Sending message to nodes about the file's first chunk
         for (const auto &nodeID : targetNodes) {
             Message msg;
             msg._Type = MessageType::CreateFile;
-            msg._Filename = filename;
-            msg._Content = "Adding file to node"; // Content might be chunk specific later
+            msg._Filename = GetChunkStorageName(filename, chunk.id);
+            msg._Content = filename; // The file the chunk belongs to
             std::string serializedMsg = Message::Serialize(msg);
             // Here you would send `serializedMsg` to the appropriate node 
             // (communication code is assumed to be elsewhere, using nodeID to get address)
@@ -284,51 +502,182 @@ public:
         }
     }
 
+    /**
+     * @brief Changes the recorded size of a file, allocating or releasing chunks to match.
+     *
+     * New chunks are placed on the live nodes holding the fewest chunks, so a growing file
+     * spreads over the cluster instead of filling the nodes of its first chunk. Chunks past
+     * the new end are dropped and their replicas told to delete them.
+     * @param filename The file to resize.
+     * @param newSize Its new size in bytes.
+     * @throw std::runtime_error if the file is not found in the metadata, newSize is past
+     *        getMaxFileSize(), the file predates chunking, or no live node is available for
+     *        a new chunk.
+     */
+    void resizeFile(const std::string& filename, uint64_t newSize) {
+        // Checked before locking: every chunk of a huge size would be allocated under metadataMutex
+        if (newSize > getMaxFileSize()) {
+            throw std::runtime_error("Size of " + filename + " exceeds the maximum file size.");
+        }
+        std::lock_guard<std::mutex> lock(metadataMutex);
+        auto it = fileMetadata.find(filename);
+        if (it == fileMetadata.end()) {
+            throw std::runtime_error("File not found in metadata.");
+        }
+        resizeLocked(filename, it->second, newSize);
+    }
+
+    /**
+     * @brief Looks up the chunks holding part of a file, for a ReadFileRange.
+     * @param filename The file to read.
+     * @param offset First byte to read.
+     * @param length Number of bytes to read; the range is clipped where the file ends.
+     * @throw std::runtime_error if the file is not found in the metadata.
+     */
+    ChunkRange getChunkRange(const std::string& filename, uint64_t offset, uint64_t length) {
+        std::lock_guard<std::mutex> lock(metadataMutex);
+        auto it = fileMetadata.find(filename);
+        if (it == fileMetadata.end()) {
+            throw std::runtime_error("File not found in metadata.");
+        }
+        uint64_t end = length > UINT64_MAX - offset ? UINT64_MAX : offset + length;
+        return chunkRangeLocked(it->second, offset, end);
+    }
+
+    /**
+     * @brief Looks up the chunks a WriteFileAt goes to, first growing the file, and allocating
+     *        chunks, if the write ends past its recorded size.
+     * @param filename The file to write.
+     * @param offset Where the write starts.
+     * @param length Number of bytes written.
+     * @param range Receives the chunks.
+     * @return False, leaving the file as it is, if the write would end past getMaxFileSize().
+     * @throw std::runtime_error as resizeFile.
+     */
+    bool prepareWrite(const std::string& filename, uint64_t offset, uint64_t length, ChunkRange& range) {
+        if (offset > getMaxFileSize() || length > getMaxFileSize() - offset) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(metadataMutex);
+        auto it = fileMetadata.find(filename);
+        if (it == fileMetadata.end()) {
+            throw std::runtime_error("File not found in metadata.");
+        }
+        // The size of a file recorded before chunking is unknown, and its one chunk takes any write
+        if (!isWholeFile(it->second) && offset + length > it->second.size) {
+            resizeLocked(filename, it->second, offset + length);
+        }
+        range = chunkRangeLocked(it->second, offset, offset + length);
+        return true;
+    }
+
+    /**
+     * @brief Reserves the end of a file for an AppendFile: grows the file by length bytes and
+     *        looks up the chunks they go to. Concurrent appends are given disjoint ranges.
+     * For a file recorded before chunking the range is its one chunk, with offset 0 since its
+     * size is unknown; clients append to it with the node's AppendFile.
+     * @param filename The file to append to.
+     * @param length Number of bytes appended.
+     * @param range Receives the chunks, with range.offset where the data goes.
+     * @return False, leaving the file as it is, if it would grow past getMaxFileSize().
+     * @throw std::runtime_error as resizeFile.
+     */
+    bool prepareAppend(const std::string& filename, uint64_t length, ChunkRange& range) {
+        std::lock_guard<std::mutex> lock(metadataMutex);
+        auto it = fileMetadata.find(filename);
+        if (it == fileMetadata.end()) {
+            throw std::runtime_error("File not found in metadata.");
+        }
+        if (isWholeFile(it->second)) {
+            range = chunkRangeLocked(it->second, 0, 0);
+            return true;
+        }
+        uint64_t offset = it->second.size;
+        if (offset > getMaxFileSize() || length > getMaxFileSize() - offset) {
+            return false;
+        }
+        resizeLocked(filename, it->second, offset + length);
+        range = chunkRangeLocked(it->second, offset, offset + length);
+        return true;
+    }
+
+    /**
+     * @brief Retrieves the chunks of a file in file order.
+     * @param filename The name of the file to query.
+     * @throw std::runtime_error if the file is not found in the metadata.
+     */
+    std::vector<ChunkInfo> getFileChunks(const std::string& filename) {
+        std::lock_guard<std::mutex> lock(metadataMutex);
+        auto it = fileMetadata.find(filename);
+        if (it == fileMetadata.end()) {
+            throw std::runtime_error("File not found in metadata.");
+        }
+        return it->second.chunks;
+    }
+
+    /**
+     * @brief Retrieves the recorded size of a file in bytes. Zero for a file recorded before
+     *        chunking, whose size is unknown.
+     * @param filename The name of the file to query.
+     * @throw std::runtime_error if the file is not found in the metadata.
+     */
+    uint64_t getFileSize(const std::string& filename) {
+        std::lock_guard<std::mutex> lock(metadataMutex);
+        auto it = fileMetadata.find(filename);
+        if (it == fileMetadata.end()) {
+            throw std::runtime_error("File not found in metadata.");
+        }
+        return it->second.size;
+    }
+
     // Retrieve metadata for a given file
     /**
-     * @brief Retrieves the list of node identifiers that store replicas of a given file.
+     * @brief Retrieves the list of node identifiers that store a replica of any chunk of a given file.
      * @param filename The name of the file to query.
-     * @return A vector of strings, where each string is a node identifier.
+     * @return A vector of strings, where each string is a node identifier, in the order
+     *         they first appear in the file's chunks.
      * @throw std::runtime_error if the file is not found in the metadata.
      */
     std::vector<std::string> getFileNodes(const std::string &filename) {
         std::lock_guard<std::mutex> lock(metadataMutex);
-        if (fileMetadata.find(filename) != fileMetadata.end()) {
-            return fileMetadata[filename];
-        } else {
+        auto it = fileMetadata.find(filename);
+        if (it == fileMetadata.end()) {
             throw std::runtime_error("File not found in metadata.");
         }
+        std::vector<std::string> nodes;
+        for (const ChunkInfo& chunk : it->second.chunks) {
+            for (const std::string& nodeID : chunk.replicas) {
+                if (std::find(nodes.begin(), nodes.end(), nodeID) == nodes.end()) {
+                    nodes.push_back(nodeID);
+                }
+            }
+        }
+        return nodes;
     }
 
     // Remove a file from metadata
     /**
      * @brief Removes a file from the metadata and logs (stubbed) messages to instruct relevant nodes to delete their replicas.
      * @param filename The name of the file to remove.
-     * @note If the file is found and removed from metadata, messages of type `DeleteFile` are
-     *       logged for each node that was storing a replica.
+     * @note If the file is found and removed from metadata, a message of type `DeleteFile` is
+     *       logged for each replica of each of its chunks.
      */
     void removeFile(const std::string &filename) {
         std::lock_guard<std::mutex> lock(metadataMutex);
-        
-        std::vector<std::string> nodesToNotify;
-        if (fileMetadata.count(filename)) { // Check if file exists before getting nodes
-            nodesToNotify = fileMetadata[filename];
-        }
 
-        if (fileMetadata.erase(filename)) {
+        auto it = fileMetadata.find(filename);
+        if (it != fileMetadata.end()) {
+            std::vector<ChunkInfo> chunks = std::move(it->second.chunks);
+            fileMetadata.erase(it);
             std::cout << "File " << filename << " removed from metadata." << std::endl;
-            
-            Message msg;
-            msg._Type = MessageType::DeleteFile; // Correct message type
-            msg._Filename = filename;
-            msg._Content = "Instructing node to delete file.";
 
-            for (const auto& nodeID : nodesToNotify) { // Iterate nodes that HAD the file
+            for (const ChunkInfo& chunk : chunks) { // Iterate nodes that HAD the file's chunks
                 // STUB: This is where you'd use the (missing) networking library
                 // to send the serialized message to the node `nodeID`.
                 // For now, we'll just log it.
-                std::string serializedMsg = Message::Serialize(msg);
-                std::cout << "[METASERVER_STUB] To " << nodeID << ": " << serializedMsg << std::endl;
+                for (const std::string& nodeID : chunk.replicas) {
+                    notifyChunkReplica(MessageType::DeleteFile, filename, chunk, nodeID);
+                }
             }
         } else {
             std::cout << "File " << filename << " not found in metadata." << std::endl;
@@ -338,17 +687,20 @@ public:
     // Print all metadata (for debugging)
     /**
      * @brief Prints all current metadata to the console for debugging purposes.
-     * Lists all files and the nodes storing their replicas.
+     * Lists all files with their size and, per chunk, the nodes storing its replicas.
      */
     void printMetadata() {
         std::lock_guard<std::mutex> lock(metadataMutex);
         std::cout << "Current Metadata: " << std::endl;
         for (const auto &entry : fileMetadata) {
-            std::cout << "File: " << entry.first << " - Nodes: ";
-            for (const auto &node : entry.second) {
-                std::cout << node << " ";
+            std::cout << "File: " << entry.first << " (" << entry.second.size << " bytes)" << std::endl;
+            for (const ChunkInfo& chunk : entry.second.chunks) {
+                std::cout << "  Chunk " << chunk.id << " - Nodes: ";
+                for (const auto &node : chunk.replicas) {
+                    std::cout << node << " ";
+                }
+                std::cout << std::endl;
             }
-            std::cout << std::endl;
         }
     }
 
@@ -356,7 +708,8 @@ public:
      * @brief Saves the current state of `fileMetadata` and `registeredNodes` to persistence files.
      * @param fileMetadataPath Path to the file where file-to-node mappings will be stored.
      * @param nodeRegistryPath Path to the file where node registration information will be stored.
-     * @note Uses `METADATA_SEPARATOR` and `NODE_LIST_SEPARATOR` for formatting.
+     * @note Uses `METADATA_SEPARATOR` and `NODE_LIST_SEPARATOR` for formatting. Each file is
+     *       stored as `filename|size|id:node,node;id:node,...` with its chunks in file order.
      *       Logs errors if files cannot be opened for writing.
      */
     void saveMetadata(const std::string& fileMetadataPath, const std::string& nodeRegistryPath) {
@@ -366,11 +719,8 @@ public:
         std::ofstream fm_ofs(fileMetadataPath);
         if (fm_ofs.is_open()) {
             for (const auto& entry : fileMetadata) {
-                fm_ofs << entry.first << METADATA_SEPARATOR;
-                for (size_t i = 0; i < entry.second.size(); ++i) {
-                    fm_ofs << entry.second[i] << (i == entry.second.size() - 1 ? "" : std::string(1, NODE_LIST_SEPARATOR));
-                }
-                fm_ofs << std::endl;
+                fm_ofs << entry.first << METADATA_SEPARATOR << entry.second.size << METADATA_SEPARATOR
+                       << EncodeChunkList(entry.second.chunks) << std::endl;
             }
             fm_ofs.close();
         } else {
@@ -398,7 +748,9 @@ public:
      * @param fileMetadataPath Path to the file from which file-to-node mappings will be loaded.
      * @param nodeRegistryPath Path to the file from which node registration information will be loaded.
      * @note Clears current in-memory metadata before loading. Uses `METADATA_SEPARATOR` and 
-     *       `NODE_LIST_SEPARATOR` for parsing. Logs errors if files cannot be opened or if parsing fails.
+     *       `NODE_LIST_SEPARATOR` for parsing. Lines written before chunking (`filename|node,node`)
+     *       load as an empty file whose single chunk is the whole file (WHOLE_FILE_CHUNK_ID).
+     *       Logs errors if files cannot be opened or if parsing fails.
      */
     void loadMetadata(const std::string& fileMetadataPath, const std::string& nodeRegistryPath) {
         std::lock_guard<std::mutex> lock(metadataMutex);
@@ -408,20 +760,32 @@ public:
         std::string line;
         if (fm_ifs.is_open()) {
             fileMetadata.clear();
+            nextChunkId = 1;
             while (std::getline(fm_ifs, line)) {
                 std::stringstream ss(line);
-                std::string filename, nodesStr;
+                std::string filename, sizeStr, chunksStr;
                 std::getline(ss, filename, METADATA_SEPARATOR);
-                std::getline(ss, nodesStr); // The rest is node list
+                std::getline(ss, sizeStr, METADATA_SEPARATOR);
+                if (!std::getline(ss, chunksStr)) {
+                    // Legacy format: the rest is the node list of the whole file. Its size was never
+                    // recorded; the 0 kept here is not used, since resizeFile refuses whole-file chunks
+                    chunksStr = std::to_string(WHOLE_FILE_CHUNK_ID) + CHUNK_ID_SEPARATOR + sizeStr;
+                    sizeStr = "0";
+                }
 
-                std::vector<std::string> nodes;
-                std::stringstream nodes_ss(nodesStr);
-                std::string node;
-                while(std::getline(nodes_ss, node, NODE_LIST_SEPARATOR)) {
-                    nodes.push_back(node);
+                FileMetadata metadata;
+                try {
+                    metadata.size = std::stoull(sizeStr);
+                    metadata.chunks = DecodeChunkList(chunksStr);
+                    for (const ChunkInfo& chunk : metadata.chunks) {
+                        nextChunkId = std::max(nextChunkId, chunk.id + 1);
+                    }
+                } catch (const std::exception& e) {
+                    std::cerr << "Error parsing chunks of file " << filename << ": " << e.what() << std::endl;
+                    continue; // Skip this record
                 }
-                if (!filename.empty()) {
-                    fileMetadata[filename] = nodes;
+                if (!filename.empty() && !metadata.chunks.empty()) {
+                    fileMetadata[filename] = std::move(metadata);
                 }
             }
             fm_ifs.close();
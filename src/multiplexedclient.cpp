@@ -0,0 +1,170 @@
+#include "multiplexedclient.h"
+#include <cerrno>
+#include <system_error>
+
+namespace {
+
+std::exception_ptr ConnectionError(int _pErrorCode)
+{
+	return std::make_exception_ptr(std::system_error(_pErrorCode, std::generic_category(), "Multiplexed request failed"));
+}
+
+}
+
+Networking::MultiplexedClient::MultiplexedClient(const std::string& _pHost, int _pPort)
+	: client(_pHost.c_str(), _pPort)
+{
+	connected = client.IsConnected();
+	if(connected)
+		reader = std::thread(&MultiplexedClient::ReadReplies, this);
+}
+
+Networking::MultiplexedClient::~MultiplexedClient()
+{
+	Close();
+}
+
+std::future<std::vector<char> > Networking::MultiplexedClient::Call(const std::string& _pPayload)
+{
+	auto promise = std::make_shared<std::promise<std::vector<char> > >();
+	std::future<std::vector<char> > reply = promise->get_future();
+	Send(_pPayload, [promise](std::vector<char> _pReply, std::exception_ptr _pError) {
+		if(_pError)
+			promise->set_exception(_pError);
+		else
+			promise->set_value(std::move(_pReply));
+	});
+	return reply;
+}
+
+void Networking::MultiplexedClient::Call(const std::string& _pPayload, ReplyCallback _pCallback)
+{
+	Send(_pPayload, std::move(_pCallback));
+}
+
+void Networking::MultiplexedClient::Close()
+{
+	std::lock_guard<std::mutex> lock(closeMutex);
+	if(reader.joinable())
+	{
+		// Shutting the socket down makes the blocked reader return
+		client.Shutdown();
+		reader.join();
+	}
+	FailPending(ENOTCONN);
+	if(client.IsConnected())
+	{
+		try
+		{
+			client.Disconnect();
+		}
+		catch(NetworkException&)
+		{
+			// Disconnect has already closed the socket
+		}
+	}
+}
+
+bool Networking::MultiplexedClient::IsConnected() const
+{
+	return connected;
+}
+
+size_t Networking::MultiplexedClient::GetPendingCount() const
+{
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	return pendingCalls.size();
+}
+
+void Networking::MultiplexedClient::Send(const std::string& _pPayload, ReplyCallback _pCallback)
+{
+	// Zero marks an uncorrelated frame, so it is skipped when the counter wraps
+	uint32_t requestId = nextRequestId++;
+	if(requestId == 0)
+		requestId = nextRequestId++;
+
+	bool registered = false;
+	{
+		// The call is registered before it is sent, since the reply may arrive
+		// before SendFrame returns. Checking the connection under the same lock
+		// as FailPending ensures no call is registered after the reader gave up.
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		if(connected)
+		{
+			pendingCalls[requestId] = _pCallback;
+			registered = true;
+		}
+	}
+	if(!registered)
+	{
+		_pCallback(std::vector<char>(), ConnectionError(ENOTCONN));
+		return;
+	}
+
+	int errorCode = 0;
+	{
+		std::lock_guard<std::mutex> lock(sendMutex);
+		Result<long> sent = client.TrySendFrame(_pPayload.data(), _pPayload.size(), requestId);
+		if(!sent)
+			errorCode = sent.GetError().code;
+	}
+	if(errorCode == 0)
+		return;
+
+	// The reader may have failed the call already if the connection dropped
+	bool stillPending;
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		stillPending = pendingCalls.erase(requestId) > 0;
+	}
+	if(stillPending)
+		_pCallback(std::vector<char>(), ConnectionError(errorCode));
+	// A socket error closes the client; an oversized payload leaves it usable
+	if(!client.IsConnected())
+		connected = false;
+}
+
+void Networking::MultiplexedClient::ReadReplies()
+{
+	int errorCode = ECONNRESET;
+	while(true)
+	{
+		uint32_t requestId;
+		Result<std::vector<char>> received = client.TryReceiveFrame(requestId);
+		if(!received)
+		{
+			// An orderly close keeps the default ECONNRESET for the calls still pending
+			if(received.GetError().code != 0)
+				errorCode = received.GetError().code;
+			break;
+		}
+		std::vector<char> reply = std::move(received.Value());
+		// Replies to calls always carry an ID; a frame without one answers nothing we sent
+		if(requestId == 0)
+			continue;
+
+		ReplyCallback callback;
+		{
+			std::lock_guard<std::mutex> lock(pendingMutex);
+			auto it = pendingCalls.find(requestId);
+			if(it == pendingCalls.end())
+				continue;
+			callback = std::move(it->second);
+			pendingCalls.erase(it);
+		}
+		callback(std::move(reply), nullptr);
+	}
+	FailPending(errorCode);
+}
+
+void Networking::MultiplexedClient::FailPending(int _pErrorCode)
+{
+	std::unordered_map<uint32_t, ReplyCallback> failed;
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		connected = false;
+		failed.swap(pendingCalls);
+	}
+	for(auto& entry : failed)
+		entry.second(std::vector<char>(), ConnectionError(_pErrorCode));
+}
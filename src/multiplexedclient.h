@@ -0,0 +1,79 @@
+#pragma once
+#ifndef _NET_MULTIPLEXED_CLIENT_
+#define _NET_MULTIPLEXED_CLIENT_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "client.h"
+
+namespace Networking {
+
+// Carries many requests at once over a single connection. Each request is sent
+// with its own request ID and a background thread matches reply frames to
+// their requests by ID, so replies may arrive in any order. The server must
+// have keep-alive enabled and run in epoll mode with an executor to handle the
+// requests of one connection concurrently; otherwise they are simply answered
+// in turn. Call and Close are safe to call from any thread.
+class MultiplexedClient {
+public:
+
+// Invoked with the reply payload and a null exception_ptr, or with an empty
+// payload and the error if the request fails. Runs on the reader thread, or on
+// the calling thread if the request could not be sent, so it must not block.
+typedef std::function<void(std::vector<char>, std::exception_ptr)> ReplyCallback;
+
+// Connects to _pHost:_pPort and starts the reader thread. Check IsConnected()
+// before issuing calls.
+MultiplexedClient(const std::string& _pHost, int _pPort);
+
+// Closes the connection, failing any calls still waiting for a reply
+~MultiplexedClient();
+
+MultiplexedClient(const MultiplexedClient&) = delete;
+MultiplexedClient& operator=(const MultiplexedClient&) = delete;
+
+// Sends _pPayload as a new request. The future yields the reply payload, or
+// throws std::system_error if the request could not be sent or the connection
+// was lost before the reply arrived.
+std::future<std::vector<char> > Call(const std::string& _pPayload);
+
+// Sends _pPayload as a new request and invokes _pCallback with its reply
+void Call(const std::string& _pPayload, ReplyCallback _pCallback);
+
+// Shuts the connection down, fails pending calls and waits for the reader thread
+void Close();
+
+// Returns true until the connection fails or is closed
+bool IsConnected() const;
+
+// Returns the number of calls waiting for a reply
+size_t GetPendingCount() const;
+
+private:
+
+void Send(const std::string& _pPayload, ReplyCallback _pCallback);
+void ReadReplies();
+void FailPending(int _pErrorCode);
+
+Client client;
+std::atomic<bool> connected{false};
+std::atomic<uint32_t> nextRequestId{1};
+// Serializes writers so frames are not interleaved on the socket
+std::mutex sendMutex;
+mutable std::mutex pendingMutex;
+std::unordered_map<uint32_t, ReplyCallback> pendingCalls;
+std::mutex closeMutex;
+std::thread reader;
+};
+
+}
+
+#endif
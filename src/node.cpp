@@ -1,15 +1,39 @@
 #include "node.h"
+#include "logstorageengine.h"
 
 int main(int argc, char* argv[]) {
     if (argc < 3) {
-        std::cerr << "Usage: " << argv[0] << " <NodeName> <Port>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <NodeName> <Port> [--mode blocking|epoll|uring] [--workers N] [--data-dir DIR]" << std::endl;
         return 1;
     }
 
     std::string nodeName = argv[1];
     int port = std::stoi(argv[2]);
 
-    Node node(nodeName, port);
+    Networking::ServerMode serverMode = Networking::ServerMode::Blocking;
+    size_t workerCount = 0; // One per hardware thread
+    std::string dataDirectory; // Files are kept in memory unless a directory is given
+    for (int i = 3; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--mode") {
+            serverMode = Networking::ParseServerMode(argv[++i]);
+        } else if (std::string(argv[i]) == "--workers") {
+            workerCount = std::stoul(argv[++i]);
+        } else if (std::string(argv[i]) == "--data-dir") {
+            dataDirectory = argv[++i];
+        }
+    }
+
+    std::unique_ptr<StorageEngine> storage;
+    if (!dataDirectory.empty()) {
+        try {
+            storage.reset(new LogStorageEngine(dataDirectory));
+        } catch (const std::runtime_error& e) {
+            std::cerr << "Cannot open data directory: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    Node node(nodeName, port, serverMode, workerCount, std::move(storage));
     node.start();
 
     // Register with the MetadataManager
@@ -17,9 +17,12 @@
 #include "message.h"
 #include "server.h"
 #include "client.h"
+#include "connectionpool.h"
 #include "networkexception.h"
+#include "threadpool.h"
 #include <thread>
 #include <chrono> // Required for std::chrono
+#include <atomic> // Required for std::atomic
 
 /**
  * @brief Represents a storage node in the SimpliDFS system.
@@ -33,15 +36,31 @@ class Node {
 private:
     std::string nodeName;       ///< Unique identifier for this node.
     Networking::Server server;  ///< Server instance from NetworkingLibrary to listen for incoming connections.
+    Networking::ServerMode serverMode; ///< How the server services connections (blocking threads, epoll or io_uring).
     FileSystem fileSystem;      ///< Local file system manager for this node.
+    std::atomic<int> metadataManagerProtocolVersion{-1}; ///< Wire version agreed with the MetadataManager; -1 until negotiated.
+    std::atomic<int> metadataManagerCodec{0}; ///< Frame compression codec agreed with the MetadataManager (a Networking::CompressionCodec).
+    Networking::ConnectionPool metadataManagerConnections; ///< Persistent connections to the MetadataManager, reused across heartbeats and registrations.
+    ThreadPool requestPool;     ///< Workers that run handleClient; declared last so queued requests finish before the members they use are destroyed.
 
 public:
     /**
      * @brief Constructs a Node object.
      * @param name The unique name (identifier) for this node.
      * @param port The port number on which this node's server should listen.
+     * @param mode How incoming connections are serviced. Defaults to blocking accept.
+     * @param workerCount Number of request worker threads. Zero uses one per hardware thread.
+     * @param storage Engine that keeps the node's files. Null keeps them in memory; a
+     *                LogStorageEngine keeps them on disk across restarts.
      */
-    Node(const std::string& name, int port) : nodeName(name), server(port) {}
+    Node(const std::string& name, int port, Networking::ServerMode mode = Networking::ServerMode::Blocking, size_t workerCount = 0,
+         std::unique_ptr<StorageEngine> storage = nullptr)
+        : nodeName(name), server(port), serverMode(mode),
+          fileSystem(storage ? FileSystem(std::move(storage)) : FileSystem()), requestPool(workerCount) {
+        // Peers may send several requests over one pooled connection. Idle connections are
+        // cheap for the event loops but would each hold a worker thread in blocking mode.
+        server.SetKeepAlive(mode != Networking::ServerMode::Blocking);
+    }
 
     /**
      * @brief Starts the node's operations.
@@ -83,52 +102,136 @@ public:
     }
 
     /**
-     * @brief Listens for incoming client connections and spawns threads to handle them.
-     * This method runs in a loop as long as the server is running.
+     * @brief Listens for incoming client connections and dispatches their requests to handleClient.
+     * Requests are run on the node's bounded worker pool. This method runs until the server is stopped.
      */
     void listenForRequests() {
-        while (server.ServerIsRunning()) {
-            Networking::ClientConnection client = server.Accept();
-            std::thread clientThread(&Node::handleClient, this, client);
-            clientThread.detach();
-        }
+        server.Run([this](Networking::ClientConnection client, const std::vector<char>& request_vector) {
+            handleClient(client, request_vector);
+        }, serverMode, &requestPool);
+    }
+
+    /**
+     * @brief Returns queue-depth and work-stealing counters for the request worker pool.
+     * @return A snapshot of the pool's statistics.
+     */
+    ThreadPool::Stats getRequestPoolStats() const {
+        return requestPool.GetStats();
+    }
+
+    /**
+     * @brief Returns hit-rate and outstanding-byte counters for the pool that receive buffers come from.
+     * @return A snapshot of the buffer pool's statistics.
+     */
+    Networking::BufferPool::Stats getReceiveBufferStats() const {
+        return Networking::BufferPool::Default().GetStats();
+    }
+
+    /**
+     * @brief Returns the compression ratio and CPU time counters of the frame compression stage.
+     * @return A snapshot of the process-wide compression statistics.
+     */
+    Networking::CompressionStats getCompressionStats() const {
+        return Networking::GetCompressionStats();
     }
 
     /**
-     * @brief Handles an individual client connection.
-     * Receives a message, deserializes it, and processes it based on its type.
-     * Supported message types include WriteFile, ReadFile, DeleteFile, 
+     * @brief Handles a request received on an individual client connection.
+     * Deserializes the message and processes it based on its type.
+     * Supported message types include CreateFile, WriteFile, ReadFile, ReadFileRange, WriteFileAt,
+     * AppendFile, TruncateFile, DeleteFile, 
      * ReplicateFileCommand, and ReceiveFileCommand.
      * @param client The ClientConnection object representing the connected client.
+     * @param request_vector The raw request received from the client.
      * @note This method uses the local FileSystem to perform file operations.
      *       Error handling for message deserialization and network operations is included.
      */
-    void handleClient(Networking::ClientConnection client) {
+    void handleClient(Networking::ClientConnection client, const std::vector<char>& request_vector) {
         try {
-            std::vector<char> request_vector = server.Receive(client);
             if (request_vector.empty()) {
                 std::cerr << "Node " << nodeName << " received empty data." << std::endl;
                 return;
             }
-            std::string request_str(request_vector.begin(), request_vector.end());
-            Message message = Message::Deserialize(request_str);
+            // Accepts both the legacy text format and the binary format. The fields point into
+            // request_vector; only what is stored or kept past the request is copied.
+            MessageView message = MessageView::Decode(request_vector.data(), request_vector.size());
+            std::string filename(message._Filename);
 
             switch (message._Type) {
+                case MessageType::CreateFile: {
+                    // The metaserver places a new chunk on this node; _Content names the file it belongs to
+                    std::cout << "[NODE " << nodeName << "] Received CreateFile for " << message._Filename << std::endl;
+                    if (fileSystem.createFile(filename)) {
+                        server.SendFrame("File " + filename + " created successfully.", client);
+                    } else {
+                        server.SendFrame("Error: File " + filename + " already exists.", client);
+                    }
+                    break;
+                }
                 case MessageType::WriteFile: {
-                    bool success = fileSystem.writeFile(message._Filename, message._Content);
+                    // The content is copied once, straight from the request into storage
+                    bool success = fileSystem.writeFile(filename, std::string(message._Content));
                     if (success) {
-                        server.Send(("File " + message._Filename + " written successfully.").c_str(), client);
+                        server.SendFrame("File " + filename + " written successfully.", client);
                     } else {
-                        server.Send(("Error: Unable to write file " + message._Filename + ".").c_str(), client);
+                        server.SendFrame("Error: Unable to write file " + filename + ".", client);
                     }
                     break;
                 }
                 case MessageType::ReadFile: {
-                    std::string content = fileSystem.readFile(message._Filename);
-                    if (!content.empty()) {
-                        server.Send(content.c_str(), client);
+                    // The reply is sent from the stored buffer itself; a concurrent write
+                    // publishes a new version and leaves this one intact until it is sent
+                    FileContent content = fileSystem.readFileShared(filename);
+                    if (content && !content->empty()) {
+                        server.SendFrame(content->data(), content->size(), client);
+                    } else {
+                        server.SendFrame("Error: File not found.", client);
+                    }
+                    break;
+                }
+                case MessageType::ReadFileRange: {
+                    uint64_t offset = 0, length = 0;
+                    if (!ParseMessageNumber(message._NodeAddress, offset) || !ParseMessageNumber(message._Content, length)) {
+                        server.SendFrame("Error: Invalid range.", client);
+                        break;
+                    }
+                    // Only the requested bytes are copied, so tailing a large file stays cheap
+                    // An empty or past-the-end range is answered with no bytes, like a read at EOF
+                    std::string content;
+                    if (fileSystem.readRange(filename, offset, length, content)) {
+                        server.SendFrame(content, client);
+                    } else {
+                        server.SendFrame("Error: File not found.", client);
+                    }
+                    break;
+                }
+                case MessageType::WriteFileAt: {
+                    uint64_t offset = 0;
+                    if (!ParseMessageNumber(message._NodeAddress, offset)) {
+                        server.SendFrame("Error: Invalid offset.", client);
+                    } else if (fileSystem.writeAt(filename, offset, std::string(message._Content))) {
+                        server.SendFrame("File " + filename + " written successfully.", client);
+                    } else {
+                        server.SendFrame("Error: Unable to write file " + filename + ".", client);
+                    }
+                    break;
+                }
+                case MessageType::AppendFile: {
+                    if (fileSystem.append(filename, std::string(message._Content))) {
+                        server.SendFrame("File " + filename + " appended successfully.", client);
                     } else {
-                        server.Send("Error: File not found.", client);
+                        server.SendFrame("Error: Unable to append to file " + filename + ".", client);
+                    }
+                    break;
+                }
+                case MessageType::TruncateFile: {
+                    uint64_t size = 0;
+                    if (!ParseMessageNumber(message._Content, size)) {
+                        server.SendFrame("Error: Invalid size.", client);
+                    } else if (fileSystem.truncate(filename, size)) {
+                        server.SendFrame("File " + filename + " truncated successfully.", client);
+                    } else {
+                        server.SendFrame("Error: Unable to truncate file " + filename + ".", client);
                     }
                     break;
                 }
@@ -139,9 +242,9 @@ public:
                 // it needs to be re-added to the MessageType enum in message.h.
                 // For now, assuming it was superseded by DeleteFile.
                 case MessageType::ReplicateFileCommand: {
-                    std::string filenameToReplicate = message._Filename;
-                    std::string targetNodeAddress = message._NodeAddress;
-                    std::string sourceNodeForConfirmation = message._Content; // Original source node ID for logging/confirmation
+                    std::string_view filenameToReplicate = message._Filename;
+                    std::string_view targetNodeAddress = message._NodeAddress;
+                    std::string_view sourceNodeForConfirmation = message._Content; // Original source node ID for logging/confirmation
                     std::cout << "[NODE " << nodeName << "] Received ReplicateFileCommand for " << filenameToReplicate 
                               << " to " << targetNodeAddress 
                               << " (Original source: " << sourceNodeForConfirmation << ")" << std::endl;
@@ -151,13 +254,13 @@ public:
                     // STUB: This node would then connect to targetNodeAddress and send the file
                     // Example: Networking::Client clientToTarget(targetNodeAddress_ip, targetNodeAddress_port);
                     // clientToTarget.Send(actual_content);
-                    server.Send("Replication command received.", client); // Acknowledge receipt
+                    server.SendFrame("Replication command received.", client); // Acknowledge receipt
                     break;
                 }
                 case MessageType::ReceiveFileCommand: {
-                    std::string filenameToReceive = message._Filename;
-                    std::string sourceNodeAddress = message._NodeAddress;
-                    std::string targetNodeForConfirmation = message._Content; // Original target node ID for logging/confirmation
+                    std::string_view filenameToReceive = message._Filename;
+                    std::string_view sourceNodeAddress = message._NodeAddress;
+                    std::string_view targetNodeForConfirmation = message._Content; // Original target node ID for logging/confirmation
                     std::cout << "[NODE " << nodeName << "] Received ReceiveFileCommand for " << filenameToReceive 
                               << " from " << sourceNodeAddress 
                               << " (Original target: " << targetNodeForConfirmation << ")" << std::endl;
@@ -166,12 +269,12 @@ public:
                     // STUB: This node would expect a connection from sourceNodeAddress or initiate if needed
                     // Example: std::string received_content = server.Receive(client_from_source_node);
                     // fileSystem.writeFile(filenameToReceive, received_content);
-                    server.Send("Receive command acknowledged.", client); // Acknowledge receipt
+                    server.SendFrame("Receive command acknowledged.", client); // Acknowledge receipt
                     break;
                 }
                 case MessageType::DeleteFile: {
                     std::cout << "[NODE " << nodeName << "] Received DeleteFile for " << message._Filename << std::endl;
-                    bool success = fileSystem.deleteFile(message._Filename);
+                    bool success = fileSystem.deleteFile(filename);
                     if (success) {
                         std::cout << "[NODE " << nodeName << "] File " << message._Filename << " deleted successfully." << std::endl;
                         // STUB: server.Send(("File " + message._Filename + " deleted.").c_str(), client);
@@ -183,23 +286,30 @@ public:
                     }
                     break;
                 }
+                case MessageType::Hello: {
+                    // Answer in the text format so that peers of any version can read it
+                    server.SendFrame(Message::Serialize(Message::CreateHello(Networking::GetSupportedCodecs())), client);
+                    break;
+                }
                 default: {
-                    server.Send("Unknown request type.", client);
+                    server.SendFrame("Unknown request type.", client);
                     break;
                 }
             }
         } catch (const std::runtime_error& e) { // Catching more specific runtime_error from Deserialize
             std::cerr << "Error deserializing message or runtime issue in handleClient: " << e.what() << std::endl;
-            // Optionally, send an error response to the client if appropriate
-            // server.Send("Error: Malformed message received.", client);
+            // A keep-alive client would otherwise wait for a reply until its deadline
+            server.SendFrame("Error: Malformed message.", client);
         } catch (const std::exception& e) { // Catching other general exceptions
             std::cerr << "Error handling client: " << e.what() << std::endl;
+            // A keep-alive client waits for a reply, so even a failed request gets one
+            server.SendFrame("Error: Request failed.", client);
         }
     }
 
     /**
      * @brief Sends a message to the MetadataManager.
-     * Serializes the given Message object and sends it using the Networking::Client.
+     * Encodes the given Message object in the negotiated wire format and sends it using the Networking::Client.
      * @param metadataManagerAddress The IP address or hostname of the MetadataManager.
      * @param metadataManagerPort The port number of the MetadataManager.
      * @param message The Message object to send.
@@ -207,10 +317,14 @@ public:
      */
     void sendMessageToMetadataManager(const std::string& metadataManagerAddress, int metadataManagerPort, const Message& message) {
         try {
-            Networking::Client client(metadataManagerAddress.c_str(), metadataManagerPort);
-            std::string serializedMessage = Message::Serialize(message);
-            client.Send(serializedMessage.c_str());
-            std::vector<char> response_vector = client.Receive();
+            uint8_t wireVersion = negotiateProtocolVersion(metadataManagerAddress, metadataManagerPort);
+            std::string serializedMessage = Message::Encode(message, wireVersion);
+            std::vector<char> response_vector;
+            if (!exchangeWithMetadataManager(metadataManagerAddress, metadataManagerPort, serializedMessage, response_vector)) {
+                std::cerr << "Node " << nodeName << " could not reach MetadataManager at "
+                          << metadataManagerAddress << ":" << metadataManagerPort << std::endl;
+                return;
+            }
             if (response_vector.empty()) {
                 std::cout << "Node " << nodeName << " received empty response from MetadataManager." << std::endl;
                 // Handle empty response, maybe log or retry
@@ -229,6 +343,80 @@ public:
     }
 
 private:
+    /**
+     * @brief Sends one framed request to the MetadataManager over a pooled connection and reads the reply.
+     * A pooled connection may have been closed by the server while idle; if the exchange fails on a
+     * reused connection it is retried once on a fresh one. Heartbeats, registrations and the Hello
+     * handshake are idempotent, so the retry is safe.
+     * @param metadataManagerAddress The IP address or hostname of the MetadataManager.
+     * @param metadataManagerPort The port number of the MetadataManager.
+     * @param request The encoded request payload.
+     * @param response Receives the reply payload.
+     * @return False if no connection could be established.
+     * @throws Networking::NetworkException if the exchange fails on a fresh connection.
+     */
+    bool exchangeWithMetadataManager(const std::string& metadataManagerAddress, int metadataManagerPort,
+                                     const std::string& request, std::vector<char>& response) {
+        while (true) {
+            Networking::ConnectionPool::Lease connection = metadataManagerConnections.Acquire(metadataManagerAddress, metadataManagerPort);
+            if (!connection) {
+                return false;
+            }
+            try {
+                // Large requests are compressed once the handshake has found a codec both sides have
+                connection->SetCompression(static_cast<Networking::CompressionCodec>(metadataManagerCodec.load()));
+                connection->SendFrame(request);
+                response = connection->ReceiveFrame();
+            } catch (const Networking::NetworkException&) {
+                connection.Invalidate();
+                if (connection.IsReused()) {
+                    continue;
+                }
+                throw;
+            }
+            if (response.empty()) {
+                // The server closed the connection instead of replying
+                connection.Invalidate();
+                if (connection.IsReused()) {
+                    continue;
+                }
+            }
+            return true;
+        }
+    }
+
+    /**
+     * @brief Returns the wire version to use with the MetadataManager, performing the Hello handshake on first use.
+     * Peers that do not answer the handshake are spoken to in the legacy text format. The handshake also
+     * picks the frame compression codec from the ones the MetadataManager advertises.
+     * @param metadataManagerAddress The IP address or hostname of the MetadataManager.
+     * @param metadataManagerPort The port number of the MetadataManager.
+     * @return The negotiated wire version.
+     */
+    uint8_t negotiateProtocolVersion(const std::string& metadataManagerAddress, int metadataManagerPort) {
+        int known = metadataManagerProtocolVersion.load();
+        if (known >= 0) {
+            return static_cast<uint8_t>(known);
+        }
+        std::vector<char> reply;
+        if (!exchangeWithMetadataManager(metadataManagerAddress, metadataManagerPort,
+                                         Message::Serialize(Message::CreateHello(Networking::GetSupportedCodecs())), reply)) {
+            return MESSAGE_PROTOCOL_TEXT; // Try again on the next message
+        }
+        uint8_t version = MESSAGE_PROTOCOL_TEXT;
+        if (!reply.empty()) {
+            try {
+                Message hello = Message::Decode(reply.data(), reply.size());
+                version = Message::NegotiateVersion(hello);
+                metadataManagerCodec = static_cast<int>(Networking::NegotiateCodec(Message::GetHelloCodecs(hello)));
+            } catch (const std::runtime_error&) {
+                // Not a Hello: the peer predates the handshake
+            }
+        }
+        metadataManagerProtocolVersion = version;
+        return version;
+    }
+
     /**
      * @brief Periodically sends heartbeat messages to the MetadataManager.
      * This method runs in a separate thread.
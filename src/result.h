@@ -0,0 +1,112 @@
+#pragma once
+#ifndef _NET_RESULT_
+#define _NET_RESULT_
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <utility>
+
+namespace Networking {
+
+// How a failed socket call should be handled, decided once from its errno so
+// that callers branch on a handful of cases instead of on raw codes.
+enum class ErrorKind {
+	None,        // The call succeeded
+	WouldBlock,  // EAGAIN/EWOULDBLOCK/EINPROGRESS: try again once the socket is ready
+	Interrupted, // EINTR: repeat the call at once
+	PeerClosed,  // The peer hung up (orderly close, reset or broken pipe)
+	TimedOut,    // A deadline or the kernel's own timer ran out
+	Protocol,    // The peer sent a malformed or oversized frame
+	Resources,   // Out of descriptors, buffers or memory
+	Fatal        // Anything else; the connection is not usable
+};
+
+// Classifies an errno value. Zero stands for an orderly close by the peer,
+// which the socket calls report as a zero-length read rather than an errno.
+inline ErrorKind ClassifyError(int _pErrorCode)
+{
+	switch(_pErrorCode)
+	{
+	case 0:
+	case ECONNRESET:
+	case ECONNABORTED:
+	case EPIPE:
+	case ENOTCONN:
+	case ESHUTDOWN:
+		return ErrorKind::PeerClosed;
+	case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+	case EWOULDBLOCK:
+#endif
+	case EINPROGRESS:
+		return ErrorKind::WouldBlock;
+	case EINTR:
+		return ErrorKind::Interrupted;
+	case ETIMEDOUT:
+		return ErrorKind::TimedOut;
+	case EPROTO:
+	case EMSGSIZE:
+		return ErrorKind::Protocol;
+	case EMFILE:
+	case ENFILE:
+	case ENOBUFS:
+	case ENOMEM:
+		return ErrorKind::Resources;
+	default:
+		return ErrorKind::Fatal;
+	}
+}
+
+// A classified socket error
+struct IoError {
+	int code = 0;
+	ErrorKind kind = ErrorKind::None;
+
+	static IoError FromCode(int _pErrorCode)
+	{
+		IoError error;
+		error.code = _pErrorCode;
+		error.kind = ClassifyError(_pErrorCode);
+		return error;
+	}
+
+	// Worth repeating the same call: the socket was busy or a signal arrived
+	bool IsTransient() const { return kind == ErrorKind::WouldBlock || kind == ErrorKind::Interrupted; }
+	bool IsPeerClosed() const { return kind == ErrorKind::PeerClosed; }
+
+	std::string Message() const
+	{
+		return code == 0 ? std::string("Connection closed by peer") : std::string(strerror(code));
+	}
+};
+
+// Either the value of a successful socket call or the error it failed with,
+// returned instead of throwing so that routine failures such as a peer hanging
+// up cost a branch rather than an unwind. T must be default-constructible.
+template<typename T>
+class Result {
+public:
+Result(T _pValue) : value(std::move(_pValue)) {}
+Result(const IoError& _pError) : error(_pError) {}
+
+static Result Failure(int _pErrorCode) { return Result(IoError::FromCode(_pErrorCode)); }
+
+bool IsOk() const { return error.kind == ErrorKind::None; }
+explicit operator bool() const { return IsOk(); }
+
+// The value; only meaningful when IsOk()
+T& Value() { return value; }
+const T& Value() const { return value; }
+T ValueOr(T _pFallback) const { return IsOk() ? value : std::move(_pFallback); }
+
+const IoError& GetError() const { return error; }
+
+private:
+T value{};
+IoError error;
+};
+
+}
+
+#endif
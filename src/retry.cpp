@@ -0,0 +1,146 @@
+#include "retry.h"
+#include <algorithm>
+#include <random>
+#include <thread>
+
+Networking::Deadline::Deadline()
+{
+}
+
+Networking::Deadline Networking::Deadline::After(std::chrono::milliseconds _pTimeout)
+{
+	Deadline deadline;
+	deadline.set = true;
+	deadline.expiry = std::chrono::steady_clock::now() + _pTimeout;
+	return deadline;
+}
+
+Networking::Deadline Networking::Deadline::Never()
+{
+	return Deadline();
+}
+
+bool Networking::Deadline::IsSet() const
+{
+	return set;
+}
+
+bool Networking::Deadline::Expired() const
+{
+	return set && std::chrono::steady_clock::now() >= expiry;
+}
+
+std::chrono::milliseconds Networking::Deadline::Remaining() const
+{
+	if(!set)
+		return std::chrono::milliseconds::max();
+	auto remaining = expiry - std::chrono::steady_clock::now();
+	if(remaining <= std::chrono::steady_clock::duration::zero())
+		return std::chrono::milliseconds(0);
+	return std::chrono::duration_cast<std::chrono::milliseconds>(remaining);
+}
+
+int Networking::Deadline::PollTimeout() const
+{
+	if(!set)
+		return -1;
+	auto remaining = expiry - std::chrono::steady_clock::now();
+	if(remaining <= std::chrono::steady_clock::duration::zero())
+		return 0;
+	// Round up, so a wait does not time out with a sliver of the deadline left
+	auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(remaining + std::chrono::milliseconds(1) - std::chrono::nanoseconds(1));
+	return (int)std::min<long long>(millis.count(), 0x7fffffff);
+}
+
+std::chrono::milliseconds Networking::RetryPolicy::BackoffDelay(int _pRetry) const
+{
+	// Each thread draws from its own generator, so retries never contend on a lock
+	thread_local std::minstd_rand generator(std::random_device{}());
+
+	long long cap = initialDelay.count();
+	for(int i = 0; i < _pRetry && cap < maxDelay.count(); i++)
+		cap *= 2;
+	cap = std::min<long long>(cap, maxDelay.count());
+	if(cap <= 0)
+		return std::chrono::milliseconds(0);
+	std::uniform_int_distribution<long long> jitter(0, cap);
+	return std::chrono::milliseconds(jitter(generator));
+}
+
+bool Networking::RetryPolicy::WaitBeforeRetry(int _pRetry, const Deadline& _pDeadline) const
+{
+	if(_pRetry >= maxRetries || _pDeadline.Expired())
+		return false;
+	std::chrono::milliseconds delay = BackoffDelay(_pRetry);
+	if(delay >= _pDeadline.Remaining())
+		return false;
+	std::this_thread::sleep_for(delay);
+	return true;
+}
+
+Networking::CircuitBreaker::CircuitBreaker(int _pFailureThreshold, std::chrono::milliseconds _pOpenDuration)
+	: failureThreshold(_pFailureThreshold), openDuration(_pOpenDuration)
+{
+}
+
+bool Networking::CircuitBreaker::Allow(const std::string& _pPeer)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = peers.find(_pPeer);
+	if(it == peers.end())
+		return true;
+	Peer& peer = it->second;
+	switch(peer.state)
+	{
+	case State::Closed:
+		return true;
+	case State::Open:
+	case State::HalfOpen:
+	default:
+		// A probe that never reported back is replaced after another open duration
+		if(std::chrono::steady_clock::now() - peer.openedAt < openDuration)
+			return false;
+		// Let one caller find out whether the peer is back
+		peer.state = State::HalfOpen;
+		peer.openedAt = std::chrono::steady_clock::now();
+		return true;
+	}
+}
+
+void Networking::CircuitBreaker::RecordSuccess(const std::string& _pPeer)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	// Healthy peers are not tracked, so the map only holds peers that have failed
+	peers.erase(_pPeer);
+}
+
+void Networking::CircuitBreaker::RecordFailure(const std::string& _pPeer)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Peer& peer = peers[_pPeer];
+	peer.consecutiveFailures++;
+	if(peer.state == State::HalfOpen || peer.consecutiveFailures >= failureThreshold)
+	{
+		peer.state = State::Open;
+		peer.openedAt = std::chrono::steady_clock::now();
+	}
+}
+
+Networking::CircuitBreaker::State Networking::CircuitBreaker::GetState(const std::string& _pPeer) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = peers.find(_pPeer);
+	return it == peers.end() ? State::Closed : it->second.state;
+}
+
+void Networking::CircuitBreaker::Reset()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	peers.clear();
+}
+
+Networking::CircuitBreaker& Networking::CircuitBreaker::Default()
+{
+	static CircuitBreaker breaker;
+	return breaker;
+}
@@ -0,0 +1,119 @@
+#pragma once
+#ifndef _NET_RETRY_
+#define _NET_RETRY_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Retries after a transient failure, not counting the first attempt
+#ifndef MAX_RETRIES
+#define MAX_RETRIES 3
+#endif
+// First backoff delay; each retry doubles it up to RETRY_MAX_DELAY_MS
+#ifndef RETRY_INITIAL_DELAY_MS
+#define RETRY_INITIAL_DELAY_MS 50
+#endif
+#ifndef RETRY_MAX_DELAY_MS
+#define RETRY_MAX_DELAY_MS 2000
+#endif
+
+namespace Networking {
+
+// A point in time after which an operation should give up. Passed down
+// through a call so that connecting, sending and receiving share one budget
+// instead of each waiting their own timeout. A default-constructed deadline
+// never expires.
+class Deadline {
+public:
+Deadline();
+
+// Expires _pTimeout from now
+static Deadline After(std::chrono::milliseconds _pTimeout);
+static Deadline Never();
+
+// Returns true if the deadline can expire at all
+bool IsSet() const;
+bool Expired() const;
+
+// Time left before expiry; zero once expired and the maximum duration if unset
+std::chrono::milliseconds Remaining() const;
+
+// Remaining time as a poll(2) timeout: -1 if unset, rounded up otherwise so
+// that a wait never ends just before the deadline
+int PollTimeout() const;
+
+private:
+bool set = false;
+std::chrono::steady_clock::time_point expiry;
+};
+
+// How often and how far apart a transient failure is retried. Delays grow
+// exponentially and are drawn uniformly below the current cap ("full jitter"),
+// so peers that failed together do not retry in lockstep.
+struct RetryPolicy {
+	int maxRetries = MAX_RETRIES;
+	std::chrono::milliseconds initialDelay{RETRY_INITIAL_DELAY_MS};
+	std::chrono::milliseconds maxDelay{RETRY_MAX_DELAY_MS};
+
+	// Delay before retry number _pRetry, counting from zero
+	std::chrono::milliseconds BackoffDelay(int _pRetry) const;
+
+	// Sleeps before retry number _pRetry. Returns false without sleeping if
+	// the retries are used up or the delay would run past _pDeadline.
+	bool WaitBeforeRetry(int _pRetry, const Deadline& _pDeadline = Deadline()) const;
+};
+
+// Tracks the health of remote peers so that calls to a peer known to be down
+// fail immediately instead of each waiting for a connect timeout. After
+// failureThreshold consecutive failures a peer's circuit opens and Allow
+// refuses it; once openDuration has passed, one caller is let through as a
+// probe, and its outcome closes or reopens the circuit. Safe to use from any thread.
+class CircuitBreaker {
+public:
+
+enum class State {
+	Closed,  // Calls go through
+	Open,    // Calls are refused until the open duration has passed
+	HalfOpen // One probe call is in flight
+};
+
+CircuitBreaker(int _pFailureThreshold = 5, std::chrono::milliseconds _pOpenDuration = std::chrono::seconds(5));
+
+CircuitBreaker(const CircuitBreaker&) = delete;
+CircuitBreaker& operator=(const CircuitBreaker&) = delete;
+
+// Returns true if a call to _pPeer may proceed; the caller must then report
+// the outcome with RecordSuccess or RecordFailure
+bool Allow(const std::string& _pPeer);
+void RecordSuccess(const std::string& _pPeer);
+void RecordFailure(const std::string& _pPeer);
+
+State GetState(const std::string& _pPeer) const;
+
+// Forgets all peers
+void Reset();
+
+// Breaker shared by Client connections and the ConnectionPool
+static CircuitBreaker& Default();
+
+private:
+
+struct Peer {
+	State state = State::Closed;
+	int consecutiveFailures = 0;
+	std::chrono::steady_clock::time_point openedAt;
+};
+
+int failureThreshold;
+std::chrono::milliseconds openDuration;
+mutable std::mutex mutex;
+std::unordered_map<std::string, Peer> peers;
+};
+
+}
+
+#endif
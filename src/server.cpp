@@ -1,4 +1,5 @@
 #include "server.h"
+#include "uringloop.h"
 
 Networking::Server::Server(int _pPortNumber, ServerType _pServerType,const std::string& _pLogFile) : logger(_pLogFile)
 {
@@ -9,6 +10,13 @@ Networking::Server::Server(int _pPortNumber, ServerType _pServerType,const std::
 }
 
 
+Networking::Server::Server(const std::string& _pSocketPath, const std::string& _pLogFile) : logger(_pLogFile)
+{
+	serverType = ServerType::Unix;
+	Networking::Server::InitServer();
+	Networking::Server::CreateUnixServerSocket(_pSocketPath);
+}
+
 Networking::Server::~Server()
 {
 }
@@ -65,64 +73,60 @@ bool Networking::Server::CreateServerSocket(int _pPortNumber,  ServerType _pServ
 
 
 
-void Networking::Server::CreateSocket()
+bool Networking::Server::CreateUnixServerSocket(const std::string& _pSocketPath)
 {
-
-	static int retries =0;
-	try
+	memset(&serverInfo, 0, sizeof(serverInfo));
+	memset(&unixInfo, 0, sizeof(unixInfo));
+	unixInfo.sun_family = AF_UNIX;
+	if(_pSocketPath.size() >= sizeof(unixInfo.sun_path))
 	{
-		// Create the socket
-		serverSocket = socket(serverInfo.sin_family, SOCK_STREAM, IPPROTO_TCP);
-		// Check for errors
-		if (INVALIDSOCKET(serverSocket))
-		{
-			// Get the error code
-			int errorCode = GETERROR();
-			// Throw an exception
-			ThrowSocketException(serverSocket, errorCode);
-		}
-		retries =0;
+		logger.log("Unix socket path too long: " + _pSocketPath);
+		std::exit(EXIT_FAILURE);
 	}
+	memcpy(unixInfo.sun_path, _pSocketPath.c_str(), _pSocketPath.size() + 1);
+
+	// A socket file outlives the server that bound it, and bind fails while it exists
+	unlink(unixInfo.sun_path);
+	CreateSocket();
+	BindSocket();
+	ListenOnSocket();
+	serverIsConnected = true;
+	return true;
+}
 
-	catch(Networking::NetworkException &ex)
+void Networking::Server::CreateSocket()
+{
+	for(int retry = 0; ; retry++)
 	{
-		switch (ex.GetErrorCode())
+		try
 		{
-		case EACCES:
-			logger.log(ex.what());
-			std::exit(EXIT_FAILURE);
-
-		case EAFNOSUPPORT:
-			logger.log(ex.what());
-			std::exit(EXIT_FAILURE);
-
-		case EADDRINUSE:
-			if(retries < MAX_RETRIES)
-			{
-				retries++;
-				std::this_thread::sleep_for(std::chrono::seconds(RETRY_DELAY));
-				CreateSocket();
-			}
-
+			// Create the socket
+			if(serverType == ServerType::Unix)
+				serverSocket = socket(AF_UNIX, SOCK_STREAM, 0);
 			else
+				serverSocket = socket(serverInfo.sin_family, SOCK_STREAM, IPPROTO_TCP);
+			// Check for errors
+			if (INVALIDSOCKET(serverSocket))
 			{
-				logger.log(ex.what());
-				std::exit(EXIT_FAILURE);
-			}
-		case EINTR:
-			if(retries < MAX_RETRIES)
-			{
-				retries++;
-				std::this_thread::sleep_for(std::chrono::seconds(RETRY_DELAY));
-				CreateSocket();
+				// Get the error code
+				int errorCode = GETERROR();
+				// Throw an exception
+				ThrowSocketException(serverSocket, errorCode);
 			}
+			// Connections closed by the server linger in TIME_WAIT; allow rebinding the port meanwhile
+			int reuseAddress = 1;
+			setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuseAddress, sizeof(reuseAddress));
+			if(reusePort)
+				setsockopt(serverSocket, SOL_SOCKET, SO_REUSEPORT, (const char*)&reuseAddress, sizeof(reuseAddress));
+			return;
+		}
 
-			else
-			{
-				logger.log(ex.what());
-				std::exit(EXIT_FAILURE);
-			}
-		default:
+		catch(Networking::NetworkException &ex)
+		{
+			// A busy address or an interrupted call may succeed on another attempt; anything else is fatal
+			int errorCode = ex.GetErrorCode();
+			if((errorCode == EADDRINUSE || errorCode == EINTR) && retryPolicy.WaitBeforeRetry(retry))
+				continue;
 			logger.log(ex.what());
 			std::exit(EXIT_FAILURE);
 		}
@@ -131,86 +135,55 @@ void Networking::Server::CreateSocket()
 
 void Networking::Server::BindSocket()
 {
-	static int retries=0;
-	// Bind the socket to a local address and port
-	try{
-		if (bind(serverSocket, (sockaddr*)&serverInfo, sizeof(serverInfo)) == SOCKET_ERROR)
-		{
-			// Get the error code
-			int errorCode = GETERROR();
-			// Throw an exception
-			ThrowBindException(serverSocket, errorCode);
-		}
-		retries = 0;
-	}
-	catch(Networking::NetworkException &ex)
+	for(int retry = 0; ; retry++)
 	{
-
-		switch(ex.GetErrorCode())
-		{
-		case EADDRINUSE:
-			if(retries < MAX_RETRIES)
-			{
-				retries++;
-				std::this_thread::sleep_for(std::chrono::seconds(RETRY_DELAY));
-				BindSocket();
-			}
-			else
-			{
-				logger.log(ex.what());
-				std::exit(EXIT_FAILURE);
-			}
-		case EADDRNOTAVAIL:
-			if(retries < MAX_RETRIES)
-			{
-				retries++;
-				std::this_thread::sleep_for(std::chrono::seconds(RETRY_DELAY));
-				BindSocket();
-			}
+		// Bind the socket to a local address and port
+		try{
+			int bindResult;
+			if(serverType == ServerType::Unix)
+				bindResult = bind(serverSocket, (sockaddr*)&unixInfo, sizeof(unixInfo));
 			else
+				bindResult = bind(serverSocket, (sockaddr*)&serverInfo, sizeof(serverInfo));
+			if (bindResult == SOCKET_ERROR)
 			{
-				logger.log(ex.what());
-				std::exit(EXIT_FAILURE);
+				// Get the error code
+				int errorCode = GETERROR();
+				// Throw an exception
+				ThrowBindException(serverSocket, errorCode);
 			}
-
-		default:
+			return;
+		}
+		catch(Networking::NetworkException &ex)
+		{
+			// The address may be released by a previous instance that is still shutting down
+			int errorCode = ex.GetErrorCode();
+			if((errorCode == EADDRINUSE || errorCode == EADDRNOTAVAIL) && retryPolicy.WaitBeforeRetry(retry))
+				continue;
 			logger.log(ex.what());
 			std::exit(EXIT_FAILURE);
 		}
-
 	}
 }
 
 void Networking::Server::ListenOnSocket()
 {
-	static int retries =0;
-	try{
-		// Start listening for incoming connections
-		if (listen(serverSocket, SOMAXCONN) == SOCKET_ERROR)
-		{
-			// Get the error code
-			int errorCode = GETERROR();
-			// Throw an exception
-			ThrowListenException(serverSocket, errorCode);
-		}
-		retries =0;
-	}
-	catch (Networking::NetworkException &ex)
+	for(int retry = 0; ; retry++)
 	{
-		switch(ex.GetErrorCode())
-		{
-		case EADDRINUSE:
-			if(retries < MAX_RETRIES)
+		try{
+			// Start listening for incoming connections
+			if (listen(serverSocket, SOMAXCONN) == SOCKET_ERROR)
 			{
-				retries++;
-				std::this_thread::sleep_for(std::chrono::seconds(RETRY_DELAY));
-				ListenOnSocket();
-			}
-			else{
-				logger.log(ex.what());
-				std::exit(EXIT_FAILURE);
+				// Get the error code
+				int errorCode = GETERROR();
+				// Throw an exception
+				ThrowListenException(serverSocket, errorCode);
 			}
-		default:
+			return;
+		}
+		catch (Networking::NetworkException &ex)
+		{
+			if(ex.GetErrorCode() == EADDRINUSE && retryPolicy.WaitBeforeRetry(retry))
+				continue;
 			logger.log(ex.what());
 			std::exit(EXIT_FAILURE);
 		}
@@ -218,16 +191,30 @@ void Networking::Server::ListenOnSocket()
 }
 
 Networking::ClientConnection Networking::Server::Accept()
+{
+	Result<Networking::ClientConnection> client = TryAccept();
+	if(!client)
+	{
+		logger.log(ErrorMessage(Error::acceptMap, client.GetError().code));
+		return Networking::ClientConnection();
+	}
+	return client.Value();
+}
+
+Networking::Result<Networking::ClientConnection> Networking::Server::TryAccept()
 {
 // Create a client connection structure to store information about the client
 	Networking::ClientConnection client;
 
-	static int retries =0;
-// Accept a connection from a client
-
-	try{
-
-		if(serverInfo.sin_family == AF_INET)
+// Accept a connection from a client, retrying calls interrupted by a signal
+	for(int retry = 0; ; retry++)
+	{
+		if(serverType == ServerType::Unix)
+		{
+			// Unix domain peers have no address worth keeping
+			client.clientSocket = accept(serverSocket, NULL, NULL);
+		}
+		else if(serverInfo.sin_family == AF_INET)
 		{
 			int clientAddrSize = sizeof(client.clientInfo);
 			client.clientSocket = accept(serverSocket, (sockaddr*)&client.clientInfo, (socklen_t *)&clientAddrSize);
@@ -237,57 +224,279 @@ Networking::ClientConnection Networking::Server::Accept()
 			int clientAddrSize = sizeof(client.clientInfo6);
 			client.clientSocket = accept(serverSocket, (sockaddr*)&client.clientInfo6, (socklen_t *)&clientAddrSize);
 		}
-// If there was an error, throw an exception
-		if ( INVALIDSOCKET(client.clientSocket))
-		{
-			// Get the error code
-			int errorCode = GETERROR();
-			Networking::ThrowAcceptException(serverSocket, errorCode);
-		}
-		retries = 0;
+		if(!INVALIDSOCKET(client.clientSocket))
+			break;
+
+		int errorCode = GETERROR();
+		#ifdef _WIN32
+		bool interrupted = errorCode == WSAEINTR;
+		#else
+		bool interrupted = errorCode == EINTR;
+		#endif
+		// An interrupted accept can be repeated at once; there is nothing to back off from
+		if(interrupted && retry < retryPolicy.maxRetries)
+			continue;
+		return Result<Networking::ClientConnection>::Failure(errorCode);
 	}
 
-	catch(NetworkException &ex)
+// Add the client connection to the table, unless it is full
+	if(!connections.Insert(client))
 	{
-		switch (ex.GetErrorCode())
+		logger.log("Refusing connection from " + GetClientIPAddress(client) + ": " + std::to_string(connections.Size()) + " connections are open");
+		CLOSESOCKET(client.clientSocket);
+		return Result<Networking::ClientConnection>::Failure(EMFILE);
+	}
+	logger.log("New connection from " + GetClientIPAddress(client));
+	return client;
+}
+
+Networking::ServerMode Networking::ParseServerMode(const std::string& _pName)
+{
+	if(_pName == "epoll")
+		return ServerMode::Epoll;
+	if(_pName == "uring")
+		return ServerMode::Uring;
+	return ServerMode::Blocking;
+}
+
+void Networking::Server::Run(MessageHandler _pHandler, ServerMode _pMode, ThreadPool* _pExecutor)
+{
+	running = true;
+	if(_pMode == ServerMode::Uring && !UringLoop::IsSupported())
+	{
+		logger.log("io_uring is not available, serving in epoll mode: " + std::string(strerror(errno)));
+		_pMode = ServerMode::Epoll;
+	}
+	std::thread reaper(&Server::RunIdleReaper, this);
+	if(_pMode == ServerMode::Epoll || _pMode == ServerMode::Uring)
+		RunEventLoop(_pHandler, _pExecutor, _pMode == ServerMode::Uring);
+	else
+		RunBlocking(_pHandler, _pExecutor);
+	{
+		std::lock_guard<std::mutex> lock(reaperMutex);
+		running = false;
+	}
+	reaperWake.notify_all();
+	reaper.join();
+}
+
+void Networking::Server::RunIdleReaper()
+{
+	std::unique_lock<std::mutex> lock(reaperMutex);
+	while(running)
+	{
+		// The tick is read each time, since SetIdleTimeout may change it
+		reaperWake.wait_for(lock, connections.GetTickLength());
+		if(!running)
+			break;
+		lock.unlock();
+		ReapIdleConnections();
+		lock.lock();
+	}
+}
+
+size_t Networking::Server::ReapIdleConnections()
+{
+	std::vector<std::string> reaped;
+	size_t count = connections.ExpireIdle(std::chrono::steady_clock::now(), [&](const ClientConnection& _pClient) {
+		// Only shut down: the descriptor still belongs to the thread or loop
+		// serving it, which closes it once it sees the connection end
+		shutdown(_pClient.clientSocket, SHUT_RDWR);
+		reaped.push_back(GetClientIPAddress(_pClient));
+	});
+	// Logged outside the table's locks
+	for(const std::string& address : reaped)
+		logger.log("Closing idle connection from " + address);
+	return count;
+}
+
+void Networking::Server::RunBlocking(MessageHandler _pHandler, ThreadPool* _pExecutor)
+{
+	while(running && ServerIsRunning())
+	{
+		// Accept returns an invalid socket on failure or once Stop() closed the listener
+		Networking::ClientConnection client = Accept();
+		if(INVALIDSOCKET(client.clientSocket))
+			continue;
+
+		if(keepAlive)
 		{
-			#ifdef _WIN32
+			// A receive that times out ends the connection instead of holding the thread forever
+			timeval timeout;
+			timeout.tv_sec = idleTimeout.count() / 1000;
+			timeout.tv_usec = (idleTimeout.count() % 1000) * 1000;
+			setsockopt(client.clientSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		}
 
-		case WSAEINTR:
-			if(retries <MAX_RETRIES)
+		auto serveClient = [this, _pHandler, client]() {
+			// Requests on one connection are handled in turn, so each reply can carry the current ID
+			Networking::ClientConnection current = client;
+			do
 			{
-				retries++;
-				std::this_thread::sleep_for(std::chrono::seconds(RETRY_DELAY));
-				Accept();
-			}
-			logger.log(ex.what());
-			return Networking::ClientConnection();
+				FrameHeader header;
+				Result<SharedBuffer> message = TryReceiveFrame(current, header);
+				if(!message)
+				{
+					LogFrameError(current, message.GetError());
+					break;
+				}
+				if(message.Value()->empty())
+					break;
+				current.requestId = header.requestId;
+				current.replyCodec = GetReplyCodec(header);
+				_pHandler(current, *message.Value());
+			} while(keepAlive && running);
+			DisconnectClient(client);
+		};
+
+		if(_pExecutor == nullptr)
+		{
+			std::thread(serveClient).detach();
+			continue;
+		}
+		// Submit blocks while the pool's queue is full, which stops accepting
+		// until the workers catch up
+		if(!_pExecutor->Submit(serveClient))
+		{
+			logger.log("Thread pool is shut down; dropping connection from " + GetClientIPAddress(client));
+			DisconnectClient(client);
+		}
+	}
+}
 
-			#else
+void Networking::Server::RunEventLoop(MessageHandler _pHandler, ThreadPool* _pExecutor, bool _pUseUring)
+{
+	// Listeners after the first share the port through SO_REUSEPORT
+	std::vector<SOCKET> listeners(1, serverSocket);
+	for(size_t i = 1; i < listenerCount; i++)
+	{
+		SOCKET listener = OpenReusePortListener();
+		if(INVALIDSOCKET(listener))
+			break;
+		listeners.push_back(listener);
+	}
 
-		case EINTR:
-			if(retries <  MAX_RETRIES)
+	{
+		std::lock_guard<std::mutex> lock(eventLoopMutex);
+		if(running)
+		{
+			for(size_t i = 0; i < listeners.size(); i++)
 			{
-				retries++;
-				std::this_thread::sleep_for(std::chrono::seconds(RETRY_DELAY));
-				Accept();
+				std::unique_ptr<ServerLoop> loop;
+				if(_pUseUring)
+					loop.reset(new UringLoop(listeners[i], _pHandler, logger, maxMessageSize, _pExecutor));
+				else
+					loop.reset(new EventLoop(listeners[i], _pHandler, logger, maxMessageSize, _pExecutor));
+				loop->SetKeepAlive(keepAlive);
+				loop->SetListenerIndex(i);
+				loop->SetConnectionTable(&connections);
+				eventLoops.push_back(std::move(loop));
 			}
+		}
+	}
 
-			logger.log(ex.what());
-			return Networking::ClientConnection();
+	if(!eventLoops.empty())
+	{
+		// The loops are only destroyed below, so they are safe to use without the lock
+		std::vector<std::thread> loopThreads;
+		for(size_t i = 1; i < eventLoops.size(); i++)
+			loopThreads.emplace_back(&ServerLoop::Run, eventLoops[i].get());
+		eventLoops[0]->Run();
+		for(auto& thread : loopThreads)
+			thread.join();
+
+		std::lock_guard<std::mutex> lock(eventLoopMutex);
+		eventLoops.clear();
+	}
 
-			#endif
+	for(size_t i = 1; i < listeners.size(); i++)
+		CLOSESOCKET(listeners[i]);
+	Shutdown();
+}
 
-		default:
-			logger.log(ex.what());
-			return Networking::ClientConnection();
+void Networking::Server::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(reaperMutex);
+		running = false;
+	}
+	reaperWake.notify_all();
+	{
+		std::lock_guard<std::mutex> lock(eventLoopMutex);
+		if(!eventLoops.empty())
+		{
+			// RunEventLoop shuts the listeners down once the loops have exited
+			for(auto& loop : eventLoops)
+				loop->Stop();
+			return;
 		}
 	}
+	// Closing the listener wakes a thread blocked in Accept
+	Shutdown();
+}
 
-// Add the client connection to the list of clients
-	clients.push_back(client);
-	logger.log("New connection from " + GetClientIPAddress(client));
-	return client;
+void Networking::Server::SetListenerCount(size_t _pListenerCount)
+{
+	// The kernel does not balance Unix domain sockets across SO_REUSEPORT listeners
+	listenerCount = serverType == ServerType::Unix ? 1 : std::max<size_t>(_pListenerCount, 1);
+	if(listenerCount == 1 || reusePort || !serverIsConnected)
+		return;
+
+	// SO_REUSEPORT only groups sockets that all set it before binding
+	reusePort = true;
+	CLOSESOCKET(serverSocket);
+	CreateSocket();
+	BindSocket();
+	ListenOnSocket();
+}
+
+size_t Networking::Server::GetListenerCount() const
+{
+	return listenerCount;
+}
+
+SOCKET Networking::Server::OpenReusePortListener()
+{
+	SOCKET listener = socket(serverInfo.sin_family, SOCK_STREAM, IPPROTO_TCP);
+	if(INVALIDSOCKET(listener))
+	{
+		logger.log("Unable to create listener: " + std::string(strerror(GETERROR())));
+		return listener;
+	}
+	int enable = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&enable, sizeof(enable));
+	setsockopt(listener, SOL_SOCKET, SO_REUSEPORT, (const char*)&enable, sizeof(enable));
+	if(bind(listener, (sockaddr*)&serverInfo, sizeof(serverInfo)) == SOCKET_ERROR || listen(listener, SOMAXCONN) == SOCKET_ERROR)
+	{
+		logger.log("Unable to open additional listener: " + std::string(strerror(GETERROR())));
+		CLOSESOCKET(listener);
+		return -1;
+	}
+	return listener;
+}
+
+Networking::ServerLoop* Networking::Server::GetEventLoop(const Networking::ClientConnection& _pClient)
+{
+	if(_pClient.listenerIndex < eventLoops.size())
+		return eventLoops[_pClient.listenerIndex].get();
+	return nullptr;
+}
+
+bool Networking::Server::OwnedByEventLoop(const Networking::ClientConnection& _pClient)
+{
+	std::lock_guard<std::mutex> lock(eventLoopMutex);
+	return GetEventLoop(_pClient) != nullptr;
+}
+
+Networking::Result<long> Networking::Server::QueueOnEventLoop(const Networking::ClientConnection& _pClient, std::vector<char>&& _pData, long _pLength)
+{
+	std::lock_guard<std::mutex> lock(eventLoopMutex);
+	// A loop that stopped since the caller checked has closed its connections,
+	// and the loop refuses data only for a connection it has already closed
+	ServerLoop* loop = GetEventLoop(_pClient);
+	if(loop == nullptr || !loop->QueueSend(_pClient.clientSocket, std::move(_pData)))
+		return Result<long>::Failure(ENOTCONN);
+	return _pLength;
 }
 
 void Networking::Server::SetSocketType(int _pSocktype)
@@ -309,90 +518,92 @@ void Networking::Server::SetFamily(int _pFamily)
 // Send data to the client
 int Networking::Server::Send(PCSTR _pSendBuffer, Networking::ClientConnection _pClient)
 {
-	static int retries =0;
-	int bytesSent;
-	try{
-
-		// Send the data to the client
-		bytesSent = send(_pClient.clientSocket,_pSendBuffer, strlen(_pSendBuffer),0 );
+	return Send(_pSendBuffer, strlen(_pSendBuffer), _pClient);
+}
 
-		// If there was an error, throw an exception
-		if(bytesSent == SOCKET_ERROR)
+// Send a buffer of known length to the client
+int Networking::Server::Send(const char* _pData, size_t _pLength, Networking::ClientConnection _pClient)
+{
+	Result<long> bytesSent = TrySend(_pData, _pLength, _pClient);
+	if(!bytesSent)
+	{
+		// A connection an event loop refused is already closed by the loop
+		if(!OwnedByEventLoop(_pClient))
 		{
-			// Get the error code
-			int errorCode = GETERROR();
-
-			// Throw the error code
-			Networking::ThrowSendException(_pClient.clientSocket, errorCode);
-
+			logger.log(ErrorMessage(Error::sendMap, bytesSent.GetError().code));
+			DisconnectClient(_pClient);
 		}
-		retries =0;
+		return SOCKET_ERROR;
 	}
+	// Return the number of bytes sent if the data was sent successfully
+	return (int)bytesSent.Value();
+}
 
-	catch (Networking::NetworkException &ex)
+Networking::Result<long> Networking::Server::TrySend(const char* _pData, size_t _pLength, Networking::ClientConnection _pClient)
+{
+	if(OwnedByEventLoop(_pClient))
 	{
-		switch(ex.GetErrorCode())
-		{
-		case EAGAIN:
-			if(retries < MAX_RETRIES)
-			{
-				retries++;
-				std::this_thread::sleep_for(std::chrono::seconds(RETRY_DELAY));
-				Send(_pSendBuffer, _pClient);
-			}
-			else
-			{
-				logger.log(ex.what());
-				DisconnectClient(_pClient);
-				break;
-			}
+		// The queue owns what it writes, so the data is copied here, outside eventLoopMutex
+		return QueueOnEventLoop(_pClient, std::vector<char>(_pData, _pData + _pLength), (long)_pLength);
+	}
 
-		case EINTR:
-			if(retries < MAX_RETRIES)
-			{
-				retries++;
-				std::this_thread::sleep_for(std::chrono::seconds(RETRY_DELAY));
-				Send(_pSendBuffer, _pClient);
-			}
-			else
-			{
-				logger.log(ex.what());
-				DisconnectClient(_pClient);
-				break;
-			}
+	for(int retry = 0; ; retry++)
+	{
+		// Send the data to the client
+		long bytesSent = send(_pClient.clientSocket, _pData, _pLength, MSG_NOSIGNAL);
+		if(bytesSent != SOCKET_ERROR)
+		{
+			connections.Touch(_pClient.clientSocket);
+			return bytesSent;
+		}
 
-		case EINPROGRESS:
-			if(retries < MAX_RETRIES)
-			{
-				retries++;
-				std::this_thread::sleep_for(std::chrono::seconds(RETRY_DELAY));
-				Send(_pSendBuffer, _pClient);
-			}
-			else
-			{
-				logger.log(ex.what());
-				DisconnectClient(_pClient);
-				break;
-			}
+		// A full send buffer or an interrupted call is retried after a jittered backoff
+		IoError error = IoError::FromCode(GETERROR());
+		if(error.IsTransient() && retryPolicy.WaitBeforeRetry(retry))
+			continue;
+		return error;
+	}
+}
 
-		default:
-			logger.log(ex.what());
+// Send several buffers to the client as one stream
+long Networking::Server::Send(const iovec* _pVectors, size_t _pCount, Networking::ClientConnection _pClient)
+{
+	Result<long> bytesSent = TrySend(_pVectors, _pCount, _pClient);
+	if(!bytesSent)
+	{
+		if(!OwnedByEventLoop(_pClient))
+		{
+			logger.log("Send to " + GetClientIPAddress(_pClient) + " failed: " + bytesSent.GetError().Message());
 			DisconnectClient(_pClient);
-			break;
-
 		}
+		return SOCKET_ERROR;
+	}
+	return bytesSent.Value();
+}
 
+Networking::Result<long> Networking::Server::TrySend(const iovec* _pVectors, size_t _pCount, Networking::ClientConnection _pClient)
+{
+	if(OwnedByEventLoop(_pClient))
+	{
+		// The queue owns what it writes, so the buffers are joined once here,
+		// outside eventLoopMutex
+		std::vector<char> data;
+		for(size_t i = 0; i < _pCount; i++)
+			data.insert(data.end(), (const char*)_pVectors[i].iov_base, (const char*)_pVectors[i].iov_base + _pVectors[i].iov_len);
+		long length = data.size();
+		return QueueOnEventLoop(_pClient, std::move(data), length);
 	}
 
-	// Return  the number of bytes sent if the data was sent successfully
+	long bytesSent = WriteVectorFully(_pClient.clientSocket, _pVectors, _pCount);
+	if(bytesSent == SOCKET_ERROR)
+		return Result<long>::Failure(GETERROR());
+	connections.Touch(_pClient.clientSocket);
 	return bytesSent;
 }
 
 // Send data to a specified address and port
 int Networking::Server::SendTo(PCSTR _pBuffer, PCSTR _pAddress, int _pPort)
 {
-	static int retries=0;
-	int bytesSent=0;
 	// Create a sockaddr_in structure to hold the address and port of the recipient
 	sockaddr_storage sockAddress;
 	ZeroMemory(&sockAddress, sizeof(sockAddress));
@@ -418,372 +629,507 @@ int Networking::Server::SendTo(PCSTR _pBuffer, PCSTR _pAddress, int _pPort)
 		inet_pton(serverInfo.sin_family, _pAddress, &recipient->sin6_addr);
 	}
 
-	try{
+	for(int retry = 0; ; retry++)
+	{
 		// Send the data to the specified recipient
-		bytesSent = sendto(serverSocket, _pBuffer, strlen(_pBuffer), 0, (sockaddr*)&sockAddress, sizeof(sockAddress));
+		int bytesSent = sendto(serverSocket, _pBuffer, strlen(_pBuffer), 0, (sockaddr*)&sockAddress, sizeof(sockAddress));
 
-		// If there was an error, throw an exception
-		if(bytesSent == SOCKET_ERROR)
-		{
-			// Get the error code
-			int errorCode = GETERROR();
-			ThrowSendException(serverSocket, errorCode);
-		}
+		// Return the number of bytes sent if the data was sent successfully
+		if(bytesSent != SOCKET_ERROR)
+			return bytesSent;
 
-		retries = 0;
+		IoError error = IoError::FromCode(GETERROR());
+		if(error.IsTransient() && retryPolicy.WaitBeforeRetry(retry))
+			continue;
+		logger.log(ErrorMessage(Error::sendMap, error.code));
+		return SOCKET_ERROR;
 	}
+}
 
-	catch(Networking::NetworkException &ex)
+
+// Send data to all connected clients
+int Networking::Server::SendToAll(PCSTR _pSendBuffer)
+{
+	size_t length = strlen(_pSendBuffer);
+	SharedBuffer data = BufferPool::Default().Acquire(length);
+	memcpy(data->data(), _pSendBuffer, length);
+
+	// A client that cannot keep up would otherwise see the stream with a gap in it
+	BroadcastOptions options;
+	options.policy = SlowReceiverPolicy::Disconnect;
+	BroadcastBuffer(data, DeliveryCallback(), options);
+	return (int)length;
+}
+
+size_t Networking::Server::Broadcast(const char* _pData, size_t _pLength, DeliveryCallback _pOnDelivery, const BroadcastOptions& _pOptions)
+{
+	if(_pLength > maxMessageSize)
 	{
-		switch(ex.GetErrorCode())
-		{
-		case EAGAIN:
-			if(retries < MAX_RETRIES)
-			{
-				retries++;
-				std::this_thread::sleep_for(std::chrono::seconds(RETRY_DELAY));
-				SendTo(_pBuffer, _pAddress, _pPort);
-			}
-			else
-			{
-				logger.log(ex.what());
-				break;
-			}
+		logger.log("Refusing to broadcast frame of " + std::to_string(_pLength) + " bytes");
+		return 0;
+	}
 
-		case EINTR:
-			if(retries < MAX_RETRIES)
-			{
-				retries++;
-				std::this_thread::sleep_for(std::chrono::seconds(RETRY_DELAY));
-				SendTo(_pBuffer, _pAddress, _pPort);
-			}
-			else
-			{
-				logger.log(ex.what());
-				break;
-			}
+	FrameHeader header;
+	header.payloadLength = _pLength;
+	SharedBuffer frame = BufferPool::Default().Acquire(FRAME_HEADER_SIZE + _pLength);
+	EncodeFrameHeader(header, frame->data());
+	if(_pLength > 0)
+		memcpy(frame->data() + FRAME_HEADER_SIZE, _pData, _pLength);
+	return BroadcastBuffer(frame, _pOnDelivery, _pOptions);
+}
 
-		case EINPROGRESS:
-			if(retries < MAX_RETRIES)
-			{
-				retries++;
-				std::this_thread::sleep_for(std::chrono::seconds(RETRY_DELAY));
-				SendTo(_pBuffer, _pAddress, _pPort);
-			}
-			else
+size_t Networking::Server::BroadcastBuffer(const SharedBuffer& _pData, const DeliveryCallback& _pOnDelivery, const BroadcastOptions& _pOptions)
+{
+	ConnectionTable::Snapshot clients = connections.GetSnapshot();
+	for(const ClientConnection& client : *clients)
+	{
+		{
+			std::lock_guard<std::mutex> lock(eventLoopMutex);
+			if(ServerLoop* loop = GetEventLoop(client))
 			{
-				logger.log(ex.what());
-				break;
+				// The completion reports Failed if the loop has stopped and drops it
+				std::unique_ptr<WriteCompletion> completion(new WriteCompletion([_pOnDelivery, client](DeliveryStatus _pStatus) {
+					if(_pOnDelivery)
+						_pOnDelivery(client, _pStatus);
+				}));
+				loop->QueueShared(client.clientSocket, _pData, _pOptions.highWaterMark, _pOptions.policy, std::move(completion));
+				continue;
 			}
+		}
 
-		default:
-			logger.log(ex.what());
-			break;
+		DeliveryStatus status = SendWithoutWaiting(client, *_pData, _pOptions.policy);
+		if(_pOnDelivery)
+			_pOnDelivery(client, status);
+	}
+	return clients->size();
+}
 
+Networking::DeliveryStatus Networking::Server::SendWithoutWaiting(const Networking::ClientConnection& _pClient, const std::vector<char>& _pData, SlowReceiverPolicy _pPolicy)
+{
+	size_t written = 0;
+	while(written < _pData.size())
+	{
+		ssize_t bytesSent = send(_pClient.clientSocket, _pData.data() + written, _pData.size() - written, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if(bytesSent >= 0)
+		{
+			written += bytesSent;
+			continue;
 		}
+		IoError error = IoError::FromCode(GETERROR());
+		if(error.kind == ErrorKind::Interrupted)
+			continue;
+		if(error.kind != ErrorKind::WouldBlock)
+			return DeliveryStatus::Failed;
+		if(written == 0 && _pPolicy == SlowReceiverPolicy::Drop)
+			return DeliveryStatus::Dropped;
+
+		// Only shut down: the thread serving the client closes it once it sees
+		// the connection end, just as for an idle one
+		shutdown(_pClient.clientSocket, SHUT_RDWR);
+		logger.log("Closing slow broadcast receiver " + GetClientIPAddress(_pClient));
+		return DeliveryStatus::Disconnected;
 	}
-	// Return  the number of bytes sent if the data was sent successfully
-	return bytesSent;
+	connections.Touch(_pClient.clientSocket);
+	return DeliveryStatus::Sent;
 }
 
 
-// Send data to all connected clients
-int Networking::Server::SendToAll(PCSTR _pSendBuffer)
-{
 
-	int bytesSent;
-	int retries =0;
-	// Iterate over all connected clients
-	for (auto client : clients)
+// Send a file to the server
+long long Networking::Server::SendFile(const std::string& _pFilePath, Networking::ClientConnection client, uint64_t _pOffset, uint64_t _pLength)
+{
+	long long bytesSent = SendFileRange(client.clientSocket, _pFilePath, _pOffset, _pLength);
+	if(bytesSent == SOCKET_ERROR)
 	{
-		try
-		{
-			// Send the data to the current client
-			bytesSent = send(client.clientSocket, _pSendBuffer, strlen(_pSendBuffer), 0);
+		logger.log("Sending " + _pFilePath + " to " + GetClientIPAddress(client) + " failed: " + std::string(strerror(GETERROR())));
+		return SOCKET_ERROR;
+	}
+	logger.log("Sent " + _pFilePath + " to " + GetClientIPAddress(client));
+	return bytesSent;
+}
 
-			// If there was an error, throw an exception
-			if (bytesSent == SOCKET_ERROR)
-			{
-				// Get the error code
-				int errorCode = GETERROR();
-				ThrowSendException(client.clientSocket, errorCode);
-			}
-		}
 
-		catch(Networking::NetworkException &ex)
+// Receive data from the server
+std::vector <char> Networking::Server::Receive(Networking::ClientConnection client)
+{
+	Result<std::vector<char>> received = TryReceive(client);
+	if(!received)
+	{
+		// An orderly close leaves the socket to the caller, as a zero-length read always has
+		if(received.GetError().code != 0)
 		{
-			switch(ex.GetErrorCode())
-			{
-			case EAGAIN:
-				retries =0;
-				while(retries < MAX_RETRIES && bytesSent == SOCKET_ERROR)
-				{
-					retries++;
-					std::this_thread::sleep_for(std::chrono::seconds(RETRY_DELAY));
-					bytesSent = send(client.clientSocket, _pSendBuffer, strlen(_pSendBuffer), 0);
-				}
-
-				if(retries == MAX_RETRIES && bytesSent == SOCKET_ERROR)
-				{
-					DisconnectClient(client);
-				}
+			DisconnectClient(client);
+			logger.log(ErrorMessage(Error::receiveMap, received.GetError().code));
+		}
+		return std::vector<char>();
+	}
 
-				break;
+	// Return the vector containing the received data
+	return std::move(received.Value());
+}
 
-			case EINPROGRESS:
+Networking::Result<std::vector<char>> Networking::Server::TryReceive(Networking::ClientConnection _pClient)
+{
+	// Initialize the number of bytes received to 0
+	int bytesReceived =0;
 
-				retries =0;
-				while(retries < MAX_RETRIES && bytesSent == SOCKET_ERROR)
-				{
-					retries++;
-					std::this_thread::sleep_for(std::chrono::seconds(RETRY_DELAY));
-					bytesSent = send(client.clientSocket, _pSendBuffer, strlen(_pSendBuffer), 0);
-				}
+	// Create a vector to store the received data
+	std::vector<char> receiveBuffer;
 
-				if(retries == MAX_RETRIES && bytesSent == SOCKET_ERROR)
-				{
-					DisconnectClient(client);
-				}
+	// Read through a pooled scratch buffer and append each chunk once, instead
+	// of growing the result 512 bytes at a time
+	SharedBuffer chunk = BufferPool::Default().Acquire(RECEIVE_CHUNK_SIZE);
+	for(int retry = 0; ; retry++)
+	{
+		do{
+			// Receive data from the client
+			bytesReceived = recv(_pClient.clientSocket, chunk->data(), chunk->size(), 0);
+			if(bytesReceived > 0)
+				receiveBuffer.insert(receiveBuffer.end(), chunk->data(), chunk->data() + bytesReceived);
+		} while (bytesReceived == (int)chunk->size());
 
-				break;
+		if(bytesReceived != SOCKET_ERROR)
+			break;
 
+		// An interrupted call is repeated at once, a busy socket after a backoff
+		IoError error = IoError::FromCode(GETERROR());
+		if(error.kind == ErrorKind::Interrupted && retry < retryPolicy.maxRetries)
+			continue;
+		if(error.kind == ErrorKind::WouldBlock && retryPolicy.WaitBeforeRetry(retry))
+			continue;
+		// Data received before the failure is still returned; the error shows up on the next call
+		if(receiveBuffer.empty())
+			return error;
+		break;
+	}
 
-			case EINTR:
-				retries =0;
-				while(retries < MAX_RETRIES && bytesSent == SOCKET_ERROR)
-				{
-					retries++;
-					std::this_thread::sleep_for(std::chrono::seconds(RETRY_DELAY));
-					bytesSent = send(client.clientSocket, _pSendBuffer, strlen(_pSendBuffer), 0);
-				}
+	if(receiveBuffer.empty())
+		return Result<std::vector<char>>::Failure(0);
+	connections.Touch(_pClient.clientSocket);
+	return receiveBuffer;
+}
 
-				if(retries == MAX_RETRIES && bytesSent == SOCKET_ERROR)
-				{
-					DisconnectClient(client);
-				}
 
-				break;
+int Networking::Server::SendFrame(const char* _pData, size_t _pLength, Networking::ClientConnection _pClient)
+{
+	Result<long> bytesSent = TrySendFrame(_pData, _pLength, _pClient);
+	if(!bytesSent)
+	{
+		if(bytesSent.GetError().code == EMSGSIZE)
+			logger.log("Refusing to send frame of " + std::to_string(_pLength) + " bytes to " + GetClientIPAddress(_pClient));
+		else if(!OwnedByEventLoop(_pClient))
+			logger.log("Send frame failed: " + bytesSent.GetError().Message());
+		return SOCKET_ERROR;
+	}
+	return (int)bytesSent.Value();
+}
 
+Networking::Result<long> Networking::Server::TrySendFrame(const char* _pData, size_t _pLength, Networking::ClientConnection _pClient)
+{
+	if(_pLength > maxMessageSize)
+		return Result<long>::Failure(EMSGSIZE);
 
-			default:
-				DisconnectClient(client);
-				break;
-			}
+	FrameHeader header;
+	header.payloadLength = _pLength;
+	header.requestId = _pClient.requestId;
+	CompressionCodec codec = (CompressionCodec)_pClient.replyCodec;
+	bool compress = codec != CompressionCodec::None && _pLength >= compressionThreshold;
 
+	if(OwnedByEventLoop(_pClient))
+	{
+		// The event loop's queue owns the frame, so header and payload are joined
+		// once, compressing straight into place where asked. That happens before
+		// eventLoopMutex is taken, which every sending worker shares
+		std::vector<char> frame(FRAME_HEADER_SIZE + (compress ? CompressedPayloadBound(_pLength) : _pLength));
+		size_t compressed = compress ? CompressFramePayload(codec, _pData, _pLength, &frame[FRAME_HEADER_SIZE]) : 0;
+		if(compressed > 0)
+		{
+			header.flags |= FRAME_FLAG_COMPRESSED;
+			header.codec = (uint8_t)codec;
+			header.payloadLength = compressed;
 		}
+		else if(_pLength > 0)
+			memcpy(&frame[FRAME_HEADER_SIZE], _pData, _pLength);
+		frame.resize(FRAME_HEADER_SIZE + header.payloadLength);
+		EncodeFrameHeader(header, &frame[0]);
+		return QueueOnEventLoop(_pClient, std::move(frame), (long)_pLength);
 	}
 
-	// Return the number of bytes sent if the data was sent successfully
-	return bytesSent;
+	SharedBuffer compressedPayload;
+	if(compress)
+	{
+		compressedPayload = BufferPool::Default().Acquire(CompressedPayloadBound(_pLength));
+		size_t compressed = CompressFramePayload(codec, _pData, _pLength, compressedPayload->data());
+		if(compressed > 0)
+		{
+			header.flags |= FRAME_FLAG_COMPRESSED;
+			header.codec = (uint8_t)codec;
+			header.payloadLength = compressed;
+			_pData = compressedPayload->data();
+		}
+	}
+	char headerBuffer[FRAME_HEADER_SIZE];
+	EncodeFrameHeader(header, headerBuffer);
+
+	// Header and payload go out in one sendmsg, so small frames are not split
+	// across segments and the payload is not copied
+	iovec vectors[2];
+	vectors[0].iov_base = headerBuffer;
+	vectors[0].iov_len = FRAME_HEADER_SIZE;
+	vectors[1].iov_base = (void*)_pData;
+	vectors[1].iov_len = header.payloadLength;
+	if(WriteVectorFully(_pClient.clientSocket, vectors, 2) == SOCKET_ERROR)
+		return Result<long>::Failure(GETERROR());
+	connections.Touch(_pClient.clientSocket);
+	return (long)_pLength;
 }
 
+int Networking::Server::SendFrame(const std::string& _pData, Networking::ClientConnection _pClient)
+{
+	return SendFrame(_pData.data(), _pData.size(), _pClient);
+}
 
+std::vector<char> Networking::Server::ReceiveFrame(Networking::ClientConnection _pClient)
+{
+	uint32_t requestId;
+	return ReceiveFrame(_pClient, requestId);
+}
 
-// Send a file to the server
-void Networking::Server::SendFile(const std::string& _pFilePath, Networking::ClientConnection client)
+std::vector<char> Networking::Server::ReceiveFrame(Networking::ClientConnection _pClient, uint32_t& _pRequestId)
 {
-	// Open the file for reading
-	std::ifstream file(_pFilePath, std::ios::in | std::ios::binary);
+	_pRequestId = 0;
+	Result<FrameHeader> header = ReceiveFrameHeader(_pClient);
+	if(!header)
+	{
+		LogFrameError(_pClient, header.GetError());
+		return std::vector<char>();
+	}
 
-	// Check if the file was opened successfully
-	if(!file)
+	// The header tells us the full size, so the payload is read into one buffer
+	std::vector<char> payload(header.Value().payloadLength);
+	Result<size_t> received = ReceiveFramePayload(_pClient, payload.data(), payload.size());
+	if(!received)
 	{
-		// Throw an exception if the file could not be opened
-		throw std::runtime_error("Error: Unable to open file '" + _pFilePath + "'");
+		LogFrameError(_pClient, received.GetError());
+		return std::vector<char>();
 	}
+	_pRequestId = header.Value().requestId;
+	if(!(header.Value().flags & FRAME_FLAG_COMPRESSED))
+		return payload;
 
-	// Read the file data into a buffer
-	std::vector<char> fileData((std::istreambuf_iterator<char>(file)), (std::istreambuf_iterator<char>()));
+	Result<SharedBuffer> restored = DecompressFramePayload((CompressionCodec)header.Value().codec, payload.data(), payload.size(), maxMessageSize);
+	if(!restored)
+	{
+		LogFrameError(_pClient, restored.GetError());
+		_pRequestId = 0;
+		return std::vector<char>();
+	}
+	return std::vector<char>(restored.Value()->begin(), restored.Value()->end());
+}
 
-	// Send the file data to the server
-	Send(&fileData[0], client);
-	logger.log("Sent " + _pFilePath + " to " + GetClientIPAddress(client));
+Networking::SharedBuffer Networking::Server::ReceiveFrameBuffer(Networking::ClientConnection _pClient, uint32_t& _pRequestId)
+{
+	Result<SharedBuffer> payload = TryReceiveFrame(_pClient, _pRequestId);
+	if(!payload)
+	{
+		LogFrameError(_pClient, payload.GetError());
+		return SharedBuffer();
+	}
+	return std::move(payload.Value());
 }
 
+Networking::Result<Networking::SharedBuffer> Networking::Server::TryReceiveFrame(Networking::ClientConnection _pClient, uint32_t& _pRequestId)
+{
+	FrameHeader header;
+	Result<SharedBuffer> payload = TryReceiveFrame(_pClient, header);
+	_pRequestId = payload ? header.requestId : 0;
+	return payload;
+}
 
-// Receive data from the server
-std::vector <char> Networking::Server::Receive(Networking::ClientConnection client)
+Networking::Result<Networking::SharedBuffer> Networking::Server::TryReceiveFrame(Networking::ClientConnection _pClient, FrameHeader& _pHeader)
 {
-	static int retries =0;
-	// Initialize the number of bytes received to 0
-	int bytesReceived =0;
+	Result<FrameHeader> header = ReceiveFrameHeader(_pClient);
+	if(!header)
+		return header.GetError();
+	_pHeader = header.Value();
+
+	SharedBuffer payload = BufferPool::Default().Acquire(_pHeader.payloadLength);
+	Result<size_t> received = ReceiveFramePayload(_pClient, payload->data(), payload->size());
+	if(!received)
+		return received.GetError();
+	if(!(_pHeader.flags & FRAME_FLAG_COMPRESSED))
+		return payload;
+	return DecompressFramePayload((CompressionCodec)_pHeader.codec, payload->data(), payload->size(), maxMessageSize);
+}
 
-	// Create a vector to store the received data
-	std::vector<char> receiveBuffer;
-	try{
-		// Receive data from the server in a loop
-		do{
-			// Get the current size of the receive buffer
-			int bufferStart = receiveBuffer.size();
-			// Resize the buffer to make room for more data
-			receiveBuffer.resize(bufferStart+512);
-			// Receive data from the server
-			bytesReceived = recv(client.clientSocket, &receiveBuffer[bufferStart],512,0);
-			// Resize the buffer to the actual size of the received data
-			receiveBuffer.resize(bufferStart + bytesReceived);
-		} while (bytesReceived == 512);
+Networking::Result<Networking::FrameHeader> Networking::Server::ReceiveFrameHeader(Networking::ClientConnection _pClient)
+{
+	char headerBuffer[FRAME_HEADER_SIZE];
+	long bytesReceived = ReadFully(_pClient.clientSocket, headerBuffer, FRAME_HEADER_SIZE);
+	if(bytesReceived == SOCKET_ERROR)
+		return Result<FrameHeader>::Failure(GETERROR());
+	// A short read means the peer closed the connection
+	if(bytesReceived != (long)FRAME_HEADER_SIZE)
+		return Result<FrameHeader>::Failure(0);
+	connections.Touch(_pClient.clientSocket);
+
+	FrameHeader header;
+	if(!DecodeFrameHeader(headerBuffer, header))
+		return Result<FrameHeader>::Failure(EPROTO);
+	if(header.payloadLength > maxMessageSize)
+		return Result<FrameHeader>::Failure(EMSGSIZE);
+	return header;
+}
 
-// If there was an error, throw an exception
-		if (bytesReceived == SOCKET_ERROR)
-		{
-			// Get the error code
-			int errorCode = GETERROR();
-			Networking::ThrowReceiveException(client.clientSocket,errorCode);
-		}
-		retries =0;
-	}
-	catch(Networking::NetworkException &ex)
-	{
-		switch(ex.GetErrorCode())
-		{
-		case EAGAIN:
-			if(retries < MAX_RETRIES)
-			{
-				retries++;
-				Receive(client);
-			}
-			else{
-				retries =0;
-				DisconnectClient(client);
-				logger.log(ex.what());
-				break;
-			}
-		case EINTR:
-			if(retries < MAX_RETRIES)
-			{
-				retries++;
-				Receive(client);
-			}
-			else{
-				retries =0;
-				DisconnectClient(client);
-				logger.log(ex.what());
-				break;
-			}
-		default:
-			DisconnectClient(client);
-			logger.log(ex.what());
-			break;
-		}
-	}
+Networking::Result<size_t> Networking::Server::ReceiveFramePayload(Networking::ClientConnection _pClient, char* _pBuffer, size_t _pLength)
+{
+	if(_pLength == 0)
+		return _pLength;
+	long bytesReceived = ReadFully(_pClient.clientSocket, _pBuffer, _pLength);
+	if(bytesReceived == SOCKET_ERROR)
+		return Result<size_t>::Failure(GETERROR());
+	if(bytesReceived != (long)_pLength)
+		return Result<size_t>::Failure(0);
+	connections.Touch(_pClient.clientSocket);
+	return _pLength;
+}
 
-	// Return the vector containing the received data
-	return receiveBuffer;
+void Networking::Server::LogFrameError(Networking::ClientConnection _pClient, const IoError& _pError)
+{
+	// A peer closing between frames is the normal end of a connection
+	if(_pError.code == 0)
+		return;
+	if(_pError.kind == ErrorKind::WouldBlock)
+		logger.log("Closing idle connection from " + GetClientIPAddress(_pClient));
+	else if(_pError.code == EPROTO)
+		logger.log("Invalid frame from " + GetClientIPAddress(_pClient));
+	else if(_pError.code == EMSGSIZE)
+		logger.log("Frame from " + GetClientIPAddress(_pClient) + " exceeds the maximum message size");
+	else
+		logger.log("Receive frame failed: " + _pError.Message());
+}
+
+void Networking::Server::SetMaxMessageSize(size_t _pMaxMessageSize)
+{
+	maxMessageSize = _pMaxMessageSize;
+}
+
+size_t Networking::Server::GetMaxMessageSize() const
+{
+	return maxMessageSize;
+}
+
+void Networking::Server::SetCompressionThreshold(size_t _pThreshold)
+{
+	compressionThreshold = _pThreshold;
+}
+
+size_t Networking::Server::GetCompressionThreshold() const
+{
+	return compressionThreshold;
+}
+
+void Networking::Server::SetKeepAlive(bool _pKeepAlive)
+{
+	keepAlive = _pKeepAlive;
+}
+
+bool Networking::Server::GetKeepAlive() const
+{
+	return keepAlive;
+}
+
+void Networking::Server::SetIdleTimeout(std::chrono::milliseconds _pIdleTimeout)
+{
+	idleTimeout = _pIdleTimeout;
+	connections.SetIdleTimeout(_pIdleTimeout);
+}
+
+void Networking::Server::SetMaxConnections(size_t _pMaxConnections)
+{
+	connections.SetMaxConnections(_pMaxConnections);
+}
+
+size_t Networking::Server::GetMaxConnections() const
+{
+	return connections.GetMaxConnections();
 }
 
+void Networking::Server::SetRetryPolicy(const RetryPolicy& _pRetryPolicy)
+{
+	retryPolicy = _pRetryPolicy;
+}
 
 // Receive data from a specified address and port
 std::vector<char> Networking::Server::ReceiveFrom(PCSTR _pAddress, int _pPort)
 {
 	// Initialize the number of bytes received to 0
 	int bytesReceived =0;
-	static int retries =0;
 	std::vector<char> receiveBuffer;
-	try{
-		sockaddr_storage sockAddress;
-		ZeroMemory(&sockAddress, sizeof(sockAddress));
-		if(serverInfo.sin_family == AF_INET)
-		{
-
-			// Create a sockaddr_in structure to hold the address and port of the sender
-			sockaddr_in* sender = (sockaddr_in*) &sockAddress;
+	sockaddr_storage sockAddress;
+	ZeroMemory(&sockAddress, sizeof(sockAddress));
+	if(serverInfo.sin_family == AF_INET)
+	{
 
-			// Set the address family, port, and address of the sender
-			sender->sin_family = AF_INET;
-			sender->sin_port = htons(_pPort);
-			inet_pton(AF_INET, _pAddress, &sender->sin_addr);
-		}
+		// Create a sockaddr_in structure to hold the address and port of the sender
+		sockaddr_in* sender = (sockaddr_in*) &sockAddress;
 
-		else if (serverInfo.sin_family == AF_INET6)
-		{
-			// Create a sockaddr_in structure to hold the address and port of the sender
-			sockaddr_in6* sender = (sockaddr_in6*) &sockAddress;
+		// Set the address family, port, and address of the sender
+		sender->sin_family = AF_INET;
+		sender->sin_port = htons(_pPort);
+		inet_pton(AF_INET, _pAddress, &sender->sin_addr);
+	}
 
-			// Set the address family, port, and address of the sender
-			sender->sin6_family = AF_INET6;
-			sender->sin6_port = htons(_pPort);
-			inet_pton(AF_INET6, _pAddress, &sender->sin6_addr);
-		}
+	else if (serverInfo.sin_family == AF_INET6)
+	{
+		// Create a sockaddr_in structure to hold the address and port of the sender
+		sockaddr_in6* sender = (sockaddr_in6*) &sockAddress;
 
+		// Set the address family, port, and address of the sender
+		sender->sin6_family = AF_INET6;
+		sender->sin6_port = htons(_pPort);
+		inet_pton(AF_INET6, _pAddress, &sender->sin6_addr);
+	}
 
-		// Receive data from the server in a loop
+	// Read through a pooled scratch buffer and append each chunk once, instead
+	// of growing the result 512 bytes at a time
+	SharedBuffer chunk = BufferPool::Default().Acquire(RECEIVE_CHUNK_SIZE);
+	for(int retry = 0; ; retry++)
+	{
 		do{
-			// Get the current size of the receive buffer
-			int bufferStart = receiveBuffer.size();
-			// Resize the buffer to make room for more data
-			receiveBuffer.resize(bufferStart+512);
 			// Receive data from the server
-			bytesReceived = recvfrom(serverSocket, &receiveBuffer[bufferStart], 512, 0, (sockaddr*)&sockAddress, (socklen_t*)sizeof(sockAddress));
-			// Resize the buffer to the actual size of the received data
-			receiveBuffer.resize(bufferStart + bytesReceived);
-		} while (bytesReceived == 512);
-
+			bytesReceived = recvfrom(serverSocket, chunk->data(), chunk->size(), 0, (sockaddr*)&sockAddress, (socklen_t*)sizeof(sockAddress));
+			if(bytesReceived > 0)
+				receiveBuffer.insert(receiveBuffer.end(), chunk->data(), chunk->data() + bytesReceived);
+		} while (bytesReceived == (int)chunk->size());
 
-		// If there was an error, throw an exception
-		if(bytesReceived == SOCKET_ERROR)
-		{
-			// Get the error code
-			int errorCode = GETERROR();
-
-			ThrowReceiveException(serverSocket,errorCode);
-		}
-		retries =0;
-	}
-
-	catch(Networking::NetworkException &ex)
-	{
-		switch(ex.GetErrorCode())
-		{
-		case EAGAIN:
-			if(retries < MAX_RETRIES)
-			{
-				retries++;
-				ReceiveFrom(_pAddress, _pPort);
-			}
-			else{
-				retries =0;
-				logger.log(ex.what());
-				break;
-			}
-		case EINTR:
-			if(retries < MAX_RETRIES)
-			{
-				retries++;
-				ReceiveFrom(_pAddress, _pPort);
-			}
-			else{
-				retries =0;
-				logger.log(ex.what());
-				break;
-			}
-		default:
-			logger.log(ex.what());
+		if(bytesReceived != SOCKET_ERROR)
 			break;
-		}
+
+		IoError error = IoError::FromCode(GETERROR());
+		if(error.kind == ErrorKind::Interrupted && retry < retryPolicy.maxRetries)
+			continue;
+		if(error.kind == ErrorKind::WouldBlock && retryPolicy.WaitBeforeRetry(retry))
+			continue;
+		logger.log(ErrorMessage(Error::receiveMap, error.code));
+		break;
 	}
 	// Return the received data
 	return receiveBuffer;
 }
 
 // Receive a file from the server
-void Networking::Server::ReceiveFile(const std::string& _pFilePath, Networking::ClientConnection client)
+long long Networking::Server::ReceiveFile(const std::string& _pFilePath, Networking::ClientConnection client, uint64_t _pMaxLength)
 {
-	// Open the file for writing
-	std::ofstream file(_pFilePath, std::ios::out | std::ios::binary);
-
-	// Check if the file was opened successfully
-	if(!file)
+	// Write the file data to the file as it arrives
+	long long bytesReceived = ReceiveFileToPath(client.clientSocket, _pFilePath, _pMaxLength);
+	if(bytesReceived == SOCKET_ERROR)
 	{
-		// Throw an exception if the file could not be opened
-		throw std::runtime_error("Error: Unable to open file '" + _pFilePath + "'");
+		logger.log("Receiving " + _pFilePath + " from " + GetClientIPAddress(client) + " failed: " + std::string(strerror(GETERROR())));
+		return SOCKET_ERROR;
 	}
-
-	// Receive the file data from the server
-	std::vector<char> fileData = Receive(client);
-
-	// Write the file data to the file
-	file.write(&fileData[0], fileData.size());
 	logger.log("Received " + _pFilePath + " from " + GetClientIPAddress(client));
+	return bytesReceived;
 }
 
 
@@ -796,34 +1142,25 @@ bool Networking::Server::ServerIsRunning()
 void Networking::Server::DisconnectClient(Networking::ClientConnection _pClient)
 
 {
-	try{
-		// Disconnect the client from the server
-		// Shut down the server socket
-    #ifdef _WIN32
-		int shutdownResult = shutdown(_pClient.clientSocket, SD_BOTH);
-    #else
-		int shutdownResult = shutdown(_pClient.clientSocket, SHUT_RDWR);
-    #endif
-		// If there was an error, throw an exception
-		if (shutdownResult == SOCKET_ERROR)
-		{
-			// Get the error code
-			int errorCode = GETERROR();
-
-			// Throw the error code
-			ThrowShutdownException(_pClient.clientSocket, errorCode);
-		}
-	}
-	catch (Networking::NetworkException &ex)
+	// The descriptor leaves the table before it is closed and can be reused
+	connections.Remove(_pClient.clientSocket);
+
+	// Disconnect the client from the server
+#ifdef _WIN32
+	int shutdownResult = shutdown(_pClient.clientSocket, SD_BOTH);
+#else
+	int shutdownResult = shutdown(_pClient.clientSocket, SHUT_RDWR);
+#endif
+	// A peer that already hung up leaves nothing to shut down, so only other errors are logged
+	if (shutdownResult == SOCKET_ERROR)
 	{
-
-		logger.log(ex.what());
+		IoError error = IoError::FromCode(GETERROR());
+		if(!error.IsPeerClosed())
+			logger.log(ErrorMessage(Error::shutdownMap, error.code));
 	}
 	// Close the socket
 	CLOSESOCKET(_pClient.clientSocket);
 
-	// Remove the client from the list of clients
-	clients.erase(std::remove(clients.begin(), clients.end(), _pClient), clients.end());
 }
 
 
@@ -865,6 +1202,10 @@ void Networking::Server::Shutdown()
 		logger.log(ex.what());
 	}
 
+	// Remove the socket file so the path can be bound again
+	if(serverIsConnected && serverType == ServerType::Unix)
+		unlink(unixInfo.sun_path);
+
 	#ifdef _WIN32
 	// Clean up the Windows Sockets DLL
 	WSACleanup();
@@ -876,15 +1217,17 @@ void Networking::Server::Shutdown()
 
 
 // Return a vector of ClientConnection objects representing the currently connected clients
-std::vector<Networking::ClientConnection> Networking::Server::getClients() const
+Networking::ConnectionTable::Snapshot Networking::Server::getClients() const
 {
-	return clients;
+	return connections.GetSnapshot();
 }
 
 std::string Networking::Server::GetClientIPAddress(Networking::ClientConnection _pClient)
 {
 	std::string ip;
-	if(GetServerType() == Networking::ServerType::IPv4)
+	if(GetServerType() == Networking::ServerType::Unix)
+		ip = std::string("unix:") + unixInfo.sun_path;
+	else if(GetServerType() == Networking::ServerType::IPv4)
 		ip = inet_ntoa(_pClient.clientInfo.sin_addr);
 	else {
 		ip.resize(INET6_ADDRSTRLEN);
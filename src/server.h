@@ -15,6 +15,7 @@
 #else
 #include  <sys/socket.h>
 #include <netinet/in.h>
+#include <sys/un.h>
 #include  <errno.h>
 #include <arpa/inet.h>
 #include <unistd.h>
@@ -31,41 +32,62 @@
 typedef const char* PCSTR;
 #endif
 #endif
-#ifndef MAX_RETRIES
-#define MAX_RETRIES 3
-#endif
-#ifndef RETRY_DELAY
-#define RETRY_DELAY 5
-#endif
 #include <iostream>
 #include <string>
 #include <vector>
 #include <thread>
 #include <chrono>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include "clientconnection.h"
+#include "connectiontable.h"
+#include "eventloop.h"
+#include "serverloop.h"
+#include "bufferpool.h"
+#include "compression.h"
+#include "filetransfer.h"
+#include "frame.h"
+#include "retry.h"
+#include "result.h"
 #include "networkexception.h"
 #include "errorcodes.h"
 #include "logger.h"
+#include "threadpool.h"
 
 namespace Networking {
 
 enum ServerType
 {
 	IPv4,
-	IPv6
+	IPv6,
+	Unix  // AF_UNIX stream socket bound to a filesystem path, for peers on the same host
 };
 
-// Struct to hold information about a connected client
-struct ClientConnection {
-	SOCKET clientSocket;
-	sockaddr_in clientInfo;
-	sockaddr_in6 clientInfo6;
-	bool operator==(const ClientConnection& other) const
-	{
-		// Compare the clientSocket member variables of the two objects
-		return clientSocket == other.clientSocket;
-	}
+// How Server::Run services client connections
+enum ServerMode
+{
+	Blocking, // Blocking Accept with one thread per connection
+	Epoll,    // Edge-triggered epoll reactor on the calling thread
+	Uring     // io_uring completion loop on the calling thread; falls back to Epoll where unsupported
+};
+
+// Parses a server mode name ("blocking", "epoll" or "uring"); unknown names yield Blocking
+ServerMode ParseServerMode(const std::string& _pName);
+
+// Bytes a broadcast recipient may have queued before it counts as slow
+const size_t DEFAULT_BROADCAST_HIGH_WATER_MARK = 4 * 1024 * 1024;
+
+// How Server::Broadcast treats recipients that fall behind
+struct BroadcastOptions {
+	size_t highWaterMark = DEFAULT_BROADCAST_HIGH_WATER_MARK;
+	SlowReceiverPolicy policy = SlowReceiverPolicy::Drop;
 };
 
+// Told how a broadcast ended for each recipient
+typedef std::function<void(const ClientConnection&, DeliveryStatus)> DeliveryCallback;
+
 
 class Server {
 public:
@@ -73,6 +95,10 @@ public:
 //Constructor that takes in a port number and a server type
 Server(int _pPortNumber = 8080, ServerType _pServerType = ServerType::IPv4, const std::string& _pLogFile = "server.log");
 
+// Constructor for a Unix domain socket server listening on _pSocketPath.
+// A stale socket file left at the path is replaced.
+explicit Server(const std::string& _pSocketPath, const std::string& _pLogFile = "server.log");
+
 // Destructor
 ~Server();
 
@@ -83,6 +109,9 @@ bool InitServer();
 //Creates a socket for the server using the specified port number and server type
 bool CreateServerSocket(int _pPortNumber, ServerType _pServerType);
 
+// Creates a Unix domain socket listening on _pSocketPath
+bool CreateUnixServerSocket(const std::string& _pSocketPath);
+
 void CreateSocket();
 void BindSocket();
 void ListenOnSocket();
@@ -91,6 +120,21 @@ void ListenOnSocket();
 // Networking::ClientConnection object representing the connected client
 Networking::ClientConnection Accept();
 
+// As Accept, but returns the error instead of logging it
+Result<Networking::ClientConnection> TryAccept();
+
+// Accepts connections and passes every framed message received to _pHandler
+// until Stop() is called. Unless keep-alive is enabled, each connection carries
+// a single request and is closed once the handler has returned and its replies
+// have been sent.
+// With _pExecutor set, connections (blocking mode) or requests (epoll and
+// uring modes) are serviced on the pool instead of on a thread per connection
+// or the loop.
+void Run(MessageHandler _pHandler, ServerMode _pMode = ServerMode::Blocking, ThreadPool* _pExecutor = nullptr);
+
+// Makes Run() return and closes the listening socket; safe to call from any thread
+void Stop();
+
 // Sets the socket type
 void SetSocketType(int _pSockType);
 
@@ -100,26 +144,134 @@ void SetFamily(int _pFamily);
 // Sets the socket protocol
 void SetProtocol(int _pProtocol);
 
-// Sends data to a specific client
+// Sends data to a specific client. While Run() is in epoll or uring mode the
+// data is queued on the connection and written by the event loop.
 int Send(PCSTR _pSendBuffer, Networking::ClientConnection _pClient);
 
+// Sends _pLength bytes, which may include NUL bytes, to a specific client
+int Send(const char* _pData, size_t _pLength, Networking::ClientConnection _pClient);
+
+// Sends the _pCount buffers described by _pVectors to a specific client as
+// one stream, gathered with sendmsg instead of being joined first. In epoll or
+// uring mode they are copied once into the connection's write queue.
+long Send(const iovec* _pVectors, size_t _pCount, Networking::ClientConnection _pClient);
+
 // Sends data to a specific address and port
 int SendTo(PCSTR _pBuffer, PCSTR _pAddress, int _pPort);
 
-// Sends data to all connected clients
+// Sends data to all connected clients without waiting on any of them, as
+// Broadcast does, but unframed and closing any client that cannot take it.
+// Returns the length of the data.
 int SendToAll(PCSTR _pSendBuffer);
 
-// Sends a file to a specific client
-void SendFile(const std::string& _pFilePath, Networking::ClientConnection client);
+// Sends _pLength bytes to every connected client as one frame with request ID
+// zero. The frame is encoded once into a shared buffer; no recipient is waited
+// on, so a slow one cannot hold up the rest. In epoll or uring mode the buffer
+// is queued on each connection unless it already has more than
+// _pOptions.highWaterMark bytes queued; otherwise it is written with a
+// nonblocking send and the kernel's socket buffer is the high-water mark. A
+// recipient over the mark is skipped or closed as _pOptions.policy says, and one
+// that took only part of the frame is always closed. _pOnDelivery, if set, is
+// called once per recipient: on an event loop's thread for connections it owns
+// and on the calling thread for the rest, so it must not block. Returns the
+// number of recipients, or zero if the frame exceeds the maximum message size.
+size_t Broadcast(const char* _pData, size_t _pLength, DeliveryCallback _pOnDelivery = DeliveryCallback(), const BroadcastOptions& _pOptions = BroadcastOptions());
+
+// Streams a file, or the byte range [_pOffset, _pOffset + _pLength) of it, to a
+// client as a file stream (see filetransfer.h) without copying it through user
+// space. Returns the number of file bytes sent or SOCKET_ERROR. Throws
+// std::runtime_error if the file cannot be opened. In epoll or uring mode the
+// file is written directly, so it must not follow other replies still queued on
+// the connection.
+long long SendFile(const std::string& _pFilePath, Networking::ClientConnection client, uint64_t _pOffset = 0, uint64_t _pLength = FILE_TO_END);
 
 // Receives data from a specific client
 std::vector<char> Receive(Networking::ClientConnection client);
 
+// Sends _pLength bytes to a client as a single length-prefixed frame carrying
+// _pClient.requestId, so a reply answers the request passed to the handler.
+// While Run() is in epoll or uring mode the frame is queued on the connection.
+int SendFrame(const char* _pData, size_t _pLength, Networking::ClientConnection _pClient);
+int SendFrame(const std::string& _pData, Networking::ClientConnection _pClient);
+
+// Receives one length-prefixed frame from a client and returns its payload.
+// Returns an empty vector if the peer closed the connection, the frame is
+// malformed or it exceeds the maximum message size.
+std::vector<char> ReceiveFrame(Networking::ClientConnection _pClient);
+// As above, also storing the frame's request ID in _pRequestId. The ID is
+// left at zero when no complete frame was received.
+std::vector<char> ReceiveFrame(Networking::ClientConnection _pClient, uint32_t& _pRequestId);
+
+// Receives one frame into a buffer from BufferPool::Default(), which returns to
+// the pool once the last reference to it is dropped. Returns a null buffer
+// where ReceiveFrame would return an empty vector for a failure.
+SharedBuffer ReceiveFrameBuffer(Networking::ClientConnection _pClient, uint32_t& _pRequestId);
+
+// Non-throwing forms of the calls above. Transient errors are retried under
+// the retry policy as usual, but a failure is returned, classified, instead of
+// being logged, and the connection is left for the caller to disconnect (in
+// epoll or uring mode the loop owns it, and ENOTCONN means the loop has
+// already closed it). A peer that hung up is reported as ErrorKind::PeerClosed, so serving loops can
+// treat it as the routine end of a connection. Send, Receive and friends are
+// thin wrappers that log the error and disconnect.
+Result<long> TrySend(const char* _pData, size_t _pLength, Networking::ClientConnection _pClient);
+Result<long> TrySend(const iovec* _pVectors, size_t _pCount, Networking::ClientConnection _pClient);
+Result<std::vector<char>> TryReceive(Networking::ClientConnection _pClient);
+Result<long> TrySendFrame(const char* _pData, size_t _pLength, Networking::ClientConnection _pClient);
+// Fails with EPROTO for a malformed header and EMSGSIZE for an oversized frame
+Result<SharedBuffer> TryReceiveFrame(Networking::ClientConnection _pClient, uint32_t& _pRequestId);
+
+// Sets the largest frame payload this server will accept
+void SetMaxMessageSize(size_t _pMaxMessageSize);
+size_t GetMaxMessageSize() const;
+
+// Replies of at least _pThreshold bytes are compressed for clients whose
+// request said they accept it (see Client::SetCompression). Compressed
+// requests are always accepted.
+void SetCompressionThreshold(size_t _pThreshold);
+size_t GetCompressionThreshold() const;
+
+// Lets Run() serve any number of requests on a connection, one after another,
+// until the peer closes it. In blocking mode a connection that sends nothing for
+// the idle timeout is closed, since it holds a thread while it waits.
+void SetKeepAlive(bool _pKeepAlive);
+bool GetKeepAlive() const;
+void SetIdleTimeout(std::chrono::milliseconds _pIdleTimeout);
+
+// Most connections held at once, in every mode; further ones are closed as
+// soon as they are accepted. Zero removes the limit.
+void SetMaxConnections(size_t _pMaxConnections);
+size_t GetMaxConnections() const;
+
+// Shuts down every connection that has sent or received nothing for the idle
+// timeout, so that its owner (a serving thread or event loop) sees the peer
+// gone and closes it. Run() calls this on a timer; returns how many were shut.
+size_t ReapIdleConnections();
+
+// Sets how transient socket errors (EINTR, EAGAIN, a busy address) are
+// retried by the blocking calls. Each call keeps its own count and backs off
+// with jitter instead of sleeping a fixed delay.
+void SetRetryPolicy(const RetryPolicy& _pRetryPolicy);
+
+// Sets how many listening sockets, each with its own event loop thread, Run()
+// uses in epoll or uring mode. With more than one, every listener is bound to
+// the port with SO_REUSEPORT and the kernel spreads new connections across them, so
+// accepting is no longer limited to one thread. The existing listener is
+// reopened with SO_REUSEPORT, so this must be called before Run() and before
+// any client connects. Blocking mode and Unix domain servers always accept on
+// a single socket.
+void SetListenerCount(size_t _pListenerCount);
+size_t GetListenerCount() const;
+
 // Receives data from a specific address and port
 std::vector<char> ReceiveFrom(PCSTR _pAddress, int _pPort);
 
-// Receives a file from a specific client
-void ReceiveFile(const std::string& _pFilePath, Networking::ClientConnection client);
+// Receives a file stream from a client and writes it to _pFilePath as it arrives,
+// using a bounded amount of memory whatever the file size. Streams announcing more
+// than _pMaxLength bytes are refused. Returns the number of bytes written or
+// SOCKET_ERROR, in which case no partial file is left behind. Throws
+// std::runtime_error if the file cannot be created.
+long long ReceiveFile(const std::string& _pFilePath, Networking::ClientConnection client, uint64_t _pMaxLength = FILE_TO_END);
 
 // Returns true if the server is currently running and listening for connections
 // Returns false otherwise
@@ -130,9 +282,10 @@ void Shutdown();
 // Disconnects a specific client
 void DisconnectClient(Networking::ClientConnection _pClient);
 
-// Returns a vector of Networking::ClientConnection objects representing all
-// currently connected clients
-std::vector<Networking::ClientConnection> getClients() const;
+// Returns the currently connected clients, accepted by Accept or by an event
+// loop. The list is shared and immutable, so repeated calls are cheap until a
+// connection opens or closes.
+ConnectionTable::Snapshot getClients() const;
 
 //Handles errors
 void ErrorHandling(NetworkException _pNetEx);
@@ -145,16 +298,51 @@ int GetPort();
 
 private:
 
+void RunBlocking(MessageHandler _pHandler, ThreadPool* _pExecutor);
+void RunEventLoop(MessageHandler _pHandler, ThreadPool* _pExecutor, bool _pUseUring);
+// Calls ReapIdleConnections every wheel tick until Run() is over
+void RunIdleReaper();
+SOCKET OpenReusePortListener();
+ServerLoop* GetEventLoop(const Networking::ClientConnection& _pClient);
+// Whether an event loop owns the connection, and so closes it itself
+bool OwnedByEventLoop(const Networking::ClientConnection& _pClient);
+// Hands a fully built buffer to the connection's event loop, locking only for the lookup and queueing
+Result<long> QueueOnEventLoop(const Networking::ClientConnection& _pClient, std::vector<char>&& _pData, long _pLength);
+Result<FrameHeader> ReceiveFrameHeader(Networking::ClientConnection _pClient);
+Result<size_t> ReceiveFramePayload(Networking::ClientConnection _pClient, char* _pBuffer, size_t _pLength);
+void LogFrameError(Networking::ClientConnection _pClient, const IoError& _pError);
+// Receives one frame, restoring a compressed payload, and stores its header in _pHeader
+Result<SharedBuffer> TryReceiveFrame(Networking::ClientConnection _pClient, FrameHeader& _pHeader);
+// Offers _pData to every client in the table; see Broadcast
+size_t BroadcastBuffer(const SharedBuffer& _pData, const DeliveryCallback& _pOnDelivery, const BroadcastOptions& _pOptions);
+// Writes a broadcast to a client no event loop owns without blocking
+DeliveryStatus SendWithoutWaiting(const Networking::ClientConnection& _pClient, const std::vector<char>& _pData, SlowReceiverPolicy _pPolicy);
+
 	#ifdef _WIN32
 WSADATA wsaData;
 	#endif
 addrinfo addressInfo;
 SOCKET serverSocket;
 sockaddr_in serverInfo;
+sockaddr_un unixInfo;
 bool serverIsConnected = false;
 ServerType serverType;
-std::vector<Networking::ClientConnection> clients;
+ConnectionTable connections;
 Logger logger;
+size_t maxMessageSize = DEFAULT_MAX_MESSAGE_SIZE;
+size_t compressionThreshold = DEFAULT_COMPRESSION_THRESHOLD;
+bool keepAlive = false;
+std::chrono::milliseconds idleTimeout{DEFAULT_IDLE_TIMEOUT};
+// Wakes the idle reaper started by Run() when Stop() is called
+std::mutex reaperMutex;
+std::condition_variable reaperWake;
+RetryPolicy retryPolicy;
+size_t listenerCount = 1;
+bool reusePort = false;
+std::atomic<bool> running{false};
+std::mutex eventLoopMutex;
+// One loop per listener while Run() is in epoll or uring mode, indexed by ClientConnection::listenerIndex
+std::vector<std::unique_ptr<ServerLoop> > eventLoops;
 };
 }
 
@@ -0,0 +1,119 @@
+#pragma once
+#ifndef _NET_SERVER_LOOP_
+#define _NET_SERVER_LOOP_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "bufferpool.h"
+#include "clientconnection.h"
+#include "connectiontable.h"
+
+namespace Networking {
+
+// How a broadcast ended for one recipient
+enum class DeliveryStatus {
+	Sent,         // Written to the socket completely
+	Dropped,      // Skipped, since the recipient had more than the high-water mark queued
+	Disconnected, // The recipient was over the high-water mark and was closed
+	Failed        // The connection failed or closed before the data was written
+};
+
+// What a broadcast does with a recipient over the high-water mark
+enum class SlowReceiverPolicy {
+	Drop,      // Skip this message for it
+	Disconnect // Close the connection
+};
+
+// Reports the delivery of one queued write exactly once. A completion that is
+// destroyed unreported, because its queue was cleared or its connection
+// closed, reports Failed.
+class WriteCompletion {
+public:
+explicit WriteCompletion(std::function<void(DeliveryStatus)> _pCallback) : callback(std::move(_pCallback)) {}
+~WriteCompletion() { Report(DeliveryStatus::Failed); }
+
+WriteCompletion(const WriteCompletion&) = delete;
+WriteCompletion& operator=(const WriteCompletion&) = delete;
+
+void Report(DeliveryStatus _pStatus)
+{
+	if(!callback)
+		return;
+	std::function<void(DeliveryStatus)> done = std::move(callback);
+	callback = nullptr;
+	done(_pStatus);
+}
+
+private:
+std::function<void(DeliveryStatus)> callback;
+};
+
+// An entry in a connection's write queue: bytes the queue owns, such as a
+// reply, or a buffer shared with other connections, such as a broadcast
+// frame, with the completion to report once it is written.
+struct QueuedWrite {
+	std::vector<char> owned;
+	SharedBuffer shared;
+	std::unique_ptr<WriteCompletion> completion;
+
+	QueuedWrite(std::vector<char>&& _pData) : owned(std::move(_pData)) {}
+	QueuedWrite(const SharedBuffer& _pShared, std::unique_ptr<WriteCompletion> _pCompletion)
+		: shared(_pShared), completion(std::move(_pCompletion)) {}
+
+	char* Data() { return shared ? shared->data() : owned.data(); }
+	size_t Size() const { return shared ? shared->size() : owned.size(); }
+};
+
+// A reactor that owns one listening socket and the connections accepted on it,
+// reads framed requests, hands them to the server's MessageHandler and writes
+// the replies queued for them. Server::Run drives every implementation the
+// same way, so the handler cannot tell which one is serving it.
+class ServerLoop {
+public:
+
+virtual ~ServerLoop() {}
+
+// Keeps connections open after a request so that one socket can carry many.
+// Must be called before Run().
+virtual void SetKeepAlive(bool _pKeepAlive) = 0;
+
+// Records which of the server's listeners this loop serves, in the
+// listenerIndex of every connection it accepts. Must be called before Run().
+virtual void SetListenerIndex(size_t _pListenerIndex) = 0;
+
+// Registers every accepted connection in _pTable, which is shared with the
+// server and other loops, and records activity on it there. A connection the
+// table refuses is closed at once, and one the server shuts down for being idle
+// is closed like any peer that hung up. Must be called before Run().
+virtual void SetConnectionTable(ConnectionTable* _pTable) = 0;
+
+// Runs the loop on the calling thread until Stop() is called
+virtual void Run() = 0;
+
+// Asks the loop to exit; safe to call from any thread
+virtual void Stop() = 0;
+
+// Queues data to be written to a connection; safe to call from any thread.
+// Returns false if the loop is not running.
+virtual bool QueueSend(SOCKET _pSocket, const char* _pData, size_t _pLength) = 0;
+virtual bool QueueSend(SOCKET _pSocket, std::vector<char>&& _pData) = 0;
+
+// Queues a buffer shared with other connections, as a broadcast does, without
+// copying it; safe to call from any thread. If the connection already has more
+// than _pHighWaterMark bytes queued the buffer is skipped, and _pPolicy says
+// whether the connection is closed as well. _pCompletion is reported on the
+// loop thread. Returns false, reporting Failed, if the loop is not running.
+virtual bool QueueShared(SOCKET _pSocket, const SharedBuffer& _pData, size_t _pHighWaterMark, SlowReceiverPolicy _pPolicy, std::unique_ptr<WriteCompletion> _pCompletion) = 0;
+
+// Returns true while Run() is executing
+virtual bool IsRunning() const = 0;
+
+// Returns the number of connections currently owned by the loop
+virtual size_t GetConnectionCount() const = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,458 @@
+#include "shmchannel.h"
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <utility>
+
+namespace {
+
+// Sent with the descriptors so a stray message on the socket is not mistaken for a channel
+const char CHANNEL_MAGIC[8] = {'S', 'D', 'S', 'H', 'M', 'C', 'H', '1'};
+
+// Memory fd followed by the data and space eventfds of both rings
+const int CHANNEL_FD_COUNT = 5;
+
+// Each ring's header gets its own page so the data behind it is page aligned
+const size_t RING_HEADER_SIZE = 4096;
+
+// Number of times a waiting side rechecks the ring before sleeping on its
+// eventfd. Spinning only helps when the peer can run at the same time.
+const int SPIN_COUNT = std::thread::hardware_concurrency() > 1 ? 64 : 0;
+
+struct ChannelOffer {
+	char magic[8];
+	uint64_t ringCapacity;
+};
+
+}
+
+// Positions are running byte counts; the ring offset is the count modulo the
+// capacity. Each counter is written by one side only and sits on its own cache line.
+struct Networking::ShmChannel::RingHeader {
+	uint64_t capacity;
+	alignas(64) std::atomic<uint64_t> head;          // Bytes published by the writer
+	alignas(64) std::atomic<uint64_t> tail;          // Bytes consumed by the reader
+	alignas(64) std::atomic<uint32_t> readerWaiting; // Reader is about to sleep on dataFd
+	alignas(64) std::atomic<uint32_t> writerWaiting; // Writer is about to sleep on spaceFd
+	std::atomic<uint32_t> closed;
+};
+
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t) && std::atomic<uint64_t>::is_always_lock_free,
+	"Shared ring counters must be lock-free to work across processes");
+
+const size_t Networking::ShmChannel::DEFAULT_RING_CAPACITY;
+
+Networking::ShmChannel::ShmChannel()
+{
+	static_assert(sizeof(RingHeader) <= RING_HEADER_SIZE, "Ring header must fit in its page");
+}
+
+Networking::ShmChannel::~ShmChannel()
+{
+	Close();
+	Release();
+}
+
+Networking::ShmChannel::ShmChannel(ShmChannel&& _pOther)
+{
+	*this = std::move(_pOther);
+}
+
+Networking::ShmChannel& Networking::ShmChannel::operator=(ShmChannel&& _pOther)
+{
+	if(this != &_pOther)
+	{
+		Close();
+		Release();
+		memoryFd = _pOther.memoryFd;
+		mapping = _pOther.mapping;
+		mappingSize = _pOther.mappingSize;
+		ringCapacity = _pOther.ringCapacity;
+		std::copy(_pOther.eventFds, _pOther.eventFds + 4, eventFds);
+		peerSocket = _pOther.peerSocket;
+		outbound = _pOther.outbound;
+		inbound = _pOther.inbound;
+		open = _pOther.open;
+		maxMessageSize = _pOther.maxMessageSize;
+
+		// Leave the source empty so its destructor releases nothing
+		_pOther.memoryFd = -1;
+		_pOther.mapping = nullptr;
+		std::fill(_pOther.eventFds, _pOther.eventFds + 4, -1);
+		_pOther.peerSocket = -1;
+		_pOther.outbound = Ring();
+		_pOther.inbound = Ring();
+		_pOther.open = false;
+	}
+	return *this;
+}
+
+Networking::ShmChannel Networking::ShmChannel::Create(size_t _pRingCapacity)
+{
+	size_t capacity = 4096;
+	while(capacity < _pRingCapacity)
+		capacity <<= 1;
+
+	ShmChannel channel;
+	channel.memoryFd = memfd_create("simplidfs-shm-channel", MFD_CLOEXEC);
+	if(channel.memoryFd < 0)
+		throw (int)errno;
+	if(ftruncate(channel.memoryFd, 2 * (RING_HEADER_SIZE + capacity)) < 0)
+		throw (int)errno;
+	for(int i = 0; i < 4; i++)
+	{
+		channel.eventFds[i] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if(channel.eventFds[i] < 0)
+			throw (int)errno;
+	}
+	channel.Map(channel.memoryFd, capacity, true);
+	return channel;
+}
+
+void Networking::ShmChannel::ShareOver(SOCKET _pSocket)
+{
+	if(!open)
+		throw (int)ENOTCONN;
+
+	ChannelOffer offer;
+	memcpy(offer.magic, CHANNEL_MAGIC, sizeof(offer.magic));
+	offer.ringCapacity = ringCapacity;
+	iovec payload;
+	payload.iov_base = &offer;
+	payload.iov_len = sizeof(offer);
+
+	int descriptors[CHANNEL_FD_COUNT] = {memoryFd, eventFds[0], eventFds[1], eventFds[2], eventFds[3]};
+	char control[CMSG_SPACE(sizeof(descriptors))];
+	memset(control, 0, sizeof(control));
+	msghdr message;
+	memset(&message, 0, sizeof(message));
+	message.msg_iov = &payload;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = sizeof(control);
+	cmsghdr* header = CMSG_FIRSTHDR(&message);
+	header->cmsg_level = SOL_SOCKET;
+	header->cmsg_type = SCM_RIGHTS;
+	header->cmsg_len = CMSG_LEN(sizeof(descriptors));
+	memcpy(CMSG_DATA(header), descriptors, sizeof(descriptors));
+
+	while(sendmsg(_pSocket, &message, MSG_NOSIGNAL) < 0)
+	{
+		if(errno == EAGAIN || errno == EWOULDBLOCK)
+			WaitForSocket(_pSocket, POLLOUT, Deadline());
+		else if(errno != EINTR)
+			throw (int)errno;
+	}
+
+	peerSocket = dup(_pSocket);
+	if(peerSocket < 0)
+		throw (int)errno;
+}
+
+Networking::ShmChannel Networking::ShmChannel::AttachFrom(SOCKET _pSocket)
+{
+	ChannelOffer offer;
+	iovec payload;
+	payload.iov_base = &offer;
+	payload.iov_len = sizeof(offer);
+	char control[CMSG_SPACE(sizeof(int) * CHANNEL_FD_COUNT)];
+	msghdr message;
+	memset(&message, 0, sizeof(message));
+	message.msg_iov = &payload;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = sizeof(control);
+
+	ssize_t received;
+	while((received = recvmsg(_pSocket, &message, MSG_CMSG_CLOEXEC | MSG_WAITALL)) < 0)
+	{
+		if(errno == EAGAIN || errno == EWOULDBLOCK)
+			WaitForSocket(_pSocket, POLLIN, Deadline());
+		else if(errno != EINTR)
+			throw (int)errno;
+	}
+
+	// Take ownership of whatever arrived before validating it, so nothing leaks
+	ShmChannel channel;
+	int descriptors[CHANNEL_FD_COUNT] = {-1, -1, -1, -1, -1};
+	size_t descriptorCount = 0;
+	for(cmsghdr* header = CMSG_FIRSTHDR(&message); header != NULL; header = CMSG_NXTHDR(&message, header))
+	{
+		if(header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+			continue;
+		descriptorCount = std::min<size_t>((header->cmsg_len - CMSG_LEN(0)) / sizeof(int), CHANNEL_FD_COUNT);
+		memcpy(descriptors, CMSG_DATA(header), descriptorCount * sizeof(int));
+	}
+	channel.memoryFd = descriptors[0];
+	std::copy(descriptors + 1, descriptors + CHANNEL_FD_COUNT, channel.eventFds);
+
+	if(received != (ssize_t)sizeof(offer) || memcmp(offer.magic, CHANNEL_MAGIC, sizeof(offer.magic)) != 0
+		|| (message.msg_flags & MSG_CTRUNC) || descriptorCount != (size_t)CHANNEL_FD_COUNT)
+		throw (int)EPROTO;
+
+	// The capacity is only trusted if the memory really is that large
+	struct stat memoryStat;
+	uint64_t capacity = offer.ringCapacity;
+	if(fstat(channel.memoryFd, &memoryStat) < 0 || capacity < 4096 || (capacity & (capacity - 1)) != 0
+		|| (uint64_t)memoryStat.st_size != 2 * (RING_HEADER_SIZE + capacity))
+		throw (int)EPROTO;
+
+	channel.Map(channel.memoryFd, capacity, false);
+	channel.peerSocket = dup(_pSocket);
+	if(channel.peerSocket < 0)
+		throw (int)errno;
+	return channel;
+}
+
+int Networking::ShmChannel::SendFrame(const char* _pData, size_t _pLength, uint32_t _pRequestId)
+{
+	if(!open)
+		throw (int)ENOTCONN;
+	if(_pLength > maxMessageSize)
+		throw (int)EMSGSIZE;
+
+	FrameHeader header;
+	header.payloadLength = _pLength;
+	header.requestId = _pRequestId;
+	char headerBuffer[FRAME_HEADER_SIZE];
+	EncodeFrameHeader(header, headerBuffer);
+	Write(headerBuffer, FRAME_HEADER_SIZE);
+	Write(_pData, _pLength);
+	return _pLength;
+}
+
+int Networking::ShmChannel::SendFrame(const std::string& _pData, uint32_t _pRequestId)
+{
+	return SendFrame(_pData.data(), _pData.size(), _pRequestId);
+}
+
+std::vector<char> Networking::ShmChannel::ReceiveFrame()
+{
+	uint32_t requestId;
+	return ReceiveFrame(requestId);
+}
+
+std::vector<char> Networking::ShmChannel::ReceiveFrame(uint32_t& _pRequestId)
+{
+	_pRequestId = 0;
+	if(!open)
+		throw (int)ENOTCONN;
+
+	char headerBuffer[FRAME_HEADER_SIZE];
+	if(!Read(headerBuffer, FRAME_HEADER_SIZE))
+		return std::vector<char>();
+	FrameHeader header;
+	if(!DecodeFrameHeader(headerBuffer, header))
+		throw (int)EPROTO;
+	if(header.payloadLength > maxMessageSize)
+		throw (int)EMSGSIZE;
+
+	std::vector<char> payload(header.payloadLength);
+	if(!Read(payload.data(), payload.size()))
+		return std::vector<char>();
+	_pRequestId = header.requestId;
+	return payload;
+}
+
+void Networking::ShmChannel::Close()
+{
+	if(!open)
+		return;
+	open = false;
+	outbound.header->closed.store(1);
+	inbound.header->closed.store(1);
+	// The peer may be asleep waiting for data or for space
+	for(int i = 0; i < 4; i++)
+		Signal(eventFds[i]);
+}
+
+bool Networking::ShmChannel::IsOpen() const
+{
+	return open;
+}
+
+void Networking::ShmChannel::SetMaxMessageSize(size_t _pMaxMessageSize)
+{
+	maxMessageSize = _pMaxMessageSize;
+}
+
+void Networking::ShmChannel::Map(int _pMemoryFd, size_t _pRingCapacity, bool _pCreator)
+{
+	mappingSize = 2 * (RING_HEADER_SIZE + _pRingCapacity);
+	void* memory = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, _pMemoryFd, 0);
+	if(memory == MAP_FAILED)
+		throw (int)errno;
+	mapping = memory;
+	ringCapacity = _pRingCapacity;
+
+	// Ring 0 carries data from the creator to the peer, ring 1 the other way
+	char* base = (char*)mapping;
+	Ring rings[2];
+	for(int i = 0; i < 2; i++)
+	{
+		char* start = base + i * (RING_HEADER_SIZE + _pRingCapacity);
+		if(_pCreator)
+		{
+			RingHeader* header = new (start) RingHeader();
+			header->capacity = _pRingCapacity;
+			header->head.store(0);
+			header->tail.store(0);
+			header->readerWaiting.store(0);
+			header->writerWaiting.store(0);
+			header->closed.store(0);
+		}
+		rings[i].header = (RingHeader*)start;
+		rings[i].data = start + RING_HEADER_SIZE;
+		rings[i].dataFd = eventFds[2 * i];
+		rings[i].spaceFd = eventFds[2 * i + 1];
+	}
+	outbound = rings[_pCreator ? 0 : 1];
+	inbound = rings[_pCreator ? 1 : 0];
+	open = true;
+}
+
+void Networking::ShmChannel::Write(const char* _pData, size_t _pLength)
+{
+	RingHeader* header = outbound.header;
+	int spins = 0;
+	while(_pLength > 0)
+	{
+		if(header->closed.load(std::memory_order_acquire))
+			throw (int)EPIPE;
+
+		uint64_t head = header->head.load(std::memory_order_relaxed);
+		size_t space = ringCapacity - (head - header->tail.load(std::memory_order_acquire));
+		if(space == 0)
+		{
+			if(spins++ < SPIN_COUNT)
+				continue;
+			// Announce the wait before the final check, so a reader freeing space
+			// in between is guaranteed to see the flag and signal
+			header->writerWaiting.store(1);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if(head == header->tail.load() + ringCapacity && !header->closed.load())
+				Wait(outbound.spaceFd);
+			header->writerWaiting.store(0, std::memory_order_relaxed);
+			spins = 0;
+			continue;
+		}
+
+		size_t count = std::min(space, _pLength);
+		size_t offset = head & (ringCapacity - 1);
+		size_t first = std::min(count, ringCapacity - offset);
+		memcpy(outbound.data + offset, _pData, first);
+		memcpy(outbound.data, _pData + first, count - first);
+		header->head.store(head + count, std::memory_order_release);
+		_pData += count;
+		_pLength -= count;
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(header->readerWaiting.load(std::memory_order_relaxed))
+			Signal(outbound.dataFd);
+	}
+}
+
+bool Networking::ShmChannel::Read(char* _pData, size_t _pLength)
+{
+	RingHeader* header = inbound.header;
+	int spins = 0;
+	while(_pLength > 0)
+	{
+		uint64_t tail = header->tail.load(std::memory_order_relaxed);
+		size_t available = header->head.load(std::memory_order_acquire) - tail;
+		if(available == 0)
+		{
+			// Bytes written before the peer closed are still delivered
+			if(header->closed.load(std::memory_order_acquire))
+				return false;
+			if(spins++ < SPIN_COUNT)
+				continue;
+			header->readerWaiting.store(1);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if(header->head.load() == tail && !header->closed.load())
+				Wait(inbound.dataFd);
+			header->readerWaiting.store(0, std::memory_order_relaxed);
+			spins = 0;
+			continue;
+		}
+
+		size_t count = std::min(available, _pLength);
+		size_t offset = tail & (ringCapacity - 1);
+		size_t first = std::min(count, ringCapacity - offset);
+		memcpy(_pData, inbound.data + offset, first);
+		memcpy(_pData + first, inbound.data, count - first);
+		header->tail.store(tail + count, std::memory_order_release);
+		_pData += count;
+		_pLength -= count;
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(header->writerWaiting.load(std::memory_order_relaxed))
+			Signal(inbound.spaceFd);
+	}
+	return true;
+}
+
+void Networking::ShmChannel::Wait(int _pEventFd)
+{
+	// The socket is only watched for hang-up: a peer that exits without calling
+	// Close never signals, but its end of the socket is closed by the kernel
+	pollfd descriptors[2];
+	descriptors[0].fd = _pEventFd;
+	descriptors[0].events = POLLIN;
+	descriptors[0].revents = 0;
+	descriptors[1].fd = peerSocket;
+	descriptors[1].events = POLLRDHUP;
+	descriptors[1].revents = 0;
+	int ready = poll(descriptors, peerSocket >= 0 ? 2 : 1, -1);
+	if(ready <= 0)
+		return;
+
+	if(descriptors[0].revents & POLLIN)
+	{
+		uint64_t counter;
+		ssize_t bytesRead = read(_pEventFd, &counter, sizeof(counter));
+		(void)bytesRead;
+	}
+	if(descriptors[1].revents & (POLLRDHUP | POLLHUP | POLLERR))
+	{
+		outbound.header->closed.store(1);
+		inbound.header->closed.store(1);
+	}
+}
+
+void Networking::ShmChannel::Signal(int _pEventFd)
+{
+	uint64_t one = 1;
+	ssize_t written = write(_pEventFd, &one, sizeof(one));
+	(void)written;
+}
+
+void Networking::ShmChannel::Release()
+{
+	if(mapping != nullptr)
+		munmap(mapping, mappingSize);
+	mapping = nullptr;
+	if(memoryFd >= 0)
+		close(memoryFd);
+	memoryFd = -1;
+	for(int i = 0; i < 4; i++)
+	{
+		if(eventFds[i] >= 0)
+			close(eventFds[i]);
+		eventFds[i] = -1;
+	}
+	if(peerSocket >= 0)
+		close(peerSocket);
+	peerSocket = -1;
+	outbound = Ring();
+	inbound = Ring();
+}
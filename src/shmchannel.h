@@ -0,0 +1,111 @@
+#pragma once
+#ifndef _NET_SHM_CHANNEL_
+#define _NET_SHM_CHANNEL_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "frame.h"
+
+namespace Networking {
+
+// Frame transport between two processes on the same host. Each direction is a
+// single-producer single-consumer byte ring in a shared memfd mapping, carrying
+// the same frames as a socket (see frame.h). A sender copies a frame straight
+// into the ring and the receiver copies it out, with no system call unless one
+// side has to wait: waiting is done on an eventfd, which the other side only
+// signals when it knows a waiter is parked.
+//
+// One side creates the channel with Create and hands the memfd and eventfds to
+// the other over a connected Unix domain socket with ShareOver; the other side
+// maps them with AttachFrom. Both keep the socket, which is how a peer that
+// exits without calling Close is noticed.
+//
+// SendFrame and ReceiveFrame mirror Client: they may be used from one sending
+// and one receiving thread at a time, return the payload length or payload,
+// and throw the error code on failure (EPIPE once the peer has gone).
+class ShmChannel {
+public:
+
+// Capacity of each direction's ring unless another is requested
+static const size_t DEFAULT_RING_CAPACITY = 1024 * 1024;
+
+// An empty channel; IsOpen() is false
+ShmChannel();
+
+// Unmaps the rings and closes the descriptors; the peer sees the channel close
+~ShmChannel();
+
+ShmChannel(ShmChannel&& _pOther);
+ShmChannel& operator=(ShmChannel&& _pOther);
+ShmChannel(const ShmChannel&) = delete;
+ShmChannel& operator=(const ShmChannel&) = delete;
+
+// Creates a channel with rings of _pRingCapacity bytes, rounded up to a power
+// of two. Throws the error code if the shared memory or eventfds cannot be created.
+static ShmChannel Create(size_t _pRingCapacity = DEFAULT_RING_CAPACITY);
+
+// Sends the channel's descriptors to the peer over the connected Unix domain
+// socket _pSocket and keeps a duplicate of the socket to watch for the peer
+// exiting. Throws the error code on failure.
+void ShareOver(SOCKET _pSocket);
+
+// Receives descriptors sent with ShareOver on _pSocket and maps the channel.
+// Throws the error code on failure, or EPROTO if the message is not a channel.
+static ShmChannel AttachFrom(SOCKET _pSocket);
+
+// Sends _pLength bytes as one frame, waiting for ring space as needed. Frames
+// larger than the ring are streamed through it.
+int SendFrame(const char* _pData, size_t _pLength, uint32_t _pRequestId = 0);
+int SendFrame(const std::string& _pData, uint32_t _pRequestId = 0);
+
+// Receives one frame and returns its payload. Returns an empty vector once the
+// peer has closed the channel; throws EPROTO/EMSGSIZE for malformed or
+// oversized frames.
+std::vector<char> ReceiveFrame();
+std::vector<char> ReceiveFrame(uint32_t& _pRequestId);
+
+// Marks the channel closed and wakes the peer
+void Close();
+
+// Returns true between Create/AttachFrom and Close
+bool IsOpen() const;
+
+// Sets the largest frame payload this channel will accept
+void SetMaxMessageSize(size_t _pMaxMessageSize);
+
+private:
+
+struct RingHeader;
+
+// One direction of the channel as seen from this side
+struct Ring {
+	RingHeader* header = nullptr;
+	char* data = nullptr;
+	int dataFd = -1;  // Signalled by the writer when it publishes bytes
+	int spaceFd = -1; // Signalled by the reader when it frees space
+};
+
+void Map(int _pMemoryFd, size_t _pRingCapacity, bool _pCreator);
+void Write(const char* _pData, size_t _pLength);
+bool Read(char* _pData, size_t _pLength);
+void Wait(int _pEventFd);
+void Signal(int _pEventFd);
+void Release();
+
+int memoryFd = -1;
+void* mapping = nullptr;
+size_t mappingSize = 0;
+size_t ringCapacity = 0;
+int eventFds[4] = {-1, -1, -1, -1};
+SOCKET peerSocket = -1;
+Ring outbound;
+Ring inbound;
+bool open = false;
+size_t maxMessageSize = DEFAULT_MAX_MESSAGE_SIZE;
+};
+
+}
+
+#endif
@@ -0,0 +1,177 @@
+#include "storageengine.h"
+
+#include <algorithm>
+#include <atomic>
+
+FileContent StorageEngine::readShared(const std::string& _pName)
+{
+	std::string content;
+	if(!read(_pName, content))
+		return nullptr;
+	return std::make_shared<const std::string>(std::move(content));
+}
+
+
+MemoryStorageEngine::MemoryStorageEngine(size_t _pShardCount)
+	: _Files(_pShardCount)
+{
+}
+
+
+bool MemoryStorageEngine::create(const std::string& _pName)
+{
+	Version empty = std::make_shared<std::string>();
+	ShardedFileMap<Version>::Shard& shard = _Files.shardFor(_pName);
+	std::unique_lock<std::shared_mutex> lock(shard.mutex);
+	return shard.entries.emplace(_pName, std::move(empty)).second;
+}
+
+
+bool MemoryStorageEngine::write(const std::string& _pName, const std::string& _pContent)
+{
+	return publish(_pName, std::make_shared<std::string>(_pContent));
+}
+
+
+bool MemoryStorageEngine::write(const std::string& _pName, std::string&& _pContent)
+{
+	return publish(_pName, std::make_shared<std::string>(std::move(_pContent)));
+}
+
+
+bool MemoryStorageEngine::publish(const std::string& _pName, Version _pContent)
+{
+	ShardedFileMap<Version>::Shard& shard = _Files.shardFor(_pName);
+	std::unique_lock<std::shared_mutex> lock(shard.mutex);
+	auto it = shard.entries.find(_pName);
+	if(it == shard.entries.end())
+		return false;
+	// Readers holding the old version keep it; otherwise it is freed with
+	// _pContent, after the lock is released
+	it->second.swap(_pContent);
+	lock.unlock();
+	return true;
+}
+
+
+bool MemoryStorageEngine::modify(const std::string& _pName, const std::function<bool(std::string&)>& _pChange)
+{
+	ShardedFileMap<Version>::Shard& shard = _Files.shardFor(_pName);
+	for(;;)
+	{
+		Version current;
+		{
+			std::unique_lock<std::shared_mutex> lock(shard.mutex);
+			auto it = shard.entries.find(_pName);
+			if(it == shard.entries.end())
+				return false;
+			// Versions are only handed out under the shard lock, which we hold exclusively,
+			// so a count of one means no reader has this version and it can change in place
+			if(it->second.use_count() == 1)
+			{
+				// Orders the change after the last reader's accesses, which ended with its release
+				std::atomic_thread_fence(std::memory_order_acquire);
+				return _pChange(*it->second);
+			}
+			current = it->second;
+		}
+
+		// A reader holds the version, so the whole file is copied, without blocking the shard
+		Version changed = std::make_shared<std::string>(*current);
+		if(!_pChange(*changed))
+			return false;
+
+		std::unique_lock<std::shared_mutex> lock(shard.mutex);
+		auto it = shard.entries.find(_pName);
+		if(it == shard.entries.end())
+			return false;
+		// Published only over the version the copy was made from; a write that
+		// came in between is not lost, the change is applied again on top of it
+		if(it->second != current)
+			continue;
+		it->second.swap(changed);
+		lock.unlock();
+		return true;
+	}
+}
+
+
+bool MemoryStorageEngine::read(const std::string& _pName, std::string& _pContent)
+{
+	FileContent content = readShared(_pName);
+	if(!content)
+		return false;
+	_pContent = *content; // Copied outside the lock
+	return true;
+}
+
+
+FileContent MemoryStorageEngine::readShared(const std::string& _pName)
+{
+	ShardedFileMap<Version>::Shard& shard = _Files.shardFor(_pName);
+	std::shared_lock<std::shared_mutex> lock(shard.mutex);
+	auto it = shard.entries.find(_pName);
+	if(it == shard.entries.end())
+		return nullptr;
+	return it->second;
+}
+
+
+bool MemoryStorageEngine::readRange(const std::string& _pName, uint64_t _pOffset, uint64_t _pLength, std::string& _pContent)
+{
+	FileContent content = readShared(_pName);
+	if(!content)
+		return false;
+	if(_pOffset >= content->size())
+		_pContent.clear();
+	else
+		_pContent.assign(*content, static_cast<size_t>(_pOffset), static_cast<size_t>(std::min<uint64_t>(_pLength, content->size() - _pOffset)));
+	return true;
+}
+
+
+bool MemoryStorageEngine::writeAt(const std::string& _pName, uint64_t _pOffset, const std::string& _pData)
+{
+	if(_pOffset + _pData.size() < _pOffset)
+		return false;
+	return modify(_pName, [&](std::string& _pContent) {
+		if(_pContent.size() < _pOffset + _pData.size())
+			_pContent.resize(static_cast<size_t>(_pOffset + _pData.size()));
+		_pContent.replace(static_cast<size_t>(_pOffset), _pData.size(), _pData);
+		return true;
+	});
+}
+
+
+bool MemoryStorageEngine::append(const std::string& _pName, const std::string& _pData, uint64_t _pMaxSize)
+{
+	return modify(_pName, [&](std::string& _pContent) {
+		if(_pContent.size() > _pMaxSize || _pData.size() > _pMaxSize - _pContent.size())
+			return false;
+		_pContent.append(_pData);
+		return true;
+	});
+}
+
+
+bool MemoryStorageEngine::truncate(const std::string& _pName, uint64_t _pSize)
+{
+	return modify(_pName, [&](std::string& _pContent) {
+		_pContent.resize(static_cast<size_t>(_pSize));
+		return true;
+	});
+}
+
+
+bool MemoryStorageEngine::remove(const std::string& _pName)
+{
+	Version removed;
+	ShardedFileMap<Version>::Shard& shard = _Files.shardFor(_pName);
+	std::unique_lock<std::shared_mutex> lock(shard.mutex);
+	auto it = shard.entries.find(_pName);
+	if(it == shard.entries.end())
+		return false;
+	removed.swap(it->second); // Freed after the lock is released
+	shard.entries.erase(it);
+	return true;
+}
@@ -0,0 +1,187 @@
+#pragma once
+#ifndef _SIMPLIDFS_STORAGEENGINE_H
+#define _SIMPLIDFS_STORAGEENGINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief An immutable version of a file's content, shared by everyone reading it.
+ * Writing a file publishes a new version; readers keep the one they have for as long
+ * as they hold the pointer, without copying it and without holding any lock.
+ */
+typedef std::shared_ptr<const std::string> FileContent;
+
+/**
+ * @brief Where a FileSystem keeps file content.
+ *
+ * Implementations are thread-safe on their own; FileSystem forwards every call
+ * without further locking. The contract for each operation is the one documented
+ * on the matching FileSystem method.
+ */
+class StorageEngine {
+public:
+    virtual ~StorageEngine() = default;
+
+    /** @brief Creates an empty file. @return False if it already exists or could not be stored. */
+    virtual bool create(const std::string& _pName) = 0;
+
+    /** @brief Replaces the content of an existing file. @return False if it does not exist or could not be stored. */
+    virtual bool write(const std::string& _pName, const std::string& _pContent) = 0;
+
+    /** @brief As above, taking ownership of the content where the engine can keep it as it is. */
+    virtual bool write(const std::string& _pName, std::string&& _pContent) = 0;
+
+    /**
+     * @brief Reads the content of a file.
+     * @param _pName The file to read.
+     * @param _pContent Receives the content.
+     * @return False if the file does not exist or could not be read.
+     */
+    virtual bool read(const std::string& _pName, std::string& _pContent) = 0;
+
+    /**
+     * @brief Returns the current version of a file's content without copying it where the
+     *        engine keeps content in memory. This default reads a private copy with read().
+     * @return The content, or nullptr if the file does not exist or could not be read.
+     */
+    virtual FileContent readShared(const std::string& _pName);
+
+    /**
+     * @brief Reads part of a file.
+     * @param _pName The file to read.
+     * @param _pOffset First byte to read. At or past the end of the file nothing is read.
+     * @param _pLength Number of bytes to read; fewer are read where the file ends first.
+     * @param _pContent Receives the bytes read.
+     * @return False if the file does not exist or could not be read.
+     */
+    virtual bool readRange(const std::string& _pName, uint64_t _pOffset, uint64_t _pLength, std::string& _pContent) = 0;
+
+    /**
+     * @brief Overwrites part of a file, leaving the rest as it is. A write past the end
+     *        extends the file, filling any gap with zero bytes.
+     * @return False if the file does not exist or could not be stored.
+     */
+    virtual bool writeAt(const std::string& _pName, uint64_t _pOffset, const std::string& _pData) = 0;
+
+    /**
+     * @brief Adds data at the end of a file.
+     * @param _pMaxSize Largest size the file may grow to; nothing is appended past it.
+     * @return False if it does not exist, would grow past _pMaxSize or could not be stored.
+     */
+    virtual bool append(const std::string& _pName, const std::string& _pData, uint64_t _pMaxSize) = 0;
+
+    /**
+     * @brief Sets the size of a file, cutting it off or extending it with zero bytes.
+     * @return False if the file does not exist or could not be stored.
+     */
+    virtual bool truncate(const std::string& _pName, uint64_t _pSize) = 0;
+
+    /** @brief Deletes a file. @return False if it did not exist or the deletion could not be stored. */
+    virtual bool remove(const std::string& _pName) = 0;
+};
+
+/** @brief Number of lock stripes a storage engine splits its files over by default. */
+const size_t DEFAULT_STORAGE_SHARD_COUNT = 64;
+
+/**
+ * @brief A filename-keyed map split into independently locked shards.
+ *
+ * A file's shard is chosen by the hash of its name, so operations on files in different
+ * shards never wait for each other, and readers of one shard share its lock. Callers
+ * lock the shard they use themselves; at most one shard lock is held at a time unless
+ * all of them are taken in index order.
+ */
+template <typename Value>
+class ShardedFileMap {
+public:
+    /** @brief One stripe: its lock and the files hashed to it, on a cache line of its own. */
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<std::string, Value> entries;
+    };
+
+    /** @param _pShardCount Number of shards; rounded up to a power of two, at least 1. */
+    explicit ShardedFileMap(size_t _pShardCount = DEFAULT_STORAGE_SHARD_COUNT) {
+        while ((size_t(1) << _ShardBits) < _pShardCount && _ShardBits < 16) {
+            ++_ShardBits;
+        }
+        _Shards.reset(new Shard[size_t(1) << _ShardBits]);
+    }
+
+    /** @brief The shard holding the given file. */
+    Shard& shardFor(const std::string& _pName) const {
+        if (_ShardBits == 0) {
+            return _Shards[0];
+        }
+        // Take the high bits of a multiplicative mix, so that the shard does not follow the
+        // low bits the shard's own unordered_map picks its bucket with
+        uint64_t hash = static_cast<uint64_t>(std::hash<std::string>()(_pName)) * 0x9E3779B97F4A7C15ull;
+        return _Shards[hash >> (64 - _ShardBits)];
+    }
+
+    size_t shardCount() const { return size_t(1) << _ShardBits; }
+    Shard& shard(size_t _pIndex) const { return _Shards[_pIndex]; }
+
+private:
+    unsigned _ShardBits = 0;
+    std::unique_ptr<Shard[]> _Shards;
+};
+
+/**
+ * @brief Keeps every file as a string in memory. Content is lost when the process exits.
+ *
+ * Files are spread over lock-striped shards (ShardedFileMap): reads take their shard's
+ * lock shared, writes take it exclusively, and every operation does one hash lookup.
+ * Content is kept as FileContent versions: a write builds the new version before taking
+ * the lock and only swaps the pointer under it, and readShared() hands out the current
+ * version, so the locks are only ever held for a lookup and a reference-count update.
+ * Partial writes change the current version in place while no reader holds it, and
+ * otherwise publish a changed copy, made outside the lock.
+ */
+class MemoryStorageEngine : public StorageEngine {
+public:
+    /** @param _pShardCount Number of independently locked shards; 1 gives a single global lock. */
+    explicit MemoryStorageEngine(size_t _pShardCount = DEFAULT_STORAGE_SHARD_COUNT);
+
+    bool create(const std::string& _pName) override;
+    bool write(const std::string& _pName, const std::string& _pContent) override;
+    bool write(const std::string& _pName, std::string&& _pContent) override;
+    bool read(const std::string& _pName, std::string& _pContent) override;
+    FileContent readShared(const std::string& _pName) override;
+    bool readRange(const std::string& _pName, uint64_t _pOffset, uint64_t _pLength, std::string& _pContent) override;
+    bool writeAt(const std::string& _pName, uint64_t _pOffset, const std::string& _pData) override;
+    bool append(const std::string& _pName, const std::string& _pData, uint64_t _pMaxSize) override;
+    bool truncate(const std::string& _pName, uint64_t _pSize) override;
+    bool remove(const std::string& _pName) override;
+
+private:
+    /** @brief A version of a file's content; only changed in place while nothing else holds it. */
+    typedef std::shared_ptr<std::string> Version;
+
+    /** @brief Replaces the current version of an existing file. */
+    bool publish(const std::string& _pName, Version _pContent);
+
+    /**
+     * @brief Applies a change to the content of an existing file, copy-on-write.
+     * A copy is published only if no other write came in while it was made; otherwise the
+     * change is made again on the newer version.
+     * @param _pChange Changes the content it is given, which is only seen by the caller, or
+     *                 returns false, leaving it as it is, to refuse the change. May run more than once.
+     * @return False if the file does not exist or the change was refused.
+     */
+    bool modify(const std::string& _pName, const std::function<bool(std::string&)>& _pChange);
+
+    /**
+     * @brief In-memory storage for files, mapping filename to its current content, each shard under its own lock.
+     */
+    ShardedFileMap<Version> _Files;
+};
+
+#endif
@@ -0,0 +1,195 @@
+#include "threadpool.h"
+#include <exception>
+#include <iostream>
+
+namespace {
+
+// Identifies the pool and worker running on the current thread so that tasks
+// submitted from inside a task can go to the worker's own deque
+thread_local ThreadPool* currentPool = nullptr;
+thread_local size_t currentWorker = 0;
+
+}
+
+ThreadPool::ThreadPool(size_t _pWorkerCount, size_t _pQueueCapacity)
+    : _QueueCapacity(_pQueueCapacity == 0 ? 1 : _pQueueCapacity)
+{
+    if (_pWorkerCount == 0) {
+        _pWorkerCount = std::thread::hardware_concurrency();
+        if (_pWorkerCount == 0) {
+            _pWorkerCount = 1;
+        }
+    }
+
+    for (size_t i = 0; i < _pWorkerCount; ++i) {
+        _Workers.emplace_back(new Worker());
+    }
+    // Start threads only once every deque exists, since workers steal from each other
+    for (size_t i = 0; i < _pWorkerCount; ++i) {
+        _Workers[i]->thread = std::thread(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    Shutdown();
+}
+
+bool ThreadPool::Submit(std::function<void()> _pTask) {
+    return Enqueue(_pTask, true);
+}
+
+bool ThreadPool::TrySubmit(std::function<void()> _pTask) {
+    return Enqueue(_pTask, false);
+}
+
+bool ThreadPool::Enqueue(std::function<void()>& _pTask, bool _pWait) {
+    if (currentPool == this) {
+        // Accepted even while shutting down: this worker drains its deque before it exits
+        {
+            // Counted before the task is visible so a thief never takes the count below zero;
+            // holding the lock orders the increment with a worker's check before it sleeps
+            std::lock_guard<std::mutex> lock(_GlobalMutex);
+            _PendingTasks++;
+        }
+        Worker& worker = *_Workers[currentWorker];
+        {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.tasks.push_back(std::move(_pTask));
+            _LocalTasks++;
+        }
+        _Submitted++;
+        _TaskAvailable.notify_one();
+        return true;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(_GlobalMutex);
+        if (_pWait) {
+            _SpaceAvailable.wait(lock, [this] { return _Stopping || _GlobalQueue.size() < _QueueCapacity; });
+        }
+        if (_Stopping) {
+            return false;
+        }
+        if (_GlobalQueue.size() >= _QueueCapacity) {
+            _Rejected++;
+            return false;
+        }
+        _GlobalQueue.push_back(std::move(_pTask));
+        _PendingTasks++;
+        _Submitted++;
+    }
+    _TaskAvailable.notify_one();
+    return true;
+}
+
+void ThreadPool::Shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(_GlobalMutex);
+        if (_Stopping) {
+            return;
+        }
+        _Stopping = true;
+    }
+    _TaskAvailable.notify_all();
+    _SpaceAvailable.notify_all();
+
+    for (auto& worker : _Workers) {
+        if (worker->thread.joinable()) {
+            if (worker->thread.get_id() == std::this_thread::get_id()) {
+                worker->thread.detach();
+            } else {
+                worker->thread.join();
+            }
+        }
+    }
+}
+
+ThreadPool::Stats ThreadPool::GetStats() const {
+    Stats stats;
+    stats.workerCount = _Workers.size();
+    {
+        std::lock_guard<std::mutex> lock(_GlobalMutex);
+        stats.globalQueueDepth = _GlobalQueue.size();
+    }
+    stats.localQueueDepth = _LocalTasks;
+    stats.submitted = _Submitted;
+    stats.executed = _Executed;
+    stats.steals = _Steals;
+    stats.rejected = _Rejected;
+    return stats;
+}
+
+size_t ThreadPool::GetWorkerCount() const {
+    return _Workers.size();
+}
+
+void ThreadPool::WorkerLoop(size_t _pIndex) {
+    currentPool = this;
+    currentWorker = _pIndex;
+
+    while (true) {
+        std::function<void()> task;
+        if (PopLocal(_pIndex, task) || PopGlobal(task) || Steal(_pIndex, task)) {
+            _PendingTasks--;
+            try {
+                task();
+            } catch (const std::exception& ex) {
+                std::cerr << "Unhandled exception in thread pool task: " << ex.what() << std::endl;
+            } catch (...) {
+                std::cerr << "Unhandled exception in thread pool task" << std::endl;
+            }
+            _Executed++;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_GlobalMutex);
+        _TaskAvailable.wait(lock, [this] { return _Stopping || _PendingTasks > 0; });
+        // Queued work is drained before the pool shuts down
+        if (_Stopping && _PendingTasks == 0) {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::PopLocal(size_t _pIndex, std::function<void()>& _pTask) {
+    Worker& worker = *_Workers[_pIndex];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) {
+        return false;
+    }
+    // The newest task is the one most likely to still be in cache
+    _pTask = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    _LocalTasks--;
+    return true;
+}
+
+bool ThreadPool::PopGlobal(std::function<void()>& _pTask) {
+    {
+        std::lock_guard<std::mutex> lock(_GlobalMutex);
+        if (_GlobalQueue.empty()) {
+            return false;
+        }
+        _pTask = std::move(_GlobalQueue.front());
+        _GlobalQueue.pop_front();
+    }
+    _SpaceAvailable.notify_one();
+    return true;
+}
+
+bool ThreadPool::Steal(size_t _pIndex, std::function<void()>& _pTask) {
+    for (size_t offset = 1; offset < _Workers.size(); ++offset) {
+        Worker& victim = *_Workers[(_pIndex + offset) % _Workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.tasks.empty()) {
+            continue;
+        }
+        // Thieves take the oldest task, away from the end the owner works on
+        _pTask = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        _LocalTasks--;
+        _Steals++;
+        return true;
+    }
+    return false;
+}
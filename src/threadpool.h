@@ -0,0 +1,113 @@
+#pragma once
+#ifndef _SIMPLIDFS_THREADPOOL_H
+#define _SIMPLIDFS_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Bounded work-stealing executor used to run request handlers.
+ *
+ * Tasks submitted from outside the pool go to a bounded global queue; when it is
+ * full, Submit blocks and TrySubmit fails, so a burst of requests applies
+ * backpressure instead of creating threads or growing without limit. Tasks
+ * submitted by a running task go to that worker's own deque. Idle workers take
+ * from their own deque first (newest first), then from the global queue, and
+ * finally steal the oldest task from another worker's deque.
+ */
+class ThreadPool {
+public:
+    /**
+     * @brief Snapshot of the pool's counters.
+     */
+    struct Stats {
+        size_t workerCount = 0;       ///< Number of worker threads.
+        size_t globalQueueDepth = 0;  ///< Tasks waiting in the bounded global queue.
+        size_t localQueueDepth = 0;   ///< Tasks waiting in the per-worker deques.
+        uint64_t submitted = 0;       ///< Tasks accepted by Submit or TrySubmit.
+        uint64_t executed = 0;        ///< Tasks that have finished running.
+        uint64_t steals = 0;          ///< Tasks taken from another worker's deque.
+        uint64_t rejected = 0;        ///< TrySubmit calls refused because the global queue was full.
+    };
+
+    /**
+     * @brief Starts the worker threads.
+     * @param _pWorkerCount Number of workers. Zero selects std::thread::hardware_concurrency().
+     * @param _pQueueCapacity Maximum number of tasks held in the global queue.
+     */
+    explicit ThreadPool(size_t _pWorkerCount = 0, size_t _pQueueCapacity = 1024);
+
+    /**
+     * @brief Runs any queued tasks and joins the workers.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Queues a task, blocking while the global queue is full.
+     * Called from a worker thread, the task goes to that worker's deque and never blocks.
+     * @return False if the pool has been shut down and the caller is not one of its tasks.
+     */
+    bool Submit(std::function<void()> _pTask);
+
+    /**
+     * @brief Queues a task without blocking.
+     * @return False if the global queue is full or the pool has been shut down.
+     */
+    bool TrySubmit(std::function<void()> _pTask);
+
+    /**
+     * @brief Stops accepting tasks, runs those already queued and joins the workers.
+     */
+    void Shutdown();
+
+    /**
+     * @brief Returns the current queue depths and counters.
+     */
+    Stats GetStats() const;
+
+    /**
+     * @brief Returns the number of worker threads.
+     */
+    size_t GetWorkerCount() const;
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()> > tasks;
+        std::thread thread;
+    };
+
+    bool Enqueue(std::function<void()>& _pTask, bool _pWait);
+    void WorkerLoop(size_t _pIndex);
+    bool PopLocal(size_t _pIndex, std::function<void()>& _pTask);
+    bool PopGlobal(std::function<void()>& _pTask);
+    bool Steal(size_t _pIndex, std::function<void()>& _pTask);
+
+    std::vector<std::unique_ptr<Worker> > _Workers;
+    size_t _QueueCapacity;
+
+    mutable std::mutex _GlobalMutex;
+    std::condition_variable _TaskAvailable;
+    std::condition_variable _SpaceAvailable;
+    std::deque<std::function<void()> > _GlobalQueue;
+    bool _Stopping = false;
+
+    std::atomic<size_t> _PendingTasks{0};
+    std::atomic<size_t> _LocalTasks{0};
+    std::atomic<uint64_t> _Submitted{0};
+    std::atomic<uint64_t> _Executed{0};
+    std::atomic<uint64_t> _Steals{0};
+    std::atomic<uint64_t> _Rejected{0};
+};
+
+#endif
@@ -0,0 +1,1075 @@
+#include "uringloop.h"
+#include "compression.h"
+#include "server.h"
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// Submission queue size; the completion queue gets four times as many slots,
+// since the multishot accept keeps completing without new submissions
+const unsigned RING_ENTRIES = 256;
+
+// Receive buffers handed to the kernel through the provided buffer ring.
+// The count must be a power of two.
+const unsigned RECEIVE_BUFFER_COUNT = 256;
+const size_t RECEIVE_BUFFER_SIZE = 64 * 1024;
+const uint16_t RECEIVE_BUFFER_GROUP = 0;
+
+// Size of the buffer that keeps a partial frame until the rest arrives
+const size_t INPUT_BUFFER_SIZE = 64 * 1024;
+
+// What a completion belongs to, kept in the top byte of its user_data.
+// The low 32 bits hold the socket.
+enum class Operation : uint8_t
+{
+	Accept = 1,
+	WakeRead,
+	Receive,
+	Send,
+	Close,
+	Cancel
+};
+
+uint64_t MakeUserData(Operation _pOperation, SOCKET _pSocket)
+{
+	return ((uint64_t)_pOperation << 56) | (uint32_t)_pSocket;
+}
+
+int SetupRing(unsigned _pEntries, io_uring_params* _pParams)
+{
+	return (int)syscall(__NR_io_uring_setup, _pEntries, _pParams);
+}
+
+int EnterRing(int _pRingFd, unsigned _pToSubmit, unsigned _pMinComplete, unsigned _pFlags)
+{
+	return (int)syscall(__NR_io_uring_enter, _pRingFd, _pToSubmit, _pMinComplete, _pFlags, NULL, 0);
+}
+
+int RegisterWithRing(int _pRingFd, unsigned _pOpcode, void* _pArgument, unsigned _pArgumentCount)
+{
+	return (int)syscall(__NR_io_uring_register, _pRingFd, _pOpcode, _pArgument, _pArgumentCount);
+}
+
+}
+
+// The rings are shared with the kernel: it consumes submissions from sqHead and
+// posts completions at cqTail, so those are read with acquire loads, and the
+// indexes we publish (sqTail, cqHead and the buffer ring tail) are written with
+// release stores after the entries they cover.
+struct Networking::UringLoop::Ring {
+	int fd = -1;
+	void* queues = MAP_FAILED;
+	size_t queuesSize = 0;
+	io_uring_sqe* sqes = (io_uring_sqe*)MAP_FAILED;
+	size_t sqesSize = 0;
+	unsigned* sqHead = nullptr;
+	unsigned* sqTail = nullptr;
+	unsigned* sqArray = nullptr;
+	unsigned sqMask = 0;
+	unsigned sqEntries = 0;
+	// Entries are prepared past the published tail and handed over by Enter
+	unsigned sqPrepared = 0;
+	unsigned* cqHead = nullptr;
+	unsigned* cqTail = nullptr;
+	unsigned cqMask = 0;
+	io_uring_cqe* cqes = nullptr;
+	// The provided buffer ring. The kernel header declares it with a flexible
+	// array member whose C++ layout differs from C, so it is indexed as a plain
+	// array; the tail overlays the reserved field of the first entry.
+	io_uring_buf* buffers = (io_uring_buf*)MAP_FAILED;
+	size_t buffersSize = 0;
+	char* bufferMemory = (char*)MAP_FAILED;
+	size_t bufferMemorySize = 0;
+	size_t bufferSize = 0;
+	unsigned bufferMask = 0;
+	uint16_t bufferTail = 0;
+	bool disabled = false;
+
+	~Ring()
+	{
+		// Closing the ring cancels whatever is still in flight
+		if(fd >= 0)
+			close(fd);
+		if(queues != MAP_FAILED)
+			munmap(queues, queuesSize);
+		if(sqes != MAP_FAILED)
+			munmap(sqes, sqesSize);
+		if(buffers != MAP_FAILED)
+			munmap(buffers, buffersSize);
+		if(bufferMemory != MAP_FAILED)
+			munmap(bufferMemory, bufferMemorySize);
+	}
+
+	// Sets up a ring with _pEntries submission slots and registers _pBufferCount
+	// receive buffers of _pBufferSize bytes. Returns false with errno set.
+	bool Open(unsigned _pEntries, unsigned _pBufferCount, size_t _pBufferSize)
+	{
+		io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		// Completion work is deferred until the loop asks for events, instead of
+		// interrupting it whenever a socket is ready. That requires a single
+		// submitting thread, which is the one that enables the ring in Run().
+		params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_R_DISABLED;
+		params.cq_entries = _pEntries * 4;
+		fd = SetupRing(_pEntries, &params);
+		if(fd < 0 && errno == EINVAL)
+		{
+			// Kernels before 6.1 lack deferred task work
+			memset(&params, 0, sizeof(params));
+			params.flags = IORING_SETUP_CQSIZE;
+			params.cq_entries = _pEntries * 4;
+			fd = SetupRing(_pEntries, &params);
+		}
+		if(fd < 0)
+			return false;
+		disabled = (params.flags & IORING_SETUP_R_DISABLED) != 0;
+		// Every kernel with provided buffer rings has these
+		if(!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP))
+		{
+			errno = ENOSYS;
+			return false;
+		}
+
+		queuesSize = std::max<size_t>(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+			params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+		queues = mmap(NULL, queuesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+		if(queues == MAP_FAILED)
+			return false;
+		sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+		sqes = (io_uring_sqe*)mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+		if(sqes == MAP_FAILED)
+			return false;
+
+		char* base = (char*)queues;
+		sqHead = (unsigned*)(base + params.sq_off.head);
+		sqTail = (unsigned*)(base + params.sq_off.tail);
+		sqArray = (unsigned*)(base + params.sq_off.array);
+		sqMask = *(unsigned*)(base + params.sq_off.ring_mask);
+		sqEntries = params.sq_entries;
+		sqPrepared = *sqTail;
+		cqHead = (unsigned*)(base + params.cq_off.head);
+		cqTail = (unsigned*)(base + params.cq_off.tail);
+		cqMask = *(unsigned*)(base + params.cq_off.ring_mask);
+		cqes = (io_uring_cqe*)(base + params.cq_off.cqes);
+
+		buffersSize = _pBufferCount * sizeof(io_uring_buf);
+		buffers = (io_uring_buf*)mmap(NULL, buffersSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(buffers == MAP_FAILED)
+			return false;
+		bufferSize = _pBufferSize;
+		bufferMemorySize = _pBufferCount * _pBufferSize;
+		bufferMemory = (char*)mmap(NULL, bufferMemorySize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(bufferMemory == MAP_FAILED)
+			return false;
+
+		io_uring_buf_reg registration;
+		memset(&registration, 0, sizeof(registration));
+		registration.ring_addr = (uint64_t)(uintptr_t)buffers;
+		registration.ring_entries = _pBufferCount;
+		registration.bgid = RECEIVE_BUFFER_GROUP;
+		if(RegisterWithRing(fd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0)
+			return false;
+		bufferMask = _pBufferCount - 1;
+		for(unsigned i = 0; i < _pBufferCount; i++)
+			ReturnBuffer((uint16_t)i);
+		return true;
+	}
+
+	// Makes the calling thread the ring's only submitter
+	bool Enable()
+	{
+		if(!disabled)
+			return true;
+		if(RegisterWithRing(fd, IORING_REGISTER_ENABLE_RINGS, NULL, 0) < 0)
+			return false;
+		disabled = false;
+		return true;
+	}
+
+	// Returns a zeroed submission entry, or nullptr if the queue is full even
+	// after handing what is prepared to the kernel
+	io_uring_sqe* NextSqe()
+	{
+		if(!Reserve(1))
+			return nullptr;
+		unsigned index = sqPrepared & sqMask;
+		io_uring_sqe* sqe = &sqes[index];
+		memset(sqe, 0, sizeof(*sqe));
+		sqArray[index] = index;
+		sqPrepared++;
+		return sqe;
+	}
+
+	// Makes sure _pCount entries can be prepared without a submission in
+	// between, which would break a chain of linked entries
+	bool Reserve(unsigned _pCount)
+	{
+		if(sqPrepared - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) + _pCount <= sqEntries)
+			return true;
+		Enter(0);
+		return sqPrepared - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) + _pCount <= sqEntries;
+	}
+
+	// Submits every prepared entry and waits until at least _pWaitFor
+	// completions are available. Returns SOCKET_ERROR with errno set.
+	int Enter(unsigned _pWaitFor)
+	{
+		__atomic_store_n(sqTail, sqPrepared, __ATOMIC_RELEASE);
+		unsigned toSubmit = sqPrepared - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+		return EnterRing(fd, toSubmit, _pWaitFor, _pWaitFor > 0 ? IORING_ENTER_GETEVENTS : 0);
+	}
+
+	char* BufferData(uint16_t _pBufferId)
+	{
+		return bufferMemory + (size_t)_pBufferId * bufferSize;
+	}
+
+	// Gives a receive buffer back to the kernel
+	void ReturnBuffer(uint16_t _pBufferId)
+	{
+		io_uring_buf* entry = &buffers[bufferTail & bufferMask];
+		entry->addr = (uint64_t)(uintptr_t)BufferData(_pBufferId);
+		entry->len = (uint32_t)bufferSize;
+		entry->bid = _pBufferId;
+		bufferTail++;
+		__atomic_store_n(&buffers[0].resv, bufferTail, __ATOMIC_RELEASE);
+	}
+};
+
+Networking::UringLoop::UringLoop(SOCKET _pListenSocket, MessageHandler _pHandler, Logger& _pLogger, size_t _pMaxMessageSize, ThreadPool* _pExecutor)
+	: listenSocket(_pListenSocket), ring(new Ring()), handler(std::move(_pHandler)), logger(_pLogger), maxMessageSize(_pMaxMessageSize), executor(_pExecutor)
+{
+	if(!ring->Open(RING_ENTRIES, RECEIVE_BUFFER_COUNT, RECEIVE_BUFFER_SIZE))
+		throw std::runtime_error("Error: Unable to create io_uring: " + std::string(strerror(errno)));
+	wakeFd = eventfd(0, EFD_CLOEXEC);
+	if(wakeFd < 0)
+		throw std::runtime_error("Error: Unable to create event loop: " + std::string(strerror(errno)));
+}
+
+Networking::UringLoop::~UringLoop()
+{
+	ring.reset();
+	for(auto& entry : connections)
+	{
+		if(connectionTable != nullptr)
+			connectionTable->Remove(entry.first);
+		CLOSESOCKET(entry.first);
+	}
+	connections.clear();
+	if(wakeFd >= 0)
+		close(wakeFd);
+}
+
+bool Networking::UringLoop::IsSupported()
+{
+	Ring probe;
+	return probe.Open(2, 1, 4096);
+}
+
+void Networking::UringLoop::SetKeepAlive(bool _pKeepAlive)
+{
+	keepAlive = _pKeepAlive;
+}
+
+void Networking::UringLoop::SetListenerIndex(size_t _pListenerIndex)
+{
+	listenerIndex = _pListenerIndex;
+}
+
+void Networking::UringLoop::SetConnectionTable(ConnectionTable* _pTable)
+{
+	connectionTable = _pTable;
+}
+
+void Networking::UringLoop::Run()
+{
+	loopThreadId = std::this_thread::get_id();
+	if(!ring->Enable())
+	{
+		logger.log("Unable to enable io_uring: " + std::string(strerror(errno)));
+		return;
+	}
+
+	running = true;
+	while(!stopRequested)
+	{
+		// Either may have been left unarmed by a full submission queue
+		if(!accepting)
+			SubmitAccept();
+		if(!wakeArmed)
+			SubmitWakeRead();
+
+		if(ring->Enter(1) < 0 && errno != EINTR && errno != EBUSY)
+		{
+			logger.log("io_uring_enter failed: " + std::string(strerror(errno)));
+			break;
+		}
+		ReapCompletions();
+	}
+
+	running = false;
+	// Receives and the accept would wait for peers forever, and the kernel must
+	// be done with connection buffers before they are freed
+	draining = true;
+	if(io_uring_sqe* sqe = ring->NextSqe())
+	{
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL | IORING_ASYNC_CANCEL_ANY;
+		sqe->user_data = MakeUserData(Operation::Cancel, -1);
+		operationsInFlight++;
+	}
+	while(operationsInFlight > 0)
+	{
+		if(ring->Enter(1) < 0 && errno != EINTR && errno != EBUSY)
+			break;
+		ReapCompletions();
+	}
+
+	// Workers still hold a pointer to this loop until their handlers return
+	WaitForHandlers();
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	pendingOperations.clear();
+}
+
+void Networking::UringLoop::Stop()
+{
+	stopRequested = true;
+	Wake();
+}
+
+bool Networking::UringLoop::QueueSend(SOCKET _pSocket, const char* _pData, size_t _pLength)
+{
+	return QueueSend(_pSocket, std::vector<char>(_pData, _pData + _pLength));
+}
+
+bool Networking::UringLoop::QueueSend(SOCKET _pSocket, std::vector<char>&& _pData)
+{
+	if(!running)
+		return false;
+
+	if(OnLoopThread())
+	{
+		ApplySend(_pSocket, std::move(_pData));
+		return true;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		pendingOperations.push_back(PendingOperation{_pSocket, false, 0, std::move(_pData)});
+	}
+	Wake();
+	return true;
+}
+
+bool Networking::UringLoop::QueueShared(SOCKET _pSocket, const SharedBuffer& _pData, size_t _pHighWaterMark, SlowReceiverPolicy _pPolicy, std::unique_ptr<WriteCompletion> _pCompletion)
+{
+	if(!running)
+		return false;
+
+	PendingOperation operation{_pSocket, false, 0, QueuedWrite(_pData, std::move(_pCompletion))};
+	operation.highWaterMark = _pHighWaterMark;
+	operation.policy = _pPolicy;
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		pendingOperations.push_back(std::move(operation));
+	}
+	Wake();
+	return true;
+}
+
+void Networking::UringLoop::FinishRequest(SOCKET _pSocket, uint32_t _pRequestId)
+{
+	if(OnLoopThread())
+	{
+		ApplyFinishRequest(_pSocket, _pRequestId);
+		ResumeReading(_pSocket);
+		CloseIfDone(_pSocket);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		pendingOperations.push_back(PendingOperation{_pSocket, true, _pRequestId, std::vector<char>()});
+	}
+	Wake();
+}
+
+bool Networking::UringLoop::IsRunning() const
+{
+	return running;
+}
+
+size_t Networking::UringLoop::GetConnectionCount() const
+{
+	return connectionCount;
+}
+
+void Networking::UringLoop::ReapCompletions()
+{
+	unsigned head = *ring->cqHead;
+	while(head != __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE))
+	{
+		const io_uring_cqe& cqe = ring->cqes[head & ring->cqMask];
+		uint64_t userData = cqe.user_data;
+		int result = cqe.res;
+		uint32_t flags = cqe.flags;
+		// The slot is free for the kernel again once the fields are copied out
+		head++;
+		__atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+		HandleCompletion(userData, result, flags);
+	}
+}
+
+void Networking::UringLoop::SubmitAccept()
+{
+	io_uring_sqe* sqe = ring->NextSqe();
+	if(sqe == nullptr)
+		return;
+	// One submission keeps accepting until it fails or is cancelled.
+	// The peer address is looked up per connection, as a multishot accept
+	// would write every one of them to the same place.
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = listenSocket;
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->accept_flags = SOCK_CLOEXEC;
+	sqe->user_data = MakeUserData(Operation::Accept, listenSocket);
+	accepting = true;
+	operationsInFlight++;
+}
+
+void Networking::UringLoop::SubmitWakeRead()
+{
+	io_uring_sqe* sqe = ring->NextSqe();
+	if(sqe == nullptr)
+		return;
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = wakeFd;
+	sqe->addr = (uint64_t)(uintptr_t)&wakeCounter;
+	sqe->len = sizeof(wakeCounter);
+	sqe->user_data = MakeUserData(Operation::WakeRead, wakeFd);
+	wakeArmed = true;
+	operationsInFlight++;
+}
+
+void Networking::UringLoop::SubmitReceive(Connection& _pConnection)
+{
+	io_uring_sqe* sqe = ring->NextSqe();
+	if(sqe == nullptr)
+	{
+		logger.log("Dropping connection: io_uring submission queue is full");
+		_pConnection.state = EventLoop::ConnectionState::Broken;
+		return;
+	}
+
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = _pConnection.client.clientSocket;
+	sqe->user_data = MakeUserData(Operation::Receive, _pConnection.client.clientSocket);
+	_pConnection.directReceive = _pConnection.readState == EventLoop::ReadState::ReadingPayload
+		&& _pConnection.inputStart == _pConnection.inputEnd
+		&& _pConnection.payload->size() - _pConnection.payloadFilled >= RECEIVE_BUFFER_SIZE;
+	if(_pConnection.directReceive)
+	{
+		// Large payloads are received straight into their pre-sized buffer
+		sqe->addr = (uint64_t)(uintptr_t)(_pConnection.payload->data() + _pConnection.payloadFilled);
+		sqe->len = (uint32_t)std::min<size_t>(_pConnection.payload->size() - _pConnection.payloadFilled, INT_MAX);
+	}
+	else
+	{
+		// The kernel picks a buffer once data is there, so waiting costs none
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = RECEIVE_BUFFER_GROUP;
+	}
+	_pConnection.receiving = true;
+	operationsInFlight++;
+}
+
+void Networking::UringLoop::SubmitSend(Connection& _pConnection)
+{
+	size_t count = 0;
+	size_t length = 0;
+	for(auto it = _pConnection.writeQueue.begin(); it != _pConnection.writeQueue.end() && count < MAX_WRITE_VECTORS; ++it)
+	{
+		size_t offset = count == 0 ? _pConnection.writeOffset : 0;
+		_pConnection.sendVectors[count].iov_base = it->Data() + offset;
+		_pConnection.sendVectors[count].iov_len = it->Size() - offset;
+		length += it->Size() - offset;
+		count++;
+	}
+
+	// The last replies of a closing connection go out linked to the close. The
+	// close only runs if the whole send succeeded (MSG_WAITALL makes a short
+	// send a failure) and is cancelled otherwise.
+	bool closeAfter = _pConnection.state == EventLoop::ConnectionState::Closing
+		&& _pConnection.pendingRequests == 0
+		&& count == _pConnection.writeQueue.size();
+	if(!ring->Reserve(closeAfter ? 2 : 1))
+	{
+		logger.log("Dropping connection: io_uring submission queue is full");
+		_pConnection.state = EventLoop::ConnectionState::Broken;
+		_pConnection.writeQueue.clear();
+		_pConnection.queuedBytes = 0;
+		_pConnection.writeOffset = 0;
+		return;
+	}
+
+	memset(&_pConnection.sendMessage, 0, sizeof(_pConnection.sendMessage));
+	_pConnection.sendMessage.msg_iov = _pConnection.sendVectors;
+	_pConnection.sendMessage.msg_iovlen = count;
+	io_uring_sqe* sqe = ring->NextSqe();
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->fd = _pConnection.client.clientSocket;
+	sqe->addr = (uint64_t)(uintptr_t)&_pConnection.sendMessage;
+	sqe->len = 1;
+	sqe->msg_flags = MSG_NOSIGNAL | (closeAfter ? MSG_WAITALL : 0);
+	sqe->user_data = MakeUserData(Operation::Send, _pConnection.client.clientSocket);
+	_pConnection.sending = true;
+	_pConnection.sendLength = length;
+	operationsInFlight++;
+
+	if(closeAfter)
+	{
+		sqe->flags |= IOSQE_IO_LINK;
+		io_uring_sqe* closeSqe = ring->NextSqe();
+		closeSqe->opcode = IORING_OP_CLOSE;
+		closeSqe->fd = _pConnection.client.clientSocket;
+		closeSqe->user_data = MakeUserData(Operation::Close, _pConnection.client.clientSocket);
+		_pConnection.closeSubmitted = true;
+		// The kernel may close the descriptor, and accept reuse it, before the
+		// close completes, so it leaves the table now
+		if(connectionTable != nullptr)
+			connectionTable->Remove(_pConnection.client.clientSocket);
+		operationsInFlight++;
+	}
+}
+
+void Networking::UringLoop::SubmitCancel(Connection& _pConnection)
+{
+	io_uring_sqe* sqe = ring->NextSqe();
+	if(sqe == nullptr)
+		return;
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->addr = MakeUserData(Operation::Receive, _pConnection.client.clientSocket);
+	sqe->user_data = MakeUserData(Operation::Cancel, _pConnection.client.clientSocket);
+	_pConnection.cancelling = true;
+	operationsInFlight++;
+}
+
+void Networking::UringLoop::HandleCompletion(uint64_t _pUserData, int _pResult, uint32_t _pFlags)
+{
+	Operation operation = (Operation)(_pUserData >> 56);
+	SOCKET socket = (SOCKET)(uint32_t)_pUserData;
+	if(!(_pFlags & IORING_CQE_F_MORE))
+		operationsInFlight--;
+
+	switch(operation)
+	{
+	case Operation::Accept:
+		HandleAccepted(_pResult, _pFlags);
+		return;
+	case Operation::WakeRead:
+		wakeArmed = false;
+		if(!draining)
+			ProcessPendingOperations();
+		return;
+	case Operation::Cancel:
+		return;
+	default:
+		break;
+	}
+
+	auto it = connections.find(socket);
+	if(it == connections.end())
+	{
+		if(_pFlags & IORING_CQE_F_BUFFER)
+			ring->ReturnBuffer((uint16_t)(_pFlags >> IORING_CQE_BUFFER_SHIFT));
+		return;
+	}
+	Connection& connection = *it->second;
+
+	switch(operation)
+	{
+	case Operation::Receive:
+		HandleReceived(connection, _pResult, _pFlags);
+		break;
+	case Operation::Send:
+		HandleSent(connection, _pResult);
+		break;
+	case Operation::Close:
+		// The close is cancelled when the send linked before it failed
+		ReleaseConnection(socket, _pResult == -ECANCELED);
+		return;
+	default:
+		return;
+	}
+	if(!draining)
+		CloseIfDone(socket);
+}
+
+void Networking::UringLoop::HandleAccepted(int _pResult, uint32_t _pFlags)
+{
+	// The kernel ends a multishot accept on errors; the main loop re-arms it
+	if(!(_pFlags & IORING_CQE_F_MORE))
+		accepting = false;
+	if(_pResult < 0)
+	{
+		if(_pResult != -ECANCELED && _pResult != -EINTR && _pResult != -ECONNABORTED)
+			logger.log("Accept failed: " + std::string(strerror(-_pResult)));
+		return;
+	}
+	if(draining)
+	{
+		CLOSESOCKET(_pResult);
+		return;
+	}
+
+	ClientConnection client;
+	client.clientSocket = _pResult;
+	client.listenerIndex = listenerIndex;
+	socklen_t clientAddrSize = sizeof(client.clientInfo);
+	getpeername(client.clientSocket, (sockaddr*)&client.clientInfo, &clientAddrSize);
+	if(connectionTable != nullptr && !connectionTable->Insert(client))
+	{
+		logger.log("Refusing connection: " + std::to_string(connectionTable->Size()) + " connections are open");
+		CLOSESOCKET(client.clientSocket);
+		return;
+	}
+
+	std::unique_ptr<Connection> connection(new Connection());
+	connection->client = client;
+	Connection& added = *connection;
+	connections[client.clientSocket] = std::move(connection);
+	connectionCount++;
+	SubmitReceive(added);
+	CloseIfDone(client.clientSocket);
+}
+
+void Networking::UringLoop::HandleReceived(Connection& _pConnection, int _pResult, uint32_t _pFlags)
+{
+	_pConnection.receiving = false;
+	if(_pResult > 0 && connectionTable != nullptr)
+		connectionTable->Touch(_pConnection.client.clientSocket);
+	if(_pFlags & IORING_CQE_F_BUFFER)
+	{
+		uint16_t bufferId = (uint16_t)(_pFlags >> IORING_CQE_BUFFER_SHIFT);
+		if(_pResult > 0 && !draining && _pConnection.state == EventLoop::ConnectionState::Open)
+			ReceiveData(_pConnection, ring->BufferData(bufferId), _pResult);
+		// Whatever was not parsed has been copied out, so the buffer can go straight back
+		ring->ReturnBuffer(bufferId);
+	}
+	else if(_pResult > 0 && _pConnection.directReceive)
+	{
+		_pConnection.payloadFilled += _pResult;
+		if(_pConnection.payloadFilled == _pConnection.payload->size() && !draining)
+			DispatchMessage(_pConnection);
+	}
+	if(draining)
+		return;
+
+	if(_pResult == 0 && _pConnection.state == EventLoop::ConnectionState::Open)
+		_pConnection.state = EventLoop::ConnectionState::Closing;
+	// ENOBUFS means every provided buffer was taken; the ones reaped before this were returned already
+	else if(_pResult < 0 && _pResult != -ENOBUFS && _pResult != -EINTR && _pResult != -EAGAIN && _pResult != -ECANCELED)
+		_pConnection.state = EventLoop::ConnectionState::Broken;
+
+	if(_pConnection.state != EventLoop::ConnectionState::Open)
+	{
+		_pConnection.input.reset();
+		_pConnection.payload.reset();
+		return;
+	}
+	// Reading pauses while requests are with handlers, see EventLoop::HandleReadable
+	if(CanRead(_pConnection) && !_pConnection.receiving)
+		SubmitReceive(_pConnection);
+}
+
+void Networking::UringLoop::HandleSent(Connection& _pConnection, int _pResult)
+{
+	_pConnection.sending = false;
+	if(draining)
+		return;
+	if(_pResult < 0)
+	{
+		_pConnection.state = EventLoop::ConnectionState::Broken;
+		_pConnection.writeQueue.clear();
+		_pConnection.queuedBytes = 0;
+		_pConnection.writeOffset = 0;
+		return;
+	}
+
+	// Drop every buffer that was written completely and remember how far into the next one we got
+	size_t remaining = _pResult;
+	while(remaining > 0)
+	{
+		QueuedWrite& front = _pConnection.writeQueue.front();
+		size_t left = front.Size() - _pConnection.writeOffset;
+		if(remaining < left)
+		{
+			_pConnection.writeOffset += remaining;
+			break;
+		}
+		remaining -= left;
+		PopWrite(_pConnection);
+	}
+	while(!_pConnection.writeQueue.empty() && _pConnection.writeQueue.front().Size() == _pConnection.writeOffset)
+		PopWrite(_pConnection);
+	// A receiver cut off by ApplyShared kept its queue only while this send was in flight
+	if(_pConnection.state == EventLoop::ConnectionState::Broken)
+	{
+		_pConnection.writeQueue.clear();
+		_pConnection.queuedBytes = 0;
+		_pConnection.writeOffset = 0;
+	}
+
+	// A closing connection's remaining replies are sent by CloseIfDone
+	if(_pConnection.state == EventLoop::ConnectionState::Open && !_pConnection.writeQueue.empty())
+		SubmitSend(_pConnection);
+}
+
+void Networking::UringLoop::ReceiveData(Connection& _pConnection, const char* _pData, size_t _pLength)
+{
+	// Frames that arrived whole are parsed straight from the provided buffer;
+	// only the start of a frame that needs more data is copied out
+	if(_pConnection.inputStart != _pConnection.inputEnd)
+	{
+		AppendInput(_pConnection, _pData, _pLength);
+		ParseInput(_pConnection);
+		return;
+	}
+	size_t consumed = ConsumeFrames(_pConnection, _pData, _pLength);
+	if(consumed < _pLength && _pConnection.state != EventLoop::ConnectionState::Broken)
+		AppendInput(_pConnection, _pData + consumed, _pLength - consumed);
+}
+
+size_t Networking::UringLoop::ConsumeFrames(Connection& _pConnection, const char* _pData, size_t _pLength)
+{
+	size_t consumed = 0;
+	while(CanRead(_pConnection))
+	{
+		size_t available = _pLength - consumed;
+		const char* data = _pData + consumed;
+
+		if(_pConnection.readState == EventLoop::ReadState::ReadingHeader)
+		{
+			if(available < FRAME_HEADER_SIZE)
+				break;
+
+			FrameHeader header;
+			if(!DecodeFrameHeader(data, header) || header.payloadLength > maxMessageSize)
+			{
+				logger.log("Dropping connection after invalid or oversized frame header");
+				_pConnection.state = EventLoop::ConnectionState::Broken;
+				return consumed;
+			}
+			consumed += FRAME_HEADER_SIZE;
+			_pConnection.requestId = header.requestId;
+			_pConnection.compressed = (header.flags & FRAME_FLAG_COMPRESSED) != 0;
+			_pConnection.replyCodec = GetReplyCodec(header);
+			_pConnection.payload = BufferPool::Default().Acquire(header.payloadLength);
+			_pConnection.payloadFilled = 0;
+			_pConnection.readState = EventLoop::ReadState::ReadingPayload;
+			continue;
+		}
+
+		size_t needed = _pConnection.payload->size() - _pConnection.payloadFilled;
+		size_t take = std::min(needed, available);
+		if(take > 0)
+			memcpy(_pConnection.payload->data() + _pConnection.payloadFilled, data, take);
+		_pConnection.payloadFilled += take;
+		consumed += take;
+		if(_pConnection.payloadFilled < _pConnection.payload->size())
+			break;
+		DispatchMessage(_pConnection);
+	}
+	return consumed;
+}
+
+void Networking::UringLoop::AppendInput(Connection& _pConnection, const char* _pData, size_t _pLength)
+{
+	if(!_pConnection.input)
+		_pConnection.input = BufferPool::Default().Acquire(std::max(INPUT_BUFFER_SIZE, _pLength));
+	if(_pConnection.inputStart > 0)
+	{
+		size_t remaining = _pConnection.inputEnd - _pConnection.inputStart;
+		memmove(_pConnection.input->data(), _pConnection.input->data() + _pConnection.inputStart, remaining);
+		_pConnection.inputStart = 0;
+		_pConnection.inputEnd = remaining;
+	}
+	// Data only piles up while reading is paused, and then no receive is
+	// submitted, so this is at most one provided buffer more than a frame header
+	if(_pConnection.inputEnd + _pLength > _pConnection.input->size())
+	{
+		SharedBuffer larger = BufferPool::Default().Acquire(_pConnection.inputEnd + _pLength);
+		memcpy(larger->data(), _pConnection.input->data(), _pConnection.inputEnd);
+		_pConnection.input = std::move(larger);
+	}
+	memcpy(_pConnection.input->data() + _pConnection.inputEnd, _pData, _pLength);
+	_pConnection.inputEnd += _pLength;
+}
+
+void Networking::UringLoop::ParseInput(Connection& _pConnection)
+{
+	_pConnection.inputStart += ConsumeFrames(_pConnection, _pConnection.input->data() + _pConnection.inputStart,
+		_pConnection.inputEnd - _pConnection.inputStart);
+	// Nothing is kept for idle connections
+	if(_pConnection.inputStart == _pConnection.inputEnd)
+	{
+		_pConnection.input.reset();
+		_pConnection.inputStart = 0;
+		_pConnection.inputEnd = 0;
+	}
+}
+
+bool Networking::UringLoop::CanRead(const Connection& _pConnection) const
+{
+	return _pConnection.state == EventLoop::ConnectionState::Open
+		&& _pConnection.orderedRequests == 0
+		&& _pConnection.pendingRequests < MAX_REQUESTS_IN_FLIGHT;
+}
+
+void Networking::UringLoop::DispatchMessage(Connection& _pConnection)
+{
+	SharedBuffer message = std::move(_pConnection.payload);
+	_pConnection.payloadFilled = 0;
+	_pConnection.readState = EventLoop::ReadState::ReadingHeader;
+	SOCKET socket = _pConnection.client.clientSocket;
+	uint32_t requestId = _pConnection.requestId;
+
+	// The handler only ever sees the original payload
+	if(_pConnection.compressed)
+	{
+		Result<SharedBuffer> restored = DecompressFramePayload((CompressionCodec)_pConnection.replyCodec, message->data(), message->size(), maxMessageSize);
+		if(!restored)
+		{
+			logger.log("Dropping connection after invalid compressed frame");
+			_pConnection.state = EventLoop::ConnectionState::Broken;
+			return;
+		}
+		message = std::move(restored.Value());
+	}
+
+	_pConnection.pendingRequests++;
+	if(requestId == 0)
+		_pConnection.orderedRequests++;
+	// Without keep-alive each connection carries one request: stop reading once it has arrived
+	if(!keepAlive && _pConnection.state == EventLoop::ConnectionState::Open)
+		_pConnection.state = EventLoop::ConnectionState::Closing;
+
+	ClientConnection client = _pConnection.client;
+	client.requestId = requestId;
+	client.replyCodec = _pConnection.replyCodec;
+
+	if(executor != nullptr)
+	{
+		{
+			std::lock_guard<std::mutex> lock(handlersMutex);
+			handlersInFlight++;
+		}
+		bool queued = executor->TrySubmit([this, client, message]() mutable {
+			RunHandler(client, *message);
+			message.reset();
+			FinishRequest(client.clientSocket, client.requestId);
+			std::lock_guard<std::mutex> lock(handlersMutex);
+			if(--handlersInFlight == 0)
+				handlersDone.notify_all();
+		});
+		if(queued)
+			return;
+
+		// The pool is saturated, so the loop takes the request itself
+		std::lock_guard<std::mutex> lock(handlersMutex);
+		handlersInFlight--;
+	}
+
+	RunHandler(client, *message);
+	// The caller still holds _pConnection, so closing is left to the completion handler
+	ApplyFinishRequest(socket, requestId);
+}
+
+void Networking::UringLoop::RunHandler(const ClientConnection& _pClient, const std::vector<char>& _pMessage)
+{
+	try
+	{
+		handler(_pClient, _pMessage);
+	}
+	catch(const std::exception& ex)
+	{
+		logger.log("Unhandled exception in message handler: " + std::string(ex.what()));
+	}
+}
+
+void Networking::UringLoop::WaitForHandlers()
+{
+	std::unique_lock<std::mutex> lock(handlersMutex);
+	handlersDone.wait(lock, [this]() { return handlersInFlight == 0; });
+}
+
+void Networking::UringLoop::PopWrite(Connection& _pConnection)
+{
+	QueuedWrite& front = _pConnection.writeQueue.front();
+	if(front.completion)
+		front.completion->Report(DeliveryStatus::Sent);
+	_pConnection.queuedBytes -= front.Size();
+	_pConnection.writeQueue.pop_front();
+	_pConnection.writeOffset = 0;
+}
+
+void Networking::UringLoop::ApplySend(SOCKET _pSocket, QueuedWrite&& _pData)
+{
+	// A write that is not queued reports Failed as it goes out of scope
+	auto it = connections.find(_pSocket);
+	if(it == connections.end() || it->second->state == EventLoop::ConnectionState::Broken)
+		return;
+
+	Connection& connection = *it->second;
+	connection.queuedBytes += _pData.Size();
+	connection.writeQueue.push_back(std::move(_pData));
+	// A send in flight picks the rest up when it completes, and a closing
+	// connection sends everything together with its close in CloseIfDone
+	if(connection.state == EventLoop::ConnectionState::Open && !connection.sending)
+		SubmitSend(connection);
+}
+
+void Networking::UringLoop::ApplyShared(SOCKET _pSocket, QueuedWrite&& _pData, size_t _pHighWaterMark, SlowReceiverPolicy _pPolicy)
+{
+	// Broadcasts go only to connections still taking requests
+	auto it = connections.find(_pSocket);
+	if(it == connections.end() || it->second->state != EventLoop::ConnectionState::Open)
+		return;
+
+	Connection& connection = *it->second;
+	if(connection.queuedBytes <= _pHighWaterMark)
+	{
+		ApplySend(_pSocket, std::move(_pData));
+		return;
+	}
+	if(_pPolicy == SlowReceiverPolicy::Drop)
+	{
+		_pData.completion->Report(DeliveryStatus::Dropped);
+		return;
+	}
+	_pData.completion->Report(DeliveryStatus::Disconnected);
+	connection.state = EventLoop::ConnectionState::Broken;
+	if(connection.sending)
+	{
+		// The send in flight waits on a receiver that is not reading and still
+		// points into the queue; shutting down fails it, and HandleSent clears
+		// the queue once the kernel is done with it
+		shutdown(_pSocket, SHUT_RDWR);
+		return;
+	}
+	connection.writeQueue.clear();
+	connection.queuedBytes = 0;
+	connection.writeOffset = 0;
+}
+
+void Networking::UringLoop::ApplyFinishRequest(SOCKET _pSocket, uint32_t _pRequestId)
+{
+	auto it = connections.find(_pSocket);
+	if(it == connections.end())
+		return;
+
+	it->second->pendingRequests--;
+	if(_pRequestId == 0)
+		it->second->orderedRequests--;
+}
+
+void Networking::UringLoop::ResumeReading(SOCKET _pSocket)
+{
+	auto it = connections.find(_pSocket);
+	if(it == connections.end())
+		return;
+
+	Connection& connection = *it->second;
+	if(!CanRead(connection))
+		return;
+	if(connection.inputStart != connection.inputEnd)
+		ParseInput(connection);
+	if(CanRead(connection) && !connection.receiving)
+		SubmitReceive(connection);
+}
+
+void Networking::UringLoop::ProcessPendingOperations()
+{
+	std::vector<PendingOperation> operations;
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		operations.swap(pendingOperations);
+	}
+
+	for(auto& operation : operations)
+	{
+		if(operation.finishRequest)
+		{
+			ApplyFinishRequest(operation.socket, operation.requestId);
+			ResumeReading(operation.socket);
+		}
+		else if(operation.data.shared)
+			ApplyShared(operation.socket, std::move(operation.data), operation.highWaterMark, operation.policy);
+		else
+			ApplySend(operation.socket, std::move(operation.data));
+		CloseIfDone(operation.socket);
+	}
+}
+
+void Networking::UringLoop::CloseIfDone(SOCKET _pSocket)
+{
+	auto it = connections.find(_pSocket);
+	if(it == connections.end())
+		return;
+
+	Connection& connection = *it->second;
+	// As in EventLoop, a descriptor is never closed while a handler may still
+	// reply on it, nor while the kernel may still be using it
+	if(connection.pendingRequests > 0 || connection.state == EventLoop::ConnectionState::Open || connection.closeSubmitted)
+		return;
+	if(connection.receiving)
+	{
+		if(!connection.cancelling)
+			SubmitCancel(connection);
+		return;
+	}
+	if(connection.sending)
+		return;
+	if(connection.state == EventLoop::ConnectionState::Closing && !connection.writeQueue.empty())
+	{
+		SubmitSend(connection);
+		return;
+	}
+	ReleaseConnection(_pSocket, true);
+}
+
+void Networking::UringLoop::ReleaseConnection(SOCKET _pSocket, bool _pCloseSocket)
+{
+	// After a linked close the descriptor has already left the table and may belong to a new connection
+	if(_pCloseSocket)
+	{
+		if(connectionTable != nullptr)
+			connectionTable->Remove(_pSocket);
+		CLOSESOCKET(_pSocket);
+	}
+	connections.erase(_pSocket);
+	connectionCount--;
+}
+
+bool Networking::UringLoop::OnLoopThread() const
+{
+	return running && std::this_thread::get_id() == loopThreadId;
+}
+
+void Networking::UringLoop::Wake()
+{
+	uint64_t one = 1;
+	ssize_t written = write(wakeFd, &one, sizeof(one));
+	(void)written;
+}
@@ -0,0 +1,192 @@
+#pragma once
+#ifndef _NET_URING_LOOP_
+#define _NET_URING_LOOP_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "bufferpool.h"
+#include "clientconnection.h"
+#include "eventloop.h"
+#include "frame.h"
+#include "logger.h"
+#include "serverloop.h"
+#include "threadpool.h"
+
+namespace Networking {
+
+// io_uring reactor used by Server::Run in ServerMode::Uring. It serves the same
+// handlers with the same keep-alive and ordering rules as EventLoop, but instead
+// of being told a socket is ready and then calling accept, recv and sendmsg
+// itself, it submits those operations to the kernel and is told when they are done:
+//   - one multishot accept keeps producing a completion per new connection;
+//   - receives pick a buffer from a ring registered with the kernel, so idle
+//     connections hold no receive buffer of their own;
+//   - queued replies are gathered into one sendmsg per connection, and the
+//     last reply of a connection that is closing is linked to the close, so
+//     both go out in a single submission.
+// Many operations are submitted with one io_uring_enter call, which also waits
+// for completions. The ring is driven with raw system calls; no liburing needed.
+class UringLoop : public ServerLoop {
+public:
+
+// Creates a loop that serves connections accepted on _pListenSocket, with the
+// same arguments as EventLoop. Throws std::runtime_error if the kernel does
+// not support io_uring or the ring cannot be set up.
+UringLoop(SOCKET _pListenSocket, MessageHandler _pHandler, Logger& _pLogger, size_t _pMaxMessageSize = DEFAULT_MAX_MESSAGE_SIZE, ThreadPool* _pExecutor = nullptr);
+
+// Closes the ring, the wakeup descriptor and any remaining connections
+~UringLoop() override;
+
+// Returns true if this kernel offers everything the loop needs: io_uring
+// itself (which seccomp profiles often block), multishot accept and
+// provided buffer rings
+static bool IsSupported();
+
+// See EventLoop::SetKeepAlive
+void SetKeepAlive(bool _pKeepAlive) override;
+
+void SetListenerIndex(size_t _pListenerIndex) override;
+void SetConnectionTable(ConnectionTable* _pTable) override;
+
+// Runs the loop on the calling thread until Stop() is called.
+// Returns once every handler submitted to the executor has finished;
+// replies still queued at that point are dropped.
+void Run() override;
+
+// Asks the loop to exit; safe to call from any thread
+void Stop() override;
+
+bool QueueSend(SOCKET _pSocket, const char* _pData, size_t _pLength) override;
+bool QueueSend(SOCKET _pSocket, std::vector<char>&& _pData) override;
+bool QueueShared(SOCKET _pSocket, const SharedBuffer& _pData, size_t _pHighWaterMark, SlowReceiverPolicy _pPolicy, std::unique_ptr<WriteCompletion> _pCompletion) override;
+
+// Signals that the handler for the request _pRequestId on the connection has returned
+void FinishRequest(SOCKET _pSocket, uint32_t _pRequestId = 0);
+
+bool IsRunning() const override;
+size_t GetConnectionCount() const override;
+
+private:
+
+// Submission and completion queues mapped from the kernel, and the provided buffer ring
+struct Ring;
+
+// Queued replies gathered into one sendmsg
+static const size_t MAX_WRITE_VECTORS = 64;
+
+struct Connection {
+	ClientConnection client;
+	EventLoop::ConnectionState state = EventLoop::ConnectionState::Open;
+	EventLoop::ReadState readState = EventLoop::ReadState::ReadingHeader;
+	// Bytes received but not yet parsed live in [inputStart, inputEnd).
+	// Taken from the buffer pool when data first has to wait for more.
+	SharedBuffer input;
+	size_t inputStart = 0;
+	size_t inputEnd = 0;
+	SharedBuffer payload;
+	size_t payloadFilled = 0;
+	std::deque<QueuedWrite> writeQueue;
+	// Bytes in writeQueue, counted from the start of its front entry
+	size_t queuedBytes = 0;
+	size_t writeOffset = 0;
+	uint32_t requestId = 0;
+	bool compressed = false;
+	uint8_t replyCodec = 0;
+	int pendingRequests = 0;
+	int orderedRequests = 0;
+	// Operations the kernel may still be working on. The connection, and the
+	// descriptor number, are only released once none are left.
+	bool receiving = false;
+	bool sending = false;
+	bool cancelling = false;
+	bool closeSubmitted = false;
+	// The receive in flight writes straight into the payload instead of a provided buffer
+	bool directReceive = false;
+	// Arguments of the sendmsg in flight, which the kernel reads when it runs
+	msghdr sendMessage;
+	iovec sendVectors[MAX_WRITE_VECTORS];
+	size_t sendLength = 0;
+};
+
+// A send or request completion posted from a thread other than the loop
+struct PendingOperation {
+	SOCKET socket;
+	bool finishRequest;
+	uint32_t requestId;
+	QueuedWrite data;
+	// Set for a shared write, which is skipped above this many queued bytes
+	size_t highWaterMark = 0;
+	SlowReceiverPolicy policy = SlowReceiverPolicy::Drop;
+};
+
+void ReapCompletions();
+void SubmitAccept();
+void SubmitWakeRead();
+void SubmitReceive(Connection& _pConnection);
+void SubmitSend(Connection& _pConnection);
+void SubmitCancel(Connection& _pConnection);
+void HandleCompletion(uint64_t _pUserData, int _pResult, uint32_t _pFlags);
+void HandleAccepted(int _pResult, uint32_t _pFlags);
+void HandleReceived(Connection& _pConnection, int _pResult, uint32_t _pFlags);
+void HandleSent(Connection& _pConnection, int _pResult);
+void ReceiveData(Connection& _pConnection, const char* _pData, size_t _pLength);
+size_t ConsumeFrames(Connection& _pConnection, const char* _pData, size_t _pLength);
+void AppendInput(Connection& _pConnection, const char* _pData, size_t _pLength);
+void ParseInput(Connection& _pConnection);
+bool CanRead(const Connection& _pConnection) const;
+void DispatchMessage(Connection& _pConnection);
+void RunHandler(const ClientConnection& _pClient, const std::vector<char>& _pMessage);
+void WaitForHandlers();
+void ApplyFinishRequest(SOCKET _pSocket, uint32_t _pRequestId);
+void ResumeReading(SOCKET _pSocket);
+void ApplySend(SOCKET _pSocket, QueuedWrite&& _pData);
+void PopWrite(Connection& _pConnection);
+void ApplyShared(SOCKET _pSocket, QueuedWrite&& _pData, size_t _pHighWaterMark, SlowReceiverPolicy _pPolicy);
+void ProcessPendingOperations();
+void CloseIfDone(SOCKET _pSocket);
+void ReleaseConnection(SOCKET _pSocket, bool _pCloseSocket);
+bool OnLoopThread() const;
+void Wake();
+
+SOCKET listenSocket;
+std::unique_ptr<Ring> ring;
+int wakeFd = -1;
+// Target of the read that waits on wakeFd
+uint64_t wakeCounter = 0;
+// Whether the multishot accept and the wakeup read are armed
+bool accepting = false;
+bool wakeArmed = false;
+// Operations submitted that have not posted their last completion
+size_t operationsInFlight = 0;
+// Set once Run() is cancelling what is left in flight before it returns
+bool draining = false;
+MessageHandler handler;
+Logger& logger;
+size_t maxMessageSize;
+ThreadPool* executor;
+bool keepAlive = false;
+size_t listenerIndex = 0;
+ConnectionTable* connectionTable = nullptr;
+std::atomic<bool> running{false};
+std::atomic<bool> stopRequested{false};
+std::atomic<size_t> connectionCount{0};
+std::thread::id loopThreadId;
+std::unordered_map<SOCKET, std::unique_ptr<Connection> > connections;
+std::mutex pendingMutex;
+std::vector<PendingOperation> pendingOperations;
+std::mutex handlersMutex;
+std::condition_variable handlersDone;
+size_t handlersInFlight = 0;
+};
+
+}
+
+#endif
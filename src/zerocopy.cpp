@@ -0,0 +1,155 @@
+#include "zerocopy.h"
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <limits.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+bool Networking::ZeroCopySender::Enable(SOCKET _pSocket)
+{
+	int one = 1;
+	enabled = setsockopt(_pSocket, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+	return enabled;
+}
+
+bool Networking::ZeroCopySender::IsActive() const
+{
+	return enabled && !kernelCopies;
+}
+
+long Networking::ZeroCopySender::Write(SOCKET _pSocket, const iovec* _pVectors, size_t _pCount, const Deadline& _pDeadline)
+{
+	if(!IsActive())
+	{
+		stats.fallbacks++;
+		return WriteVectorFully(_pSocket, _pVectors, _pCount, _pDeadline);
+	}
+
+	std::vector<iovec> pending(_pVectors, _pVectors + _pCount);
+	size_t first = 0;
+	long bytesWritten = 0;
+	while(true)
+	{
+		while(first < pending.size() && pending[first].iov_len == 0)
+			first++;
+		if(first == pending.size())
+			break;
+
+		msghdr message;
+		memset(&message, 0, sizeof(message));
+		message.msg_iov = &pending[first];
+		message.msg_iovlen = std::min<size_t>(pending.size() - first, IOV_MAX);
+		ssize_t result = sendmsg(_pSocket, &message, MSG_NOSIGNAL | MSG_ZEROCOPY | (_pDeadline.IsSet() ? MSG_DONTWAIT : 0));
+		if(result < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			if(errno == ENOBUFS)
+			{
+				// Out of memory for pinned pages; this part goes out as a normal copy
+				stats.fallbacks++;
+				result = sendmsg(_pSocket, &message, MSG_NOSIGNAL | (_pDeadline.IsSet() ? MSG_DONTWAIT : 0));
+			}
+			if(result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && _pDeadline.IsSet())
+			{
+				if(WaitForSocket(_pSocket, POLLOUT, _pDeadline) < 0)
+					return -1;
+				continue;
+			}
+			if(result < 0)
+				return -1;
+		}
+		else
+		{
+			sendsIssued++;
+			stats.zeroCopySends++;
+		}
+		bytesWritten += result;
+
+		size_t remaining = result;
+		while(remaining > 0)
+		{
+			size_t consumed = std::min(remaining, pending[first].iov_len);
+			pending[first].iov_base = (char*)pending[first].iov_base + consumed;
+			pending[first].iov_len -= consumed;
+			remaining -= consumed;
+			if(pending[first].iov_len == 0)
+				first++;
+		}
+	}
+
+	// The caller's buffers are still referenced by the kernel until it says otherwise
+	if(AwaitCompletions(_pSocket, _pDeadline) < 0)
+		return -1;
+	return bytesWritten;
+}
+
+Networking::ZeroCopySender::Stats Networking::ZeroCopySender::GetStats() const
+{
+	return stats;
+}
+
+int Networking::ZeroCopySender::AwaitCompletions(SOCKET _pSocket, const Deadline& _pDeadline)
+{
+	while(sendsCompleted != sendsIssued)
+	{
+		char control[128];
+		msghdr message;
+		memset(&message, 0, sizeof(message));
+		message.msg_control = control;
+		message.msg_controllen = sizeof(control);
+		// Reading the error queue never blocks
+		if(recvmsg(_pSocket, &message, MSG_ERRQUEUE) < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			if(errno != EAGAIN && errno != EWOULDBLOCK)
+				return -1;
+			// An error queue entry is reported as POLLERR, whatever events are requested
+			if(WaitForSocket(_pSocket, 0, _pDeadline) < 0)
+				return -1;
+			continue;
+		}
+
+		for(cmsghdr* header = CMSG_FIRSTHDR(&message); header != NULL; header = CMSG_NXTHDR(&message, header))
+		{
+			bool isReport = (header->cmsg_level == SOL_IP && header->cmsg_type == IP_RECVERR)
+				|| (header->cmsg_level == SOL_IPV6 && header->cmsg_type == IPV6_RECVERR);
+			if(!isReport)
+				continue;
+			sock_extended_err error;
+			memcpy(&error, CMSG_DATA(header), sizeof(error));
+			if(error.ee_origin != SO_EE_ORIGIN_ZEROCOPY || error.ee_errno != 0)
+				continue;
+
+			// Each notification covers the inclusive range of sends [ee_info, ee_data]
+			uint32_t count = error.ee_data - error.ee_info + 1;
+			sendsCompleted += count;
+			stats.completions += count;
+			if(error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+			{
+				// Pinning pages bought nothing; stop paying for it on this socket
+				stats.copied += count;
+				kernelCopies = true;
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#ifndef _NET_ZERO_COPY_
+#define _NET_ZERO_COPY_
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/uio.h>
+#include "frame.h"
+
+namespace Networking {
+
+// Sends large buffers with MSG_ZEROCOPY, so the kernel transmits straight
+// from the caller's pages instead of copying them into socket buffers. The
+// kernel reports when it has released the pages through the socket's error
+// queue; Write waits for those notifications before returning, so callers may
+// reuse or free their buffers as soon as it returns, exactly as with send.
+//
+// Zero-copy only pays off for large payloads: pinning pages and reading the
+// notifications costs more than copying a few kilobytes. When the kernel
+// reports that it had to copy anyway (as it always does on loopback), the
+// sender falls back to ordinary sends for the rest of the connection.
+class ZeroCopySender {
+public:
+
+// Counters describing how zero-copy sends went
+struct Stats {
+	uint64_t zeroCopySends = 0; // sendmsg calls made with MSG_ZEROCOPY
+	uint64_t completions = 0;   // Sends the kernel has released the pages of
+	uint64_t copied = 0;        // Completions where the kernel copied the data after all
+	uint64_t fallbacks = 0;     // Writes sent normally because zero-copy was unavailable
+};
+
+// Enables SO_ZEROCOPY on _pSocket. Returns false if the kernel or socket
+// type does not support it, in which case Write always sends normally.
+bool Enable(SOCKET _pSocket);
+
+// Returns true if Write will currently use MSG_ZEROCOPY
+bool IsActive() const;
+
+// Writes the buffers as one stream like WriteVectorFully and returns once
+// the kernel no longer references them. Returns the number of bytes written
+// or SOCKET_ERROR with errno set.
+long Write(SOCKET _pSocket, const iovec* _pVectors, size_t _pCount, const Deadline& _pDeadline = Deadline());
+
+Stats GetStats() const;
+
+private:
+
+// Reads notifications until every send issued so far has completed
+int AwaitCompletions(SOCKET _pSocket, const Deadline& _pDeadline);
+
+bool enabled = false;
+bool kernelCopies = false;
+// Each successful MSG_ZEROCOPY sendmsg is numbered from zero by the kernel
+uint32_t sendsIssued = 0;
+uint32_t sendsCompleted = 0;
+Stats stats;
+};
+
+}
+
+#endif
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include "bufferpool.h"
+#include <memory>
+
+TEST(BufferPoolTests, ReusesReleasedBuffersOfTheSameSizeClass)
+{
+	Networking::BufferPool pool;
+	const char* first;
+	{
+		Networking::SharedBuffer buffer = pool.Acquire(5000);
+		ASSERT_EQ(buffer->size(), 5000u);
+		EXPECT_GE(buffer->capacity(), 8192u);
+		first = buffer->data();
+	}
+
+	// 5000 and 8000 bytes both round up to the 8 KiB class
+	Networking::SharedBuffer buffer = pool.Acquire(8000);
+	EXPECT_EQ(buffer->size(), 8000u);
+	EXPECT_EQ(buffer->data(), first);
+
+	Networking::BufferPool::Stats stats = pool.GetStats();
+	EXPECT_EQ(stats.acquisitions, 2u);
+	EXPECT_EQ(stats.hits, 1u);
+	EXPECT_EQ(stats.misses, 1u);
+	EXPECT_DOUBLE_EQ(stats.HitRate(), 0.5);
+}
+
+TEST(BufferPoolTests, CountsOutstandingAndPooledBytes)
+{
+	Networking::BufferPool pool;
+	Networking::SharedBuffer small = pool.Acquire(100);
+	Networking::SharedBuffer large = pool.Acquire(100 * 1024);
+	size_t capacity = small->capacity() + large->capacity();
+
+	Networking::BufferPool::Stats stats = pool.GetStats();
+	EXPECT_EQ(stats.outstandingBuffers, 2u);
+	EXPECT_EQ(stats.outstandingBytes, capacity);
+	EXPECT_EQ(stats.pooledBytes, 0u);
+
+	// A buffer is only released once every reference to it is gone
+	Networking::SharedBuffer shared = large;
+	small.reset();
+	large.reset();
+	EXPECT_EQ(pool.GetStats().outstandingBuffers, 1u);
+	shared.reset();
+
+	stats = pool.GetStats();
+	EXPECT_EQ(stats.outstandingBuffers, 0u);
+	EXPECT_EQ(stats.outstandingBytes, 0u);
+	EXPECT_EQ(stats.pooledBytes, capacity);
+
+	pool.Trim();
+	EXPECT_EQ(pool.GetStats().pooledBytes, 0u);
+}
+
+TEST(BufferPoolTests, DiscardsOversizedBuffersAndFullClasses)
+{
+	Networking::BufferPool pool(64 * 1024, 1);
+	pool.Acquire(1024 * 1024).reset();
+	EXPECT_EQ(pool.GetStats().discarded, 1u);
+	EXPECT_EQ(pool.GetStats().pooledBytes, 0u);
+
+	// Only one free buffer is kept per class
+	Networking::SharedBuffer first = pool.Acquire(1000);
+	Networking::SharedBuffer second = pool.Acquire(1000);
+	first.reset();
+	second.reset();
+	Networking::BufferPool::Stats stats = pool.GetStats();
+	EXPECT_EQ(stats.discarded, 2u);
+	EXPECT_EQ(stats.pooledBytes, Networking::BufferPool::MIN_CLASS_SIZE);
+}
+
+TEST(BufferPoolTests, BuffersMayOutliveThePool)
+{
+	Networking::SharedBuffer buffer;
+	{
+		Networking::BufferPool pool;
+		buffer = pool.Acquire(4096);
+	}
+	(*buffer)[0] = 'x';
+	buffer.reset(); // Freed rather than returned to the destroyed pool
+}
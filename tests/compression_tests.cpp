@@ -0,0 +1,107 @@
+#include "gtest/gtest.h"
+#include "compression.h"
+#include <cerrno>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<char> RoundTrip(const std::vector<char>& input) {
+    std::vector<char> compressed(Networking::LzCompressBound(input.size()));
+    size_t size = Networking::LzCompress(input.data(), input.size(), compressed.data(), compressed.size());
+    EXPECT_GT(size, 0u);
+    std::vector<char> output(input.size());
+    EXPECT_TRUE(Networking::LzDecompress(compressed.data(), size, output.data(), output.size()));
+    return output;
+}
+
+}
+
+TEST(CompressionTests, LzRoundTripsRunsLiteralsAndLongMatches) {
+    std::vector<std::vector<char> > inputs;
+    inputs.push_back(std::vector<char>());
+    inputs.push_back(std::vector<char>{'a', 'b', 'c'});
+    // Overlapping matches, and match lengths that need extension bytes
+    inputs.push_back(std::vector<char>(100000, 'x'));
+    std::string text;
+    for (int i = 0; i < 2000; ++i)
+        text += "node-" + std::to_string(i % 7) + " heartbeat ok | file_" + std::to_string(i) + ".log\n";
+    inputs.push_back(std::vector<char>(text.begin(), text.end()));
+    // Literal runs longer than 15 bytes between matches
+    std::mt19937 random(1);
+    std::vector<char> mixed;
+    for (int block = 0; block < 50; ++block) {
+        for (int i = 0; i < 300; ++i) mixed.push_back((char)random());
+        mixed.insert(mixed.end(), text.begin(), text.begin() + 500);
+    }
+    inputs.push_back(mixed);
+
+    for (const std::vector<char>& input : inputs)
+        EXPECT_EQ(RoundTrip(input), input);
+}
+
+TEST(CompressionTests, FramePayloadsShrinkOrAreLeftAlone) {
+    std::string text;
+    for (int i = 0; i < 1000; ++i) text += "INFO replicated chunk " + std::to_string(i % 10) + " to node-3\n";
+    std::vector<char> compressed(Networking::CompressedPayloadBound(text.size()));
+    Networking::CompressionStats before = Networking::GetCompressionStats();
+    size_t size = Networking::CompressFramePayload(Networking::CompressionCodec::Lz, text.data(), text.size(), compressed.data());
+    ASSERT_GT(size, 0u);
+    EXPECT_LT(size, text.size() / 4);
+
+    Networking::Result<Networking::SharedBuffer> restored =
+        Networking::DecompressFramePayload(Networking::CompressionCodec::Lz, compressed.data(), size, text.size());
+    ASSERT_TRUE(restored.IsOk());
+    EXPECT_EQ(std::string(restored.Value()->begin(), restored.Value()->end()), text);
+
+    // Random bytes do not shrink, so the frame goes out as it is
+    std::mt19937 random(2);
+    std::vector<char> noise(64 * 1024);
+    for (char& byte : noise) byte = (char)random();
+    std::vector<char> scratch(Networking::CompressedPayloadBound(noise.size()));
+    EXPECT_EQ(Networking::CompressFramePayload(Networking::CompressionCodec::Lz, noise.data(), noise.size(), scratch.data()), 0u);
+    EXPECT_EQ(Networking::CompressFramePayload(Networking::CompressionCodec::None, text.data(), text.size(), scratch.data()), 0u);
+
+    Networking::CompressionStats after = Networking::GetCompressionStats();
+    EXPECT_EQ(after.framesCompressed - before.framesCompressed, 1u);
+    EXPECT_EQ(after.framesIncompressible - before.framesIncompressible, 1u);
+    EXPECT_EQ(after.bytesBeforeCompression - before.bytesBeforeCompression, text.size());
+    EXPECT_EQ(after.bytesAfterCompression - before.bytesAfterCompression, size);
+    EXPECT_EQ(after.framesDecompressed - before.framesDecompressed, 1u);
+    EXPECT_GT(after.Ratio(), 1.0);
+}
+
+TEST(CompressionTests, CorruptPayloadsAreRejected) {
+    std::string text;
+    for (int i = 0; i < 500; ++i) text += "WARN slow disk on node-" + std::to_string(i % 4) + "\n";
+    std::vector<char> compressed(Networking::CompressedPayloadBound(text.size()));
+    size_t size = Networking::CompressFramePayload(Networking::CompressionCodec::Lz, text.data(), text.size(), compressed.data());
+    ASSERT_GT(size, 0u);
+
+    EXPECT_EQ(Networking::DecompressFramePayload(Networking::CompressionCodec::Lz, compressed.data(), size, text.size() - 1).GetError().code, EMSGSIZE);
+    EXPECT_EQ(Networking::DecompressFramePayload((Networking::CompressionCodec)9, compressed.data(), size, text.size()).GetError().code, EPROTO);
+    EXPECT_EQ(Networking::DecompressFramePayload(Networking::CompressionCodec::Lz, compressed.data(), size - 1, text.size()).GetError().code, EPROTO);
+    EXPECT_EQ(Networking::DecompressFramePayload(Networking::CompressionCodec::Lz, compressed.data(), 2, text.size()).GetError().code, EPROTO);
+
+    // Damaged data fails cleanly instead of reading or writing out of bounds
+    std::mt19937 random(3);
+    for (int trial = 0; trial < 2000; ++trial) {
+        std::vector<char> damaged(compressed.begin(), compressed.begin() + size);
+        size_t position = Networking::COMPRESSED_PAYLOAD_PREFIX_SIZE + random() % (size - Networking::COMPRESSED_PAYLOAD_PREFIX_SIZE);
+        damaged[position] = (char)random();
+        Networking::Result<Networking::SharedBuffer> restored =
+            Networking::DecompressFramePayload(Networking::CompressionCodec::Lz, damaged.data(), damaged.size(), text.size());
+        if (restored.IsOk()) {
+            EXPECT_EQ(restored.Value()->size(), text.size());
+        }
+    }
+}
+
+TEST(CompressionTests, NegotiateCodecPicksTheFirstSupportedOne) {
+    EXPECT_EQ(Networking::NegotiateCodec(Networking::GetSupportedCodecs()), Networking::CompressionCodec::Lz);
+    EXPECT_EQ(Networking::NegotiateCodec("zstd,lz"), Networking::CompressionCodec::Lz);
+    EXPECT_EQ(Networking::NegotiateCodec("zstd"), Networking::CompressionCodec::None);
+    EXPECT_EQ(Networking::NegotiateCodec(""), Networking::CompressionCodec::None);
+    EXPECT_EQ(Networking::ParseCodecName(Networking::GetCodecName(Networking::CompressionCodec::Lz)), Networking::CompressionCodec::Lz);
+}
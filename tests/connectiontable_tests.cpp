@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+#include "connectiontable.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+
+Networking::ClientConnection MakeClient(SOCKET _pSocket)
+{
+	Networking::ClientConnection client;
+	client.clientSocket = _pSocket;
+	return client;
+}
+
+}
+
+TEST(ConnectionTableTests, InsertRemoveAndLimit)
+{
+	Networking::ConnectionTable table(3);
+	EXPECT_TRUE(table.Insert(MakeClient(5)));
+	EXPECT_TRUE(table.Insert(MakeClient(21)));
+	// The same descriptor cannot be held twice
+	EXPECT_FALSE(table.Insert(MakeClient(5)));
+	EXPECT_TRUE(table.Insert(MakeClient(1000)));
+	EXPECT_FALSE(table.Insert(MakeClient(7)));
+	EXPECT_EQ(table.Size(), 3u);
+	EXPECT_TRUE(table.Contains(21));
+	EXPECT_FALSE(table.Contains(7));
+
+	EXPECT_TRUE(table.Remove(21));
+	EXPECT_FALSE(table.Remove(21));
+	EXPECT_TRUE(table.Insert(MakeClient(7)));
+
+	table.SetMaxConnections(0);
+	for (SOCKET fd = 100; fd < 200; ++fd)
+		EXPECT_TRUE(table.Insert(MakeClient(fd)));
+	EXPECT_EQ(table.Size(), 103u);
+}
+
+TEST(ConnectionTableTests, SnapshotIsSharedUntilTheTableChanges)
+{
+	Networking::ConnectionTable table;
+	table.Insert(MakeClient(3));
+	table.Insert(MakeClient(4));
+	Networking::ConnectionTable::Snapshot first = table.GetSnapshot();
+	EXPECT_EQ(first->size(), 2u);
+	EXPECT_EQ(table.GetSnapshot().get(), first.get());
+	// Touching is not a change to the list
+	table.Touch(3);
+	EXPECT_EQ(table.GetSnapshot().get(), first.get());
+
+	table.Remove(3);
+	Networking::ConnectionTable::Snapshot second = table.GetSnapshot();
+	EXPECT_NE(second.get(), first.get());
+	ASSERT_EQ(second->size(), 1u);
+	EXPECT_EQ((*second)[0].clientSocket, 4);
+	// Earlier snapshots stay valid and unchanged
+	EXPECT_EQ(first->size(), 2u);
+}
+
+TEST(ConnectionTableTests, IdleConnectionsExpireOnceOnTheWheel)
+{
+	Networking::ConnectionTable table(0, std::chrono::milliseconds(640));
+	EXPECT_EQ(table.GetTickLength(), std::chrono::milliseconds(11));
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	table.Insert(MakeClient(10));
+	table.Insert(MakeClient(11));
+
+	std::vector<SOCKET> expired;
+	auto collect = [&](const Networking::ClientConnection& c) { expired.push_back(c.clientSocket); };
+	EXPECT_EQ(table.ExpireIdle(start + std::chrono::milliseconds(300), collect), 0u);
+
+	// Activity on one connection pushes its deadline back; the wheel re-checks it lazily
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	table.Touch(11);
+	EXPECT_EQ(table.ExpireIdle(start + std::chrono::milliseconds(700), collect), 1u);
+	ASSERT_EQ(expired.size(), 1u);
+	EXPECT_EQ(expired[0], 10);
+
+	// A connection is reported once, and stays until its owner removes it
+	EXPECT_TRUE(table.Contains(10));
+	EXPECT_EQ(table.ExpireIdle(start + std::chrono::milliseconds(2000), collect), 1u);
+	ASSERT_EQ(expired.size(), 2u);
+	EXPECT_EQ(expired[1], 11);
+
+	table.SetIdleTimeout(std::chrono::milliseconds(0));
+	EXPECT_EQ(table.ExpireIdle(std::chrono::steady_clock::now() + std::chrono::hours(1), collect), 0u);
+}
+
+TEST(ConnectionTableTests, ReusedDescriptorIgnoresTheEarlierDeadline)
+{
+	Networking::ConnectionTable table(0, std::chrono::milliseconds(640));
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	table.Insert(MakeClient(20));
+	table.Remove(20);
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	table.Insert(MakeClient(20));
+
+	std::vector<SOCKET> expired;
+	auto collect = [&](const Networking::ClientConnection& c) { expired.push_back(c.clientSocket); };
+	// The first connection's wheel entry is stale and the second is not due yet
+	EXPECT_EQ(table.ExpireIdle(start + std::chrono::milliseconds(700), collect), 0u);
+	EXPECT_EQ(table.ExpireIdle(start + std::chrono::milliseconds(1000), collect), 1u);
+}
+
+TEST(ConnectionTableTests, ConcurrentInsertAndRemoveKeepTheCount)
+{
+	Networking::ConnectionTable table(0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&table, t]() {
+			for (int round = 0; round < 200; ++round) {
+				for (SOCKET fd = t * 1000; fd < t * 1000 + 50; ++fd)
+					ASSERT_TRUE(table.Insert(MakeClient(fd)));
+				table.GetSnapshot();
+				for (SOCKET fd = t * 1000; fd < t * 1000 + 50; ++fd)
+					ASSERT_TRUE(table.Remove(fd));
+			}
+			for (SOCKET fd = t * 1000; fd < t * 1000 + 10; ++fd)
+				table.Insert(MakeClient(fd));
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+	EXPECT_EQ(table.Size(), 40u);
+	EXPECT_EQ(table.GetSnapshot()->size(), 40u);
+}
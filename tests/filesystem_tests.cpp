@@ -1,5 +1,9 @@
 #include <gtest/gtest.h>
 #include "filesystem.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 
 TEST(FileSystemTests, createFile)
@@ -36,3 +40,155 @@ TEST(FileSystemTests, readFile)
 	 	
 
 }
+
+TEST(FileSystemTests, concurrentAccessAcrossShards)
+{
+	// One shard is the old single lock; many shards put most files under different locks
+	for (size_t shards : {size_t(1), size_t(7), DEFAULT_STORAGE_SHARD_COUNT}) {
+		FileSystem fs(std::unique_ptr<StorageEngine>(new MemoryStorageEngine(shards)));
+		const int threadCount = 8;
+		const int filesPerThread = 200;
+		std::atomic<int> failures{0};
+		std::vector<std::thread> threads;
+		for (int t = 0; t < threadCount; ++t) {
+			threads.emplace_back([&, t]() {
+				for (int i = 0; i < filesPerThread; ++i) {
+					std::string name = "file-" + std::to_string(t) + "-" + std::to_string(i);
+					if (!fs.createFile(name) || !fs.writeFile(name, name) || fs.readFile(name) != name)
+						++failures;
+					// Every thread also reads a file another thread owns, which may or may not exist yet
+					std::string other = fs.readFile("file-" + std::to_string((t + 1) % threadCount) + "-" + std::to_string(i));
+					if (!other.empty() && other.compare(0, 5, "file-") != 0)
+						++failures;
+					if (i % 2 == 0 && !fs.deleteFile(name))
+						++failures;
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+
+		ASSERT_EQ(failures.load(), 0) << shards << " shards";
+		for (int t = 0; t < threadCount; ++t) {
+			for (int i = 0; i < filesPerThread; ++i) {
+				std::string name = "file-" + std::to_string(t) + "-" + std::to_string(i);
+				EXPECT_EQ(fs.readFile(name), i % 2 == 0 ? "" : name);
+			}
+		}
+	}
+}
+
+TEST(FileSystemTests, readFileSharedKeepsItsVersion)
+{
+	FileSystem fs;
+	ASSERT_EQ(fs.readFileShared("Test"), nullptr);
+	fs.createFile("Test");
+	FileContent empty = fs.readFileShared("Test");
+	ASSERT_NE(empty, nullptr);
+	EXPECT_EQ(*empty, "");
+
+	std::string large(1 << 20, 'x');
+	fs.writeFile("Test", large);
+	FileContent first = fs.readFileShared("Test");
+	FileContent second = fs.readFileShared("Test");
+	ASSERT_NE(first, nullptr);
+	EXPECT_EQ(first.get(), second.get()); // Both readers share the stored buffer
+	EXPECT_EQ(*first, large);
+
+	// Writing and deleting publish new versions; the one held is left as it was
+	fs.writeFile("Test", "new");
+	EXPECT_EQ(*first, large);
+	EXPECT_EQ(*fs.readFileShared("Test"), "new");
+	fs.deleteFile("Test");
+	EXPECT_EQ(*first, large);
+	EXPECT_EQ(fs.readFileShared("Test"), nullptr);
+}
+
+TEST(FileSystemTests, byteRangeOperations)
+{
+	FileSystem fs;
+	EXPECT_FALSE(fs.writeAt("Log", 0, "x"));
+	EXPECT_FALSE(fs.append("Log", "x"));
+	EXPECT_FALSE(fs.truncate("Log", 0));
+	EXPECT_EQ(fs.readRange("Log", 0, 10), "");
+
+	fs.createFile("Log");
+	ASSERT_TRUE(fs.append("Log", "hello"));
+	ASSERT_TRUE(fs.append("Log", " world"));
+	EXPECT_EQ(fs.readRange("Log", 6, 5), "world");
+	EXPECT_EQ(fs.readRange("Log", 6, 100), "world"); // Clipped at the end
+	EXPECT_EQ(fs.readRange("Log", 11, 1), "");
+	EXPECT_EQ(fs.readRange("Log", 1000, 1), "");
+	std::string range = "stale";
+	EXPECT_TRUE(fs.readRange("Log", 1000, 1, range)); // Past the end is not a missing file
+	EXPECT_EQ(range, "");
+	EXPECT_TRUE(fs.readRange("Log", 0, 5, range));
+	EXPECT_EQ(range, "hello");
+	EXPECT_FALSE(fs.readRange("Missing", 0, 5, range));
+
+	ASSERT_TRUE(fs.writeAt("Log", 0, "J"));
+	ASSERT_TRUE(fs.writeAt("Log", 13, "!")); // Past the end: the gap reads as zero bytes
+	EXPECT_EQ(fs.readFile("Log"), std::string("Jello world\0\0!", 14));
+
+	// A reader's version is not changed by later partial writes
+	FileContent held = fs.readFileShared("Log");
+	ASSERT_TRUE(fs.truncate("Log", 5));
+	ASSERT_TRUE(fs.append("Log", "!"));
+	EXPECT_EQ(fs.readFile("Log"), "Jello!");
+	EXPECT_EQ(*held, std::string("Jello world\0\0!", 14));
+	ASSERT_TRUE(fs.truncate("Log", 8));
+	EXPECT_EQ(fs.readFile("Log"), std::string("Jello!\0\0", 8));
+}
+
+TEST(FileSystemTests, partialWritesStayWithinMaxFileSize)
+{
+	FileSystem fs;
+	EXPECT_EQ(fs.getMaxFileSize(), DEFAULT_MAX_FILE_SIZE);
+	fs.setMaxFileSize(16);
+	fs.createFile("Bounded");
+	ASSERT_TRUE(fs.writeAt("Bounded", 12, "abcd")); // Ends exactly at the bound
+	EXPECT_FALSE(fs.writeAt("Bounded", 13, "abcd"));
+	EXPECT_FALSE(fs.writeAt("Bounded", UINT64_MAX, "a"));
+	ASSERT_TRUE(fs.truncate("Bounded", 16));
+	EXPECT_FALSE(fs.truncate("Bounded", 17));
+	EXPECT_FALSE(fs.truncate("Bounded", UINT64_MAX));
+	EXPECT_EQ(fs.readFile("Bounded").size(), 16u);
+
+	// Appends stop at the bound however many there are
+	ASSERT_TRUE(fs.truncate("Bounded", 14));
+	ASSERT_TRUE(fs.append("Bounded", "ab"));
+	EXPECT_FALSE(fs.append("Bounded", "c"));
+	EXPECT_EQ(fs.readFile("Bounded").size(), 16u);
+}
+
+TEST(FileSystemTests, concurrentAppendsWhileReadersHoldVersions)
+{
+	// Readers keep versions alive, so appends copy outside the lock and must not lose one another
+	FileSystem fs;
+	fs.createFile("Shared");
+	const int threadCount = 4;
+	const int appendsPerThread = 500;
+	std::atomic<bool> done{false};
+	std::thread reader([&]() {
+		while (!done) {
+			FileContent held = fs.readFileShared("Shared");
+			std::this_thread::yield();
+		}
+	});
+	std::vector<std::thread> writers;
+	for (int t = 0; t < threadCount; ++t) {
+		writers.emplace_back([&, t]() {
+			for (int i = 0; i < appendsPerThread; ++i)
+				fs.append("Shared", std::string(1, static_cast<char>('a' + t)));
+		});
+	}
+	for (std::thread& writer : writers)
+		writer.join();
+	done = true;
+	reader.join();
+
+	std::string content = fs.readFile("Shared");
+	ASSERT_EQ(content.size(), static_cast<size_t>(threadCount * appendsPerThread));
+	for (int t = 0; t < threadCount; ++t)
+		EXPECT_EQ(std::count(content.begin(), content.end(), static_cast<char>('a' + t)), appendsPerThread);
+}
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include "message.h"
+#include <random>
 
 TEST(MessageTests, SerializeMessage)
 {
@@ -27,3 +28,199 @@ TEST(MessageTests, DeserializeMessage)
     ASSERT_EQ(msg._NodeAddress, "192.168.0.1");
     ASSERT_EQ(msg._NodePort, 9090);
 }
+
+TEST(MessageTests, BinaryRoundTripPreservesDelimitersAndNuls)
+{
+	Message msg;
+	msg._Type = MessageType::WriteFile;
+	msg._Filename = "dir/file|name";
+	msg._Content = std::string("a|b|c\0d", 7) + std::string(300, 'z');
+	msg._NodeAddress = "10.0.0.1";
+	msg._NodePort = 50505;
+
+	std::string encoded = Message::SerializeBinary(msg);
+	ASSERT_EQ(Message::GetWireVersion(encoded.data(), encoded.size()), MESSAGE_PROTOCOL_BINARY_V1);
+
+	Message decoded = Message::DeserializeBinary(encoded);
+	EXPECT_EQ(decoded._Type, MessageType::WriteFile);
+	EXPECT_EQ(decoded._Filename, msg._Filename);
+	EXPECT_EQ(decoded._Content, msg._Content);
+	EXPECT_EQ(decoded._NodeAddress, msg._NodeAddress);
+	EXPECT_EQ(decoded._NodePort, 50505);
+}
+
+TEST(MessageTests, DecodeDetectsWireFormat)
+{
+	Message msg;
+	msg._Type = MessageType::ReadFile;
+	msg._Filename = "File";
+	msg._NodePort = 9090;
+
+	std::string text = Message::Encode(msg, MESSAGE_PROTOCOL_TEXT);
+	std::string binary = Message::Encode(msg, MESSAGE_PROTOCOL_VERSION);
+	EXPECT_EQ(text, Message::Serialize(msg));
+	EXPECT_EQ(Message::GetWireVersion(text.data(), text.size()), MESSAGE_PROTOCOL_TEXT);
+
+	Message fromText = Message::Decode(text);
+	Message fromBinary = Message::Decode(binary);
+	EXPECT_EQ(fromText._Type, MessageType::ReadFile);
+	EXPECT_EQ(fromBinary._Type, MessageType::ReadFile);
+	EXPECT_EQ(fromText._Filename, fromBinary._Filename);
+	EXPECT_EQ(fromText._NodePort, fromBinary._NodePort);
+}
+
+TEST(MessageTests, TruncatedBinaryMessageThrows)
+{
+	Message msg;
+	msg._Type = MessageType::WriteFile;
+	msg._Content = "Some content";
+	std::string encoded = Message::SerializeBinary(msg);
+	EXPECT_THROW(Message::DeserializeBinary(encoded.data(), encoded.size() - 3), std::runtime_error);
+}
+
+TEST(MessageTests, NegotiateVersionFromHello)
+{
+	Message hello = Message::CreateHello();
+	Message decoded = Message::Decode(Message::Serialize(hello));
+	EXPECT_EQ(Message::NegotiateVersion(decoded), MESSAGE_PROTOCOL_VERSION);
+
+	Message newer = Message::CreateHello();
+	newer._Content = "200";
+	EXPECT_EQ(Message::NegotiateVersion(newer), MESSAGE_PROTOCOL_VERSION);
+
+	// A peer that predates the handshake answers with something other than Hello
+	Message legacyReply;
+	legacyReply._Type = MessageType::FileRead;
+	legacyReply._Content = "Unknown request type.";
+	EXPECT_EQ(Message::NegotiateVersion(legacyReply), MESSAGE_PROTOCOL_TEXT);
+	EXPECT_EQ(Message::GetHelloCodecs(legacyReply), "");
+}
+
+TEST(MessageTests, HelloAdvertisesCodecsAfterTheVersion)
+{
+	Message hello = Message::Decode(Message::Serialize(Message::CreateHello("lz,other")));
+	EXPECT_EQ(Message::NegotiateVersion(hello), MESSAGE_PROTOCOL_VERSION);
+	EXPECT_EQ(Message::GetHelloCodecs(hello), "lz,other");
+
+	// Peers from before compression send the version alone
+	EXPECT_EQ(Message::GetHelloCodecs(Message::CreateHello()), "");
+}
+
+namespace {
+
+// Outcome of a parse as a comparable string: every field, or the exception text
+std::string DescribeParse(Message (*parse)(const std::string&), const std::string& data)
+{
+	try {
+		Message msg = parse(data);
+		return std::to_string(static_cast<int>(msg._Type)) + "/" + msg._Filename + "/" + msg._Content + "/" +
+		       msg._NodeAddress + "/" + std::to_string(msg._NodePort);
+	} catch (const std::runtime_error& error) {
+		return std::string("error: ") + error.what();
+	}
+}
+
+}
+
+TEST(MessageTests, DeserializeMatchesTheStreamParser)
+{
+	Message (*fast)(const std::string&) = &Message::Deserialize;
+	const std::vector<std::string> cases = {
+		"", "|", "||||", "0", "0|", "0|f", "0|f|", "0|f|c", "0|f|c|", "0|f|c|a", "0|f|c|a|", "0|f|c|a|7",
+		"0||||", "0|||||", "1|f|c|a|12|34", "1|f|c|a|12\n|x", "1|f|c|a|\n12", "1|f|c\nd|a|5",
+		" 3|f|c|a| 9", "+3|f|c|a|+9", "-4|f|c|a|-9", "3x|f|c|a|9y", "x3|f|c|a|9", "3|f|c|a|y9",
+		"2147483647|f|c|a|-2147483648", "2147483648|f|c|a|1", "1|f|c|a|99999999999", "-|f|c|a|1",
+		"\t\v7|f|c|a|\r8", std::string("5\0|f|c|a|6", 10), std::string("\0" "5|f|c|a|6", 10),
+	};
+	for (const std::string& data : cases) {
+		EXPECT_EQ(DescribeParse(fast, data), DescribeParse(&Message::DeserializeWithStreams, data)) << "data: " << data;
+	}
+
+	// Random messages built from the characters the parsers treat specially, at lengths that
+	// put the delimiters on either side of the 16- and 32-byte SIMD blocks
+	static const char alphabet[] = {'|', '|', '|', '\n', ' ', '+', '-', '0', '1', '9', 'a', '\0'};
+	std::mt19937 random(19);
+	for (int trial = 0; trial < 20000; ++trial) {
+		std::string data(random() % 80, 'x');
+		for (char& c : data) c = alphabet[random() % sizeof(alphabet)];
+		if (trial % 2 == 0 && !data.empty()) data[0] = '1';
+		EXPECT_EQ(DescribeParse(fast, data), DescribeParse(&Message::DeserializeWithStreams, data)) << "trial " << trial;
+	}
+}
+
+TEST(MessageTests, DelimiterScanKernelsAgree)
+{
+	std::mt19937 random(7);
+	for (int trial = 0; trial < 2000; ++trial) {
+		std::string data(random() % 300, 'x');
+		for (char& c : data) c = random() % 20 == 0 ? '|' : 'x';
+		size_t start = std::min<size_t>(random() % 4, data.size()); // Unaligned starts
+		size_t limit = 1 + random() % 8;
+		size_t expected[8];
+		size_t expectedCount = DelimiterScan::Find(data.data() + start, data.size() - start, '|', expected, limit,
+		                                           DelimiterScan::Kernel::Scalar);
+		for (DelimiterScan::Kernel kernel : {DelimiterScan::Kernel::Sse2, DelimiterScan::Kernel::Avx2}) {
+			size_t positions[8];
+			size_t count = DelimiterScan::Find(data.data() + start, data.size() - start, '|', positions, limit, kernel);
+			ASSERT_EQ(count, expectedCount);
+			for (size_t i = 0; i < count; ++i) EXPECT_EQ(positions[i], expected[i]);
+		}
+	}
+}
+
+TEST(MessageTests, MessageViewPointsIntoTheDecodedBuffer)
+{
+	Message msg;
+	msg._Type = MessageType::WriteFile;
+	msg._Filename = "dir/file.log";
+	msg._Content = std::string(5000, 'c');
+	msg._NodeAddress = "10.0.0.7";
+	msg._NodePort = 6000;
+
+	for (const std::string& encoded : {Message::Serialize(msg), Message::SerializeBinary(msg)}) {
+		MessageView view = MessageView::Decode(encoded.data(), encoded.size());
+		EXPECT_EQ(view._Type, MessageType::WriteFile);
+		EXPECT_EQ(view._Filename, "dir/file.log");
+		EXPECT_EQ(view._NodeAddress, "10.0.0.7");
+		EXPECT_EQ(view._NodePort, 6000);
+		// Nothing was copied: the content is the bytes inside the encoded message
+		ASSERT_EQ(view._Content.size(), msg._Content.size());
+		EXPECT_GE(view._Content.data(), encoded.data());
+		EXPECT_LE(view._Content.data() + view._Content.size(), encoded.data() + encoded.size());
+
+		Message copy = Message::FromView(view);
+		EXPECT_EQ(copy._Content, msg._Content);
+		EXPECT_EQ(copy._Filename, msg._Filename);
+	}
+
+	std::string truncated = Message::SerializeBinary(msg).substr(0, 20);
+	EXPECT_THROW(MessageView::Decode(truncated.data(), truncated.size()), std::runtime_error);
+}
+
+TEST(MessageTests, RangeMessagesCarryDecimalOffsets)
+{
+	Message msg;
+	msg._Type = MessageType::ReadFileRange;
+	msg._Filename = "big.log";
+	msg._NodeAddress = "68719476736"; // Past what an int port could hold
+	msg._Content = "4096";
+
+	for (const std::string& encoded : {Message::Serialize(msg), Message::SerializeBinary(msg)}) {
+		MessageView view = MessageView::Decode(encoded.data(), encoded.size());
+		ASSERT_EQ(view._Type, MessageType::ReadFileRange);
+		uint64_t offset = 0, length = 0;
+		ASSERT_TRUE(ParseMessageNumber(view._NodeAddress, offset));
+		ASSERT_TRUE(ParseMessageNumber(view._Content, length));
+		EXPECT_EQ(offset, 68719476736ull);
+		EXPECT_EQ(length, 4096u);
+	}
+
+	uint64_t value = 0;
+	EXPECT_TRUE(ParseMessageNumber("18446744073709551615", value));
+	EXPECT_EQ(value, UINT64_MAX);
+	EXPECT_FALSE(ParseMessageNumber("18446744073709551616", value));
+	EXPECT_FALSE(ParseMessageNumber("", value));
+	EXPECT_FALSE(ParseMessageNumber("-1", value));
+	EXPECT_FALSE(ParseMessageNumber("12 ", value));
+	EXPECT_FALSE(ParseMessageNumber("0x10", value));
+}
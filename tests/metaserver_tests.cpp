@@ -1,6 +1,10 @@
 // Unit Tests for MetadataManager
 #include "gtest/gtest.h"
 #include "metaserver.h"
+#include <cstdio>
+#include <map>
+#include <set>
+#include <unistd.h>
 
 // Test Fixture for MetadataManager
 class MetadataManagerTest : public ::testing::Test {
@@ -77,3 +81,209 @@ TEST_F(MetadataManagerTest, PrintMetadata) {
 
     ASSERT_NO_THROW(metadataManager.printMetadata());
 }
+
+// Test that a growing file gets new chunks, spread evenly over the live nodes
+TEST(MetadataManagerChunkTest, ChunksAreSpreadAcrossNodes) {
+    MetadataManager manager(1024);
+    for (int i = 1; i <= 6; ++i) {
+        manager.registerNode("Node" + std::to_string(i), "localhost", 2000 + i);
+    }
+    manager.addFile("big.bin", {});
+    EXPECT_EQ(manager.getFileChunks("big.bin").size(), 1u);
+    EXPECT_EQ(manager.getFileSize("big.bin"), 0u);
+
+    manager.resizeFile("big.bin", 10 * 1024);
+    std::vector<ChunkInfo> chunks = manager.getFileChunks("big.bin");
+    ASSERT_EQ(chunks.size(), 10u);
+    EXPECT_EQ(manager.getFileSize("big.bin"), 10u * 1024);
+
+    std::map<std::string, int> chunksPerNode;
+    std::set<ChunkId> ids;
+    for (const ChunkInfo& chunk : chunks) {
+        EXPECT_NE(chunk.id, WHOLE_FILE_CHUNK_ID);
+        ids.insert(chunk.id);
+        std::set<std::string> replicas(chunk.replicas.begin(), chunk.replicas.end());
+        EXPECT_EQ(replicas.size(), 3u);
+        for (const std::string& nodeID : chunk.replicas) {
+            ++chunksPerNode[nodeID];
+        }
+    }
+    EXPECT_EQ(ids.size(), chunks.size());
+    ASSERT_EQ(chunksPerNode.size(), 6u);
+    for (const auto& entry : chunksPerNode) {
+        EXPECT_EQ(entry.second, 5) << entry.first;
+    }
+    EXPECT_EQ(manager.getFileNodes("big.bin").size(), 6u);
+
+    // Shrinking keeps the leading chunks as they are
+    manager.resizeFile("big.bin", 1500);
+    std::vector<ChunkInfo> remaining = manager.getFileChunks("big.bin");
+    ASSERT_EQ(remaining.size(), 2u);
+    EXPECT_EQ(remaining[0], chunks[0]);
+    EXPECT_EQ(remaining[1], chunks[1]);
+
+    EXPECT_THROW(manager.resizeFile("missing.bin", 1), std::runtime_error);
+    EXPECT_THROW(manager.getFileChunks("missing.bin"), std::runtime_error);
+}
+
+// Test that sizes past the chunk limit are refused before any chunk is allocated
+TEST(MetadataManagerChunkTest, ResizeRefusesSizesPastTheMaximum) {
+    EXPECT_EQ(GetChunkCount(0, 1024), 1u);
+    EXPECT_EQ(GetChunkCount(1024, 1024), 1u);
+    EXPECT_EQ(GetChunkCount(1025, 1024), 2u);
+    EXPECT_EQ(GetChunkCount(UINT64_MAX, 1024), UINT64_MAX / 1024 + 1);
+
+    MetadataManager manager(1024);
+    manager.registerNode("Node1", "localhost", 2001);
+    manager.addFile("huge.bin", {});
+    EXPECT_EQ(manager.getMaxFileSize(), 1024 * MAX_CHUNKS_PER_FILE);
+    EXPECT_THROW(manager.resizeFile("huge.bin", manager.getMaxFileSize() + 1), std::runtime_error);
+    EXPECT_THROW(manager.resizeFile("huge.bin", UINT64_MAX), std::runtime_error);
+    EXPECT_EQ(manager.getFileChunks("huge.bin").size(), 1u);
+    EXPECT_EQ(MetadataManager(UINT64_MAX).getMaxFileSize(), UINT64_MAX);
+}
+
+// Test that appends and writes past the end grow the metadata, and ranges name their chunks
+TEST(MetadataManagerChunkTest, AppendsAndWritesGrowTheChunkMap) {
+    MetadataManager manager(1024);
+    for (int i = 1; i <= 3; ++i) {
+        manager.registerNode("Node" + std::to_string(i), "localhost", 2000 + i);
+    }
+    manager.addFile("log.bin", {});
+    ChunkInfo first = manager.getFileChunks("log.bin")[0];
+
+    ChunkRange range;
+    ASSERT_TRUE(manager.prepareAppend("log.bin", 1500, range));
+    EXPECT_EQ(manager.getFileSize("log.bin"), 1500u);
+    std::vector<ChunkInfo> chunks = manager.getFileChunks("log.bin");
+    ASSERT_EQ(chunks.size(), 2u);
+    EXPECT_EQ(chunks[0], first);
+    EXPECT_EQ(range.offset, 0u);
+    EXPECT_EQ(range.chunkSize, 1024u);
+    EXPECT_EQ(range.firstChunk, 0u);
+    EXPECT_EQ(range.chunks, chunks);
+
+    // The next append lands after the first, in the chunks that hold its bytes
+    ASSERT_TRUE(manager.prepareAppend("log.bin", 1000, range));
+    EXPECT_EQ(manager.getFileSize("log.bin"), 2500u);
+    chunks = manager.getFileChunks("log.bin");
+    ASSERT_EQ(chunks.size(), 3u);
+    EXPECT_EQ(range.offset, 1500u);
+    EXPECT_EQ(range.firstChunk, 1u);
+    EXPECT_EQ(range.chunks, std::vector<ChunkInfo>(chunks.begin() + 1, chunks.end()));
+
+    // A write inside the file leaves it as it is; one past the end grows it
+    ASSERT_TRUE(manager.prepareWrite("log.bin", 100, 10, range));
+    EXPECT_EQ(manager.getFileSize("log.bin"), 2500u);
+    EXPECT_EQ(range.chunks, std::vector<ChunkInfo>({chunks[0]}));
+    ASSERT_TRUE(manager.prepareWrite("log.bin", 4000, 100, range));
+    EXPECT_EQ(manager.getFileSize("log.bin"), 4100u);
+    ASSERT_EQ(manager.getFileChunks("log.bin").size(), 5u);
+    EXPECT_EQ(range.firstChunk, 3u);
+    EXPECT_EQ(range.chunks.size(), 2u);
+
+    // Reads are clipped to the file
+    range = manager.getChunkRange("log.bin", 1000, UINT64_MAX);
+    EXPECT_EQ(range.firstChunk, 0u);
+    EXPECT_EQ(range.chunks, manager.getFileChunks("log.bin"));
+    EXPECT_TRUE(manager.getChunkRange("log.bin", 4100, 10).chunks.empty());
+
+    EXPECT_FALSE(manager.prepareWrite("log.bin", manager.getMaxFileSize(), 1, range));
+    EXPECT_FALSE(manager.prepareAppend("log.bin", manager.getMaxFileSize(), range));
+    EXPECT_EQ(manager.getFileSize("log.bin"), 4100u);
+
+    ChunkRange decoded;
+    ASSERT_TRUE(DecodeChunkRange(EncodeChunkRange(range), decoded));
+    EXPECT_EQ(decoded, range);
+    EXPECT_FALSE(DecodeChunkRange("Error: File not found.", decoded));
+}
+
+// Test saving and loading chunk maps, and loading a file list written before chunking
+TEST(MetadataManagerChunkTest, ChunkMapsSurviveSaveAndLoad) {
+    const std::string filesPath = "chunk_test_files_" + std::to_string(getpid()) + ".dat";
+    const std::string nodesPath = "chunk_test_nodes_" + std::to_string(getpid()) + ".dat";
+
+    MetadataManager original(1024);
+    original.registerNode("NodeA", "localhost", 3001);
+    original.registerNode("NodeB", "localhost", 3002);
+    original.addFile("data.bin", {});
+    original.resizeFile("data.bin", 3000);
+    original.saveMetadata(filesPath, nodesPath);
+
+    MetadataManager loaded(1024);
+    loaded.loadMetadata(filesPath, nodesPath);
+    EXPECT_EQ(loaded.getFileSize("data.bin"), 3000u);
+    std::vector<ChunkInfo> chunks = loaded.getFileChunks("data.bin");
+    EXPECT_EQ(chunks, original.getFileChunks("data.bin"));
+
+    // New chunks never reuse a loaded ID
+    loaded.addFile("other.bin", {});
+    EXPECT_GT(loaded.getFileChunks("other.bin")[0].id, chunks.back().id);
+
+    {
+        std::ofstream legacy(filesPath);
+        legacy << "old.txt|NodeA,NodeB" << std::endl;
+    }
+    MetadataManager upgraded;
+    upgraded.loadMetadata(filesPath, nodesPath);
+    std::vector<ChunkInfo> legacyChunks = upgraded.getFileChunks("old.txt");
+    ASSERT_EQ(legacyChunks.size(), 1u);
+    EXPECT_EQ(legacyChunks[0].id, WHOLE_FILE_CHUNK_ID);
+    EXPECT_EQ(GetChunkStorageName("old.txt", legacyChunks[0].id), "old.txt");
+    EXPECT_EQ(upgraded.getFileNodes("old.txt"), std::vector<std::string>({"NodeA", "NodeB"}));
+
+    // Its size is unknown, so chunks placed after it would overlap its bytes
+    EXPECT_THROW(upgraded.resizeFile("old.txt", 4096), std::runtime_error);
+    EXPECT_EQ(upgraded.getFileChunks("old.txt"), legacyChunks);
+    // Ranges and appends address its one chunk as a whole
+    ChunkRange legacyRange;
+    ASSERT_TRUE(upgraded.prepareAppend("old.txt", 100, legacyRange));
+    EXPECT_EQ(legacyRange.chunkSize, 0u);
+    EXPECT_EQ(legacyRange.chunks, legacyChunks);
+    EXPECT_EQ(upgraded.getChunkRange("old.txt", 5000, 10).chunks, legacyChunks);
+    EXPECT_EQ(upgraded.getFileChunks("old.txt"), legacyChunks);
+
+    std::remove(filesPath.c_str());
+    std::remove(nodesPath.c_str());
+}
+
+// Test that only the chunks of a failed node get a new replica, each on a live node
+TEST(MetadataManagerChunkTest, DeadNodeChunksAreReReplicated) {
+    const std::string filesPath = "chunk_test_files_dead_" + std::to_string(getpid()) + ".dat";
+    const std::string nodesPath = "chunk_test_nodes_dead_" + std::to_string(getpid()) + ".dat";
+    const time_t now = time(nullptr);
+    {
+        std::ofstream nodes(nodesPath);
+        for (int i = 1; i <= 5; ++i) {
+            // Node5 was last heard from long ago
+            time_t lastHeartbeat = i == 5 ? now - 10 * NODE_TIMEOUT_SECONDS : now;
+            nodes << "Node" << i << "|localhost:" << 4000 + i << "|" << now << "|" << lastHeartbeat << "|1" << std::endl;
+        }
+    }
+    MetadataManager manager(1024);
+    manager.loadMetadata(filesPath, nodesPath);
+    manager.addFile("spread.bin", {});
+    manager.resizeFile("spread.bin", 8 * 1024);
+    std::vector<ChunkInfo> before = manager.getFileChunks("spread.bin");
+
+    manager.checkForDeadNodes(now);
+    std::vector<ChunkInfo> after = manager.getFileChunks("spread.bin");
+    ASSERT_EQ(after.size(), before.size());
+    size_t moved = 0;
+    for (size_t i = 0; i < after.size(); ++i) {
+        EXPECT_EQ(after[i].id, before[i].id);
+        EXPECT_EQ(after[i].replicas.size(), 3u);
+        EXPECT_EQ(std::count(after[i].replicas.begin(), after[i].replicas.end(), "Node5"), 0);
+        std::set<std::string> replicas(after[i].replicas.begin(), after[i].replicas.end());
+        EXPECT_EQ(replicas.size(), 3u);
+        if (std::count(before[i].replicas.begin(), before[i].replicas.end(), "Node5") == 0) {
+            EXPECT_EQ(after[i].replicas, before[i].replicas);
+        } else {
+            ++moved;
+        }
+    }
+    EXPECT_GT(moved, 0u);
+
+    std::remove(filesPath.c_str());
+    std::remove(nodesPath.c_str());
+}
@@ -1,11 +1,27 @@
 #include "gtest/gtest.h"
 #include "client.h"
+#include "connectionpool.h"
+#include "message.h"
+#include "multiplexedclient.h"
 #include "server.h"
+#include "shmchannel.h"
+#include "uringloop.h"
 #include "networkexception.h"
 #include <thread>
 #include <chrono>
+#include <future>
+#include <map>
+#include <mutex>
+#include <set>
+#include <system_error>
 #include <vector>
 #include <string>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 // Basic test fixture for networking tests if needed, or just use TEST directly.
 class NetworkingTest : public ::testing::Test {
@@ -157,3 +173,1376 @@ TEST(NetworkingTest, MultipleClientsConnect) {
     server.Shutdown();
     ASSERT_EQ(connectedClients, numClients);
 }
+
+TEST(NetworkingTest, RunBlockingModeRepliesAndStops) {
+    const int testPort = 12350;
+    Networking::Server server(testPort);
+
+    std::thread runThread([&]() {
+        server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+            std::string reply = "echo:" + std::string(message.begin(), message.end());
+            server.SendFrame(reply, c);
+        }, Networking::ServerMode::Blocking);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    Networking::Client client("127.0.0.1", testPort);
+    ASSERT_TRUE(client.IsConnected());
+    client.SendFrame("ping");
+    std::vector<char> data = client.ReceiveFrame();
+    EXPECT_EQ(std::string(data.begin(), data.end()), "echo:ping");
+    client.Disconnect();
+
+    server.Stop();
+    runThread.join();
+    EXPECT_FALSE(server.ServerIsRunning());
+}
+
+TEST(NetworkingTest, RunEpollModeRepliesAndStops) {
+    const int testPort = 12351;
+    Networking::Server server(testPort);
+
+    std::thread runThread([&]() {
+        server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+            std::string reply = "echo:" + std::string(message.begin(), message.end());
+            server.SendFrame(reply, c);
+        }, Networking::ServerMode::Epoll);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    Networking::Client client("127.0.0.1", testPort);
+    ASSERT_TRUE(client.IsConnected());
+    client.SendFrame("ping");
+    std::vector<char> data = client.ReceiveFrame();
+    EXPECT_EQ(std::string(data.begin(), data.end()), "echo:ping");
+    client.Disconnect();
+
+    server.Stop();
+    runThread.join();
+    EXPECT_FALSE(server.ServerIsRunning());
+}
+
+TEST(NetworkingTest, RunEpollModeServesManyClientsOnOneThread) {
+    const int testPort = 12352;
+    const int numClients = 50;
+    Networking::Server server(testPort);
+    std::atomic<int> handlerCalls{0};
+    std::set<std::thread::id> handlerThreads;
+
+    std::thread runThread([&]() {
+        server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+            handlerCalls++;
+            handlerThreads.insert(std::this_thread::get_id());
+            server.SendFrame(message.data(), message.size(), c);
+        }, Networking::ServerMode::Epoll);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::atomic<int> matchedReplies{0};
+    std::vector<std::thread> clientThreads;
+    for (int i = 0; i < numClients; ++i) {
+        clientThreads.emplace_back([&, i]() {
+            Networking::Client client("127.0.0.1", testPort);
+            if (!client.IsConnected()) return;
+            std::string payload = "client-" + std::to_string(i);
+            client.SendFrame(payload);
+            std::vector<char> data = client.ReceiveFrame();
+            if (std::string(data.begin(), data.end()) == payload) matchedReplies++;
+            client.Disconnect();
+        });
+    }
+    for (auto& t : clientThreads) {
+        t.join();
+    }
+
+    server.Stop();
+    runThread.join();
+    EXPECT_EQ(matchedReplies, numClients);
+    EXPECT_EQ(handlerCalls, numClients);
+    EXPECT_EQ(handlerThreads.size(), 1u);
+}
+
+TEST(NetworkingTest, RunDispatchesRequestsOntoThreadPool) {
+    const int testPort = 12356;
+    const int numClients = 20;
+    Networking::Server server(testPort);
+    ThreadPool pool(2, 4);
+    std::atomic<int> handlerCalls{0};
+    std::mutex threadsMutex;
+    std::set<std::thread::id> handlerThreads;
+    std::thread::id runThreadId;
+
+    std::thread runThread([&]() {
+        runThreadId = std::this_thread::get_id();
+        server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+            handlerCalls++;
+            {
+                std::lock_guard<std::mutex> lock(threadsMutex);
+                handlerThreads.insert(std::this_thread::get_id());
+            }
+            server.SendFrame(message.data(), message.size(), c);
+        }, Networking::ServerMode::Epoll, &pool);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::atomic<int> matchedReplies{0};
+    std::vector<std::thread> clientThreads;
+    for (int i = 0; i < numClients; ++i) {
+        clientThreads.emplace_back([&, i]() {
+            Networking::Client client("127.0.0.1", testPort);
+            if (!client.IsConnected()) return;
+            std::string payload = "pooled-" + std::to_string(i);
+            client.SendFrame(payload);
+            std::vector<char> data = client.ReceiveFrame();
+            if (std::string(data.begin(), data.end()) == payload) matchedReplies++;
+            client.Disconnect();
+        });
+    }
+    for (auto& t : clientThreads) {
+        t.join();
+    }
+
+    server.Stop();
+    runThread.join();
+    EXPECT_EQ(matchedReplies, numClients);
+    EXPECT_EQ(handlerCalls, numClients);
+    // Requests the saturated pool refused ran on the loop thread; the rest ran on workers
+    ThreadPool::Stats stats = pool.GetStats();
+    EXPECT_EQ(stats.executed + stats.rejected, (uint64_t)numClients);
+    handlerThreads.erase(runThreadId);
+    EXPECT_LE(handlerThreads.size(), 2u);
+    EXPECT_GE(handlerThreads.size(), 1u);
+}
+
+TEST(NetworkingTest, FrameHeaderRoundTrip) {
+    Networking::FrameHeader header;
+    header.flags = 3;
+    header.payloadLength = 123456789;
+    header.requestId = 0xDEADBEEF;
+    char buffer[Networking::FRAME_HEADER_SIZE];
+    Networking::EncodeFrameHeader(header, buffer);
+
+    Networking::FrameHeader decoded;
+    ASSERT_TRUE(Networking::DecodeFrameHeader(buffer, decoded));
+    EXPECT_EQ(decoded.flags, 3);
+    EXPECT_EQ(decoded.payloadLength, 123456789u);
+    EXPECT_EQ(decoded.requestId, 0xDEADBEEFu);
+
+    buffer[0] = 'X';
+    EXPECT_FALSE(Networking::DecodeFrameHeader(buffer, decoded));
+}
+
+TEST(NetworkingTest, FramedPayloadOfExactMultipleOf512IsReceivedWhole) {
+    const int testPort = 12353;
+    Networking::Server server(testPort);
+
+    // 1024 bytes with embedded NULs: the legacy Receive would stall or truncate this
+    std::string payload(1024, 'a');
+    payload[100] = '\0';
+    std::vector<char> received;
+    std::thread serverThread([&]() {
+        Networking::ClientConnection clientConn = server.Accept();
+        received = server.ReceiveFrame(clientConn);
+        server.SendFrame(received.data(), received.size(), clientConn);
+        server.DisconnectClient(clientConn);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    Networking::Client client("127.0.0.1", testPort);
+    ASSERT_TRUE(client.IsConnected());
+    client.SendFrame(payload);
+    std::vector<char> echoed = client.ReceiveFrame();
+    client.Disconnect();
+    serverThread.join();
+    server.Shutdown();
+
+    EXPECT_EQ(std::string(received.begin(), received.end()), payload);
+    EXPECT_EQ(std::string(echoed.begin(), echoed.end()), payload);
+}
+
+TEST(NetworkingTest, RunEpollModeReassemblesLargeAndSplitFrames) {
+    const int testPort = 12354;
+    Networking::Server server(testPort);
+    std::thread runThread([&]() {
+        server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+            server.SendFrame(message.data(), message.size(), c);
+        }, Networking::ServerMode::Epoll);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    // A payload far larger than a socket buffer exercises partial reads and writes
+    std::string large(8 * 1024 * 1024, 'x');
+    for (size_t i = 0; i < large.size(); i += 4096) large[i] = static_cast<char>(i / 4096);
+    Networking::Client client("127.0.0.1", testPort);
+    ASSERT_TRUE(client.IsConnected());
+    client.SendFrame(large);
+    std::vector<char> echoed = client.ReceiveFrame();
+    client.Disconnect();
+    EXPECT_TRUE(std::string(echoed.begin(), echoed.end()) == large);
+
+    // A frame dribbled out a few bytes at a time must still arrive as one message
+    std::string small = "split frame";
+    Networking::FrameHeader header;
+    header.payloadLength = small.size();
+    std::vector<char> frame(Networking::FRAME_HEADER_SIZE);
+    Networking::EncodeFrameHeader(header, frame.data());
+    frame.insert(frame.end(), small.begin(), small.end());
+
+    int rawSocket = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(testPort);
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    ASSERT_EQ(connect(rawSocket, (sockaddr*)&address, sizeof(address)), 0);
+    for (size_t i = 0; i < frame.size(); i += 3) {
+        ASSERT_GT(send(rawSocket, frame.data() + i, std::min<size_t>(3, frame.size() - i), 0), 0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    char replyHeader[Networking::FRAME_HEADER_SIZE];
+    ASSERT_EQ(Networking::ReadFully(rawSocket, replyHeader, sizeof(replyHeader)), (long)sizeof(replyHeader));
+    Networking::FrameHeader decoded;
+    ASSERT_TRUE(Networking::DecodeFrameHeader(replyHeader, decoded));
+    std::string reply(decoded.payloadLength, '\0');
+    ASSERT_EQ(Networking::ReadFully(rawSocket, &reply[0], reply.size()), (long)reply.size());
+    close(rawSocket);
+    EXPECT_EQ(reply, small);
+
+    server.Stop();
+    runThread.join();
+}
+
+TEST(NetworkingTest, OversizedFrameIsRejected) {
+    const int testPort = 12355;
+    Networking::Server server(testPort);
+    server.SetMaxMessageSize(16);
+    EXPECT_EQ(server.GetMaxMessageSize(), 16u);
+
+    std::vector<char> received{'x'};
+    std::thread serverThread([&]() {
+        Networking::ClientConnection clientConn = server.Accept();
+        received = server.ReceiveFrame(clientConn);
+        server.DisconnectClient(clientConn);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    Networking::Client client("127.0.0.1", testPort);
+    ASSERT_TRUE(client.IsConnected());
+    client.SendFrame(std::string(32, 'y'));
+    try {
+        client.Disconnect();
+    } catch (const Networking::NetworkException&) {
+        // The server may already have reset the connection after rejecting the header
+    }
+    serverThread.join();
+    server.Shutdown();
+
+    EXPECT_TRUE(received.empty());
+}
+
+TEST(NetworkingTest, KeepAliveEpollAnswersPipelinedRequestsInOrder) {
+    const int testPort = 12357;
+    const int numRequests = 8;
+    Networking::Server server(testPort);
+    server.SetKeepAlive(true);
+    ThreadPool pool(2, 4);
+
+    std::thread runThread([&]() {
+        server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+            server.SendFrame(message.data(), message.size(), c);
+        }, Networking::ServerMode::Epoll, &pool);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    Networking::Client client("127.0.0.1", testPort);
+    ASSERT_TRUE(client.IsConnected());
+    // Every request is written before any reply is read
+    for (int i = 0; i < numRequests; ++i) {
+        client.SendFrame("request-" + std::to_string(i));
+    }
+    for (int i = 0; i < numRequests; ++i) {
+        std::vector<char> data = client.ReceiveFrame();
+        EXPECT_EQ(std::string(data.begin(), data.end()), "request-" + std::to_string(i));
+    }
+    client.Disconnect();
+
+    server.Stop();
+    runThread.join();
+}
+
+TEST(NetworkingTest, KeepAliveBlockingServesSeveralRequestsPerConnection) {
+    const int testPort = 12358;
+    Networking::Server server(testPort);
+    server.SetKeepAlive(true);
+    EXPECT_TRUE(server.GetKeepAlive());
+
+    std::thread runThread([&]() {
+        server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+            server.SendFrame("echo:" + std::string(message.begin(), message.end()), c);
+        }, Networking::ServerMode::Blocking);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    Networking::Client client("127.0.0.1", testPort);
+    ASSERT_TRUE(client.IsConnected());
+    for (int i = 0; i < 3; ++i) {
+        client.SendFrame("ping" + std::to_string(i));
+        std::vector<char> data = client.ReceiveFrame();
+        EXPECT_EQ(std::string(data.begin(), data.end()), "echo:ping" + std::to_string(i));
+    }
+    client.Disconnect();
+
+    server.Stop();
+    runThread.join();
+}
+
+TEST(NetworkingTest, ServerEchoesRequestIdsInReplies) {
+    const int testPort = 12364;
+    Networking::Server server(testPort);
+    server.SetKeepAlive(true);
+
+    std::thread runThread([&]() {
+        server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+            server.SendFrame(message.data(), message.size(), c);
+        }, Networking::ServerMode::Blocking);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    Networking::Client client("127.0.0.1", testPort);
+    ASSERT_TRUE(client.IsConnected());
+    uint32_t requestId = 0;
+    client.SendFrame(std::string("tagged"), 42);
+    std::vector<char> data = client.ReceiveFrame(requestId);
+    EXPECT_EQ(std::string(data.begin(), data.end()), "tagged");
+    EXPECT_EQ(requestId, 42u);
+
+    // Untagged requests get untagged replies
+    client.SendFrame("plain");
+    data = client.ReceiveFrame(requestId);
+    EXPECT_EQ(std::string(data.begin(), data.end()), "plain");
+    EXPECT_EQ(requestId, 0u);
+    client.Disconnect();
+
+    server.Stop();
+    runThread.join();
+}
+
+TEST(NetworkingTest, MultiplexedClientCompletesRequestsOutOfOrder) {
+    const int testPort = 12365;
+    Networking::Server server(testPort);
+    server.SetKeepAlive(true);
+    ThreadPool pool(4, 16);
+
+    std::thread runThread([&]() {
+        server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+            std::string request(message.begin(), message.end());
+            if (request == "slow")
+                std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            server.SendFrame("reply:" + request, c);
+        }, Networking::ServerMode::Epoll, &pool);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    Networking::MultiplexedClient client("127.0.0.1", testPort);
+    ASSERT_TRUE(client.IsConnected());
+
+    // The slow request is sent first, but must not hold up the ones behind it
+    std::future<std::vector<char> > slow = client.Call("slow");
+    std::vector<std::future<std::vector<char> > > fast;
+    for (int i = 0; i < 4; ++i) {
+        fast.push_back(client.Call("fast" + std::to_string(i)));
+    }
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_EQ(fast[i].wait_for(std::chrono::milliseconds(400)), std::future_status::ready);
+        std::vector<char> data = fast[i].get();
+        EXPECT_EQ(std::string(data.begin(), data.end()), "reply:fast" + std::to_string(i));
+    }
+    EXPECT_NE(slow.wait_for(std::chrono::milliseconds(0)), std::future_status::ready);
+    std::vector<char> data = slow.get();
+    EXPECT_EQ(std::string(data.begin(), data.end()), "reply:slow");
+
+    std::promise<std::string> callbackReply;
+    client.Call("callback", [&](std::vector<char> reply, std::exception_ptr error) {
+        callbackReply.set_value(error ? "error" : std::string(reply.begin(), reply.end()));
+    });
+    EXPECT_EQ(callbackReply.get_future().get(), "reply:callback");
+    EXPECT_EQ(client.GetPendingCount(), 0u);
+
+    // Calls on a closed client fail instead of waiting forever
+    client.Close();
+    EXPECT_FALSE(client.IsConnected());
+    std::future<std::vector<char> > closed = client.Call("late");
+    EXPECT_THROW(closed.get(), std::system_error);
+
+    server.Stop();
+    runThread.join();
+}
+
+TEST(NetworkingTest, EventLoopRecyclesReceiveBuffers) {
+    const int testPort = 12366;
+    const int numRequests = 20;
+    Networking::BufferPool& buffers = Networking::BufferPool::Default();
+    Networking::BufferPool::Stats before = buffers.GetStats();
+    {
+        Networking::Server server(testPort);
+        server.SetKeepAlive(true);
+        ThreadPool pool(2, 4);
+
+        std::thread runThread([&]() {
+            server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+                server.SendFrame(message.data(), message.size(), c);
+            }, Networking::ServerMode::Epoll, &pool);
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+        Networking::Client client("127.0.0.1", testPort);
+        ASSERT_TRUE(client.IsConnected());
+        std::string payload(20000, 'p');
+        for (int i = 0; i < numRequests; ++i) {
+            client.SendFrame(payload);
+            std::vector<char> data = client.ReceiveFrame();
+            ASSERT_EQ(data.size(), payload.size());
+        }
+        client.Disconnect();
+
+        server.Stop();
+        runThread.join();
+    }
+
+    // Each request's payload buffer is returned after its handler, so only the first allocates
+    Networking::BufferPool::Stats after = buffers.GetStats();
+    EXPECT_GE(after.acquisitions - before.acquisitions, (uint64_t)numRequests);
+    EXPECT_GE(after.hits - before.hits, (uint64_t)numRequests - 1);
+    EXPECT_EQ(after.outstandingBuffers, before.outstandingBuffers);
+    EXPECT_EQ(after.outstandingBytes, before.outstandingBytes);
+}
+
+TEST(NetworkingTest, ReusePortListenersShareConnections) {
+    const int testPort = 12367;
+    const int numClients = 32;
+    Networking::Server server(testPort);
+    server.SetListenerCount(4);
+    EXPECT_EQ(server.GetListenerCount(), 4u);
+
+    std::mutex mutex;
+    std::set<size_t> listenersUsed;
+    std::thread runThread([&]() {
+        server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                listenersUsed.insert(c.listenerIndex);
+            }
+            // The reply must go out through the loop that owns the connection
+            server.SendFrame(message.data(), message.size(), c);
+        }, Networking::ServerMode::Epoll);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    for (int i = 0; i < numClients; ++i) {
+        Networking::Client client("127.0.0.1", testPort);
+        ASSERT_TRUE(client.IsConnected());
+        client.SendFrame("hello" + std::to_string(i));
+        std::vector<char> data = client.ReceiveFrame();
+        EXPECT_EQ(std::string(data.begin(), data.end()), "hello" + std::to_string(i));
+        client.Disconnect();
+    }
+
+    server.Stop();
+    runThread.join();
+
+    // The kernel hashes each connection to one of the listeners
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_GT(listenersUsed.size(), 1u);
+    for (size_t index : listenersUsed) {
+        EXPECT_LT(index, 4u);
+    }
+}
+
+TEST(NetworkingTest, UnixDomainServerEchoesFrames) {
+    const std::string socketPath = "/tmp/simplidfs-test-" + std::to_string(getpid()) + ".sock";
+    Networking::Server server(socketPath);
+    ASSERT_TRUE(server.ServerIsRunning());
+
+    std::thread runThread([&]() {
+        server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+            server.SendFrame(message.data(), message.size(), c);
+        }, Networking::ServerMode::Epoll);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    Networking::Client client;
+    ASSERT_TRUE(client.ConnectUnixSocket(socketPath));
+    std::string payload(200000, 'u');
+    client.SendFrame(payload);
+    std::vector<char> data = client.ReceiveFrame();
+    EXPECT_EQ(std::string(data.begin(), data.end()), payload);
+    client.Disconnect();
+
+    server.Stop();
+    runThread.join();
+
+    // Shutting down removes the socket file
+    struct stat pathStat;
+    EXPECT_NE(stat(socketPath.c_str(), &pathStat), 0);
+}
+
+TEST(NetworkingTest, ShmChannelCarriesFramesLargerThanTheRing) {
+    int sockets[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+
+    Networking::ShmChannel creator = Networking::ShmChannel::Create(4096);
+    creator.ShareOver(sockets[0]);
+    Networking::ShmChannel peer = Networking::ShmChannel::AttachFrom(sockets[1]);
+    ASSERT_TRUE(creator.IsOpen());
+    ASSERT_TRUE(peer.IsOpen());
+
+    // The peer echoes every frame back with its request ID
+    std::thread echoThread([&]() {
+        while (true) {
+            uint32_t requestId;
+            std::vector<char> frame = peer.ReceiveFrame(requestId);
+            if (frame.empty())
+                break;
+            peer.SendFrame(frame.data(), frame.size(), requestId);
+        }
+    });
+
+    for (size_t size : {size_t(1), size_t(4096), size_t(100000)}) {
+        std::string payload(size, 'a');
+        for (size_t i = 0; i < size; ++i)
+            payload[i] = char('a' + i % 26);
+        creator.SendFrame(payload, uint32_t(size));
+        uint32_t requestId = 0;
+        std::vector<char> reply = creator.ReceiveFrame(requestId);
+        EXPECT_EQ(requestId, uint32_t(size));
+        EXPECT_EQ(std::string(reply.begin(), reply.end()), payload);
+    }
+
+    // Closing wakes the peer, which sees the end of the channel
+    creator.Close();
+    echoThread.join();
+    EXPECT_THROW(creator.SendFrame(std::string("late")), int);
+    close(sockets[0]);
+    close(sockets[1]);
+}
+
+TEST(NetworkingTest, ShmChannelNoticesPeerExitWithoutClose) {
+    int sockets[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+
+    pid_t child = fork();
+    ASSERT_GE(child, 0);
+    if (child == 0) {
+        close(sockets[0]);
+        try {
+            Networking::ShmChannel peer = Networking::ShmChannel::AttachFrom(sockets[1]);
+            peer.ReceiveFrame();
+            // Exit without closing the channel, as a crashed process would
+            _exit(0);
+        } catch (int) {
+            _exit(1);
+        }
+    }
+    close(sockets[1]);
+
+    Networking::ShmChannel channel = Networking::ShmChannel::Create(4096);
+    channel.ShareOver(sockets[0]);
+    channel.SendFrame(std::string("ping"));
+
+    // No reply ever comes; the hang-up on the socket ends the wait
+    std::vector<char> reply = channel.ReceiveFrame();
+    EXPECT_TRUE(reply.empty());
+    try {
+        channel.SendFrame(std::string("ping"));
+        FAIL() << "Expected the send to fail once the peer is gone";
+    } catch (int error) {
+        EXPECT_EQ(error, EPIPE);
+    }
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    close(sockets[0]);
+}
+
+TEST(NetworkingTest, ReceiveFrameGivesUpAtTheDeadline) {
+    const int testPort = 12368;
+    Networking::Server server(testPort);
+    server.SetKeepAlive(true);
+
+    // The handler never replies, and keep-alive holds the connection open
+    std::thread runThread([&]() {
+        server.Run([&](Networking::ClientConnection, const std::vector<char>&) {
+        }, Networking::ServerMode::Epoll);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    Networking::Client client;
+    ASSERT_TRUE(client.Connect("127.0.0.1", testPort, Networking::Deadline::After(std::chrono::seconds(2))));
+    client.SendFrame(std::string("hello"));
+    client.SetDeadline(Networking::Deadline::After(std::chrono::milliseconds(100)));
+
+    auto start = std::chrono::steady_clock::now();
+    try {
+        client.ReceiveFrame();
+        FAIL() << "Expected the receive to time out";
+    } catch (Networking::NetworkException& exception) {
+        EXPECT_EQ(exception.GetErrorCode(), ETIMEDOUT);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_GE(elapsed, std::chrono::milliseconds(90));
+    EXPECT_LT(elapsed, std::chrono::seconds(2));
+    // The stream may be mid-frame, so the connection is closed
+    EXPECT_FALSE(client.IsConnected());
+
+    server.Stop();
+    runThread.join();
+}
+
+TEST(NetworkingTest, ConnectFailsFastOnceTheCircuitIsOpen) {
+    // Nothing listens on this port
+    const int closedPort = 12369;
+    Networking::CircuitBreaker breaker(2, std::chrono::seconds(30));
+    Networking::RetryPolicy noRetries;
+    noRetries.maxRetries = 0;
+
+    for (int i = 0; i < 2; ++i) {
+        Networking::Client client;
+        client.SetCircuitBreaker(&breaker);
+        try {
+            client.Connect("127.0.0.1", closedPort, Networking::Deadline::After(std::chrono::seconds(1)), noRetries);
+            FAIL() << "Expected the connection to be refused";
+        } catch (Networking::NetworkException& exception) {
+            EXPECT_EQ(exception.GetErrorCode(), ECONNREFUSED);
+        }
+    }
+
+    Networking::Client client;
+    client.SetCircuitBreaker(&breaker);
+    try {
+        client.Connect("127.0.0.1", closedPort, Networking::Deadline::After(std::chrono::seconds(1)), noRetries);
+        FAIL() << "Expected the open circuit to refuse the call";
+    } catch (Networking::NetworkException& exception) {
+        EXPECT_EQ(exception.GetErrorCode(), EHOSTDOWN);
+    }
+
+    // Retries back off within the deadline instead of waiting a fixed delay
+    Networking::RetryPolicy retries;
+    retries.maxRetries = 10;
+    retries.initialDelay = std::chrono::milliseconds(5);
+    Networking::Client retrying;
+    retrying.SetCircuitBreaker(nullptr);
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_THROW(retrying.Connect("127.0.0.1", closedPort, Networking::Deadline::After(std::chrono::milliseconds(300)), retries), Networking::NetworkException);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+}
+
+TEST(NetworkingTest, WriteVectorFullyResumesAcrossBuffersAfterShortWrites) {
+    int sockets[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+    // A small send buffer forces many short writes that end mid-buffer
+    int bufferSize = 4096;
+    setsockopt(sockets[0], SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+
+    std::vector<std::string> parts = {std::string(100000, 'a'), std::string(), std::string(1, '\0'), std::string(300001, 'b')};
+    std::string expected;
+    std::vector<iovec> vectors;
+    for (std::string& part : parts) {
+        expected += part;
+        iovec vector;
+        vector.iov_base = &part[0];
+        vector.iov_len = part.size();
+        vectors.push_back(vector);
+    }
+
+    std::string received(expected.size(), 'x');
+    std::thread reader([&]() {
+        Networking::ReadFully(sockets[1], &received[0], received.size());
+    });
+    EXPECT_EQ(Networking::WriteVectorFully(sockets[0], vectors.data(), vectors.size()), (long)expected.size());
+    reader.join();
+    EXPECT_TRUE(received == expected);
+    close(sockets[0]);
+    close(sockets[1]);
+}
+
+TEST(NetworkingTest, LengthAndVectorSendsKeepEmbeddedNulBytes) {
+    const int testPort = 12370;
+    Networking::Server server(testPort);
+
+    // Echo the payload as a header and body gathered from two buffers
+    std::thread runThread([&]() {
+        server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+            Networking::FrameHeader header;
+            header.payloadLength = message.size();
+            char headerBuffer[Networking::FRAME_HEADER_SIZE];
+            Networking::EncodeFrameHeader(header, headerBuffer);
+            iovec vectors[2];
+            vectors[0].iov_base = headerBuffer;
+            vectors[0].iov_len = sizeof(headerBuffer);
+            vectors[1].iov_base = (void*)message.data();
+            vectors[1].iov_len = message.size();
+            server.Send(vectors, 2, c);
+        }, Networking::ServerMode::Epoll);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    Networking::Client client("127.0.0.1", testPort);
+    ASSERT_TRUE(client.IsConnected());
+    const char payload[] = {'a', '\0', 'b', '\0', '\0', 'c'};
+    Networking::FrameHeader header;
+    header.payloadLength = sizeof(payload);
+    char headerBuffer[Networking::FRAME_HEADER_SIZE];
+    Networking::EncodeFrameHeader(header, headerBuffer);
+    // The header goes out through the length overload, which does not stop at NUL bytes
+    EXPECT_EQ(client.Send(headerBuffer, sizeof(headerBuffer)), (int)sizeof(headerBuffer));
+    EXPECT_EQ(client.Send(payload, sizeof(payload)), (int)sizeof(payload));
+
+    std::vector<char> reply = client.ReceiveFrame();
+    EXPECT_EQ(std::string(reply.begin(), reply.end()), std::string(payload, sizeof(payload)));
+    client.Disconnect();
+
+    server.Stop();
+    runThread.join();
+}
+
+TEST(NetworkingTest, ZeroCopyFramesArriveIntact) {
+    const int testPort = 12371;
+    Networking::Server server(testPort);
+    server.SetKeepAlive(true);
+
+    std::thread runThread([&]() {
+        server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+            server.SendFrame(message.data(), message.size(), c);
+        }, Networking::ServerMode::Epoll);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    Networking::Client client("127.0.0.1", testPort);
+    ASSERT_TRUE(client.IsConnected());
+    client.SetZeroCopyThreshold(64 * 1024);
+
+    std::string payload(1024 * 1024, '\0');
+    for (size_t i = 0; i < payload.size(); ++i)
+        payload[i] = char(i * 31);
+    for (int i = 0; i < 3; ++i) {
+        client.SendFrame(payload);
+        std::vector<char> reply = client.ReceiveFrame();
+        EXPECT_TRUE(std::string(reply.begin(), reply.end()) == payload);
+    }
+    // Small frames stay below the threshold
+    client.SendFrame(std::string("small"));
+    std::vector<char> reply = client.ReceiveFrame();
+    EXPECT_EQ(std::string(reply.begin(), reply.end()), "small");
+
+    // Every large write either went out zero-copy and completed, or fell back;
+    // on loopback the kernel copies, after which zero-copy is switched off
+    Networking::ZeroCopySender::Stats stats = client.GetZeroCopyStats();
+    EXPECT_EQ(stats.completions, stats.zeroCopySends);
+    EXPECT_GT(stats.zeroCopySends + stats.fallbacks, 0u);
+    client.Disconnect();
+
+    server.Stop();
+    runThread.join();
+}
+
+TEST(NetworkingTest, RunUringModeServesManyClientsAndClosesThem) {
+    if (!Networking::UringLoop::IsSupported()) GTEST_SKIP() << "io_uring is not available";
+    const int testPort = 12372;
+    const int numClients = 50;
+    Networking::Server server(testPort);
+    std::atomic<int> handlerCalls{0};
+    std::set<std::thread::id> handlerThreads;
+
+    std::thread runThread([&]() {
+        server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+            handlerCalls++;
+            handlerThreads.insert(std::this_thread::get_id());
+            server.SendFrame(message.data(), message.size(), c);
+        }, Networking::ServerMode::Uring);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    // Without keep-alive every reply goes out linked to the close of its connection
+    std::atomic<int> matchedReplies{0};
+    std::atomic<int> closedAfterReply{0};
+    std::vector<std::thread> clientThreads;
+    for (int i = 0; i < numClients; ++i) {
+        clientThreads.emplace_back([&, i]() {
+            Networking::Client client("127.0.0.1", testPort);
+            if (!client.IsConnected()) return;
+            std::string payload = "uring-" + std::to_string(i);
+            client.SendFrame(payload);
+            std::vector<char> data = client.ReceiveFrame();
+            if (std::string(data.begin(), data.end()) == payload) matchedReplies++;
+            if (client.ReceiveFrame().empty()) closedAfterReply++;
+            client.Disconnect();
+        });
+    }
+    for (auto& t : clientThreads) {
+        t.join();
+    }
+
+    server.Stop();
+    runThread.join();
+    EXPECT_EQ(matchedReplies, numClients);
+    EXPECT_EQ(closedAfterReply, numClients);
+    EXPECT_EQ(handlerCalls, numClients);
+    EXPECT_EQ(handlerThreads.size(), 1u);
+    EXPECT_FALSE(server.ServerIsRunning());
+}
+
+TEST(NetworkingTest, RunUringModeAnswersPipelinedAndLargeFramesInOrder) {
+    if (!Networking::UringLoop::IsSupported()) GTEST_SKIP() << "io_uring is not available";
+    const int testPort = 12373;
+    Networking::Server server(testPort);
+    server.SetKeepAlive(true);
+    ThreadPool pool(2, 4);
+
+    std::thread runThread([&]() {
+        server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+            server.SendFrame(message.data(), message.size(), c);
+        }, Networking::ServerMode::Uring, &pool);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    // Small frames share receive buffers, larger ones span several and the
+    // largest is received straight into its payload
+    std::vector<std::string> requests;
+    for (size_t size : {5, 100, 16 * 1024, 40 * 1024, 3 * 1024 * 1024, 7}) {
+        std::string request(size, '\0');
+        for (size_t i = 0; i < size; ++i) request[i] = char(i * 7 + requests.size());
+        requests.push_back(request);
+    }
+
+    Networking::Client client("127.0.0.1", testPort);
+    ASSERT_TRUE(client.IsConnected());
+    std::thread writer([&]() {
+        for (const std::string& request : requests) client.SendFrame(request);
+    });
+    for (const std::string& request : requests) {
+        std::vector<char> data = client.ReceiveFrame();
+        EXPECT_TRUE(std::string(data.begin(), data.end()) == request);
+    }
+    writer.join();
+
+    // A frame dribbled out a few bytes at a time must still arrive as one message
+    std::string small = "split frame";
+    Networking::FrameHeader header;
+    header.payloadLength = small.size();
+    std::vector<char> frame(Networking::FRAME_HEADER_SIZE);
+    Networking::EncodeFrameHeader(header, frame.data());
+    frame.insert(frame.end(), small.begin(), small.end());
+    for (size_t i = 0; i < frame.size(); i += 5) {
+        ASSERT_EQ(client.Send(frame.data() + i, std::min<size_t>(5, frame.size() - i)), (int)std::min<size_t>(5, frame.size() - i));
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    std::vector<char> reply = client.ReceiveFrame();
+    EXPECT_EQ(std::string(reply.begin(), reply.end()), small);
+    client.Disconnect();
+
+    server.Stop();
+    runThread.join();
+}
+
+TEST(NetworkingTest, ConnectionPoolReusesHealthyConnections) {
+    const int testPort = 12359;
+    Networking::Server server(testPort);
+    server.SetKeepAlive(true);
+
+    std::thread runThread([&]() {
+        server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+            server.SendFrame(message.data(), message.size(), c);
+        }, Networking::ServerMode::Epoll);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    Networking::ConnectionPool pool;
+    for (int i = 0; i < 3; ++i) {
+        Networking::ConnectionPool::Lease lease = pool.Acquire("127.0.0.1", testPort);
+        ASSERT_TRUE(lease);
+        EXPECT_EQ(lease.IsReused(), i > 0);
+        lease->SendFrame("hello");
+        std::vector<char> data = lease->ReceiveFrame();
+        EXPECT_EQ(std::string(data.begin(), data.end()), "hello");
+    }
+    Networking::ConnectionPool::Stats stats = pool.GetStats();
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.hits, 2u);
+    EXPECT_EQ(stats.idle, 1u);
+
+    // Stopping the server closes the idle connection, which the health check must notice
+    server.Stop();
+    runThread.join();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    Networking::ConnectionPool::Lease lease = pool.Acquire("127.0.0.1", testPort);
+    EXPECT_FALSE(lease);
+    stats = pool.GetStats();
+    EXPECT_EQ(stats.failedHealthChecks, 1u);
+    EXPECT_EQ(stats.idle, 0u);
+}
+
+TEST(NetworkingTest, ConnectionPoolEvictsIdleConnections) {
+    const int testPort = 12360;
+    Networking::Server server(testPort);
+    server.SetKeepAlive(true);
+
+    std::thread runThread([&]() {
+        server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+            server.SendFrame(message.data(), message.size(), c);
+        }, Networking::ServerMode::Epoll);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    Networking::ConnectionPool pool(1, std::chrono::milliseconds(100));
+    {
+        // Two concurrent leases need two connections, but only one may stay idle
+        Networking::ConnectionPool::Lease first = pool.Acquire("127.0.0.1", testPort);
+        Networking::ConnectionPool::Lease second = pool.Acquire("127.0.0.1", testPort);
+        ASSERT_TRUE(first);
+        ASSERT_TRUE(second);
+    }
+    Networking::ConnectionPool::Stats stats = pool.GetStats();
+    EXPECT_EQ(stats.idle, 1u);
+    EXPECT_EQ(stats.evictions, 1u);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    pool.EvictIdle();
+    stats = pool.GetStats();
+    EXPECT_EQ(stats.idle, 0u);
+    EXPECT_EQ(stats.evictions, 2u);
+
+    server.Stop();
+    runThread.join();
+}
+
+TEST(NetworkingTest, KeepAliveHeartbeatsAreAnsweredOnPooledConnections) {
+    const int testPort = 12380;
+    Networking::Server server(testPort);
+    server.SetKeepAlive(true);
+
+    // Answers heartbeats the way the metaserver does; anything else goes unanswered
+    std::thread runThread([&]() {
+        server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+            if (Message::Decode(std::string(message.begin(), message.end()))._Type == MessageType::Heartbeat) {
+                server.SendFrame("Heartbeat acknowledged.", c);
+            }
+        }, Networking::ServerMode::Epoll);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    Message heartbeat;
+    heartbeat._Type = MessageType::Heartbeat;
+    heartbeat._Filename = "node1";
+    Networking::ConnectionPool pool;
+    pool.SetIoTimeout(std::chrono::milliseconds(200));
+    for (int i = 0; i < 3; ++i) {
+        Networking::ConnectionPool::Lease lease = pool.Acquire("127.0.0.1", testPort);
+        ASSERT_TRUE(lease);
+        EXPECT_EQ(lease.IsReused(), i > 0);
+        lease->SendFrame(Message::Serialize(heartbeat));
+        std::vector<char> reply = lease->ReceiveFrame();
+        EXPECT_EQ(std::string(reply.begin(), reply.end()), "Heartbeat acknowledged.");
+    }
+    EXPECT_EQ(pool.GetStats().hits, 2u);
+
+    // A peer that never replies costs the lease its I/O timeout, not the thread
+    Message other;
+    other._Type = MessageType::RegisterNode;
+    other._Filename = "node1";
+    auto start = std::chrono::steady_clock::now();
+    {
+        Networking::ConnectionPool::Lease lease = pool.Acquire("127.0.0.1", testPort);
+        ASSERT_TRUE(lease);
+        lease->SendFrame(Message::Serialize(other));
+        try {
+            lease->ReceiveFrame();
+            FAIL() << "Expected the receive to time out";
+        } catch (Networking::NetworkException& exception) {
+            EXPECT_EQ(exception.GetErrorCode(), ETIMEDOUT);
+        }
+        lease.Invalidate();
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+    EXPECT_EQ(pool.GetStats().idle, 0u);
+
+    server.Stop();
+    runThread.join();
+}
+
+TEST(NetworkingTest, SendFileStreamsWholeFilesAndRanges) {
+    const int testPort = 12361;
+    const std::string sourcePath = "sendfile_test_source.bin";
+    const std::string wholePath = "sendfile_test_whole.bin";
+    const std::string rangePath = "sendfile_test_range.bin";
+
+    // Binary content with NULs, larger than one fallback chunk
+    std::string content(3 * Networking::FILE_TRANSFER_CHUNK_SIZE + 123, '\0');
+    for (size_t i = 0; i < content.size(); ++i) {
+        content[i] = static_cast<char>((i * 31) % 251);
+    }
+    {
+        std::ofstream source(sourcePath, std::ios::binary);
+        source.write(content.data(), content.size());
+    }
+
+    Networking::Server server(testPort);
+    long long wholeSent = 0;
+    long long rangeSent = 0;
+    std::thread serverThread([&]() {
+        Networking::ClientConnection clientConn = server.Accept();
+        wholeSent = server.SendFile(sourcePath, clientConn);
+        rangeSent = server.SendFile(sourcePath, clientConn, 1000, 70000);
+        server.DisconnectClient(clientConn);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    Networking::Client client("127.0.0.1", testPort);
+    ASSERT_TRUE(client.IsConnected());
+    EXPECT_EQ(client.ReceiveFile(wholePath), (long long)content.size());
+    EXPECT_EQ(client.ReceiveFile(rangePath), 70000);
+    serverThread.join();
+    client.Disconnect();
+    server.Shutdown();
+
+    EXPECT_EQ(wholeSent, (long long)content.size());
+    EXPECT_EQ(rangeSent, 70000);
+    auto readAll = [](const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    };
+    EXPECT_TRUE(readAll(wholePath) == content);
+    EXPECT_TRUE(readAll(rangePath) == content.substr(1000, 70000));
+
+    std::remove(sourcePath.c_str());
+    std::remove(wholePath.c_str());
+    std::remove(rangePath.c_str());
+}
+
+TEST(NetworkingTest, ReceiveFileMemoryDoesNotGrowWithFileSize) {
+    const int testPort = 12362;
+    const std::string sourcePath = "receivefile_test_large_source.bin";
+    const std::string targetPath = "receivefile_test_large_target.bin";
+    const size_t fileSize = 48 * 1024 * 1024;
+    {
+        std::ofstream source(sourcePath, std::ios::binary);
+        std::vector<char> block(1024 * 1024, 'z');
+        for (size_t written = 0; written < fileSize; written += block.size()) {
+            source.write(block.data(), block.size());
+        }
+    }
+
+    rusage before;
+    getrusage(RUSAGE_SELF, &before);
+
+    Networking::Server server(testPort);
+    std::thread serverThread([&]() {
+        Networking::ClientConnection clientConn = server.Accept();
+        server.SendFile(sourcePath, clientConn);
+        server.DisconnectClient(clientConn);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    Networking::Client client("127.0.0.1", testPort);
+    ASSERT_TRUE(client.IsConnected());
+    EXPECT_EQ(client.ReceiveFile(targetPath), (long long)fileSize);
+    serverThread.join();
+    client.Disconnect();
+    server.Shutdown();
+
+    rusage after;
+    getrusage(RUSAGE_SELF, &after);
+    // ru_maxrss is in KiB; buffering the file would add at least its size
+    EXPECT_LT(after.ru_maxrss - before.ru_maxrss, 8 * 1024);
+
+    struct stat targetInfo;
+    ASSERT_EQ(stat(targetPath.c_str(), &targetInfo), 0);
+    EXPECT_EQ((size_t)targetInfo.st_size, fileSize);
+    std::remove(sourcePath.c_str());
+    std::remove(targetPath.c_str());
+}
+
+TEST(NetworkingTest, ReceiveFileRefusesStreamsLargerThanTheLimit) {
+    const int testPort = 12363;
+    const std::string sourcePath = "receivefile_test_limit_source.bin";
+    const std::string targetPath = "receivefile_test_limit_target.bin";
+    {
+        std::ofstream source(sourcePath, std::ios::binary);
+        source << std::string(10000, 'a');
+    }
+
+    Networking::Server server(testPort);
+    std::thread serverThread([&]() {
+        Networking::ClientConnection clientConn = server.Accept();
+        server.SendFile(sourcePath, clientConn);
+        server.DisconnectClient(clientConn);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    Networking::Client client("127.0.0.1", testPort);
+    ASSERT_TRUE(client.IsConnected());
+    int errorCode = 0;
+    try {
+        client.ReceiveFile(targetPath, 4096);
+    } catch (Networking::NetworkException& exception) {
+        errorCode = exception.GetErrorCode();
+    }
+    serverThread.join();
+    server.Shutdown();
+
+    EXPECT_EQ(errorCode, EFBIG);
+    EXPECT_FALSE(client.IsConnected());
+    std::ifstream target(targetPath);
+    EXPECT_FALSE(target.good());
+    std::remove(sourcePath.c_str());
+}
+
+TEST(NetworkingTest, ReceiveFileStreamCopiesWhenTheFileCannotSplice) {
+    const std::string sourcePath = "receivefile_test_append_source.bin";
+    const std::string targetPath = "receivefile_test_append_target.bin";
+    std::string content(300000, '\0');
+    for (size_t i = 0; i < content.size(); ++i) {
+        content[i] = static_cast<char>(i % 253);
+    }
+    {
+        std::ofstream source(sourcePath, std::ios::binary);
+        source.write(content.data(), content.size());
+    }
+
+    int sockets[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+    std::thread sender([&]() {
+        Networking::SendFileRange(sockets[0], sourcePath);
+    });
+
+    // Splicing into a file opened for appending fails with EINVAL
+    int targetFd = open(targetPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    ASSERT_GE(targetFd, 0);
+    EXPECT_EQ(Networking::ReceiveFileStream(sockets[1], targetFd), (long long)content.size());
+    sender.join();
+    close(targetFd);
+    close(sockets[0]);
+    close(sockets[1]);
+
+    std::ifstream target(targetPath, std::ios::binary);
+    std::string received((std::istreambuf_iterator<char>(target)), std::istreambuf_iterator<char>());
+    EXPECT_TRUE(received == content);
+    std::remove(sourcePath.c_str());
+    std::remove(targetPath.c_str());
+}
+
+TEST(NetworkingTest, TryCallsReportPeerHangupsWithoutThrowing) {
+    const int testPort = 12374;
+    Networking::Server server(testPort);
+    ASSERT_TRUE(server.ServerIsRunning());
+
+    Networking::Client client("127.0.0.1", testPort);
+    ASSERT_TRUE(client.IsConnected());
+    Networking::Result<Networking::ClientConnection> accepted = server.TryAccept();
+    ASSERT_TRUE(accepted.IsOk());
+    Networking::ClientConnection connection = accepted.Value();
+
+    Networking::Result<long> sent = client.TrySendFrame("ping", 4, 7);
+    ASSERT_TRUE(sent.IsOk());
+    EXPECT_EQ(sent.Value(), 4);
+    uint32_t requestId = 0;
+    Networking::Result<Networking::SharedBuffer> frame = server.TryReceiveFrame(connection, requestId);
+    ASSERT_TRUE(frame.IsOk());
+    EXPECT_EQ(std::string(frame.Value()->begin(), frame.Value()->end()), "ping");
+    EXPECT_EQ(requestId, 7u);
+
+    // Closing between frames is an orderly hangup, not a failure to unwind
+    client.Disconnect();
+    frame = server.TryReceiveFrame(connection, requestId);
+    ASSERT_FALSE(frame.IsOk());
+    EXPECT_TRUE(frame.GetError().IsPeerClosed());
+    EXPECT_EQ(frame.GetError().code, 0);
+    EXPECT_EQ(requestId, 0u);
+
+    // Writing to the closed peer soon fails with a reset or broken pipe
+    std::string payload(64 * 1024, 'x');
+    Networking::Result<long> reply = 0L;
+    for (int i = 0; i < 100 && reply.IsOk(); ++i)
+        reply = server.TrySendFrame(payload.data(), payload.size(), connection);
+    ASSERT_FALSE(reply.IsOk());
+    EXPECT_TRUE(reply.GetError().IsPeerClosed());
+    server.DisconnectClient(connection);
+
+    // The client side sees the server hanging up the same way
+    Networking::Client second("127.0.0.1", testPort);
+    ASSERT_TRUE(second.IsConnected());
+    accepted = server.TryAccept();
+    ASSERT_TRUE(accepted.IsOk());
+    server.DisconnectClient(accepted.Value());
+    Networking::Result<std::vector<char>> received = second.TryReceiveFrame(requestId);
+    ASSERT_FALSE(received.IsOk());
+    EXPECT_EQ(received.GetError().kind, Networking::ErrorKind::PeerClosed);
+    EXPECT_TRUE(second.ReceiveFrame().empty());
+    second.Disconnect();
+
+    Networking::Result<long> oversized = second.TrySendFrame(payload.data(), Networking::DEFAULT_MAX_MESSAGE_SIZE + 1);
+    ASSERT_FALSE(oversized.IsOk());
+    EXPECT_EQ(oversized.GetError().code, EMSGSIZE);
+    EXPECT_EQ(oversized.GetError().kind, Networking::ErrorKind::Protocol);
+}
+
+TEST(NetworkingTest, IdleAndExcessConnectionsAreClosed) {
+    const int testPort = 12375;
+    Networking::Server server(testPort);
+    server.SetKeepAlive(true);
+    server.SetIdleTimeout(std::chrono::milliseconds(300));
+    server.SetMaxConnections(2);
+
+    std::thread runThread([&]() {
+        server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+            server.SendFrame(message.data(), message.size(), c);
+        }, Networking::ServerMode::Epoll);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    Networking::Client active("127.0.0.1", testPort);
+    Networking::Client idle("127.0.0.1", testPort);
+    ASSERT_TRUE(active.IsConnected());
+    ASSERT_TRUE(idle.IsConnected());
+    active.SendFrame(std::string("hello"));
+    EXPECT_EQ(active.ReceiveFrame().size(), 5u);
+    EXPECT_EQ(server.getClients()->size(), 2u);
+
+    // A third connection is over the limit and closed at once
+    Networking::Client excess("127.0.0.1", testPort);
+    uint32_t requestId;
+    Networking::Result<std::vector<char>> refused = excess.TryReceiveFrame(requestId);
+    EXPECT_TRUE(refused.GetError().IsPeerClosed());
+    excess.Disconnect();
+
+    // The connection that keeps talking survives while the silent one is reaped
+    for (int i = 0; i < 6; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        active.SendFrame(std::string("ping"));
+        EXPECT_EQ(active.ReceiveFrame().size(), 4u);
+    }
+    Networking::Result<std::vector<char>> reaped = idle.TryReceiveFrame(requestId);
+    EXPECT_TRUE(reaped.GetError().IsPeerClosed());
+    idle.Disconnect();
+    EXPECT_EQ(server.getClients()->size(), 1u);
+    active.Disconnect();
+
+    server.Stop();
+    runThread.join();
+}
+
+TEST(NetworkingTest, BroadcastDropsThenDisconnectsSlowReceivers) {
+    const int testPort = 12376;
+    const size_t frameCount = 64;
+    Networking::Server server(testPort);
+    server.SetKeepAlive(true);
+
+    std::thread runThread([&]() {
+        server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+            server.SendFrame(message.data(), message.size(), c);
+        }, Networking::ServerMode::Epoll);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    Networking::Client reader("127.0.0.1", testPort);
+    Networking::Client slow("127.0.0.1", testPort);
+    ASSERT_TRUE(reader.IsConnected());
+    ASSERT_TRUE(slow.IsConnected());
+    for (int i = 0; i < 50 && server.getClients()->size() < 2; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_EQ(server.getClients()->size(), 2u);
+
+    std::atomic<size_t> framesRead{0};
+    std::thread readerThread([&]() {
+        uint32_t requestId;
+        while (reader.TryReceiveFrame(requestId))
+            framesRead++;
+    });
+
+    std::mutex statusMutex;
+    std::map<SOCKET, std::map<Networking::DeliveryStatus, size_t> > statuses;
+    Networking::DeliveryCallback record = [&](const Networking::ClientConnection& c, Networking::DeliveryStatus status) {
+        std::lock_guard<std::mutex> lock(statusMutex);
+        statuses[c.clientSocket][status]++;
+    };
+
+    // The reader keeps up with every frame while the client that never reads
+    // falls more than the high-water mark behind and misses some
+    std::vector<char> payload(256 * 1024, 'b');
+    Networking::BroadcastOptions options;
+    options.highWaterMark = 1024 * 1024;
+    for (size_t i = 0; i < frameCount; ++i) {
+        EXPECT_EQ(server.Broadcast(payload.data(), payload.size(), record, options), 2u);
+        for (int wait = 0; wait < 500 && framesRead < i + 1; ++wait)
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    ASSERT_EQ(framesRead.load(), frameCount);
+
+    SOCKET slowSocket = -1;
+    {
+        std::lock_guard<std::mutex> lock(statusMutex);
+        ASSERT_EQ(statuses.size(), 2u);
+        for (auto& entry : statuses) {
+            if (entry.second[Networking::DeliveryStatus::Dropped] > 0)
+                slowSocket = entry.first;
+            else
+                EXPECT_EQ(entry.second[Networking::DeliveryStatus::Sent], frameCount);
+        }
+    }
+    ASSERT_NE(slowSocket, -1);
+
+    // Under the disconnect policy the slow client is closed instead
+    options.policy = Networking::SlowReceiverPolicy::Disconnect;
+    server.Broadcast(payload.data(), payload.size(), record, options);
+    for (int wait = 0; wait < 200 && server.getClients()->size() > 1; ++wait)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(server.getClients()->size(), 1u);
+    {
+        std::lock_guard<std::mutex> lock(statusMutex);
+        EXPECT_EQ(statuses[slowSocket][Networking::DeliveryStatus::Disconnected], 1u);
+    }
+
+    // Stopping the server closes the reader's connection and ends its thread
+    server.Stop();
+    runThread.join();
+    readerThread.join();
+    reader.Disconnect();
+    slow.Disconnect();
+}
+
+TEST(NetworkingTest, CompressedFramesRoundTripInEveryMode) {
+    const Networking::ServerMode modes[] = {Networking::ServerMode::Blocking, Networking::ServerMode::Epoll, Networking::ServerMode::Uring};
+    std::string text;
+    for (int i = 0; i < 3000; ++i)
+        text += "INFO node-" + std::to_string(i % 5) + " replicated file_" + std::to_string(i % 40) + ".log\n";
+
+    int testPort = 12377;
+    for (Networking::ServerMode mode : modes) {
+        Networking::Server server(testPort);
+        server.SetCompressionThreshold(256);
+        std::thread runThread([&]() {
+            server.Run([&](Networking::ClientConnection c, const std::vector<char>& message) {
+                server.SendFrame(message.data(), message.size(), c);
+            }, mode);
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+        Networking::Client client("127.0.0.1", testPort);
+        ASSERT_TRUE(client.IsConnected());
+        client.SetCompression(Networking::CompressionCodec::Lz, 256);
+        Networking::CompressionStats before = Networking::GetCompressionStats();
+        client.SendFrame(text);
+        std::vector<char> echoed = client.ReceiveFrame();
+        EXPECT_EQ(std::string(echoed.begin(), echoed.end()), text);
+
+        // The request and the reply both went over the wire compressed
+        Networking::CompressionStats after = Networking::GetCompressionStats();
+        EXPECT_EQ(after.framesCompressed - before.framesCompressed, 2u);
+        EXPECT_EQ(after.framesDecompressed - before.framesDecompressed, 2u);
+        EXPECT_LT(after.bytesAfterCompression - before.bytesAfterCompression, text.size() / 2);
+        client.Disconnect();
+
+        server.Stop();
+        runThread.join();
+        testPort++;
+    }
+}
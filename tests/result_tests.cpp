@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+#include "result.h"
+#include "errorcodes.h"
+#include <cerrno>
+#include <string>
+#include <vector>
+
+TEST(ResultTests, ErrnoValuesAreClassified)
+{
+	EXPECT_EQ(Networking::ClassifyError(0), Networking::ErrorKind::PeerClosed);
+	EXPECT_EQ(Networking::ClassifyError(ECONNRESET), Networking::ErrorKind::PeerClosed);
+	EXPECT_EQ(Networking::ClassifyError(EPIPE), Networking::ErrorKind::PeerClosed);
+	EXPECT_EQ(Networking::ClassifyError(EAGAIN), Networking::ErrorKind::WouldBlock);
+	EXPECT_EQ(Networking::ClassifyError(EWOULDBLOCK), Networking::ErrorKind::WouldBlock);
+	EXPECT_EQ(Networking::ClassifyError(EINTR), Networking::ErrorKind::Interrupted);
+	EXPECT_EQ(Networking::ClassifyError(ETIMEDOUT), Networking::ErrorKind::TimedOut);
+	EXPECT_EQ(Networking::ClassifyError(EMSGSIZE), Networking::ErrorKind::Protocol);
+	EXPECT_EQ(Networking::ClassifyError(EMFILE), Networking::ErrorKind::Resources);
+	EXPECT_EQ(Networking::ClassifyError(EBADF), Networking::ErrorKind::Fatal);
+
+	EXPECT_TRUE(Networking::IoError::FromCode(EAGAIN).IsTransient());
+	EXPECT_TRUE(Networking::IoError::FromCode(EINTR).IsTransient());
+	EXPECT_FALSE(Networking::IoError::FromCode(ECONNRESET).IsTransient());
+	EXPECT_TRUE(Networking::IoError::FromCode(ECONNRESET).IsPeerClosed());
+}
+
+TEST(ResultTests, ResultHoldsEitherAValueOrAnError)
+{
+	Networking::Result<std::vector<char>> ok(std::vector<char>{'a', 'b'});
+	ASSERT_TRUE(ok.IsOk());
+	EXPECT_TRUE(static_cast<bool>(ok));
+	EXPECT_EQ(ok.Value().size(), 2u);
+	EXPECT_EQ(ok.GetError().kind, Networking::ErrorKind::None);
+
+	Networking::Result<long> failed = Networking::Result<long>::Failure(ECONNRESET);
+	EXPECT_FALSE(failed.IsOk());
+	EXPECT_EQ(failed.GetError().code, ECONNRESET);
+	EXPECT_EQ(failed.ValueOr(-1), -1);
+	EXPECT_FALSE(failed.GetError().Message().empty());
+
+	// A zero code is an orderly close, which still counts as a failure
+	Networking::Result<long> closed = Networking::Result<long>::Failure(0);
+	EXPECT_FALSE(closed.IsOk());
+	EXPECT_TRUE(closed.GetError().IsPeerClosed());
+}
+
+TEST(ResultTests, ErrorMessageFallsBackForUnmappedCodes)
+{
+	EXPECT_EQ(Networking::ErrorMessage(Networking::Error::sendMap, EPIPE), "Broken pipe");
+	// ETIMEDOUT is not in sendMap; the lookup must not throw std::out_of_range
+	EXPECT_EQ(Networking::ErrorMessage(Networking::Error::sendMap, ETIMEDOUT), std::string(strerror(ETIMEDOUT)));
+	try
+	{
+		Networking::ThrowSendException(3, ETIMEDOUT);
+		FAIL() << "ThrowSendException returned";
+	}
+	catch(Networking::NetworkException& ex)
+	{
+		EXPECT_EQ(ex.GetErrorCode(), ETIMEDOUT);
+	}
+}
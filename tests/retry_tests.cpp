@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include "retry.h"
+#include <chrono>
+#include <thread>
+
+TEST(RetryTests, DeadlineTracksRemainingTime)
+{
+	Networking::Deadline never;
+	EXPECT_FALSE(never.IsSet());
+	EXPECT_FALSE(never.Expired());
+	EXPECT_EQ(never.PollTimeout(), -1);
+
+	Networking::Deadline deadline = Networking::Deadline::After(std::chrono::milliseconds(50));
+	EXPECT_TRUE(deadline.IsSet());
+	EXPECT_FALSE(deadline.Expired());
+	EXPECT_GT(deadline.PollTimeout(), 0);
+	EXPECT_LE(deadline.Remaining(), std::chrono::milliseconds(50));
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	EXPECT_TRUE(deadline.Expired());
+	EXPECT_EQ(deadline.Remaining(), std::chrono::milliseconds(0));
+	EXPECT_EQ(deadline.PollTimeout(), 0);
+}
+
+TEST(RetryTests, BackoffIsJitteredBelowAnExponentialCap)
+{
+	Networking::RetryPolicy policy;
+	policy.initialDelay = std::chrono::milliseconds(10);
+	policy.maxDelay = std::chrono::milliseconds(100);
+
+	bool varied = false;
+	for(int retry = 0; retry < 8; retry++)
+	{
+		long long cap = std::min(10LL << retry, 100LL);
+		std::chrono::milliseconds first = policy.BackoffDelay(retry);
+		for(int sample = 0; sample < 50; sample++)
+		{
+			std::chrono::milliseconds delay = policy.BackoffDelay(retry);
+			EXPECT_GE(delay.count(), 0);
+			EXPECT_LE(delay.count(), cap);
+			varied = varied || delay != first;
+		}
+	}
+	// Callers that failed together must not all retry at the same moment
+	EXPECT_TRUE(varied);
+}
+
+TEST(RetryTests, WaitBeforeRetryRespectsRetryCountAndDeadline)
+{
+	Networking::RetryPolicy policy;
+	policy.maxRetries = 2;
+	policy.initialDelay = std::chrono::milliseconds(1);
+	policy.maxDelay = std::chrono::milliseconds(1);
+	EXPECT_TRUE(policy.WaitBeforeRetry(0));
+	EXPECT_TRUE(policy.WaitBeforeRetry(1));
+	EXPECT_FALSE(policy.WaitBeforeRetry(2));
+
+	// A delay that would outlast the deadline is not slept at all
+	policy.initialDelay = std::chrono::milliseconds(10000);
+	policy.maxDelay = std::chrono::milliseconds(10000);
+	policy.maxRetries = 100;
+	Networking::Deadline deadline = Networking::Deadline::After(std::chrono::milliseconds(20));
+	auto start = std::chrono::steady_clock::now();
+	for(int retry = 0; retry < 100 && policy.WaitBeforeRetry(retry, deadline); retry++)
+	{
+	}
+	EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+}
+
+TEST(RetryTests, CircuitBreakerOpensAndProbesAfterTheOpenDuration)
+{
+	Networking::CircuitBreaker breaker(3, std::chrono::milliseconds(50));
+	const std::string peer = "10.0.0.1:9000";
+
+	for(int i = 0; i < 3; i++)
+	{
+		ASSERT_TRUE(breaker.Allow(peer));
+		breaker.RecordFailure(peer);
+	}
+	EXPECT_EQ(breaker.GetState(peer), Networking::CircuitBreaker::State::Open);
+	EXPECT_FALSE(breaker.Allow(peer));
+	// Other peers are unaffected
+	EXPECT_TRUE(breaker.Allow("10.0.0.2:9000"));
+
+	// After the open duration a single probe goes through
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	EXPECT_TRUE(breaker.Allow(peer));
+	EXPECT_EQ(breaker.GetState(peer), Networking::CircuitBreaker::State::HalfOpen);
+	EXPECT_FALSE(breaker.Allow(peer));
+
+	// A failed probe reopens the circuit at once
+	breaker.RecordFailure(peer);
+	EXPECT_FALSE(breaker.Allow(peer));
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	EXPECT_TRUE(breaker.Allow(peer));
+	breaker.RecordSuccess(peer);
+	EXPECT_EQ(breaker.GetState(peer), Networking::CircuitBreaker::State::Closed);
+	EXPECT_TRUE(breaker.Allow(peer));
+}
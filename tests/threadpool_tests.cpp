@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include "threadpool.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+TEST(ThreadPoolTests, RunsEverySubmittedTask)
+{
+	std::atomic<int> counter{0};
+	{
+		ThreadPool pool(4, 16);
+		for (int i = 0; i < 1000; ++i) {
+			ASSERT_TRUE(pool.Submit([&counter]() { counter++; }));
+		}
+	} // Destruction drains the queues
+
+	EXPECT_EQ(counter, 1000);
+}
+
+TEST(ThreadPoolTests, TrySubmitRejectsWhenGlobalQueueIsFull)
+{
+	ThreadPool pool(1, 2);
+	std::mutex mutex;
+	std::condition_variable released;
+	bool release = false;
+	std::atomic<bool> started{false};
+
+	// Occupy the only worker so that queued tasks stay queued
+	ASSERT_TRUE(pool.Submit([&]() {
+		started = true;
+		std::unique_lock<std::mutex> lock(mutex);
+		released.wait(lock, [&]() { return release; });
+	}));
+	while (!started) {
+		std::this_thread::yield();
+	}
+
+	EXPECT_TRUE(pool.TrySubmit([]() {}));
+	EXPECT_TRUE(pool.TrySubmit([]() {}));
+	EXPECT_FALSE(pool.TrySubmit([]() {}));
+
+	ThreadPool::Stats stats = pool.GetStats();
+	EXPECT_EQ(stats.globalQueueDepth, 2u);
+	EXPECT_EQ(stats.rejected, 1u);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		release = true;
+	}
+	released.notify_all();
+	pool.Shutdown();
+
+	stats = pool.GetStats();
+	EXPECT_EQ(stats.executed, 3u);
+	EXPECT_EQ(stats.globalQueueDepth, 0u);
+}
+
+TEST(ThreadPoolTests, IdleWorkerStealsFromBusyWorker)
+{
+	const int subtasks = 10;
+	ThreadPool pool(2, 4);
+	std::atomic<int> completed{0};
+
+	// The parent queues subtasks on its own deque and then blocks, so only
+	// the other worker can run them
+	ASSERT_TRUE(pool.Submit([&]() {
+		for (int i = 0; i < subtasks; ++i) {
+			pool.Submit([&completed]() { completed++; });
+		}
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+		while (completed < subtasks && std::chrono::steady_clock::now() < deadline) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}));
+	pool.Shutdown();
+
+	ThreadPool::Stats stats = pool.GetStats();
+	EXPECT_EQ(completed, subtasks);
+	EXPECT_EQ(stats.steals, (uint64_t)subtasks);
+	EXPECT_EQ(stats.localQueueDepth, 0u);
+	EXPECT_EQ(stats.executed, (uint64_t)subtasks + 1);
+}
+
+TEST(ThreadPoolTests, SubmitFailsAfterShutdown)
+{
+	ThreadPool pool(2);
+	EXPECT_EQ(pool.GetWorkerCount(), 2u);
+	pool.Shutdown();
+	EXPECT_FALSE(pool.Submit([]() {}));
+	EXPECT_FALSE(pool.TrySubmit([]() {}));
+}